@@ -6,6 +6,7 @@
 #include "profile/profile.h"
 #include "util/bitflag.h"
 #include "util/util.h"
+#include <algorithm>
 
 // Scout info
 static const uint32_t BOT_SCOUT_INFO_ENEMY_HAS_DETECTIVES = 1;
@@ -1167,18 +1168,15 @@ ivec2 bot_get_position_near_hall_away_from_miners(const MatchState& state, ivec2
 }
 
 EntityId bot_find_nearest_idle_worker(const MatchState& state, const Bot& bot, ivec2 cell) {
-    return match_find_best_entity(state, (MatchFindBestEntityParams) {
-        .filter = [&bot](const Entity& entity, EntityId entity_id) {
-            return entity.type == ENTITY_MINER && 
-                    entity.player_id == bot.player_id &&
-                    ((entity.mode == MODE_UNIT_IDLE &&
-                        entity.target.type == TARGET_NONE) ||
-                     (entity.mode == MODE_UNIT_MOVE &&
-                        entity.target.type == TARGET_CELL)) &&
-                    entity_id != bot.scout_id &&
-                    !bot_is_entity_reserved(bot, entity_id);
-        },
-        .compare = match_compare_closest_manhattan_distance_to(cell)
+    return match_find_nearest_entity(state, cell, [&bot](const Entity& entity, EntityId entity_id) {
+        return entity.type == ENTITY_MINER && 
+                entity.player_id == bot.player_id &&
+                ((entity.mode == MODE_UNIT_IDLE &&
+                    entity.target.type == TARGET_NONE) ||
+                 (entity.mode == MODE_UNIT_MOVE &&
+                    entity.target.type == TARGET_CELL)) &&
+                entity_id != bot.scout_id &&
+                !bot_is_entity_reserved(bot, entity_id);
     });
 }
 
@@ -1544,13 +1542,10 @@ EntityId bot_find_builder(const MatchState& state, const Bot& bot, ivec2 near_ce
     }
 
     // Then try a worker from the gold mine
-    return match_find_best_entity(state, (MatchFindBestEntityParams) {
-        .filter = [&state, &bot](const Entity& entity, EntityId /*entity_id*/) {
-            return entity.player_id == bot.player_id &&
-                    entity_is_selectable(entity) &&
-                    entity_is_mining(state, entity);
-        },
-        .compare = match_compare_closest_manhattan_distance_to(near_cell)
+    return match_find_nearest_entity(state, near_cell, [&state, &bot](const Entity& entity, EntityId /*entity_id*/) {
+        return entity.player_id == bot.player_id &&
+                entity_is_selectable(entity) &&
+                entity_is_mining(state, entity);
     });
 }
 
@@ -1968,15 +1963,12 @@ MatchInput bot_squad_update(const MatchState& state, Bot& bot, BotSquad& squad,
             // Check if there is an enemy nearby
             EntityId nearby_enemy_id = unit_is_engaged
                 ? ID_NULL
-                : match_find_best_entity(state, (MatchFindBestEntityParams) {
-                    .filter = [&state, &unit](const Entity& enemy, EntityId /*enemy_id*/) {
-                        return !entity_is_misc(enemy.type) &&
-                                state.players[enemy.player_id].team != state.players[unit.player_id].team &&
-                                entity_is_selectable(enemy) &&
-                                ivec2::manhattan_distance(enemy.cell, unit.cell) < BOT_NEAR_DISTANCE &&
-                                entity_is_visible_to_player(state, enemy, unit.player_id);
-                    },
-                    .compare = match_compare_closest_manhattan_distance_to(unit.cell)
+                : match_find_nearest_entity(state, unit.cell, [&state, &unit](const Entity& enemy, EntityId /*enemy_id*/) {
+                    return !entity_is_misc(enemy.type) &&
+                            state.players[enemy.player_id].team != state.players[unit.player_id].team &&
+                            entity_is_selectable(enemy) &&
+                            ivec2::manhattan_distance(enemy.cell, unit.cell) < BOT_NEAR_DISTANCE &&
+                            entity_is_visible_to_player(state, enemy, unit.player_id);
                 });
             if (nearby_enemy_id != ID_NULL) {
                 unit_is_engaged = true;
@@ -2617,54 +2609,136 @@ MatchInput bot_squad_pyro_micro(const MatchState& state, Bot& bot, BotSquad& squ
     return input;
 }
 
-int bot_squad_get_molotov_cell_score(const MatchState& state, const Entity& pyro, ivec2 cell) {
-    if (!map_is_cell_in_bounds(state.map, cell) ||
-            map_get_cell(state.map, CELL_LAYER_GROUND, cell).type == CELL_BLOCKED) {
-        return 0;
-    }
+// A molotov thrown at a cell sets fire to the cells from cell - PROJECTILE_MOLOTOV_FIRE_SPREAD
+// to cell + PROJECTILE_MOLOTOV_FIRE_SPREAD - 1, minus the corners of that square.
+// Every cell in the search window is scored against the fire cells around it, so instead of scoring
+// each cell on its own, the fire cell weights are baked once into a summed-area table and each cell's
+// score is a box sum from the table with the corners taken back out.
+//
+// Entities are only counted once per molotov even when the fire covers more than one of their cells.
+// Entities that show up in a single cell of the heatmap can't be counted twice, so they go into the table
+// like any other weight, and entities that show up in more than one cell are stamped onto the window cells they would be counted by.
+ivec2 bot_squad_find_best_molotov_cell(const MatchState& state, const Entity& pyro, ivec2 attack_point) {
+    ZoneScoped;
 
-    int score = 0;
-    std::unordered_map<EntityId, bool> entity_considered;
+    static const int MINIMUM_MOLOTOV_CELL_SCORE = 4;
+    static const int WINDOW_SIZE = BOT_NEAR_DISTANCE * 2;
+    static const int FIRE_SIZE = PROJECTILE_MOLOTOV_FIRE_SPREAD * 2;
+    static const int HEATMAP_SIZE = WINDOW_SIZE + FIRE_SIZE - 1;
+    static const int SUM_TABLE_SIZE = HEATMAP_SIZE + 1;
 
-    for (int y = cell.y - PROJECTILE_MOLOTOV_FIRE_SPREAD; y < cell.y + PROJECTILE_MOLOTOV_FIRE_SPREAD; y++) {
-        for (int x = cell.x - PROJECTILE_MOLOTOV_FIRE_SPREAD; x < cell.x + PROJECTILE_MOLOTOV_FIRE_SPREAD; x++) {
-            // Don't count the corners of the square
-            if ((y == cell.y - PROJECTILE_MOLOTOV_FIRE_SPREAD || y == cell.y + PROJECTILE_MOLOTOV_FIRE_SPREAD - 1) &&
-                    (x == cell.x - PROJECTILE_MOLOTOV_FIRE_SPREAD || x == cell.x + PROJECTILE_MOLOTOV_FIRE_SPREAD - 1)) {
-                continue;
-            }
+    const ivec2 window_origin = attack_point - ivec2(BOT_NEAR_DISTANCE, BOT_NEAR_DISTANCE);
+    const ivec2 heatmap_origin = window_origin - ivec2(PROJECTILE_MOLOTOV_FIRE_SPREAD, PROJECTILE_MOLOTOV_FIRE_SPREAD);
+    const uint8_t pyro_team = state.players[pyro.player_id].team;
 
-            ivec2 fire_cell = ivec2(x, y);
+    auto get_entity_weight = [&state, pyro_team](const Entity& entity) {
+        if (state.players[entity.player_id].team == pyro_team) {
+            return -2;
+        }
+        return entity_is_unit(entity.type) ? 2 : 1;
+    };
+    // Fire cell weights
+    std::vector<int> fire_cell_weights(HEATMAP_SIZE * HEATMAP_SIZE, 0);
+    // Pairs of entity id and heatmap index
+    std::vector<std::pair<EntityId, int>> entity_cells;
+    for (int y = 0; y < HEATMAP_SIZE; y++) {
+        for (int x = 0; x < HEATMAP_SIZE; x++) {
+            ivec2 fire_cell = heatmap_origin + ivec2(x, y);
             if (!map_is_cell_in_bounds(state.map, fire_cell)) {
                 continue;
             }
+            int& weight = fire_cell_weights[x + (y * HEATMAP_SIZE)];
             if (fire_cell == pyro.cell) {
-                score -= 4;
+                weight = -4;
                 continue;
             }
             if (match_is_cell_on_fire(state, fire_cell)) {
-                score--;
+                weight = -1;
                 continue;
             }
 
             Cell map_cell = map_get_cell(state.map, CELL_LAYER_GROUND, fire_cell);
             if (map_cell.type == CELL_BUILDING || map_cell.type == CELL_UNIT || map_cell.type == CELL_MINER) {
-                if (entity_considered.find(map_cell.id) != entity_considered.end()) {
-                    continue;
-                }
-                entity_considered[map_cell.id] = true;
+                entity_cells.push_back(std::make_pair(map_cell.id, x + (y * HEATMAP_SIZE)));
+            }
+        }
+    }
 
-                const Entity& target = state.entities.get_by_id(map_cell.id);
-                if (state.players[target.player_id].team == state.players[pyro.player_id].team) {
-                    score -= 2;
-                } else if (entity_is_unit(target.type)) {
-                    score += 2;
-                } else {
-                    score++;
+    // Group the entity cells by entity
+    std::sort(entity_cells.begin(), entity_cells.end());
+    std::vector<std::pair<uint32_t, uint32_t>> large_entity_cell_ranges;
+    uint32_t entity_cells_index = 0;
+    while (entity_cells_index < entity_cells.size()) {
+        uint32_t entity_cells_end = entity_cells_index + 1U;
+        while (entity_cells_end < entity_cells.size() && entity_cells[entity_cells_end].first == entity_cells[entity_cells_index].first) {
+            entity_cells_end++;
+        }
+
+        if (entity_cells_end - entity_cells_index == 1U) {
+            const Entity& entity = state.entities.get_by_id(entity_cells[entity_cells_index].first);
+            fire_cell_weights[entity_cells[entity_cells_index].second] = get_entity_weight(entity);
+        } else {
+            large_entity_cell_ranges.push_back(std::make_pair(entity_cells_index, entity_cells_end));
+        }
+        entity_cells_index = entity_cells_end;
+    }
+
+    // Summed-area table, with a row and column of zeroes in front so that box sums don't need bounds checks
+    std::vector<int> fire_cell_weight_sums(SUM_TABLE_SIZE * SUM_TABLE_SIZE, 0);
+    for (int y = 0; y < HEATMAP_SIZE; y++) {
+        for (int x = 0; x < HEATMAP_SIZE; x++) {
+            fire_cell_weight_sums[(x + 1) + ((y + 1) * SUM_TABLE_SIZE)] =
+                fire_cell_weights[x + (y * HEATMAP_SIZE)] +
+                fire_cell_weight_sums[x + ((y + 1) * SUM_TABLE_SIZE)] +
+                fire_cell_weight_sums[(x + 1) + (y * SUM_TABLE_SIZE)] -
+                fire_cell_weight_sums[x + (y * SUM_TABLE_SIZE)];
+        }
+    }
+
+    // Window scores start as the box sums of the fire cell weights
+    std::vector<int> molotov_cell_scores(WINDOW_SIZE * WINDOW_SIZE, 0);
+    for (int y = 0; y < WINDOW_SIZE; y++) {
+        for (int x = 0; x < WINDOW_SIZE; x++) {
+            // The fire square of window cell (x, y) starts at heatmap cell (x, y)
+            int box_sum =
+                fire_cell_weight_sums[(x + FIRE_SIZE) + ((y + FIRE_SIZE) * SUM_TABLE_SIZE)] -
+                fire_cell_weight_sums[x + ((y + FIRE_SIZE) * SUM_TABLE_SIZE)] -
+                fire_cell_weight_sums[(x + FIRE_SIZE) + (y * SUM_TABLE_SIZE)] +
+                fire_cell_weight_sums[x + (y * SUM_TABLE_SIZE)];
+            int corner_sum =
+                fire_cell_weights[x + (y * HEATMAP_SIZE)] +
+                fire_cell_weights[(x + FIRE_SIZE - 1) + (y * HEATMAP_SIZE)] +
+                fire_cell_weights[x + ((y + FIRE_SIZE - 1) * HEATMAP_SIZE)] +
+                fire_cell_weights[(x + FIRE_SIZE - 1) + ((y + FIRE_SIZE - 1) * HEATMAP_SIZE)];
+            molotov_cell_scores[x + (y * WINDOW_SIZE)] = box_sum - corner_sum;
+        }
+    }
+
+    // Stamp the entities that show up in more than one cell
+    std::vector<uint32_t> large_entity_stamps(WINDOW_SIZE * WINDOW_SIZE, 0);
+    for (uint32_t large_entity_index = 0; large_entity_index < large_entity_cell_ranges.size(); large_entity_index++) {
+        const std::pair<uint32_t, uint32_t>& range = large_entity_cell_ranges[large_entity_index];
+        const Entity& entity = state.entities.get_by_id(entity_cells[range.first].first);
+        const int entity_weight = get_entity_weight(entity);
+        const uint32_t stamp = large_entity_index + 1U;
+
+        for (uint32_t index = range.first; index < range.second; index++) {
+            // The fire squares that contain heatmap cell (x, y) belong to window cells (x - FIRE_SIZE + 1, y - FIRE_SIZE + 1) through (x, y)
+            int heatmap_index = entity_cells[index].second;
+            ivec2 fire_square_min = ivec2(heatmap_index % HEATMAP_SIZE, heatmap_index / HEATMAP_SIZE) - ivec2(FIRE_SIZE - 1, FIRE_SIZE - 1);
+            for (int y = std::max(fire_square_min.y, 0); y < std::min(fire_square_min.y + FIRE_SIZE, WINDOW_SIZE); y++) {
+                for (int x = std::max(fire_square_min.x, 0); x < std::min(fire_square_min.x + FIRE_SIZE, WINDOW_SIZE); x++) {
+                    bool is_corner = (y == fire_square_min.y || y == fire_square_min.y + FIRE_SIZE - 1) &&
+                                        (x == fire_square_min.x || x == fire_square_min.x + FIRE_SIZE - 1);
+                    if (is_corner || large_entity_stamps[x + (y * WINDOW_SIZE)] == stamp) {
+                        continue;
+                    }
+                    large_entity_stamps[x + (y * WINDOW_SIZE)] = stamp;
+                    molotov_cell_scores[x + (y * WINDOW_SIZE)] += entity_weight;
                 }
             }
         }
-    } // End for each fire y
+    }
 
     // Consider other existing or about to exist molotov fires
     std::vector<ivec2> existing_molotov_cells;
@@ -2681,28 +2755,28 @@ int bot_squad_get_molotov_cell_score(const MatchState& state, const Entity& pyro
         }
     }
     for (ivec2 existing_molotov_cell : existing_molotov_cells) {
-        int distance = ivec2::manhattan_distance(cell, existing_molotov_cell);
-        if (distance < PROJECTILE_MOLOTOV_FIRE_SPREAD) {
-            score -= (PROJECTILE_MOLOTOV_FIRE_SPREAD - distance) * 5;
+        ivec2 window_cell = existing_molotov_cell - window_origin;
+        for (int y = std::max(window_cell.y - PROJECTILE_MOLOTOV_FIRE_SPREAD + 1, 0); y < std::min(window_cell.y + PROJECTILE_MOLOTOV_FIRE_SPREAD, WINDOW_SIZE); y++) {
+            for (int x = std::max(window_cell.x - PROJECTILE_MOLOTOV_FIRE_SPREAD + 1, 0); x < std::min(window_cell.x + PROJECTILE_MOLOTOV_FIRE_SPREAD, WINDOW_SIZE); x++) {
+                int distance = ivec2::manhattan_distance(ivec2(x, y), window_cell);
+                if (distance < PROJECTILE_MOLOTOV_FIRE_SPREAD) {
+                    molotov_cell_scores[x + (y * WINDOW_SIZE)] -= (PROJECTILE_MOLOTOV_FIRE_SPREAD - distance) * 5;
+                }
+            }
         }
     }
 
-    return score;
-}
-
-ivec2 bot_squad_find_best_molotov_cell(const MatchState& state, const Entity& pyro, ivec2 attack_point) {
-    static const int MINIMUM_MOLOTOV_CELL_SCORE = 4;
     ivec2 best_molotov_cell = ivec2(-1, -1);
     int best_molotov_cell_score = MINIMUM_MOLOTOV_CELL_SCORE - 1;
-
-    for (int y = attack_point.y - BOT_NEAR_DISTANCE; y < attack_point.y + BOT_NEAR_DISTANCE; y++) {
-        for (int x = attack_point.x - BOT_NEAR_DISTANCE; x < attack_point.x + BOT_NEAR_DISTANCE; x++) {
-            ivec2 cell = ivec2(x, y);
-            if (!map_is_cell_in_bounds(state.map, cell)) {
+    for (int y = 0; y < WINDOW_SIZE; y++) {
+        for (int x = 0; x < WINDOW_SIZE; x++) {
+            ivec2 cell = window_origin + ivec2(x, y);
+            if (!map_is_cell_in_bounds(state.map, cell) ||
+                    map_get_cell(state.map, CELL_LAYER_GROUND, cell).type == CELL_BLOCKED) {
                 continue;
             }
 
-            int molotov_cell_score = bot_squad_get_molotov_cell_score(state, pyro, cell);
+            int molotov_cell_score = molotov_cell_scores[x + (y * WINDOW_SIZE)];
             if (molotov_cell_score > best_molotov_cell_score) {
                 best_molotov_cell = cell;
                 best_molotov_cell_score = molotov_cell_score;
@@ -3300,15 +3374,12 @@ void bot_update_base_info(const MatchState& state, Bot& bot) {
 
         // If there's no surrounding hall, fallback to the nearest building
         if (nearest_building_id == ID_NULL) {
-            nearest_building_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-                .filter = [&state, &bot, &goldmine](const Entity& building, EntityId building_id) {
-                    return entity_is_building(building.type) &&
-                            building.type != ENTITY_LANDMINE &&
-                            building.mode != MODE_BUILDING_DESTROYED &&
-                            ivec2::manhattan_distance(building.cell, goldmine.cell) < BOT_NEAR_DISTANCE &&
-                            bot_has_scouted_entity(state, bot, building, building_id);
-                },
-                .compare = match_compare_closest_manhattan_distance_to(goldmine.cell)
+            nearest_building_id = match_find_nearest_entity(state, goldmine.cell, [&state, &bot, &goldmine](const Entity& building, EntityId building_id) {
+                return entity_is_building(building.type) &&
+                        building.type != ENTITY_LANDMINE &&
+                        building.mode != MODE_BUILDING_DESTROYED &&
+                        ivec2::manhattan_distance(building.cell, goldmine.cell) < BOT_NEAR_DISTANCE &&
+                        bot_has_scouted_entity(state, bot, building, building_id);
             });
             if (nearest_building_id == ID_NULL) {
                 continue;
@@ -3498,40 +3569,31 @@ MatchInput bot_scout(const MatchState& state, Bot& bot, uint32_t match_timer) {
 
     // Flee if taking damage
     if (scout.taking_damage_timer != 0) {
-        EntityId attacker_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-            .filter = [&bot](const Entity& entity, EntityId /*entity_id*/) {
-                return entity_is_unit(entity.type) &&
-                    entity.health != 0 &&
-                    entity.target.type == TARGET_ATTACK_ENTITY &&
-                    entity.target.id == bot.scout_id;
-            },
-            .compare = match_compare_closest_manhattan_distance_to(scout.cell)
+        EntityId attacker_id = match_find_nearest_entity(state, scout.cell, [&bot](const Entity& entity, EntityId /*entity_id*/) {
+            return entity_is_unit(entity.type) &&
+                entity.health != 0 &&
+                entity.target.type == TARGET_ATTACK_ENTITY &&
+                entity.target.id == bot.scout_id;
         });
 
         if (attacker_id != ID_NULL) {
             const Entity& attacker = state.entities.get_by_id(attacker_id);
 
             // Check if close to a hall
-            EntityId hall_nearest_to_attacker_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-                .filter = [&attacker](const Entity& hall, EntityId /*hall_id*/) {
-                    return hall.type == ENTITY_HALL &&
-                        entity_is_selectable(hall) &&
-                        hall.player_id == attacker.player_id &&
-                        ivec2::manhattan_distance(hall.cell, attacker.cell) < BOT_NEAR_DISTANCE;
-                },
-                .compare = match_compare_closest_manhattan_distance_to(attacker.cell)
+            EntityId hall_nearest_to_attacker_id = match_find_nearest_entity(state, attacker.cell, [&attacker](const Entity& hall, EntityId /*hall_id*/) {
+                return hall.type == ENTITY_HALL &&
+                    entity_is_selectable(hall) &&
+                    hall.player_id == attacker.player_id &&
+                    ivec2::manhattan_distance(hall.cell, attacker.cell) < BOT_NEAR_DISTANCE;
             });
             if (bot.entities_to_scout.contains(hall_nearest_to_attacker_id)) {
                 bot_assume_entity_is_scouted(bot, hall_nearest_to_attacker_id);
             }
 
             // Check if close to a goldmine
-            EntityId goldmine_nearest_to_attacker_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-                .filter = [&attacker](const Entity& goldmine, EntityId /*goldmine_id*/) {
-                    return goldmine.type == ENTITY_GOLDMINE &&
-                        ivec2::manhattan_distance(goldmine.cell, attacker.cell) < BOT_NEAR_DISTANCE;
-                },
-                .compare = match_compare_closest_manhattan_distance_to(attacker.cell)
+            EntityId goldmine_nearest_to_attacker_id = match_find_nearest_entity(state, attacker.cell, [&attacker](const Entity& goldmine, EntityId /*goldmine_id*/) {
+                return goldmine.type == ENTITY_GOLDMINE &&
+                    ivec2::manhattan_distance(goldmine.cell, attacker.cell) < BOT_NEAR_DISTANCE;
             });
             if (bot.entities_to_scout.contains(goldmine_nearest_to_attacker_id)) {
                 bot_assume_entity_is_scouted(bot, goldmine_nearest_to_attacker_id);
@@ -4063,11 +4125,8 @@ MatchInput bot_update_building_rally_point(const MatchState& state, const Bot& b
 
 ivec2 bot_choose_building_rally_point(const MatchState& state, const Bot& bot, const Entity& building) {
     if (building.type == ENTITY_HALL) {
-        EntityId goldmine_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-            .filter = [](const Entity& goldmine, EntityId /*goldmine_id*/) {
-                return goldmine.type == ENTITY_GOLDMINE;
-            },
-            .compare = match_compare_closest_manhattan_distance_to(building.cell)
+        EntityId goldmine_id = match_find_nearest_entity(state, building.cell, [](const Entity& goldmine, EntityId /*goldmine_id*/) {
+            return goldmine.type == ENTITY_GOLDMINE;
         });
         const Entity& goldmine = state.entities.get_by_id(goldmine_id);
         return (goldmine.cell * TILE_SIZE) + ivec2((3 * TILE_SIZE) / 2, (3 * TILE_SIZE) / 2);
@@ -4267,13 +4326,10 @@ bool bot_does_entity_surround_goldmine(const Entity& entity, ivec2 goldmine_cell
 MatchInput bot_return_entity_to_nearest_hall(const MatchState& state, const Bot& bot, EntityId entity_id) {
     const Entity& entity = state.entities.get_by_id(entity_id);
 
-    EntityId nearest_hall_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-        .filter = [&bot](const Entity& hall, EntityId /*hall_id*/) {
-            return hall.type == ENTITY_HALL &&
-                entity_is_selectable(hall) &&
-                hall.player_id == bot.player_id;
-        },
-        .compare = match_compare_closest_manhattan_distance_to(entity.cell)
+    EntityId nearest_hall_id = match_find_nearest_entity(state, entity.cell, [&bot](const Entity& hall, EntityId /*hall_id*/) {
+        return hall.type == ENTITY_HALL &&
+            entity_is_selectable(hall) &&
+            hall.player_id == bot.player_id;
     });
 
     if (nearest_hall_id == ID_NULL) {
@@ -4281,11 +4337,8 @@ MatchInput bot_return_entity_to_nearest_hall(const MatchState& state, const Bot&
     }
 
     ivec2 nearest_hall_cell = state.entities.get_by_id(nearest_hall_id).cell;
-    EntityId nearest_goldmine_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-        .filter = [](const Entity& goldmine, EntityId /*goldmine_id*/) {
-            return goldmine.type == ENTITY_GOLDMINE;
-        },
-        .compare = match_compare_closest_manhattan_distance_to(nearest_hall_cell)
+    EntityId nearest_goldmine_id = match_find_nearest_entity(state, nearest_hall_cell, [](const Entity& goldmine, EntityId /*goldmine_id*/) {
+        return goldmine.type == ENTITY_GOLDMINE;
     });
     GOLD_ASSERT(nearest_goldmine_id != ID_NULL);
 
@@ -4305,13 +4358,10 @@ MatchInput bot_return_entity_to_nearest_hall(const MatchState& state, const Bot&
 MatchInput bot_unit_flee(const MatchState& state, const Bot& bot, EntityId entity_id) {
     const Entity& entity = state.entities.get_by_id(entity_id);
 
-    EntityId nearest_hall_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-        .filter = [&bot](const Entity& hall, EntityId /*hall_id*/) {
-            return hall.type == ENTITY_HALL &&
-                entity_is_selectable(hall) &&
-                hall.player_id == bot.player_id;
-        },
-        .compare = match_compare_closest_manhattan_distance_to(entity.cell)
+    EntityId nearest_hall_id = match_find_nearest_entity(state, entity.cell, [&bot](const Entity& hall, EntityId /*hall_id*/) {
+        return hall.type == ENTITY_HALL &&
+            entity_is_selectable(hall) &&
+            hall.player_id == bot.player_id;
     });
 
     if (nearest_hall_id == ID_NULL) {
@@ -5,9 +5,14 @@
 #include "container/fixed_queue.h"
 #include <cstdint>
 
-template <typename T, size_t capacity>
+// THot mirrors the few fields of T that get scanned every frame. The mirrors are packed contiguously
+// so that those scans can stream through a small array instead of pulling every item through cache.
+// THot must provide a static THot::from(const T&), which is used to refresh the mirror in push_back.
+// After an item is pushed, anything that writes a mirrored field must also write it through get_hot()
+template <typename T, size_t capacity, typename THot>
 struct IdArray {
     T data[capacity];
+    THot hot[capacity];
     EntityId ids[capacity];
     uint16_t id_to_index[ID_MAX];
     FixedQueue<uint16_t, ID_MAX> available_ids;
@@ -15,6 +20,7 @@ struct IdArray {
 
     IdArray() {
         memset(data, 0, sizeof(data));
+        memset(hot, 0, sizeof(hot));
         for (uint32_t index = 0; index < capacity; index++) {
             ids[index] = INDEX_INVALID;
         }
@@ -46,6 +52,24 @@ struct IdArray {
         return data[index];
     }
 
+    THot& get_hot(uint32_t index) {
+        GOLD_ASSERT(index != INDEX_INVALID && index <= _size);
+        return hot[index];
+    }
+    const THot& get_hot(uint32_t index) const {
+        GOLD_ASSERT(index != INDEX_INVALID && index <= _size);
+        return hot[index];
+    }
+
+    // Returns INDEX_INVALID if the item is a copy that does not live in this array
+    uint32_t get_index_of_item(const T& item) const {
+        uintptr_t item_address = (uintptr_t)&item;
+        if (item_address < (uintptr_t)data || item_address >= (uintptr_t)(data + _size)) {
+            return INDEX_INVALID;
+        }
+        return (uint32_t)(&item - data);
+    }
+
     uint32_t get_index_of(EntityId id) const {
         if (id == ID_NULL) {
             return INDEX_INVALID;
@@ -72,6 +96,7 @@ struct IdArray {
         id_to_index[id] = _size;
         ids[_size] = id;
         data[_size] = value;
+        hot[_size] = THot::from(value);
         _size++;
 
         return id;
@@ -83,6 +108,7 @@ struct IdArray {
 
         // swap 
         data[index] = data[_size - 1];
+        hot[index] = hot[_size - 1];
         ids[index] = ids[_size - 1];
         id_to_index[ids[index]] = index;
 
@@ -0,0 +1,57 @@
+#include "job.h"
+
+#include "core/logger.h"
+#include <SDL3/SDL.h>
+#include <algorithm>
+
+struct JobBatch {
+    const std::function<void(uint32_t job_index)>* job;
+    uint32_t job_count;
+    SDL_AtomicU32 next_job_index;
+};
+
+static int job_worker_run(void* user_data) {
+    JobBatch* batch = (JobBatch*)user_data;
+    while (true) {
+        uint32_t job_index = SDL_AddAtomicU32(&batch->next_job_index, 1);
+        if (job_index >= batch->job_count) {
+            break;
+        }
+        (*batch->job)(job_index);
+    }
+
+    return 0;
+}
+
+void job_parallel_for(uint32_t job_count, const std::function<void(uint32_t job_index)>& job) {
+    if (job_count == 0) {
+        return;
+    }
+
+    JobBatch batch;
+    batch.job = &job;
+    batch.job_count = job_count;
+    SDL_SetAtomicU32(&batch.next_job_index, 0);
+
+    // The calling thread works through the jobs too, so it counts as one of the workers
+    int core_count = SDL_GetNumLogicalCPUCores();
+    uint32_t worker_thread_count = std::min((uint32_t)std::max(core_count, 1), std::min(job_count, JOB_WORKER_COUNT_MAX)) - 1;
+
+    SDL_Thread* worker_threads[JOB_WORKER_COUNT_MAX];
+    uint32_t started_worker_thread_count = 0;
+    for (uint32_t worker_index = 0; worker_index < worker_thread_count; worker_index++) {
+        worker_threads[started_worker_thread_count] = SDL_CreateThread(job_worker_run, "job_worker_thread", &batch);
+        if (worker_threads[started_worker_thread_count] == NULL) {
+            // Whatever the missing worker would have done gets picked up by the others
+            log_warn("Unable to create job worker thread: %s", SDL_GetError());
+            break;
+        }
+        started_worker_thread_count++;
+    }
+
+    job_worker_run(&batch);
+
+    for (uint32_t worker_index = 0; worker_index < started_worker_thread_count; worker_index++) {
+        SDL_WaitThread(worker_threads[worker_index], NULL);
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "defines.h"
+#include <functional>
+
+/**
+ * Fork-join helper for spreading CPU heavy loading work, like noise and map generation, across cores.
+ *
+ * job_parallel_for() hands out the job indices to worker threads and to the calling thread,
+ * and returns once every job has finished. Jobs can run in any order and on any thread,
+ * so each job must only write to data that no other job touches.
+ */
+
+const uint32_t JOB_WORKER_COUNT_MAX = 8U;
+
+void job_parallel_for(uint32_t job_count, const std::function<void(uint32_t job_index)>& job);
@@ -3,45 +3,247 @@
 #include "core/filesystem.h"
 #include <SDL3/SDL.h>
 #include <cstdio>
+#include <cstdarg>
 
-static FILE* logfile;
+/**
+ * Log calls format their message straight into a slot of a fixed size ring buffer and return,
+ * and a writer thread drains the ring into the logfile. This keeps file IO off of the simulation thread.
+ *
+ * The ring is a bounded multi-producer queue. Each slot has a turn counter which tells the producers
+ * and the consumer whose turn it is to use the slot, so a zero-initialized ring is valid and
+ * log calls made before logger_init() or after logger_quit() work the same as any other.
+ *
+ * When the ring is full, messages are dropped and the writer reports how many were lost.
+ */
+
+#define LOGGER_RING_SIZE 1024U
+#define LOGGER_SLOT_MESSAGE_SIZE 504U
+#define LOGGER_WRITER_WAIT_MS 10
+#define LOGGER_WRITER_WAKE_INTERVAL (LOGGER_RING_SIZE / 8U)
+
+struct LoggerSlot {
+    SDL_AtomicU32 turn;
+    LogLevel log_level;
+    // Only set when the message did not fit in the slot, freed by the consumer
+    char* long_message;
+    char message[LOGGER_SLOT_MESSAGE_SIZE];
+};
+
+struct LoggerState {
+    FILE* logfile;
+
+    LoggerSlot ring[LOGGER_RING_SIZE];
+    SDL_AtomicU32 head;
+    SDL_AtomicU32 dropped_message_count;
+
+    // Held by whoever is draining the ring, so that the writer thread and a crash flush never consume at the same time
+    SDL_Mutex* consumer_mutex;
+    uint32_t tail;
+
+    SDL_Thread* writer_thread;
+    SDL_Semaphore* writer_semaphore;
+    SDL_AtomicInt is_writer_running;
+};
+
+static LoggerState state;
+#ifdef GOLD_DEBUG
+static LoggerTestSink logger_test_sink = NULL;
+static void* logger_test_sink_user_data = NULL;
+#endif
+// Kept out of the state so that it can be initialized to let everything through before logger_init()
+static SDL_AtomicInt logger_log_level = { LOG_LEVEL_DEBUG };
+
+static const char* LOG_PREFIX[4] = { "ERROR", "WARN", "INFO", "DEBUG" };
+
+// The turn that a producer waits for when writing to the ring at pos. The consumer waits for turn + 1.
+static uint32_t logger_ring_turn(uint32_t pos) {
+    return (pos / LOGGER_RING_SIZE) * 2U;
+}
+
+static void logger_write(LogLevel log_level, const char* message) {
+    #ifdef GOLD_DEBUG
+        if (logger_test_sink != NULL) {
+            logger_test_sink(log_level, message, logger_test_sink_user_data);
+            return;
+        }
+    #endif
+
+    if (state.logfile != NULL) {
+        fprintf(state.logfile, "[%s]: %s\n", LOG_PREFIX[log_level], message);
+    }
+
+    #ifdef GOLD_DEBUG
+        printf("[%s]: %s\n", LOG_PREFIX[log_level], message);
+    #endif
+}
+
+static void logger_drain() {
+    SDL_LockMutex(state.consumer_mutex);
+
+    bool has_written = false;
+    while (true) {
+        LoggerSlot& slot = state.ring[state.tail % LOGGER_RING_SIZE];
+        if (SDL_GetAtomicU32(&slot.turn) != logger_ring_turn(state.tail) + 1U) {
+            break;
+        }
+
+        if (slot.long_message != NULL) {
+            logger_write(slot.log_level, slot.long_message);
+            free(slot.long_message);
+            slot.long_message = NULL;
+        } else {
+            logger_write(slot.log_level, slot.message);
+        }
+        has_written = true;
+
+        // Hand the slot back to the producers for the next lap
+        SDL_SetAtomicU32(&slot.turn, logger_ring_turn(state.tail + LOGGER_RING_SIZE));
+        state.tail++;
+    }
+
+    uint32_t dropped_message_count = SDL_SetAtomicU32(&state.dropped_message_count, 0);
+    if (dropped_message_count != 0) {
+        char message[64];
+        snprintf(message, sizeof(message), "Logger dropped %u messages.", dropped_message_count);
+        logger_write(LOG_LEVEL_WARN, message);
+        has_written = true;
+    }
+
+    if (has_written && state.logfile != NULL) {
+        fflush(state.logfile);
+    }
+
+    SDL_UnlockMutex(state.consumer_mutex);
+}
+
+static int logger_writer_thread(void* /*user_data*/) {
+    while (SDL_GetAtomicInt(&state.is_writer_running)) {
+        logger_drain();
+        SDL_WaitSemaphoreTimeout(state.writer_semaphore, LOGGER_WRITER_WAIT_MS);
+    }
+
+    return 0;
+}
 
 bool logger_init(const char* logfile_path) {
     // Open logfile
     std::string logfile_full_path = filesystem_get_data_path() + FILESYSTEM_LOG_FOLDER_NAME + logfile_path;
-    logfile = fopen(logfile_full_path.c_str(), "w");
-    if (logfile == NULL) {
+    state.logfile = fopen(logfile_full_path.c_str(), "w");
+    if (state.logfile == NULL) {
         log_error("Unable to open log file for writing.");
         return false;
     }
 
+    // Start writer thread
+    state.consumer_mutex = SDL_CreateMutex();
+    state.writer_semaphore = SDL_CreateSemaphore(0);
+    SDL_SetAtomicInt(&state.is_writer_running, 1);
+    state.writer_thread = SDL_CreateThread(logger_writer_thread, "logger_writer_thread", NULL);
+    if (state.writer_thread == NULL) {
+        // Log calls will write from the calling thread instead
+        SDL_SetAtomicInt(&state.is_writer_running, 0);
+        log_warn("Unable to create logger writer thread: %s", SDL_GetError());
+    }
+
     return true;
 }
 
 void logger_quit() {
-    fclose(logfile);
+    if (SDL_GetAtomicInt(&state.is_writer_running)) {
+        SDL_SetAtomicInt(&state.is_writer_running, 0);
+        SDL_SignalSemaphore(state.writer_semaphore);
+        SDL_WaitThread(state.writer_thread, NULL);
+        state.writer_thread = NULL;
+    }
+
+    logger_drain();
+    SDL_DestroySemaphore(state.writer_semaphore);
+    state.writer_semaphore = NULL;
+    SDL_DestroyMutex(state.consumer_mutex);
+    state.consumer_mutex = NULL;
+
+    if (state.logfile != NULL) {
+        fclose(state.logfile);
+        state.logfile = NULL;
+    }
+}
+
+void logger_set_level(LogLevel log_level) {
+    SDL_SetAtomicInt(&logger_log_level, (int)log_level);
 }
 
+void logger_flush() {
+    logger_drain();
+}
+
+#ifdef GOLD_DEBUG
+
+void logger_set_test_sink(LoggerTestSink sink, void* user_data) {
+    // Taken so that the sink is never swapped out in the middle of a drain
+    SDL_LockMutex(state.consumer_mutex);
+    logger_test_sink = sink;
+    logger_test_sink_user_data = user_data;
+    SDL_UnlockMutex(state.consumer_mutex);
+}
+
+#endif
+
 void logger_output(LogLevel log_level, const char* message, ...) {
-    const size_t MESSAGE_BUFFER_LENGTH = 32000;
-    char out_message[MESSAGE_BUFFER_LENGTH];
-    memset(out_message, 0, sizeof(out_message));
+    if ((int)log_level > SDL_GetAtomicInt(&logger_log_level)) {
+        return;
+    }
 
-    __builtin_va_list arg_ptr;
+    // Claim a slot
+    uint32_t pos = SDL_GetAtomicU32(&state.head);
+    LoggerSlot* slot;
+    while (true) {
+        slot = &state.ring[pos % LOGGER_RING_SIZE];
+        if (SDL_GetAtomicU32(&slot->turn) == logger_ring_turn(pos)) {
+            if (SDL_CompareAndSwapAtomicU32(&state.head, pos, pos + 1U)) {
+                break;
+            }
+            // Another producer claimed the slot first, so move on to wherever the head is now
+            // rather than waiting for that producer to publish
+            pos = SDL_GetAtomicU32(&state.head);
+        } else {
+            uint32_t previous_pos = pos;
+            pos = SDL_GetAtomicU32(&state.head);
+            // If the head has not moved, then the slot is still waiting on the consumer and the ring is full
+            if (pos == previous_pos) {
+                SDL_AddAtomicU32(&state.dropped_message_count, 1);
+                return;
+            }
+        }
+    }
+
+    // Format the message into the slot
+    va_list arg_ptr;
     va_start(arg_ptr, message);
-    vsnprintf(out_message, MESSAGE_BUFFER_LENGTH, message, arg_ptr);
+    va_list arg_ptr_copy;
+    va_copy(arg_ptr_copy, arg_ptr);
+    int message_length = vsnprintf(slot->message, LOGGER_SLOT_MESSAGE_SIZE, message, arg_ptr);
+    if (message_length >= (int)LOGGER_SLOT_MESSAGE_SIZE) {
+        slot->long_message = (char*)malloc(message_length + 1);
+        vsnprintf(slot->long_message, message_length + 1, message, arg_ptr_copy);
+    }
+    va_end(arg_ptr_copy);
     va_end(arg_ptr);
+    slot->log_level = log_level;
 
-    const char* LOG_PREFIX[4] = { "ERROR", "WARN", "INFO", "DEBUG" };
-    fprintf(logfile, "[%s]: %s\n", LOG_PREFIX[log_level], out_message);
-    fflush(logfile);
+    // Publish the slot
+    SDL_SetAtomicU32(&slot->turn, logger_ring_turn(pos) + 1U);
 
-    #ifdef GOLD_DEBUG
-        printf("[%s]: %s\n", LOG_PREFIX[log_level], out_message);
-    #endif
+    if (!SDL_GetAtomicInt(&state.is_writer_running)) {
+        logger_drain();
+    } else if (log_level <= LOG_LEVEL_WARN || pos % LOGGER_WRITER_WAKE_INTERVAL == 0) {
+        // Errors are written out right away, and bursts of messages wake the writer before the ring fills up
+        SDL_SignalSemaphore(state.writer_semaphore);
+    }
 }
 
 // Definition of function delcared in asserts.h
 void logger_report_assertion_failure(const char* expression, const char* message, const char* file, int line) {
     logger_output(LOG_LEVEL_ERROR, "Assertion failure: %s, message: '%s', in file %s, line %d", expression, message, file, line);
+    // The caller is about to break into the debugger or crash, so write out everything that is queued before it does
+    logger_flush();
 }
\ No newline at end of file
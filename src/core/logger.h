@@ -11,8 +11,18 @@ enum LogLevel {
 
 bool logger_init(const char* logfile_path);
 void logger_quit();
+// Messages above this level are thrown away before they are formatted
+void logger_set_level(LogLevel log_level);
+// Writes out everything that has been queued so far, on the calling thread
+void logger_flush();
 void logger_output(LogLevel log_level, const char* message, ...);
 
+#ifdef GOLD_DEBUG
+    // Called by the consumer with each message instead of writing it out, for tests
+    typedef void (*LoggerTestSink)(LogLevel log_level, const char* message, void* user_data);
+    void logger_set_test_sink(LoggerTestSink sink, void* user_data);
+#endif
+
 #define log_error(message, ...) logger_output(LOG_LEVEL_ERROR, message, ##__VA_ARGS__);
 #define log_warn(message, ...) logger_output(LOG_LEVEL_WARN, message, ##__VA_ARGS__);
 #define log_info(message, ...) logger_output(LOG_LEVEL_INFO, message, ##__VA_ARGS__);
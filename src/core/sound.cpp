@@ -6,12 +6,14 @@
 #include "core/options.h"
 #include <SDL3/SDL.h>
 #include <unordered_map>
+#include <algorithm>
 #include <cstdlib>
 #include <cstdio>
 
 #define SOUND_AUDIO_CHANNEL_COUNT 2
 #define SOUND_VOICE_COUNT 32
 #define SOUND_MIX_BUFFER_SIZE 4096
+#define SOUND_COMMAND_QUEUE_SIZE 256U
 
 struct SoundParams {
     const char* path;
@@ -168,69 +170,211 @@ enum SoundVoiceMode {
     SOUND_VOICE_LOOPING
 };
 
+// Owned by the audio thread
 struct SoundVoice {
     SoundVoiceMode mode = SOUND_VOICE_OFF;
     int sound_index;
     int frame;
+    float gain;
+    uint32_t sequence;
+};
+
+// Written by the audio thread after each callback so that the game thread can pick which voice to play on
+struct SoundVoiceProgress {
+    // The sequence of the last command that the audio thread applied to the voice
+    SDL_AtomicU32 sequence;
+    // 0 once the voice has stopped
+    SDL_AtomicInt frames_remaining;
+};
+
+// Owned by the game thread, this is what the voice will be doing once the audio thread has caught up on commands
+struct SoundVoiceAllocation {
+    SoundVoiceMode mode;
+    int sound_index;
+    uint32_t sequence;
+};
+
+enum SoundCommandType {
+    SOUND_COMMAND_PLAY,
+    SOUND_COMMAND_STOP,
+    SOUND_COMMAND_STOP_ALL
+};
+
+struct SoundCommand {
+    SoundCommandType type;
+    uint32_t voice_index;
+    uint32_t sequence;
+    SoundVoiceMode mode;
+    int sound_index;
+    float gain;
 };
 
 struct SoundState {
     SDL_AudioStream* audio_stream;
-    SDL_Mutex* audio_mutex;
 
     SoundData* sounds;
     int sound_count;
     int sound_index[SOUND_COUNT];
 
+    // Single producer, single consumer queue from the game thread to the audio thread
+    SoundCommand commands[SOUND_COMMAND_QUEUE_SIZE];
+    SDL_AtomicU32 command_head;
+    SDL_AtomicU32 command_tail;
+
     SoundVoice voices[SOUND_VOICE_COUNT];
+    SoundVoiceProgress voice_progress[SOUND_VOICE_COUNT];
+    SoundVoiceAllocation voice_allocations[SOUND_VOICE_COUNT];
+    uint32_t voice_sequence;
 
     bool is_fire_loop_playing;
 };
 
 static SoundState state;
 
-static void sound_sdl_audio_callback(void* /*user_data*/, SDL_AudioStream* stream, int additional_amount, int /*total_amount*/) {
-    const int BYTES_PER_FRAME = SOUND_AUDIO_CHANNEL_COUNT * sizeof(float);
+// Adds sample_count samples times gain into the mix buffer
+#if defined(__SSE__)
+
+#include <xmmintrin.h>
+
+static void sound_mix_samples(float* mix_buffer, const float* samples, int sample_count, float gain) {
+    const __m128 gain4 = _mm_set1_ps(gain);
+    int index = 0;
+    for (; index + 8 <= sample_count; index += 8) {
+        __m128 mix0 = _mm_loadu_ps(mix_buffer + index);
+        __m128 mix1 = _mm_loadu_ps(mix_buffer + index + 4);
+        mix0 = _mm_add_ps(mix0, _mm_mul_ps(_mm_loadu_ps(samples + index), gain4));
+        mix1 = _mm_add_ps(mix1, _mm_mul_ps(_mm_loadu_ps(samples + index + 4), gain4));
+        _mm_storeu_ps(mix_buffer + index, mix0);
+        _mm_storeu_ps(mix_buffer + index + 4, mix1);
+    }
+    for (; index < sample_count; index++) {
+        mix_buffer[index] += samples[index] * gain;
+    }
+}
 
-    if (!SDL_TryLockMutex(state.audio_mutex)) {
-        return;
+#elif defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+static void sound_mix_samples(float* mix_buffer, const float* samples, int sample_count, float gain) {
+    const float32x4_t gain4 = vdupq_n_f32(gain);
+    int index = 0;
+    for (; index + 8 <= sample_count; index += 8) {
+        float32x4_t mix0 = vld1q_f32(mix_buffer + index);
+        float32x4_t mix1 = vld1q_f32(mix_buffer + index + 4);
+        mix0 = vaddq_f32(mix0, vmulq_f32(vld1q_f32(samples + index), gain4));
+        mix1 = vaddq_f32(mix1, vmulq_f32(vld1q_f32(samples + index + 4), gain4));
+        vst1q_f32(mix_buffer + index, mix0);
+        vst1q_f32(mix_buffer + index + 4, mix1);
+    }
+    for (; index < sample_count; index++) {
+        mix_buffer[index] += samples[index] * gain;
     }
+}
 
-    int requested_frames = additional_amount / BYTES_PER_FRAME;
-    float mix_buffer[SOUND_MIX_BUFFER_SIZE * SOUND_AUDIO_CHANNEL_COUNT];
-    memset(mix_buffer, 0, sizeof(mix_buffer));
-    GOLD_ASSERT(requested_frames * SOUND_AUDIO_CHANNEL_COUNT < SOUND_MIX_BUFFER_SIZE);
+#else
 
-    for (int voice_index = 0; voice_index < SOUND_VOICE_COUNT; voice_index++) {
-        SoundVoice* voice = &state.voices[voice_index];
-        if (voice->mode == SOUND_VOICE_OFF) {
-            continue;
+static void sound_mix_samples(float* mix_buffer, const float* samples, int sample_count, float gain) {
+    for (int index = 0; index < sample_count; index++) {
+        mix_buffer[index] += samples[index] * gain;
+    }
+}
+
+#endif
+
+static void sound_mix_voice(SoundVoice* voice, float* mix_buffer, int frame_count) {
+    const SoundData* sound_data = &state.sounds[voice->sound_index];
+    int mixed_frame_count = 0;
+
+    // Mix the voice in contiguous runs of frames, wrapping around whenever a looping voice reaches its end
+    while (voice->mode != SOUND_VOICE_OFF && mixed_frame_count < frame_count) {
+        int run_frame_count = std::min(frame_count - mixed_frame_count, sound_data->frame_count - voice->frame);
+        sound_mix_samples(
+            mix_buffer + (mixed_frame_count * SOUND_AUDIO_CHANNEL_COUNT),
+            sound_data->samples + (voice->frame * SOUND_AUDIO_CHANNEL_COUNT),
+            run_frame_count * SOUND_AUDIO_CHANNEL_COUNT,
+            voice->gain);
+        mixed_frame_count += run_frame_count;
+        voice->frame += run_frame_count;
+
+        if (voice->frame >= sound_data->frame_count) {
+            // An empty sound would otherwise loop forever without mixing anything
+            if (voice->mode == SOUND_VOICE_LOOPING && sound_data->frame_count != 0) {
+                voice->frame = 0;
+            } else {
+                voice->mode = SOUND_VOICE_OFF;
+            }
         }
+    }
+}
 
-        const SoundData* sound_data = &state.sounds[voice->sound_index];
-        for (int frame = 0; frame < requested_frames; frame++) {
-            int mix_buffer_index = frame * 2; 
-            int sound_data_index = voice->frame * 2;
-
-            // Once for each channel
-            mix_buffer[mix_buffer_index + 0] += sound_data->samples[sound_data_index + 0];
-            mix_buffer[mix_buffer_index + 1] += sound_data->samples[sound_data_index + 1];
-
-            voice->frame++;
-            if (voice->frame == sound_data->frame_count) {
-                if (voice->mode == SOUND_VOICE_LOOPING) {
-                    voice->frame = 0;
-                } else {
-                    voice->mode = SOUND_VOICE_OFF;
-                    break;
+static void sound_apply_commands() {
+    uint32_t tail = SDL_GetAtomicU32(&state.command_tail);
+    uint32_t head = SDL_GetAtomicU32(&state.command_head);
+    while (tail != head) {
+        const SoundCommand& command = state.commands[tail % SOUND_COMMAND_QUEUE_SIZE];
+        switch (command.type) {
+            case SOUND_COMMAND_PLAY: {
+                SoundVoice& voice = state.voices[command.voice_index];
+                voice.mode = command.mode;
+                voice.sound_index = command.sound_index;
+                voice.frame = 0;
+                voice.gain = command.gain;
+                voice.sequence = command.sequence;
+                break;
+            }
+            case SOUND_COMMAND_STOP: {
+                state.voices[command.voice_index].mode = SOUND_VOICE_OFF;
+                state.voices[command.voice_index].sequence = command.sequence;
+                break;
+            }
+            case SOUND_COMMAND_STOP_ALL: {
+                for (uint32_t voice_index = 0; voice_index < SOUND_VOICE_COUNT; voice_index++) {
+                    state.voices[voice_index].mode = SOUND_VOICE_OFF;
+                    state.voices[voice_index].sequence = command.sequence;
                 }
+                break;
             }
         }
+        tail++;
     }
 
-    SDL_PutAudioStreamData(stream, mix_buffer, requested_frames * BYTES_PER_FRAME);
+    // Hand the slots back to the game thread
+    SDL_SetAtomicU32(&state.command_tail, tail);
+}
+
+static void sound_sdl_audio_callback(void* /*user_data*/, SDL_AudioStream* stream, int additional_amount, int /*total_amount*/) {
+    const int BYTES_PER_FRAME = SOUND_AUDIO_CHANNEL_COUNT * sizeof(float);
+    const int MIX_BUFFER_FRAME_COUNT = SOUND_MIX_BUFFER_SIZE / SOUND_AUDIO_CHANNEL_COUNT;
+
+    sound_apply_commands();
+
+    // The work done here is at most every voice times the requested frames, so the callback never waits on the game thread
+    int requested_frames = additional_amount / BYTES_PER_FRAME;
+    while (requested_frames > 0) {
+        int frame_count = std::min(requested_frames, MIX_BUFFER_FRAME_COUNT);
+        float mix_buffer[SOUND_MIX_BUFFER_SIZE];
+        memset(mix_buffer, 0, frame_count * BYTES_PER_FRAME);
+
+        for (int voice_index = 0; voice_index < SOUND_VOICE_COUNT; voice_index++) {
+            if (state.voices[voice_index].mode != SOUND_VOICE_OFF) {
+                sound_mix_voice(&state.voices[voice_index], mix_buffer, frame_count);
+            }
+        }
+
+        SDL_PutAudioStreamData(stream, mix_buffer, frame_count * BYTES_PER_FRAME);
+        requested_frames -= frame_count;
+    }
 
-    SDL_UnlockMutex(state.audio_mutex);
+    for (int voice_index = 0; voice_index < SOUND_VOICE_COUNT; voice_index++) {
+        const SoundVoice& voice = state.voices[voice_index];
+        int frames_remaining = voice.mode == SOUND_VOICE_OFF
+            ? 0
+            : state.sounds[voice.sound_index].frame_count - voice.frame;
+        // Progress is set before the sequence, so a game thread that sees the new sequence also sees the new progress
+        SDL_SetAtomicInt(&state.voice_progress[voice_index].frames_remaining, frames_remaining);
+        SDL_SetAtomicU32(&state.voice_progress[voice_index].sequence, voice.sequence);
+    }
 }
 
 bool sound_init() {
@@ -296,8 +440,6 @@ bool sound_init() {
     SDL_AudioDeviceID audio_device = SDL_GetAudioStreamDevice(state.audio_stream);
     SDL_ResumeAudioDevice(audio_device);
 
-    state.audio_mutex = SDL_CreateMutex();
-
     option_apply(OPTION_SFX_VOLUME);
     option_apply(OPTION_MUSIC_VOLUME);
     log_info("Initialized sound system. Device: %s", SDL_GetAudioDeviceName(audio_device));
@@ -306,8 +448,6 @@ bool sound_init() {
 }
 
 void sound_quit() {
-    SDL_DestroyMutex(state.audio_mutex);
-
     SDL_PauseAudioStreamDevice(state.audio_stream);
 
     // Also closes the associated device
@@ -332,58 +472,134 @@ void sound_set_sfx_volume(uint32_t volume) {
 
 void sound_set_music_volume(uint32_t volume) {}
 
-int sound_voice_frames_remaining(const SoundVoice* voice) {
-    // This should only be called on a playing voice
-    GOLD_ASSERT(voice->mode == SOUND_VOICE_PLAYING);
-    return state.sounds[voice->sound_index].frame_count - voice->frame;
+// Sounds are played and stopped from the game thread only, which makes it the single producer of the command queue
+static bool sound_push_command(const SoundCommand& command) {
+    uint32_t head = SDL_GetAtomicU32(&state.command_head);
+    if (head - SDL_GetAtomicU32(&state.command_tail) == SOUND_COMMAND_QUEUE_SIZE) {
+        // The audio thread has stopped taking commands, most likely because the device is paused
+        return false;
+    }
+
+    state.commands[head % SOUND_COMMAND_QUEUE_SIZE] = command;
+    // Publish the command
+    SDL_SetAtomicU32(&state.command_head, head + 1U);
+
+    return true;
+}
+
+static SoundVoiceMode sound_voice_get_mode(uint32_t voice_index) {
+    const SoundVoiceAllocation& allocation = state.voice_allocations[voice_index];
+    if (allocation.mode == SOUND_VOICE_PLAYING && 
+            SDL_GetAtomicU32(&state.voice_progress[voice_index].sequence) == allocation.sequence &&
+            SDL_GetAtomicInt(&state.voice_progress[voice_index].frames_remaining) == 0) {
+        return SOUND_VOICE_OFF;
+    }
+
+    return allocation.mode;
 }
 
-uint32_t sound_play(SoundName sound, bool looping) { 
-    SDL_LockMutex(state.audio_mutex);
+static int sound_voice_frames_remaining(uint32_t voice_index) {
+    // This should only be called on a playing voice
+    GOLD_ASSERT(state.voice_allocations[voice_index].mode == SOUND_VOICE_PLAYING);
 
+    // Until the audio thread has started the voice, it has all of its frames left
+    const SoundVoiceAllocation& allocation = state.voice_allocations[voice_index];
+    if (SDL_GetAtomicU32(&state.voice_progress[voice_index].sequence) != allocation.sequence) {
+        return state.sounds[allocation.sound_index].frame_count;
+    }
+
+    return SDL_GetAtomicInt(&state.voice_progress[voice_index].frames_remaining);
+}
+
+uint32_t sound_play(SoundName sound, bool looping, float gain) { 
     uint32_t available_voice_index = SOUND_VOICE_COUNT;
     for (uint32_t voice_index = 0; voice_index < SOUND_VOICE_COUNT; voice_index++) {
+        SoundVoiceMode mode = sound_voice_get_mode(voice_index);
+
         // Never interrupt a looping voice
-        if (state.voices[voice_index].mode == SOUND_VOICE_LOOPING) {
+        if (mode == SOUND_VOICE_LOOPING) {
             continue;
         }
 
         // If there is an off voice, just use that one
-        if (state.voices[voice_index].mode == SOUND_VOICE_OFF) {
+        if (mode == SOUND_VOICE_OFF) {
             available_voice_index = voice_index;
             break;
         }
 
         // If the voice is active but not looping, use it if it is closer to finishing than all the others
-        if (state.voices[voice_index].mode == SOUND_VOICE_PLAYING &&
+        if (mode == SOUND_VOICE_PLAYING &&
                 (available_voice_index == SOUND_VOICE_COUNT || 
-                    sound_voice_frames_remaining(&state.voices[voice_index]) < 
-                    sound_voice_frames_remaining(&state.voices[available_voice_index]))) {
+                    sound_voice_frames_remaining(voice_index) < 
+                    sound_voice_frames_remaining(available_voice_index))) {
             available_voice_index = voice_index;
         }
     }
     GOLD_ASSERT(available_voice_index != SOUND_VOICE_COUNT);
 
-    state.voices[available_voice_index].mode = looping
-        ? SOUND_VOICE_LOOPING
-        : SOUND_VOICE_PLAYING;
     int variant = SOUND_PARAMS.at(sound).variants == 1 
         ? 0 
         : rand() % SOUND_PARAMS.at(sound).variants;
-    state.voices[available_voice_index].sound_index = state.sound_index[sound] + variant;
-    state.voices[available_voice_index].frame = 0;
+    SoundCommand command = (SoundCommand) {
+        .type = SOUND_COMMAND_PLAY,
+        .voice_index = available_voice_index,
+        .sequence = state.voice_sequence + 1U,
+        .mode = looping ? SOUND_VOICE_LOOPING : SOUND_VOICE_PLAYING,
+        .sound_index = state.sound_index[sound] + variant,
+        .gain = gain
+    };
+    if (!sound_push_command(command)) {
+        return SOUND_VOICE_NULL;
+    }
 
-    SDL_UnlockMutex(state.audio_mutex);
+    state.voice_sequence = command.sequence;
+    state.voice_allocations[available_voice_index] = (SoundVoiceAllocation) {
+        .mode = command.mode,
+        .sound_index = command.sound_index,
+        .sequence = command.sequence
+    };
 
     return available_voice_index;
 }
 
 void sound_stop(uint32_t voice_index) {
-    state.voices[voice_index].mode = SOUND_VOICE_OFF;
+    if (voice_index >= SOUND_VOICE_COUNT) {
+        return;
+    }
+
+    SoundCommand command = (SoundCommand) {
+        .type = SOUND_COMMAND_STOP,
+        .voice_index = voice_index,
+        .sequence = state.voice_sequence + 1U,
+        .mode = SOUND_VOICE_OFF,
+        .sound_index = 0,
+        .gain = 0.0f
+    };
+    if (!sound_push_command(command)) {
+        return;
+    }
+
+    state.voice_sequence = command.sequence;
+    state.voice_allocations[voice_index].mode = SOUND_VOICE_OFF;
+    state.voice_allocations[voice_index].sequence = command.sequence;
 }
 
 void sound_stop_all() {
+    SoundCommand command = (SoundCommand) {
+        .type = SOUND_COMMAND_STOP_ALL,
+        .voice_index = 0,
+        .sequence = state.voice_sequence + 1U,
+        .mode = SOUND_VOICE_OFF,
+        .sound_index = 0,
+        .gain = 0.0f
+    };
+    if (!sound_push_command(command)) {
+        return;
+    }
+
+    state.voice_sequence = command.sequence;
     for (uint32_t voice_index = 0; voice_index < SOUND_VOICE_COUNT; voice_index++) {
-        state.voices[voice_index].mode = SOUND_VOICE_OFF;
+        state.voice_allocations[voice_index].mode = SOUND_VOICE_OFF;
+        state.voice_allocations[voice_index].sequence = command.sequence;
     }
-}
\ No newline at end of file
+}
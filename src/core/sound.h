@@ -46,6 +46,9 @@ const char* sound_get_name(SoundName sound);
 void sound_set_sfx_volume(uint32_t volume);
 void sound_set_music_volume(uint32_t volume);
 
-uint32_t sound_play(SoundName sound, bool looping = false);
+const uint32_t SOUND_VOICE_NULL = UINT32_MAX;
+
+// Returns the voice that the sound will play on, or SOUND_VOICE_NULL if the audio thread is not taking any more sounds
+uint32_t sound_play(SoundName sound, bool looping = false, float gain = 1.0f);
 void sound_stop(uint32_t voice_index);
 void sound_stop_all();
\ No newline at end of file
@@ -12,14 +12,24 @@ void editor_action_execute(Scenario* scenario, const EditorAction& action, Edito
     switch (action.type) {
         case EDITOR_ACTION_BRUSH: {
             const EditorActionBrush& action_data = std::get<EditorActionBrush>(action.data);
+            if (action_data.stroke.empty()) {
+                break;
+            }
+
+            ivec2 stroke_min = ivec2(scenario->noise->width, scenario->noise->height);
+            ivec2 stroke_max = ivec2(-1, -1);
             for (uint32_t index = 0; index < action_data.stroke.size(); index++) {
                 uint8_t value = mode == EDITOR_ACTION_MODE_UNDO 
                     ? action_data.stroke[index].previous_value
                     : action_data.stroke[index].new_value;
                 scenario->noise->map[action_data.stroke[index].index] = value;
+
+                ivec2 cell = ivec2(action_data.stroke[index].index % scenario->noise->width, action_data.stroke[index].index / scenario->noise->width);
+                stroke_min = ivec2(std::min(stroke_min.x, cell.x), std::min(stroke_min.y, cell.y));
+                stroke_max = ivec2(std::max(stroke_max.x, cell.x), std::max(stroke_max.y, cell.y));
             }
 
-            scenario_bake_map(scenario);
+            scenario_bake_map_rect(scenario, stroke_min, stroke_max);
             break;
         }
         case EDITOR_ACTION_DECORATE: {
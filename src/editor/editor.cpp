@@ -74,7 +74,7 @@ static const std::unordered_map<InputAction, std::vector<std::string>> TOOLBAR_S
 };
 
 static const SDL_DialogFileFilter EDITOR_FILE_FILTERS[] = {
-    { "JSON files", "json" }
+    { "Scenario files", "json;scn" }
 };
 
 static const uint32_t TOOL_ENTITY_ROW_SIZE = 4;
@@ -1927,7 +1927,7 @@ void editor_set_scenario_paths_to_defaults() {
 
 void editor_save(const char* path) {
     std::string full_path = std::string(path);
-    if (!string_ends_with(full_path, ".json")) {
+    if (!string_ends_with(full_path, ".json") && !string_ends_with(full_path, SCENARIO_BINARY_FILE_EXTENSION)) {
         full_path += ".json";
     }
     bool success = scenario_save_file(state.scenario, full_path.c_str(), state.scenario_script_short_path.c_str());
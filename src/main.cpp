@@ -13,6 +13,7 @@
 #include "shell/desync.h"
 #include "profile/profile.h"
 #include "editor/editor.h"
+#include "shell/headless.h"
 #include "test/test.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_ttf.h>
@@ -55,6 +56,7 @@ struct GameState {
 static GameState state;
 
 bool gold_get_argv(int argc, char** argv, const char* key, const char** result);
+bool gold_parse_headless_sim_params(int argc, char** argv, HeadlessSimParams* params);
 bool game_is_running();
 void game_set_mode_match(int lcg_seed, Noise* noise);
 void game_set_mode_scenario();
@@ -104,12 +106,42 @@ int gold_main(int argc, char** argv) {
     if (!logger_init(logfile_path.c_str())) {
         return false;
     }
+    const char* log_level_value;
+    if (gold_get_argv(argc, argv, "--log-level", &log_level_value)) {
+        const char* LOG_LEVEL_NAMES[4] = { "error", "warn", "info", "debug" };
+        for (int log_level = LOG_LEVEL_ERROR; log_level <= LOG_LEVEL_DEBUG; log_level++) {
+            if (strcmp(log_level_value, LOG_LEVEL_NAMES[log_level]) == 0) {
+                logger_set_level((LogLevel)log_level);
+            }
+        }
+    }
 
     // Log initialization messages
     log_info("Initializing %s %s.", APP_NAME, APP_VERSION);
     log_info("Detected platform %s.", GOLD_PLATFORM_STR);
     log_info("%s build.", GOLD_BUILD_TYPE_STR);
 
+    // Headless sim, this intentionally runs before SDL is initialized so that it works without a display
+    if (gold_get_argv(argc, argv, "--headless-sim", NULL)) {
+        HeadlessSimParams params;
+        if (!gold_parse_headless_sim_params(argc, argv, &params) || !render_init_headless()) {
+            logger_quit();
+            return 1;
+        }
+
+        int result = headless_sim_run(params);
+        logger_quit();
+        return result;
+    }
+
+    // Scenario conversion, this also runs before SDL is initialized
+    const char* convert_scenario_path;
+    if (gold_get_argv(argc, argv, "--convert-scenario", &convert_scenario_path)) {
+        bool success = render_init_headless() && scenario_convert_file(convert_scenario_path);
+        logger_quit();
+        return success ? 0 : 1;
+    }
+
     // Desync
 #ifdef GOLD_DEBUG
     bool desync_debug = gold_get_argv(argc, argv, "--desync", NULL);
@@ -567,6 +599,126 @@ bool gold_get_argv(int argc, char** argv, const char* key, const char** result)
     return false;
 }
 
+static bool gold_parse_match_setting_value(MatchSetting setting, const char* value_str, int* value) {
+    const MatchSettingData& data = match_setting_data(setting);
+    for (size_t index = 0; index < data.values.size(); index++) {
+        const std::string& name = data.values[index];
+        bool is_match = name.size() == strlen(value_str);
+        for (size_t char_index = 0; char_index < name.size() && is_match; char_index++) {
+            is_match = tolower(name[char_index]) == tolower(value_str[char_index]);
+        }
+        if (is_match) {
+            *value = (int)index;
+            return true;
+        }
+    }
+
+    log_error("Value %s not recognized for setting %s.", value_str, data.name);
+    return false;
+}
+
+bool gold_parse_headless_sim_params(int argc, char** argv, HeadlessSimParams* params) {
+    params->lcg_seed = 0;
+    params->map_type = MAP_TYPE_TOMBSTONE;
+    params->map_size = MAP_SIZE_MEDIUM;
+    params->teams = gold_get_argv(argc, argv, "--teams", NULL);
+    params->bot_count = MAX_PLAYERS;
+    for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+        params->bot_difficulty[player_id] = DIFFICULTY_HARD;
+    }
+    params->frame_count = HEADLESS_SIM_FRAME_COUNT_DEFAULT;
+    params->checksum_frequency = 0;
+    params->has_expected_checksum = false;
+    params->expected_checksum = 0;
+    params->has_network = gold_get_argv(argc, argv, "--net", NULL);
+    memset(&params->network_impairment, 0, sizeof(params->network_impairment));
+    params->network_lcg_seed = 0;
+
+    const char* value_str;
+    if (gold_get_argv(argc, argv, "--seed", &value_str)) {
+        params->lcg_seed = (int32_t)strtol(value_str, NULL, 10);
+    }
+    if (gold_get_argv(argc, argv, "--frames", &value_str)) {
+        params->frame_count = (uint32_t)strtoul(value_str, NULL, 10);
+    }
+    if (gold_get_argv(argc, argv, "--checksum-frequency", &value_str)) {
+        params->checksum_frequency = (uint32_t)strtoul(value_str, NULL, 10);
+    }
+    if (gold_get_argv(argc, argv, "--expect-checksum", &value_str)) {
+        params->has_expected_checksum = true;
+        params->expected_checksum = (uint32_t)strtoul(value_str, NULL, 16);
+    }
+    if (gold_get_argv(argc, argv, "--map-type", &value_str)) {
+        int value;
+        if (!gold_parse_match_setting_value(MATCH_SETTING_MAP_TYPE, value_str, &value)) {
+            return false;
+        }
+        params->map_type = (MapType)value;
+    }
+    if (gold_get_argv(argc, argv, "--map-size", &value_str)) {
+        int value;
+        if (!gold_parse_match_setting_value(MATCH_SETTING_MAP_SIZE, value_str, &value)) {
+            return false;
+        }
+        params->map_size = (MapSize)value;
+    }
+
+    // Bots are given as a comma separated list of difficulties, one per player, e.g. --bots hard,hard,easy
+    if (gold_get_argv(argc, argv, "--bots", &value_str)) {
+        std::string bots_str = value_str;
+        params->bot_count = 0;
+        size_t start = 0;
+        while (start <= bots_str.size()) {
+            size_t end = bots_str.find(',', start);
+            if (end == std::string::npos) {
+                end = bots_str.size();
+            }
+            if (params->bot_count == MAX_PLAYERS) {
+                log_error("Headless sim supports at most %u bots.", MAX_PLAYERS);
+                return false;
+            }
+
+            int value;
+            if (!gold_parse_match_setting_value(MATCH_SETTING_DIFFICULTY, bots_str.substr(start, end - start).c_str(), &value)) {
+                return false;
+            }
+            params->bot_difficulty[params->bot_count] = (Difficulty)value;
+            params->bot_count++;
+            start = end + 1;
+        }
+    }
+    if (params->bot_count < 2) {
+        log_error("Headless sim needs at least 2 bots.");
+        return false;
+    }
+
+    // Network impairment, e.g. --net --net-latency 60 --net-jitter 20 --net-loss 5
+    if (gold_get_argv(argc, argv, "--net-seed", &value_str)) {
+        params->network_lcg_seed = (int32_t)strtol(value_str, NULL, 10);
+    }
+    if (gold_get_argv(argc, argv, "--net-latency", &value_str)) {
+        params->network_impairment.latency_ms = (uint32_t)strtoul(value_str, NULL, 10);
+    }
+    if (gold_get_argv(argc, argv, "--net-jitter", &value_str)) {
+        params->network_impairment.jitter_ms = (uint32_t)strtoul(value_str, NULL, 10);
+    }
+    if (gold_get_argv(argc, argv, "--net-loss", &value_str)) {
+        params->network_impairment.loss_percent = (uint32_t)strtoul(value_str, NULL, 10);
+    }
+    if (gold_get_argv(argc, argv, "--net-reorder", &value_str)) {
+        params->network_impairment.reorder_percent = (uint32_t)strtoul(value_str, NULL, 10);
+    }
+    if (gold_get_argv(argc, argv, "--net-bandwidth", &value_str)) {
+        params->network_impairment.bandwidth = (uint32_t)strtoul(value_str, NULL, 10);
+    }
+    if (params->network_impairment.loss_percent >= 100U || params->network_impairment.reorder_percent > 100U) {
+        log_error("Network loss should be below 100 percent and reorder should be at most 100 percent.");
+        return false;
+    }
+
+    return true;
+}
+
 // GAME
 
 bool game_is_running() {
@@ -764,7 +916,8 @@ void game_test_update() {
                 state.match_shell_state->match_state.players[network_get_player_id()].active &&
                 state.match_shell_state->input_queue.empty()) {
             uint32_t turn_number = state.match_shell_state->match_timer / TURN_DURATION;
-            if (turn_number % TURN_OFFSET == 0) {
+            // The input delay can grow as far as TURN_OFFSET_MAX, so the bot waits that long before it can assume that its last input has run
+            if (turn_number % TURN_OFFSET_MAX == 0) {
                 MatchInput input;
                 input = bot_get_turn_input(state.match_shell_state->match_state, state.test_bot, state.match_shell_state->match_timer);
                 state.match_shell_state->input_queue.push_back(input);
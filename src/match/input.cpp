@@ -3,9 +3,132 @@
 #include "core/logger.h"
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
+
+// The type only needs the low 5 bits of the header byte, so the rest of it is used for flags
+static const uint8_t MATCH_INPUT_HEADER_TYPE_MASK = 0x1F;
+static const uint8_t MATCH_INPUT_HEADER_SHIFT_COMMAND = 0x20;
+// The selection is the same as the previous input's, so it is left out
+static const uint8_t MATCH_INPUT_HEADER_SAME_SELECTION = 0x40;
+// The selection is in ascending order, so each id is written as its distance from the one before it
+static const uint8_t MATCH_INPUT_HEADER_SORTED_SELECTION = 0x80;
+static_assert(MATCH_INPUT_TYPE_COUNT <= MATCH_INPUT_HEADER_TYPE_MASK + 1, "Match input types must fit in the header type mask.");
+
+void match_input_codec_init(MatchInputCodec& codec) {
+    codec.last_cell = ivec2(0, 0);
+    codec.last_selection_count = 0;
+}
+
+static void match_input_write_varint(uint8_t* out_buffer, size_t& out_buffer_length, uint32_t value) {
+    while (value >= 0x80) {
+        out_buffer[out_buffer_length] = (uint8_t)(value | 0x80);
+        out_buffer_length++;
+        value >>= 7;
+    }
+    out_buffer[out_buffer_length] = (uint8_t)value;
+    out_buffer_length++;
+}
+
+// Reads past the end of the buffer come back as zero but still move the head, so that the caller can tell that the input ran over
+static uint8_t match_input_read_byte(const uint8_t* in_buffer, size_t in_buffer_length, size_t& in_buffer_head) {
+    uint8_t byte = in_buffer_head < in_buffer_length ? in_buffer[in_buffer_head] : 0;
+    in_buffer_head++;
+    return byte;
+}
+
+static uint32_t match_input_read_varint(const uint8_t* in_buffer, size_t in_buffer_length, size_t& in_buffer_head) {
+    uint32_t value = 0;
+    uint32_t shift = 0;
+    while (true) {
+        uint8_t byte = match_input_read_byte(in_buffer, in_buffer_length, in_buffer_head);
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0 || shift >= 28) {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+// Cells are written as a zigzagged offset from the previous cell, since a player's orders tend to land near each other
+static void match_input_write_cell(uint8_t* out_buffer, size_t& out_buffer_length, MatchInputCodec& codec, ivec2 cell) {
+    int32_t delta[2] = {
+        (int32_t)((uint32_t)cell.x - (uint32_t)codec.last_cell.x),
+        (int32_t)((uint32_t)cell.y - (uint32_t)codec.last_cell.y)
+    };
+    for (int32_t component : delta) {
+        match_input_write_varint(out_buffer, out_buffer_length, ((uint32_t)component << 1) ^ (uint32_t)(component >> 31));
+    }
+    codec.last_cell = cell;
+}
+
+static ivec2 match_input_read_cell(const uint8_t* in_buffer, size_t in_buffer_length, size_t& in_buffer_head, MatchInputCodec& codec) {
+    uint32_t delta[2];
+    for (uint32_t& component : delta) {
+        uint32_t zigzag = match_input_read_varint(in_buffer, in_buffer_length, in_buffer_head);
+        component = (zigzag >> 1) ^ (0U - (zigzag & 1U));
+    }
+    codec.last_cell = ivec2((int)((uint32_t)codec.last_cell.x + delta[0]), (int)((uint32_t)codec.last_cell.y + delta[1]));
+    return codec.last_cell;
+}
+
+// Returns the header flags that describe how the selection was written
+static uint8_t match_input_write_selection(uint8_t* out_buffer, size_t& out_buffer_length, MatchInputCodec& codec, uint8_t entity_count, const EntityId* entity_ids) {
+    GOLD_ASSERT(entity_count <= SELECTION_LIMIT);
+    if (entity_count == codec.last_selection_count &&
+            memcmp(entity_ids, codec.last_selection, entity_count * sizeof(EntityId)) == 0) {
+        return MATCH_INPUT_HEADER_SAME_SELECTION;
+    }
+
+    codec.last_selection_count = entity_count;
+    memcpy(codec.last_selection, entity_ids, entity_count * sizeof(EntityId));
+
+    out_buffer[out_buffer_length] = entity_count;
+    out_buffer_length++;
+
+    // The order of the ids is kept as is, since the match handles the entities in the order they are given
+    bool is_sorted = true;
+    for (uint8_t index = 1; index < entity_count; index++) {
+        if (entity_ids[index] <= entity_ids[index - 1]) {
+            is_sorted = false;
+            break;
+        }
+    }
+
+    for (uint8_t index = 0; index < entity_count; index++) {
+        uint32_t value = entity_ids[index];
+        if (is_sorted && index != 0) {
+            value -= entity_ids[index - 1] + 1U;
+        }
+        match_input_write_varint(out_buffer, out_buffer_length, value);
+    }
+
+    return is_sorted ? MATCH_INPUT_HEADER_SORTED_SELECTION : 0;
+}
+
+static void match_input_read_selection(const uint8_t* in_buffer, size_t in_buffer_length, size_t& in_buffer_head, MatchInputCodec& codec, uint8_t header, uint8_t& entity_count, EntityId* entity_ids) {
+    if (header & MATCH_INPUT_HEADER_SAME_SELECTION) {
+        entity_count = codec.last_selection_count;
+        memcpy(entity_ids, codec.last_selection, entity_count * sizeof(EntityId));
+        return;
+    }
+
+    entity_count = std::min(match_input_read_byte(in_buffer, in_buffer_length, in_buffer_head), (uint8_t)SELECTION_LIMIT);
+
+    for (uint8_t index = 0; index < entity_count; index++) {
+        uint32_t value = match_input_read_varint(in_buffer, in_buffer_length, in_buffer_head);
+        if ((header & MATCH_INPUT_HEADER_SORTED_SELECTION) && index != 0) {
+            value += entity_ids[index - 1] + 1U;
+        }
+        entity_ids[index] = (EntityId)value;
+    }
 
-void match_input_serialize(uint8_t* out_buffer, size_t& out_buffer_length, const MatchInput& input) {
-    out_buffer[out_buffer_length] = input.type;
+    codec.last_selection_count = entity_count;
+    memcpy(codec.last_selection, entity_ids, entity_count * sizeof(EntityId));
+}
+
+void match_input_serialize(uint8_t* out_buffer, size_t& out_buffer_length, const MatchInput& input, MatchInputCodec& codec) {
+    uint8_t& header = out_buffer[out_buffer_length];
+    header = input.type;
     out_buffer_length++;
 
     switch (input.type) {
@@ -18,121 +141,68 @@ void match_input_serialize(uint8_t* out_buffer, size_t& out_buffer_length, const
         case MATCH_INPUT_MOVE_REPAIR:
         case MATCH_INPUT_MOVE_UNLOAD:
         case MATCH_INPUT_MOVE_MOLOTOV: {
-            memcpy(out_buffer + out_buffer_length, &input.move.shift_command, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.move.target_cell, sizeof(ivec2));
-            out_buffer_length += sizeof(ivec2);
-
-            memcpy(out_buffer + out_buffer_length, &input.move.target_id, sizeof(EntityId));
-            out_buffer_length += sizeof(EntityId);
-
-            memcpy(out_buffer + out_buffer_length, &input.move.entity_count, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.move.entity_ids, input.move.entity_count * sizeof(EntityId));
-            out_buffer_length += input.move.entity_count * sizeof(EntityId);
+            if (input.move.shift_command) {
+                header |= MATCH_INPUT_HEADER_SHIFT_COMMAND;
+            }
+            match_input_write_cell(out_buffer, out_buffer_length, codec, input.move.target_cell);
+            match_input_write_varint(out_buffer, out_buffer_length, input.move.target_id);
+            header |= match_input_write_selection(out_buffer, out_buffer_length, codec, input.move.entity_count, input.move.entity_ids);
             break;
         }
         case MATCH_INPUT_STOP:
         case MATCH_INPUT_DEFEND: {
-            memcpy(out_buffer + out_buffer_length, &input.stop.entity_count, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.stop.entity_ids, input.stop.entity_count * sizeof(EntityId));
-            out_buffer_length += input.stop.entity_count * sizeof(EntityId);
+            header |= match_input_write_selection(out_buffer, out_buffer_length, codec, input.stop.entity_count, input.stop.entity_ids);
             break;
         }
         case MATCH_INPUT_BUILD: {
-            memcpy(out_buffer + out_buffer_length, &input.build.shift_command, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.build.building_type, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.build.target_cell, sizeof(ivec2));
-            out_buffer_length += sizeof(ivec2);
-
-            memcpy(out_buffer + out_buffer_length, &input.build.entity_count, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.build.entity_ids, input.build.entity_count * sizeof(EntityId));
-            out_buffer_length += input.build.entity_count * sizeof(EntityId);
+            if (input.build.shift_command) {
+                header |= MATCH_INPUT_HEADER_SHIFT_COMMAND;
+            }
+            out_buffer[out_buffer_length] = input.build.building_type;
+            out_buffer_length++;
+            match_input_write_cell(out_buffer, out_buffer_length, codec, input.build.target_cell);
+            header |= match_input_write_selection(out_buffer, out_buffer_length, codec, input.build.entity_count, input.build.entity_ids);
             break;
         }
         case MATCH_INPUT_BUILD_CANCEL: {
-            memcpy(out_buffer + out_buffer_length, &input.build_cancel.building_id, sizeof(EntityId));
-            out_buffer_length += sizeof(EntityId);
+            match_input_write_varint(out_buffer, out_buffer_length, input.build_cancel.building_id);
             break;
         }
         case MATCH_INPUT_BUILDING_ENQUEUE: {
-            memcpy(out_buffer + out_buffer_length, &input.building_enqueue.item_type, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.building_enqueue.item_subtype, sizeof(uint32_t));
-            out_buffer_length += sizeof(uint32_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.building_enqueue.building_count, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.building_enqueue.building_ids, input.building_enqueue.building_count * sizeof(EntityId));
-            out_buffer_length += input.building_enqueue.building_count * sizeof(EntityId);
-
+            out_buffer[out_buffer_length] = input.building_enqueue.item_type;
+            out_buffer_length++;
+            match_input_write_varint(out_buffer, out_buffer_length, input.building_enqueue.item_subtype);
+            header |= match_input_write_selection(out_buffer, out_buffer_length, codec, input.building_enqueue.building_count, input.building_enqueue.building_ids);
             break;
         }
         case MATCH_INPUT_BUILDING_DEQUEUE: {
-            memcpy(out_buffer + out_buffer_length, &input.building_dequeue.building_id, sizeof(EntityId));
-            out_buffer_length += sizeof(EntityId);
-
-            memcpy(out_buffer + out_buffer_length, &input.building_dequeue.index, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
+            match_input_write_varint(out_buffer, out_buffer_length, input.building_dequeue.building_id);
+            out_buffer[out_buffer_length] = input.building_dequeue.index;
+            out_buffer_length++;
             break;
         }
         case MATCH_INPUT_RALLY: {
-            memcpy(out_buffer + out_buffer_length, &input.rally.rally_point, sizeof(ivec2));
-            out_buffer_length += sizeof(ivec2);
-
-            memcpy(out_buffer + out_buffer_length, &input.rally.building_count, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.rally.building_ids, input.rally.building_count * sizeof(EntityId));
-            out_buffer_length += input.rally.building_count * sizeof(EntityId);
+            match_input_write_cell(out_buffer, out_buffer_length, codec, input.rally.rally_point);
+            header |= match_input_write_selection(out_buffer, out_buffer_length, codec, input.rally.building_count, input.rally.building_ids);
             break;
         }
         case MATCH_INPUT_SINGLE_UNLOAD: {
-            memcpy(out_buffer + out_buffer_length, &input.single_unload.entity_id, sizeof(EntityId));
-            out_buffer_length += sizeof(EntityId);
+            match_input_write_varint(out_buffer, out_buffer_length, input.single_unload.entity_id);
             break;
         }
         case MATCH_INPUT_UNLOAD: {
-            memcpy(out_buffer + out_buffer_length, &input.unload.carrier_count, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.unload.carrier_ids, input.unload.carrier_count * sizeof(EntityId));
-            out_buffer_length += input.unload.carrier_count * sizeof(EntityId);
+            header |= match_input_write_selection(out_buffer, out_buffer_length, codec, input.unload.carrier_count, input.unload.carrier_ids);
             break;
         }
         case MATCH_INPUT_CAMO:
         case MATCH_INPUT_DECAMO: {
-            memcpy(out_buffer + out_buffer_length, &input.camo.unit_count, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, &input.camo.unit_ids, input.camo.unit_count * sizeof(EntityId));
-            out_buffer_length += input.camo.unit_count * sizeof(EntityId);
+            header |= match_input_write_selection(out_buffer, out_buffer_length, codec, input.camo.unit_count, input.camo.unit_ids);
             break;
         }
         case MATCH_INPUT_PATROL: {
-            memcpy(out_buffer + out_buffer_length, &input.patrol.target_cell_a, sizeof(ivec2));
-            out_buffer_length += sizeof(ivec2);
-
-            memcpy(out_buffer + out_buffer_length, &input.patrol.target_cell_b, sizeof(ivec2));
-            out_buffer_length += sizeof(ivec2);
-
-            memcpy(out_buffer + out_buffer_length, &input.patrol.unit_count, sizeof(uint8_t));
-            out_buffer_length += sizeof(uint8_t);
-
-            memcpy(out_buffer + out_buffer_length, input.patrol.unit_ids, input.patrol.unit_count * sizeof(EntityId));
-            out_buffer_length += input.patrol.unit_count * sizeof(EntityId);
+            match_input_write_cell(out_buffer, out_buffer_length, codec, input.patrol.target_cell_a);
+            match_input_write_cell(out_buffer, out_buffer_length, codec, input.patrol.target_cell_b);
+            header |= match_input_write_selection(out_buffer, out_buffer_length, codec, input.patrol.unit_count, input.patrol.unit_ids);
             break;
         }
         case MATCH_INPUT_TYPE_COUNT: {
@@ -142,10 +212,9 @@ void match_input_serialize(uint8_t* out_buffer, size_t& out_buffer_length, const
     }
 }
 
-MatchInput match_input_deserialize(const uint8_t* in_buffer, size_t& in_buffer_head) {
-    MatchInput input;
-    input.type = in_buffer[in_buffer_head];
-    in_buffer_head++;
+bool match_input_deserialize(const uint8_t* in_buffer, size_t in_buffer_length, size_t& in_buffer_head, MatchInputCodec& codec, MatchInput& input) {
+    uint8_t header = match_input_read_byte(in_buffer, in_buffer_length, in_buffer_head);
+    input.type = header & MATCH_INPUT_HEADER_TYPE_MASK;
 
     switch (input.type) {
         case MATCH_INPUT_NONE:
@@ -157,129 +226,69 @@ MatchInput match_input_deserialize(const uint8_t* in_buffer, size_t& in_buffer_h
         case MATCH_INPUT_MOVE_REPAIR:
         case MATCH_INPUT_MOVE_UNLOAD:
         case MATCH_INPUT_MOVE_MOLOTOV: {
-            memcpy(&input.move.shift_command, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.move.target_cell, in_buffer + in_buffer_head, sizeof(ivec2));
-            in_buffer_head += sizeof(ivec2);
-
-            memcpy(&input.move.target_id, in_buffer + in_buffer_head, sizeof(EntityId));
-            in_buffer_head += sizeof(EntityId);
-
-            memcpy(&input.move.entity_count, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.move.entity_ids, in_buffer + in_buffer_head, input.move.entity_count * sizeof(EntityId));
-            in_buffer_head += input.move.entity_count * sizeof(EntityId);
+            input.move.shift_command = (header & MATCH_INPUT_HEADER_SHIFT_COMMAND) != 0;
+            input.move.target_cell = match_input_read_cell(in_buffer, in_buffer_length, in_buffer_head, codec);
+            input.move.target_id = (EntityId)match_input_read_varint(in_buffer, in_buffer_length, in_buffer_head);
+            match_input_read_selection(in_buffer, in_buffer_length, in_buffer_head, codec, header, input.move.entity_count, input.move.entity_ids);
             break;
         }
         case MATCH_INPUT_STOP:
         case MATCH_INPUT_DEFEND: {
-            memcpy(&input.stop.entity_count, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.stop.entity_ids, in_buffer + in_buffer_head, input.stop.entity_count * sizeof(EntityId));
-            in_buffer_head += input.stop.entity_count * sizeof(EntityId);
+            match_input_read_selection(in_buffer, in_buffer_length, in_buffer_head, codec, header, input.stop.entity_count, input.stop.entity_ids);
             break;
         }
         case MATCH_INPUT_BUILD: {
-            memcpy(&input.build.shift_command, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.build.building_type, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.build.target_cell, in_buffer + in_buffer_head, sizeof(ivec2));
-            in_buffer_head += sizeof(ivec2);
-
-            memcpy(&input.build.entity_count, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.build.entity_ids, in_buffer + in_buffer_head, input.build.entity_count * sizeof(EntityId));
-            in_buffer_head += input.build.entity_count * sizeof(EntityId);
+            input.build.shift_command = (header & MATCH_INPUT_HEADER_SHIFT_COMMAND) != 0;
+            input.build.building_type = match_input_read_byte(in_buffer, in_buffer_length, in_buffer_head);
+            input.build.target_cell = match_input_read_cell(in_buffer, in_buffer_length, in_buffer_head, codec);
+            match_input_read_selection(in_buffer, in_buffer_length, in_buffer_head, codec, header, input.build.entity_count, input.build.entity_ids);
             break;
         }
         case MATCH_INPUT_BUILD_CANCEL: {
-            memcpy(&input.build_cancel.building_id, in_buffer + in_buffer_head, sizeof(EntityId));
-            in_buffer_head += sizeof(EntityId);
+            input.build_cancel.building_id = (EntityId)match_input_read_varint(in_buffer, in_buffer_length, in_buffer_head);
             break;
         }
         case MATCH_INPUT_BUILDING_ENQUEUE: {
-            memcpy(&input.building_enqueue.item_type, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.building_enqueue.item_subtype, in_buffer + in_buffer_head, sizeof(uint32_t));
-            in_buffer_head += sizeof(uint32_t);
-
-            memcpy(&input.building_enqueue.building_count, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.building_enqueue.building_ids, in_buffer + in_buffer_head, input.building_enqueue.building_count * sizeof(EntityId));
-            in_buffer_head += input.building_enqueue.building_count * sizeof(EntityId);
+            input.building_enqueue.item_type = match_input_read_byte(in_buffer, in_buffer_length, in_buffer_head);
+            input.building_enqueue.item_subtype = match_input_read_varint(in_buffer, in_buffer_length, in_buffer_head);
+            match_input_read_selection(in_buffer, in_buffer_length, in_buffer_head, codec, header, input.building_enqueue.building_count, input.building_enqueue.building_ids);
             break;
         }
         case MATCH_INPUT_BUILDING_DEQUEUE: {
-            memcpy(&input.building_dequeue.building_id, in_buffer + in_buffer_head, sizeof(EntityId));
-            in_buffer_head += sizeof(EntityId);
-
-            memcpy(&input.building_dequeue.index, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
+            input.building_dequeue.building_id = (EntityId)match_input_read_varint(in_buffer, in_buffer_length, in_buffer_head);
+            input.building_dequeue.index = match_input_read_byte(in_buffer, in_buffer_length, in_buffer_head);
             break;
         }
         case MATCH_INPUT_RALLY: {
-            memcpy(&input.rally.rally_point, in_buffer + in_buffer_head, sizeof(ivec2));
-            in_buffer_head += sizeof(ivec2);
-
-            memcpy(&input.rally.building_count, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.rally.building_ids, in_buffer + in_buffer_head, input.rally.building_count * sizeof(EntityId));
-            in_buffer_head += input.rally.building_count * sizeof(EntityId);
+            input.rally.rally_point = match_input_read_cell(in_buffer, in_buffer_length, in_buffer_head, codec);
+            match_input_read_selection(in_buffer, in_buffer_length, in_buffer_head, codec, header, input.rally.building_count, input.rally.building_ids);
             break;
         }
         case MATCH_INPUT_SINGLE_UNLOAD: {
-            memcpy(&input.single_unload.entity_id, in_buffer + in_buffer_head, sizeof(EntityId));
-            in_buffer_head += sizeof(EntityId);
+            input.single_unload.entity_id = (EntityId)match_input_read_varint(in_buffer, in_buffer_length, in_buffer_head);
             break;
         }
         case MATCH_INPUT_UNLOAD: {
-            memcpy(&input.unload.carrier_count, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.unload.carrier_ids, in_buffer + in_buffer_head, input.unload.carrier_count * sizeof(EntityId));
-            in_buffer_head += input.unload.carrier_count * sizeof(EntityId);
+            match_input_read_selection(in_buffer, in_buffer_length, in_buffer_head, codec, header, input.unload.carrier_count, input.unload.carrier_ids);
             break;
         }
         case MATCH_INPUT_CAMO:
         case MATCH_INPUT_DECAMO: {
-            memcpy(&input.camo.unit_count, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(&input.camo.unit_ids, in_buffer + in_buffer_head, input.camo.unit_count * sizeof(EntityId));
-            in_buffer_head += input.camo.unit_count * sizeof(EntityId);
+            match_input_read_selection(in_buffer, in_buffer_length, in_buffer_head, codec, header, input.camo.unit_count, input.camo.unit_ids);
             break;
         }
         case MATCH_INPUT_PATROL: {
-            memcpy(&input.patrol.target_cell_a, in_buffer + in_buffer_head, sizeof(ivec2));
-            in_buffer_head += sizeof(ivec2);
-
-            memcpy(&input.patrol.target_cell_b, in_buffer + in_buffer_head, sizeof(ivec2));
-            in_buffer_head += sizeof(ivec2);
-
-            memcpy(&input.patrol.unit_count, in_buffer + in_buffer_head, sizeof(uint8_t));
-            in_buffer_head += sizeof(uint8_t);
-
-            memcpy(input.patrol.unit_ids, in_buffer + in_buffer_head, input.patrol.unit_count * sizeof(EntityId));
-            in_buffer_head += input.patrol.unit_count * sizeof(EntityId);
+            input.patrol.target_cell_a = match_input_read_cell(in_buffer, in_buffer_length, in_buffer_head, codec);
+            input.patrol.target_cell_b = match_input_read_cell(in_buffer, in_buffer_length, in_buffer_head, codec);
+            match_input_read_selection(in_buffer, in_buffer_length, in_buffer_head, codec, header, input.patrol.unit_count, input.patrol.unit_ids);
             break;
         }
-        case MATCH_INPUT_TYPE_COUNT: {
-            GOLD_ASSERT(false);
-            break;
+        default: {
+            return false;
         }
     }
 
-    return input;
+    return in_buffer_head <= in_buffer_length;
 }
 
 const char* match_input_type_str(MatchInputType type) {
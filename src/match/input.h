@@ -109,7 +109,20 @@ struct MatchInput {
     };
 };
 
-void match_input_serialize(uint8_t* out_buffer, size_t& out_buffer_length, const MatchInput& input);
-MatchInput match_input_deserialize(const uint8_t* in_buffer, size_t& in_buffer_head);
+/**
+ * Inputs are written relative to the input before them. Cells are offsets from the previous cell,
+ * and a selection is either left out when it is the same as the previous one or delta coded when its ids are sorted.
+ * The reader has to start from a freshly initialized codec at the same point as the writer and see every input in the same order.
+ */
+struct MatchInputCodec {
+    ivec2 last_cell;
+    uint8_t last_selection_count;
+    EntityId last_selection[SELECTION_LIMIT];
+};
+
+void match_input_codec_init(MatchInputCodec& codec);
+void match_input_serialize(uint8_t* out_buffer, size_t& out_buffer_length, const MatchInput& input, MatchInputCodec& codec);
+// Returns false if the input has an unknown type or runs past in_buffer_length, in which case the codec should not be used again
+bool match_input_deserialize(const uint8_t* in_buffer, size_t in_buffer_length, size_t& in_buffer_head, MatchInputCodec& codec, MatchInput& input);
 const char* match_input_type_str(MatchInputType type);
 void match_input_print(char* out_ptr, const MatchInput& input);
\ No newline at end of file
@@ -4,9 +4,12 @@
 #include "core/asserts.h"
 #include "render/render.h"
 #include "match/lcg.h"
+#include "core/job.h"
 #include "profile/profile.h"
+#include <SDL3/SDL.h>
 #include <unordered_map>
 #include <algorithm>
+#include <climits>
 
 static const int MAP_PLAYER_SPAWN_SIZE = 13;
 static const int MAP_PLAYER_SPAWN_MARGIN = 3;
@@ -15,24 +18,75 @@ static const int MAP_ISLAND_UNASSIGNED = -1;
 static const uint8_t REGION_UNASSIGNED = UINT8_MAX;
 static const uint8_t MAP_REGIONS_NOT_CONNECTED = UINT8_MAX;
 static const uint8_t MAP_REGION_CONNECTIONS_NOT_CONNECTED = UINT8_MAX;
+static const uint16_t MAP_REGION_COST_UNREACHABLE = UINT16_MAX;
 static const uint32_t PATHFIND_ITERATION_MAX = 1999;
 
-struct PoissonAvoidValue {
-    ivec2 cell;
-    int distance;
+// Poisson samples and trees keep away from avoid values, such as ramps and gold mines. The avoid values are fixed
+// for the whole sample, so they are baked into a field that holds, for each cell, the smallest manhattan distance
+// to an avoid value minus that avoid value's distance. A cell is inside of an avoid value's distance when its clearance is <= 0.
+struct PoissonAvoidField {
+    int width;
+    int height;
+    std::vector<int> clearance;
+};
+
+// The points accepted by the sampler are bucketed into a grid of disk radius sized buckets,
+// so any accepted point within the disk radius of a candidate is in one of the 3x3 buckets around it
+struct PoissonSampleGrid {
+    int bucket_size;
+    int width;
+    int height;
+    std::vector<std::vector<ivec2>> buckets;
 };
 
 struct PoissonDiskParams {
-    std::vector<PoissonAvoidValue> avoid_values;
+    PoissonAvoidField avoid_field;
     int disk_radius;
     bool allow_unreachable_cells;
     ivec2 margin;
 };
 
+enum MapGenerateStage {
+    MAP_GENERATE_STAGE_CLEANUP_NOISE,
+    MAP_GENERATE_STAGE_TILES,
+    MAP_GENERATE_STAGE_RAMPS,
+    MAP_GENERATE_STAGE_UNREACHABLE_CELLS,
+    MAP_GENERATE_STAGE_PLAYER_SPAWNS,
+    MAP_GENERATE_STAGE_GOLDMINES,
+    MAP_GENERATE_STAGE_DECORATIONS,
+    MAP_GENERATE_STAGE_COUNT
+};
+
+static const char* MAP_GENERATE_STAGE_NAMES[MAP_GENERATE_STAGE_COUNT] = {
+    "cleanup noise",
+    "tiles",
+    "ramps",
+    "unreachable cells",
+    "player spawns",
+    "goldmines",
+    "decorations"
+};
+
+// Times each stage of map_init_generate() so that the log shows where match loading time goes
+struct MapGenerateTimer {
+    uint64_t start_time;
+    uint64_t stage_start_time;
+    uint64_t stage_durations[MAP_GENERATE_STAGE_COUNT];
+};
+
+static void map_generate_timer_begin(MapGenerateTimer& timer);
+static void map_generate_timer_end_stage(MapGenerateTimer& timer, MapGenerateStage stage);
+static void map_generate_timer_log(const MapGenerateTimer& timer);
+static void map_generate_ramps(Map& map);
+static void map_generate_player_spawns(const Map& map, std::vector<ivec2>& player_spawns);
+static void map_generate_goldmines(const Map& map, int* lcg_seed, const std::vector<ivec2>& player_spawns, std::vector<ivec2>& goldmine_cells);
 SpriteName map_wall_autotile_lookup(uint32_t neighbors);
-bool map_is_poisson_point_valid(const Map& map, const PoissonDiskParams& params, ivec2 point);
-std::vector<ivec2> map_poisson_disk(const Map& map, int* lcg_seed, PoissonDiskParams& params);
-bool map_is_tree_cell_valid(const Map& map, ivec2 cell, const std::vector<PoissonAvoidValue>& avoid_values);
+static void map_poisson_avoid_field_init(const Map& map, PoissonAvoidField& field);
+static void map_poisson_avoid_field_add(PoissonAvoidField& field, ivec2 cell, int distance);
+static void map_poisson_avoid_field_bake(PoissonAvoidField& field);
+bool map_is_poisson_point_valid(const Map& map, const PoissonDiskParams& params, const PoissonSampleGrid& sample_grid, ivec2 point);
+std::vector<ivec2> map_poisson_disk(const Map& map, int* lcg_seed, const PoissonDiskParams& params);
+bool map_is_tree_cell_valid(const Map& map, ivec2 cell, const PoissonAvoidField& avoid_field);
 
 void map_init(Map& map, MapType map_type, int width, int height) {
     memset(&map, 0, sizeof(map));
@@ -63,15 +117,84 @@ void map_init(Map& map, MapType map_type, int width, int height) {
 }
 
 void map_init_generate(Map& map, MapType map_type, Noise* noise, int* lcg_seed, std::vector<ivec2>& player_spawns, std::vector<ivec2>& goldmine_cells) {
+    ZoneScoped;
+
+    MapGenerateTimer timer;
+    map_generate_timer_begin(timer);
+
     map_init(map, map_type, noise->width, noise->height);
 
     map_cleanup_noise(map, noise);
+    map_generate_timer_end_stage(timer, MAP_GENERATE_STAGE_CLEANUP_NOISE);
 
     // Bake map tiles
     map_bake_map_tiles_and_remove_artifacts(map, noise, lcg_seed);
     map_bake_front_walls(map);
+    map_generate_timer_end_stage(timer, MAP_GENERATE_STAGE_TILES);
+
+    map_generate_ramps(map);
+    log_debug("Generated ramps.");
+    map_generate_timer_end_stage(timer, MAP_GENERATE_STAGE_RAMPS);
+
+    // Block all walls and water
+    for (int index = 0; index < map.width * map.height; index++) {
+        ivec2 cell = ivec2(index % map.width, index / map.width);
+        if (!map_is_tile_ground(map, cell) && !map_is_tile_ramp(map, cell)) {
+            map.cells[CELL_LAYER_GROUND][index].type = CELL_BLOCKED;
+        }
+    }
+
+    // Calculate unreachable cells
+    map_calculate_unreachable_cells(map);
+    map_generate_timer_end_stage(timer, MAP_GENERATE_STAGE_UNREACHABLE_CELLS);
+
+    map_generate_player_spawns(map, player_spawns);
+    log_debug("Determined player spawns.");
+    map_generate_timer_end_stage(timer, MAP_GENERATE_STAGE_PLAYER_SPAWNS);
+
+    map_generate_goldmines(map, lcg_seed, player_spawns, goldmine_cells);
+    log_debug("Generated gold mines.");
+    map_generate_timer_end_stage(timer, MAP_GENERATE_STAGE_GOLDMINES);
+
+    // Generate decorations
+    map_generate_decorations(map, noise, lcg_seed, goldmine_cells);
+    log_debug("Generated decorations.");
+    map_generate_timer_end_stage(timer, MAP_GENERATE_STAGE_DECORATIONS);
+
+    map_generate_timer_log(timer);
+}
+
+static void map_generate_timer_begin(MapGenerateTimer& timer) {
+    timer.start_time = SDL_GetTicksNS();
+    timer.stage_start_time = timer.start_time;
+    memset(timer.stage_durations, 0, sizeof(timer.stage_durations));
+}
+
+static void map_generate_timer_end_stage(MapGenerateTimer& timer, MapGenerateStage stage) {
+    uint64_t now = SDL_GetTicksNS();
+    timer.stage_durations[stage] += now - timer.stage_start_time;
+    timer.stage_start_time = now;
+}
+
+static void map_generate_timer_log(const MapGenerateTimer& timer) {
+    char summary[256];
+    size_t summary_length = 0;
+    for (uint32_t stage = 0; stage < MAP_GENERATE_STAGE_COUNT; stage++) {
+        int length = snprintf(summary + summary_length, sizeof(summary) - summary_length, "%s%s %.2fms",
+            stage == 0 ? "" : ", ",
+            MAP_GENERATE_STAGE_NAMES[stage],
+            (double)timer.stage_durations[stage] / 1000000.0);
+        if (length < 0 || (size_t)length >= sizeof(summary) - summary_length) {
+            break;
+        }
+        summary_length += (size_t)length;
+    }
+    log_info("Map generation complete in %.2fms. %s", (double)(timer.stage_start_time - timer.start_time) / 1000000.0, summary);
+}
+
+static void map_generate_ramps(Map& map) {
+    ZoneScoped;
 
-    // Generate ramps
     std::vector<ivec2> stair_cells;
     for (int pass = 0; pass < 2; pass++) {
         for (int x = 0; x < map.width; x++) {
@@ -153,160 +276,136 @@ void map_init_generate(Map& map, MapType map_type, Noise* noise, int* lcg_seed,
             } // End for each y
         } // End for each x
     } // End for each pass
-    // End create ramps
-    log_debug("Generated ramps.");
-
-    // Block all walls and water
-    for (int index = 0; index < map.width * map.height; index++) {
-        ivec2 cell = ivec2(index % map.width, index / map.width);
-        if (!map_is_tile_ground(map, cell) && !map_is_tile_ramp(map, cell)) {
-            map.cells[CELL_LAYER_GROUND][index].type = CELL_BLOCKED;
-        }
-    }
+}
 
-    // Calculate unreachable cells
-    map_calculate_unreachable_cells(map);
+static void map_generate_player_spawns(const Map& map, std::vector<ivec2>& player_spawns) {
+    ZoneScoped;
 
-    // Determine player spawns
-    {
-        for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
-            player_spawns.push_back(ivec2(-1, -1));
-        }
-        const int spawn_margin = (MAP_PLAYER_SPAWN_SIZE / 2) + MAP_PLAYER_SPAWN_MARGIN;
-        const Rect spawn_point_rect = (Rect) {
-            .x = spawn_margin,
-            .y = spawn_margin,
-            .w = map.width - (2 * spawn_margin),
-            .h = map.height - (2 * spawn_margin)
-        };
+    player_spawns.assign(MAX_PLAYERS, ivec2(-1, -1));
+    const int spawn_margin = (MAP_PLAYER_SPAWN_SIZE / 2) + MAP_PLAYER_SPAWN_MARGIN;
+    const Rect spawn_point_rect = (Rect) {
+        .x = spawn_margin,
+        .y = spawn_margin,
+        .w = map.width - (2 * spawn_margin),
+        .h = map.height - (2 * spawn_margin)
+    };
 
-        for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
-            // Chooses diagonal directions clockwise beginning with NE
-            int spawn_direction = 1 + (player_id * 2);
+    // Each player's search only reads the map, so the searches run as parallel jobs
+    job_parallel_for(MAX_PLAYERS, [&map, &player_spawns, &spawn_point_rect](uint32_t player_id) {
+        // Chooses diagonal directions clockwise beginning with NE
+        int spawn_direction = 1 + (player_id * 2);
 
-            ivec2 start = ivec2(
-                DIRECTION_IVEC2[spawn_direction].x == -1 ? spawn_point_rect.x : spawn_point_rect.x + spawn_point_rect.w - 1,
-                DIRECTION_IVEC2[spawn_direction].y == -1 ? spawn_point_rect.y : spawn_point_rect.y + spawn_point_rect.h - 1);
-            std::vector<ivec2> frontier;
-            std::vector<bool> explored(map.width * map.height, false);
-            frontier.push_back(start);
-            ivec2 spawn_point = ivec2(-1, -1);
-
-            while (!frontier.empty() && spawn_point.x == -1) {
-                uint32_t next_index = 0;
-                for (uint32_t index = 1; index < frontier.size(); index++) {
-                    if (ivec2::manhattan_distance(frontier[index], start) < ivec2::manhattan_distance(frontier[next_index], start)) {
-                        next_index = index;
-                    }
+        ivec2 start = ivec2(
+            DIRECTION_IVEC2[spawn_direction].x == -1 ? spawn_point_rect.x : spawn_point_rect.x + spawn_point_rect.w - 1,
+            DIRECTION_IVEC2[spawn_direction].y == -1 ? spawn_point_rect.y : spawn_point_rect.y + spawn_point_rect.h - 1);
+        std::vector<ivec2> frontier;
+        std::vector<bool> explored(map.width * map.height, false);
+        frontier.push_back(start);
+        ivec2 spawn_point = ivec2(-1, -1);
+
+        while (!frontier.empty() && spawn_point.x == -1) {
+            uint32_t next_index = 0;
+            for (uint32_t index = 1; index < frontier.size(); index++) {
+                if (ivec2::manhattan_distance(frontier[index], start) < ivec2::manhattan_distance(frontier[next_index], start)) {
+                    next_index = index;
                 }
-                ivec2 candidate_center = frontier[next_index];
-                frontier.erase(frontier.begin() + next_index);
-                ivec2 candidate_top_left = candidate_center - ivec2(MAP_PLAYER_SPAWN_SIZE / 2, MAP_PLAYER_SPAWN_SIZE / 2);
-
-                if (map_is_cell_rect_same_elevation(map, candidate_top_left, MAP_PLAYER_SPAWN_SIZE) && 
-                        !map_is_cell_rect_occupied(map, CELL_LAYER_GROUND, candidate_top_left, MAP_PLAYER_SPAWN_SIZE)) {
-                    
-                    // last check, check that candidate is not too close to stairs or walls
-                    bool is_candidate_valid = true;
-                    const int stair_radius = 2;
-                    const int goldmine_size = 3;
-                    for (int x = candidate_center.x - stair_radius; x < candidate_center.x + goldmine_size + stair_radius; x++) {
-                        for (int y = candidate_center.y - stair_radius; y < candidate_center.y + goldmine_size + stair_radius; y++) {
-                            if (!map_is_cell_in_bounds(map, ivec2(x, y))) {
-                                continue;
-                            }
-                            if (map_is_tile_ramp(map, ivec2(x, y)) || map_get_cell(map, CELL_LAYER_GROUND, ivec2(x, y)).type != CELL_EMPTY) {
-                                is_candidate_valid = false;
-                                break;
-                            }
+            }
+            ivec2 candidate_center = frontier[next_index];
+            frontier.erase(frontier.begin() + next_index);
+            ivec2 candidate_top_left = candidate_center - ivec2(MAP_PLAYER_SPAWN_SIZE / 2, MAP_PLAYER_SPAWN_SIZE / 2);
+
+            if (map_is_cell_rect_same_elevation(map, candidate_top_left, MAP_PLAYER_SPAWN_SIZE) && 
+                    !map_is_cell_rect_occupied(map, CELL_LAYER_GROUND, candidate_top_left, MAP_PLAYER_SPAWN_SIZE)) {
+                
+                // last check, check that candidate is not too close to stairs or walls
+                bool is_candidate_valid = true;
+                const int stair_radius = 2;
+                const int goldmine_size = 3;
+                for (int x = candidate_center.x - stair_radius; x < candidate_center.x + goldmine_size + stair_radius; x++) {
+                    for (int y = candidate_center.y - stair_radius; y < candidate_center.y + goldmine_size + stair_radius; y++) {
+                        if (!map_is_cell_in_bounds(map, ivec2(x, y))) {
+                            continue;
                         }
-                        if (!is_candidate_valid) {
+                        if (map_is_tile_ramp(map, ivec2(x, y)) || map_get_cell(map, CELL_LAYER_GROUND, ivec2(x, y)).type != CELL_EMPTY) {
+                            is_candidate_valid = false;
                             break;
                         }
                     }
-                    if (is_candidate_valid) {
-                        spawn_point = candidate_center;
+                    if (!is_candidate_valid) {
                         break;
                     }
                 }
-
-                explored[candidate_center.x + (candidate_center.y * map.width)] = 1;
-                for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
-                    ivec2 child = candidate_center + DIRECTION_IVEC2[direction];
-                    if (!spawn_point_rect.has_point(child)) {
-                        continue;
-                    }
-                    if (explored[child.x + (child.y * map.width)]) {
-                        continue;
-                    }
-                    bool is_in_frontier = false;
-                    for (ivec2 cell : frontier) {
-                        if (child == cell) {
-                            is_in_frontier = true;
-                        }
-                    }
-                    if (is_in_frontier) {
-                        continue;
-                    }
-                    frontier.push_back(child);
+                if (is_candidate_valid) {
+                    spawn_point = candidate_center;
+                    break;
                 }
             }
 
-            if (spawn_point.x == -1) {
-                log_error("Unable to find valid spawn point for spawn direction %i", spawn_direction);
-                spawn_point = start;
+            explored[candidate_center.x + (candidate_center.y * map.width)] = 1;
+            for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+                ivec2 child = candidate_center + DIRECTION_IVEC2[direction];
+                if (!spawn_point_rect.has_point(child)) {
+                    continue;
+                }
+                if (explored[child.x + (child.y * map.width)]) {
+                    continue;
+                }
+                bool is_in_frontier = false;
+                for (ivec2 cell : frontier) {
+                    if (child == cell) {
+                        is_in_frontier = true;
+                    }
+                }
+                if (is_in_frontier) {
+                    continue;
+                }
+                frontier.push_back(child);
             }
-            player_spawns[player_id] = spawn_point;
         }
-    }
-    // End determine player spawns
-    log_debug("Determined player spawns.");
 
-    // Generate gold mines
-    {
-        PoissonDiskParams params = (PoissonDiskParams) {
-            .avoid_values = std::vector<PoissonAvoidValue>(),
-            .disk_radius = 48,
-            .allow_unreachable_cells = false,
-            .margin = ivec2(5, 5)
-        };
+        if (spawn_point.x == -1) {
+            log_error("Unable to find valid spawn point for spawn direction %i", spawn_direction);
+            spawn_point = start;
+        }
+        player_spawns[player_id] = spawn_point;
+    });
+}
 
-        // Place a gold mine on each player's spawn
-        for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
-            GOLD_ASSERT(player_spawns[player_id].x != -1);
+static void map_generate_goldmines(const Map& map, int* lcg_seed, const std::vector<ivec2>& player_spawns, std::vector<ivec2>& goldmine_cells) {
+    ZoneScoped;
 
-            ivec2 mine_cell = player_spawns[player_id];
-            goldmine_cells.push_back(mine_cell);
-            params.avoid_values.push_back((PoissonAvoidValue) {
-                .cell = mine_cell,
-                .distance = 48
-            });
-        }
+    PoissonDiskParams params;
+    params.disk_radius = 48;
+    params.allow_unreachable_cells = false;
+    params.margin = ivec2(5, 5);
+    map_poisson_avoid_field_init(map, params.avoid_field);
 
-        // Generate the avoid values
-        for (int index = 0; index < map.width * map.height; index++) {
-            if (map.cells[CELL_LAYER_GROUND][index].type == CELL_BLOCKED || map_is_tile_ramp(map, ivec2(index % map.width, index / map.width))) {
-                params.avoid_values.push_back((PoissonAvoidValue) {
-                    .cell = ivec2(index % map.width, index / map.width),
-                    .distance = 6
-                }); 
-            }
-        }
+    // Place a gold mine on each player's spawn
+    for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+        GOLD_ASSERT(player_spawns[player_id].x != -1);
 
-        std::vector<ivec2> goldmine_results = map_poisson_disk(map, lcg_seed, params);
-        goldmine_cells.insert(goldmine_cells.end(), goldmine_results.begin(), goldmine_results.end());
+        ivec2 mine_cell = player_spawns[player_id];
+        goldmine_cells.push_back(mine_cell);
+        map_poisson_avoid_field_add(params.avoid_field, mine_cell, 48);
     }
-    // End generate gold mines
-    log_debug("Generated gold mines.");
 
-    // Generate decorations
-    map_generate_decorations(map, noise, lcg_seed, goldmine_cells);
-    log_debug("Generated decorations.");
+    // Generate the avoid values
+    for (int index = 0; index < map.width * map.height; index++) {
+        if (map.cells[CELL_LAYER_GROUND][index].type == CELL_BLOCKED || map_is_tile_ramp(map, ivec2(index % map.width, index / map.width))) {
+            map_poisson_avoid_field_add(params.avoid_field, ivec2(index % map.width, index / map.width), 6);
+        }
+    }
+    map_poisson_avoid_field_bake(params.avoid_field);
 
-    log_info("Map generation complete.");
+    std::vector<ivec2> goldmine_results = map_poisson_disk(map, lcg_seed, params);
+    goldmine_cells.insert(goldmine_cells.end(), goldmine_results.begin(), goldmine_results.end());
 }
 
+static void map_bake_region_routes(Map& map);
+
 void map_init_regions(Map& map) {
+    ZoneScoped;
+
     // Create map regions
     map.region_count = 0;
     for (int index = 0; index < map.width * map.height; index++) {
@@ -433,6 +532,12 @@ void map_init_regions(Map& map) {
             map.region_connection_to_connection_cost[connection_index][other_index] = MAP_REGION_CONNECTIONS_NOT_CONNECTED;
         }
     }
+    struct RegionConnectionPair {
+        uint8_t connection_index;
+        uint8_t other_index;
+        uint8_t cost;
+    };
+    std::vector<RegionConnectionPair> connection_pairs;
     for (uint32_t region_connection_index = 0; region_connection_index < map.region_connection_count; region_connection_index++) {
         const MapRegionConnection* region_connection = &map.region_connections[region_connection_index];
 
@@ -446,45 +551,114 @@ void map_init_regions(Map& map) {
                 continue;
             }
 
-            // If we have already computed this path one way, don't re-compute it
+            // If we have already queued this path one way, don't re-compute it
             if (map.region_connection_to_connection_cost[region_connection_index][other_connection_index] != MAP_REGION_CONNECTIONS_NOT_CONNECTED) {
                 continue;
             }
 
-            MapPath path;
-            map_pathfind(map, CELL_LAYER_GROUND, region_connection_centers[region_connection_index], region_connection_centers[other_connection_index], 1, MAP_OPTION_NO_REGION_PATH, NULL, &path);
-            GOLD_ASSERT(path.size() < MAP_REGION_CONNECTIONS_NOT_CONNECTED);
-            map.region_connection_to_connection_cost[region_connection_index][other_connection_index] = (uint8_t)path.size();
-            map.region_connection_to_connection_cost[other_connection_index][region_connection_index] = (uint8_t)path.size();
+            connection_pairs.push_back((RegionConnectionPair) {
+                .connection_index = (uint8_t)region_connection_index,
+                .other_index = other_connection_index,
+                .cost = 0
+            });
+            map.region_connection_to_connection_cost[region_connection_index][other_connection_index] = 0;
+            map.region_connection_to_connection_cost[other_connection_index][region_connection_index] = 0;
         }
     }
+
+    // The pathfinds only read the map, so they run as parallel jobs
+    job_parallel_for((uint32_t)connection_pairs.size(), [&map, &connection_pairs, &region_connection_centers](uint32_t pair_index) {
+        RegionConnectionPair& pair = connection_pairs[pair_index];
+        MapPath path;
+        map_pathfind(map, CELL_LAYER_GROUND, region_connection_centers[pair.connection_index], region_connection_centers[pair.other_index], 1, MAP_OPTION_NO_REGION_PATH, NULL, &path);
+        GOLD_ASSERT(path.size() < MAP_REGION_CONNECTIONS_NOT_CONNECTED);
+        pair.cost = (uint8_t)path.size();
+    });
+    for (const RegionConnectionPair& pair : connection_pairs) {
+        map.region_connection_to_connection_cost[pair.connection_index][pair.other_index] = pair.cost;
+        map.region_connection_to_connection_cost[pair.other_index][pair.connection_index] = pair.cost;
+    }
+
+    map_bake_region_routes(map);
 }
 
-void map_cleanup_noise(const Map& map, Noise* noise) {
-    // Clear out water that is too close to walls
-    const int WATER_WALL_DIST = 6;
-    for (int x = 0; x < noise->width; x++) {
-        for (int y = 0; y < noise->height; y++) {
-            if (noise->map[x + (y * noise->width)] != NOISE_VALUE_WATER) {
+static void map_bake_region_routes(Map& map) {
+    ZoneScoped;
+
+    // Connection A -> B has its cells in region B, and stepping from it to connection B -> C costs region_connection_to_connection_cost
+    for (uint32_t connection_index = 0; connection_index < map.region_connection_count; connection_index++) {
+        for (uint32_t other_index = 0; other_index < map.region_connection_count; other_index++) {
+            uint8_t connection_cost = map.region_connection_to_connection_cost[connection_index][other_index];
+            bool is_step = connection_cost != MAP_REGION_CONNECTIONS_NOT_CONNECTED &&
+                map.region_connection_indices[map_get_region(map, map.region_connections[connection_index].cells[0])][map_get_region(map, map.region_connections[other_index].cells[0])] == other_index;
+            if (connection_index == other_index) {
+                map.region_connection_route_cost[connection_index][other_index] = 0;
+                map.region_connection_route_next[connection_index][other_index] = (uint8_t)other_index;
+            } else if (is_step) {
+                map.region_connection_route_cost[connection_index][other_index] = connection_cost;
+                map.region_connection_route_next[connection_index][other_index] = (uint8_t)other_index;
+            } else {
+                map.region_connection_route_cost[connection_index][other_index] = MAP_REGION_COST_UNREACHABLE;
+                map.region_connection_route_next[connection_index][other_index] = MAP_REGIONS_NOT_CONNECTED;
+            }
+        }
+    }
+
+    // Floyd-Warshall, there are few enough connections that this is cheap and it only runs once per map
+    for (uint32_t via_index = 0; via_index < map.region_connection_count; via_index++) {
+        for (uint32_t connection_index = 0; connection_index < map.region_connection_count; connection_index++) {
+            uint16_t cost_to_via = map.region_connection_route_cost[connection_index][via_index];
+            if (cost_to_via == MAP_REGION_COST_UNREACHABLE) {
                 continue;
             }
+            for (uint32_t other_index = 0; other_index < map.region_connection_count; other_index++) {
+                uint16_t cost_from_via = map.region_connection_route_cost[via_index][other_index];
+                if (cost_from_via == MAP_REGION_COST_UNREACHABLE) {
+                    continue;
+                }
+                int route_cost = std::min((int)cost_to_via + (int)cost_from_via, (int)MAP_REGION_COST_UNREACHABLE - 1);
+                if (route_cost < map.region_connection_route_cost[connection_index][other_index]) {
+                    map.region_connection_route_cost[connection_index][other_index] = (uint16_t)route_cost;
+                    map.region_connection_route_next[connection_index][other_index] = map.region_connection_route_next[connection_index][via_index];
+                }
+            }
+        }
+    }
+}
 
-            bool is_too_close_to_wall = false;
-            for (int nx = x - WATER_WALL_DIST; nx < x + WATER_WALL_DIST + 1; nx++) {
-                for (int ny = y - WATER_WALL_DIST; ny < y + WATER_WALL_DIST + 1; ny++) {
-                    if (!map_is_cell_in_bounds(map, ivec2(nx, ny))) {
-                        continue;
+void map_cleanup_noise(const Map& map, Noise* noise) {
+    ZoneScoped;
+
+    // Clear out water that is too close to walls
+    // This only turns water into lowground and only looks for highground, so each row can be checked in parallel
+    {
+        const int WATER_WALL_DIST = 6;
+        std::vector<uint8_t> is_too_close_to_wall(noise->width * noise->height, 0);
+        job_parallel_for((uint32_t)noise->height, [&map, noise, &is_too_close_to_wall](uint32_t row) {
+            const int y = (int)row;
+            for (int x = 0; x < noise->width; x++) {
+                if (noise->map[x + (y * noise->width)] != NOISE_VALUE_WATER) {
+                    continue;
+                }
+
+                for (int nx = x - WATER_WALL_DIST; nx < x + WATER_WALL_DIST + 1; nx++) {
+                    for (int ny = y - WATER_WALL_DIST; ny < y + WATER_WALL_DIST + 1; ny++) {
+                        if (!map_is_cell_in_bounds(map, ivec2(nx, ny))) {
+                            continue;
+                        }
+                        if (noise->map[nx + (ny * noise->width)] == NOISE_VALUE_HIGHGROUND && ivec2::manhattan_distance(ivec2(x, y), ivec2(nx, ny)) <= WATER_WALL_DIST) {
+                            is_too_close_to_wall[x + (y * noise->width)] = 1;
+                        }
                     }
-                    if (noise->map[nx + (ny * noise->width)] == NOISE_VALUE_HIGHGROUND && ivec2::manhattan_distance(ivec2(x, y), ivec2(nx, ny)) <= WATER_WALL_DIST) {
-                        is_too_close_to_wall = true;
+                    if (is_too_close_to_wall[x + (y * noise->width)]) {
+                        break;
                     }
                 }
-                if (is_too_close_to_wall) {
-                    break;
-                }
             }
-            if (is_too_close_to_wall) {
-                noise->map[x + (y * noise->width)] = NOISE_VALUE_LOWGROUND;
+        });
+        for (int index = 0; index < noise->width * noise->height; index++) {
+            if (is_too_close_to_wall[index]) {
+                noise->map[index] = NOISE_VALUE_LOWGROUND;
             }
         }
     }
@@ -557,24 +731,26 @@ void map_cleanup_noise(const Map& map, Noise* noise) {
     {
         std::vector<int> map_tile_islands(noise->width * noise->height, MAP_ISLAND_UNASSIGNED);
         std::vector<int> island_size;
+        std::vector<uint8_t> island_noise_values;
 
+        // Every cell before the search index has already been assigned to an island
+        int search_index = 0;
         while (true) {
             // Set index equal to the first index of the first unassigned tile in the array
-            int index;
-            for (index = 0; index < noise->width * noise->height; index++) {
-                if (map_tile_islands[index] == -1) {
-                    break;
-                }
+            while (search_index < noise->width * noise->height && map_tile_islands[search_index] != MAP_ISLAND_UNASSIGNED) {
+                search_index++;
             }
-            if (index == noise->width * noise->height) {
+            if (search_index == noise->width * noise->height) {
                 // Island mapping is complete
                 break;
             }
+            int index = search_index;
 
             // Determine the next island index
             int island_index = island_size.size();
             island_size.push_back(0);
             int8_t island_noise_value = noise->map[index];
+            island_noise_values.push_back(noise->map[index]);
 
             // Flood fill this island index
             std::vector<ivec2> frontier;
@@ -605,36 +781,16 @@ void map_cleanup_noise(const Map& map, Noise* noise) {
         } 
         // End assign noise tiles to islands
 
-        for (int island_index = 0; island_index < (int)island_size.size(); island_index++) {
-            // Big islands are fine as they are
-            if (island_size[island_index] > 15) {
-                continue;
-            }
-
-            // Find the first index which belongs to this island
-            int first_index;
-            for (first_index = 0; first_index < noise->width * noise->height; first_index++) {
-                if (map_tile_islands[first_index] == island_index) {
-                    break;
-                }
-            }
-            ivec2 first_index_coord = ivec2(first_index % noise->width, first_index / noise->width);
-
-            // And use that index to determine the island's noise value
-            // If the noise value is non-zero, then skip it
-            if (noise->map[first_index] != NOISE_VALUE_LOWGROUND) {
+        // We now have the small 0-elevation sections of the noise map that we would like to clean up
+        // So replace them with a different noise level. Big islands are fine as they are.
+        // Islands are disjoint, so replacing them all in one pass is the same as replacing them one island at a time
+        for (int index = 0; index < noise->width * noise->height; index++) {
+            int island_index = map_tile_islands[index];
+            if (island_size[island_index] > 15 || island_noise_values[island_index] != NOISE_VALUE_LOWGROUND) {
                 continue;
             }
 
-            // We now have a small 0-elevation section of the noise map that we would like to clean up
-            // So replace the 0-elevation section with a different noise level
-            for (int index = 0; index < noise->width * noise->height; index++) {
-                if (map_tile_islands[index] != island_index) {
-                    continue;
-                }
-
-                noise->map[index] = NOISE_VALUE_HIGHGROUND;
-            }
+            noise->map[index] = NOISE_VALUE_HIGHGROUND;
         }
     }
     
@@ -735,8 +891,12 @@ void map_cleanup_noise(const Map& map, Noise* noise) {
 }
 
 void map_bake_tiles(Map& map, const Noise* noise, int* lcg_seed) {
-    for (int y = 0; y < map.height; y++) {
-        for (int x = 0; x < map.width; x++) {
+    map_bake_tiles_in_rect(map, noise, lcg_seed, ivec2(0, 0), ivec2(map.width - 1, map.height - 1));
+}
+
+void map_bake_tiles_in_rect(Map& map, const Noise* noise, int* lcg_seed, ivec2 cell_min, ivec2 cell_max) {
+    for (int y = cell_min.y; y <= cell_max.y; y++) {
+        for (int x = cell_min.x; x <= cell_max.x; x++) {
             int index = x + (y * map.width);
             if (noise->map[index] >= NOISE_VALUE_LOWGROUND) {
                 map.tiles[index].elevation = (uint8_t)(noise->map[index] == NOISE_VALUE_HIGHGROUND || noise->map[index] == NOISE_VALUE_RAMP);
@@ -803,6 +963,8 @@ void map_bake_tiles(Map& map, const Noise* noise, int* lcg_seed) {
 }
 
 void map_bake_map_tiles_and_remove_artifacts(Map& map, Noise* noise, int* lcg_seed) {
+    ZoneScoped;
+
     std::vector<ivec2> artifacts;
     do {
         for (int index = 0; index < map.width * map.height; index++) {
@@ -831,17 +993,21 @@ void map_bake_map_tiles_and_remove_artifacts(Map& map, Noise* noise, int* lcg_se
 }
 
 void map_bake_front_walls(Map& map) {
-    for (int index = 0; index < map.width * map.height; index++) {
-        int previous = index - map.width;
-        if (previous < 0) {
-            continue;
-        }
-        if (map.tiles[previous].sprite == SPRITE_TILE_WALL_SOUTH_EDGE) {
-            map.tiles[index].sprite = SPRITE_TILE_WALL_SOUTH_FRONT;
-        } else if (map.tiles[previous].sprite == SPRITE_TILE_WALL_SW_CORNER) {
-            map.tiles[index].sprite = SPRITE_TILE_WALL_SW_FRONT;
-        } else if (map.tiles[previous].sprite == SPRITE_TILE_WALL_SE_CORNER) {
-            map.tiles[index].sprite = SPRITE_TILE_WALL_SE_FRONT;
+    map_bake_front_walls_in_rect(map, ivec2(0, 0), ivec2(map.width - 1, map.height - 1));
+}
+
+void map_bake_front_walls_in_rect(Map& map, ivec2 cell_min, ivec2 cell_max) {
+    for (int y = std::max(cell_min.y, 1); y <= cell_max.y; y++) {
+        for (int x = cell_min.x; x <= cell_max.x; x++) {
+            int index = x + (y * map.width);
+            int previous = index - map.width;
+            if (map.tiles[previous].sprite == SPRITE_TILE_WALL_SOUTH_EDGE) {
+                map.tiles[index].sprite = SPRITE_TILE_WALL_SOUTH_FRONT;
+            } else if (map.tiles[previous].sprite == SPRITE_TILE_WALL_SW_CORNER) {
+                map.tiles[index].sprite = SPRITE_TILE_WALL_SW_FRONT;
+            } else if (map.tiles[previous].sprite == SPRITE_TILE_WALL_SE_CORNER) {
+                map.tiles[index].sprite = SPRITE_TILE_WALL_SE_FRONT;
+            }
         }
     }
 }
@@ -944,14 +1110,21 @@ void map_bake_ramp(Map& map, Direction stair_direction, ivec2 stair_min, ivec2 s
 }
 
 void map_bake_ramps(Map& map, const Noise* noise) {
+    map_bake_ramps_in_rect(map, noise, ivec2(0, 0), ivec2(map.width - 1, map.height - 1));
+}
+
+void map_bake_ramps_in_rect(Map& map, const Noise* noise, ivec2 cell_min, ivec2 cell_max) {
     std::vector<bool> is_ramp(map.width * map.height, false);
-    for (int index = 0; index < map.width * map.height; index++) {
-        if (noise->map[index] == NOISE_VALUE_RAMP) {
-            is_ramp[index] = true;
+    for (int y = cell_min.y; y <= cell_max.y; y++) {
+        for (int x = cell_min.x; x <= cell_max.x; x++) {
+            int index = x + (y * map.width);
+            if (noise->map[index] == NOISE_VALUE_RAMP) {
+                is_ramp[index] = true;
+            }
         }
     }
 
-    for (int index = 0; index < map.width * map.height; index++) {
+    for (int index = cell_min.x + (cell_min.y * map.width); index <= cell_max.x + (cell_max.y * map.width); index++) {
         if (!is_ramp[index]) {
             continue;
         }
@@ -1003,6 +1176,76 @@ void map_bake_ramps(Map& map, const Noise* noise) {
     }
 }
 
+// Unlike map_clamp_cell(), keeps the cell inside the map so that it can be used as an inclusive rect bound
+static ivec2 map_clamp_bake_rect_cell(const Map& map, ivec2 cell) {
+    return ivec2(
+        std::clamp(cell.x, 0, map.width - 1),
+        std::clamp(cell.y, 0, map.height - 1)
+    );
+}
+
+void map_expand_bake_rect(const Map& map, const Noise* noise, ivec2* cell_min, ivec2* cell_max) {
+    // Autotiling looks 1 cell out and front walls look 1 more cell up,
+    // so noise changes can affect tiles up to 2 cells away
+    *cell_min = map_clamp_bake_rect_cell(map, *cell_min - ivec2(2, 2));
+    *cell_max = map_clamp_bake_rect_cell(map, *cell_max + ivec2(2, 2));
+
+    // Ramps are baked on top of the other tiles, so rebaking any tile under a ramp means rebaking the whole ramp.
+    // Ramps also read the tiles around them, so include every ramp that is close enough to see the rect,
+    // then repeat since each ramp that gets included grows the rect
+    std::vector<bool> is_ramp_visited(map.width * map.height, false);
+    std::vector<ivec2> frontier;
+    bool has_rect_grown = true;
+    while (has_rect_grown) {
+        has_rect_grown = false;
+        ivec2 search_min = map_clamp_bake_rect_cell(map, *cell_min - ivec2(3, 3));
+        ivec2 search_max = map_clamp_bake_rect_cell(map, *cell_max + ivec2(3, 3));
+        for (int y = search_min.y; y <= search_max.y; y++) {
+            for (int x = search_min.x; x <= search_max.x; x++) {
+                int index = x + (y * map.width);
+                if (noise->map[index] != NOISE_VALUE_RAMP || is_ramp_visited[index]) {
+                    continue;
+                }
+
+                // Flood fill the ramp to find its bounds
+                ivec2 ramp_min = ivec2(x, y);
+                ivec2 ramp_max = ivec2(x, y);
+                is_ramp_visited[index] = true;
+                frontier.push_back(ivec2(x, y));
+                while (!frontier.empty()) {
+                    ivec2 cell = frontier.back();
+                    frontier.pop_back();
+                    ramp_min = ivec2(std::min(ramp_min.x, cell.x), std::min(ramp_min.y, cell.y));
+                    ramp_max = ivec2(std::max(ramp_max.x, cell.x), std::max(ramp_max.y, cell.y));
+
+                    for (int direction = 0; direction < DIRECTION_COUNT; direction += 2) {
+                        ivec2 neighbor = cell + DIRECTION_IVEC2[direction];
+                        if (!map_is_cell_in_bounds(map, neighbor)) {
+                            continue;
+                        }
+                        int neighbor_index = neighbor.x + (neighbor.y * map.width);
+                        if (noise->map[neighbor_index] != NOISE_VALUE_RAMP || is_ramp_visited[neighbor_index]) {
+                            continue;
+                        }
+                        is_ramp_visited[neighbor_index] = true;
+                        frontier.push_back(neighbor);
+                    }
+                }
+
+                // South stairs also bake the front tile below them
+                ramp_max = map_clamp_bake_rect_cell(map, ramp_max + ivec2(0, 1));
+
+                if (ramp_min.x < cell_min->x || ramp_min.y < cell_min->y ||
+                        ramp_max.x > cell_max->x || ramp_max.y > cell_max->y) {
+                    *cell_min = ivec2(std::min(cell_min->x, ramp_min.x), std::min(cell_min->y, ramp_min.y));
+                    *cell_max = ivec2(std::max(cell_max->x, ramp_max.x), std::max(cell_max->y, ramp_max.y));
+                    has_rect_grown = true;
+                }
+            }
+        }
+    }
+}
+
 SpriteName map_choose_ground_tile_sprite(MapType map_type, int index, int* lcg_seed) {
     switch (map_type) {
         case MAP_TYPE_TOMBSTONE: {
@@ -1092,8 +1335,15 @@ SpriteName map_get_decoration_sprite(MapType map_type) {
 }
 
 void map_generate_decorations(Map& map, Noise* noise, int* lcg_seed, const std::vector<ivec2>& goldmine_cells) {
+    ZoneScoped;
+
+    PoissonDiskParams params;
+    params.disk_radius = 16;
+    params.allow_unreachable_cells = true;
+    params.margin = ivec2(0, 0);
+
     // Generate avoid values for decorations
-    std::vector<PoissonAvoidValue> avoid_values;
+    map_poisson_avoid_field_init(map, params.avoid_field);
 
     // Ramps
     for (int y = 0; y < map.height; y++) {
@@ -1101,27 +1351,15 @@ void map_generate_decorations(Map& map, Noise* noise, int* lcg_seed, const std::
             if (!map_is_tile_ramp(map, ivec2(x, y))) {
                 continue;
             }
-            avoid_values.push_back((PoissonAvoidValue) {
-                .cell = ivec2(x, y),
-                .distance = 6
-            });
+            map_poisson_avoid_field_add(params.avoid_field, ivec2(x, y), 6);
         }
     }
 
     // Goldmines
     for (ivec2 goldmine_cell : goldmine_cells) {
-        avoid_values.push_back((PoissonAvoidValue) {
-            .cell = goldmine_cell,
-            .distance = 16
-        });
+        map_poisson_avoid_field_add(params.avoid_field, goldmine_cell, 16);
     }
-
-    PoissonDiskParams params = (PoissonDiskParams) {
-        .avoid_values = avoid_values,
-        .disk_radius = 16,
-        .allow_unreachable_cells = true,
-        .margin = ivec2(0, 0)
-    };
+    map_poisson_avoid_field_bake(params.avoid_field);
 
     std::vector<ivec2> decoration_cells = map_poisson_disk(map, lcg_seed, params);
 
@@ -1149,7 +1387,7 @@ void map_generate_decorations(Map& map, Noise* noise, int* lcg_seed, const std::
             TreeNode next = frontier.back();
             frontier.pop_back();
 
-            if (map_is_tree_cell_valid(map, next.cell, avoid_values)) {
+            if (map_is_tree_cell_valid(map, next.cell, params.avoid_field)) {
                 map_create_decoration_at_cell(map, lcg_seed, next.cell);
             }
 
@@ -1186,10 +1424,10 @@ void map_create_decoration_at_cell(Map& map, int* lcg_seed, ivec2 cell) {
     SpriteName decoration_sprite = map_get_decoration_sprite(map.type);
     const SpriteInfo& decoration_sprite_info = render_get_sprite_info(decoration_sprite);
 
-    map.cells[CELL_LAYER_GROUND][cell.x + (cell.y * map.width)] = (Cell) {
+    map_set_cell(map, CELL_LAYER_GROUND, cell, (Cell) {
         .type = CELL_DECORATION,
         .decoration_hframe = (uint16_t)(lcg_rand(lcg_seed) % decoration_sprite_info.hframes)
-    };
+    });
 }
 
 bool map_is_cell_blocked(Cell cell) {
@@ -1211,82 +1449,434 @@ bool map_is_cell_rect_blocked(const Map& map, ivec2 cell, int cell_size) {
     return false;
 }
 
-void map_calculate_unreachable_cells(Map& map) {
-    // Determine map "islands"
-    std::vector<int> map_tile_islands = std::vector<int>(map.width * map.height, MAP_ISLAND_UNASSIGNED);
-    std::vector<int> island_size;
+static const uint16_t MAP_ISLAND_NONE = UINT16_MAX;
+static const uint16_t MAP_ISLAND_PENDING = UINT16_MAX - 1;
+static const int MAP_ISLAND_SEARCH_NONE = -1;
+
+struct MapIslandScratch {
+    std::vector<int> queue;
+    // Used by the split searches, indexed by cell
+    std::vector<int> cell_search;
+    std::vector<int> search_parent;
+    std::vector<uint32_t> search_heads;
+    std::vector<std::vector<int>> search_cells;
+    std::vector<uint16_t> verify_islands;
+    std::vector<uint16_t> verify_island_sizes;
+};
 
-    for (int index = 0; index < map.width * map.height; index++) {
-        if (map.cells[CELL_LAYER_GROUND][index].type == CELL_UNREACHABLE) {
-            map.cells[CELL_LAYER_GROUND][index].type = CELL_EMPTY;
-        }
-    }
+static thread_local MapIslandScratch island_scratch;
 
-    while (true) {
-        // Set index equal to the index of the first unassigned tile in the array
-        int index;
-        for (index = 0; index < map.width * map.height; index++) {
-            if (map_is_cell_blocked(map.cells[CELL_LAYER_GROUND][index])) {
-                continue;
-            }
+// Floods every unblocked ground cell into islands, islands are numbered in order of their first cell
+static void map_flood_islands(const Map& map, uint16_t* islands, uint16_t* island_sizes, uint32_t* island_count) {
+    std::vector<int>& queue = island_scratch.queue;
+    const int cell_count = map.width * map.height;
+    for (int index = 0; index < cell_count; index++) {
+        islands[index] = MAP_ISLAND_NONE;
+    }
+    *island_count = 0;
 
-            if (map_tile_islands[index] == MAP_ISLAND_UNASSIGNED) {
-                break;
-            }
-        }
-        if (index == map.width * map.height) {
-            break; // island mapping is complete
+    for (int index = 0; index < cell_count; index++) {
+        if (islands[index] != MAP_ISLAND_NONE || map_is_cell_blocked(map.cells[CELL_LAYER_GROUND][index])) {
+            continue;
         }
 
-        // Determine the next island index
-        int island_index = island_size.size();
-        island_size.push_back(0);
-
-        // Flood fill this island index so that every tile that is reachable from 
-        // the start tile (the tile determined by index) has the same island index
-        std::vector<ivec2> frontier;
-        frontier.push_back(ivec2(index % map.width, index / map.width));
+        uint16_t island = (uint16_t)*island_count;
+        (*island_count)++;
+        island_sizes[island] = 0;
 
-        while (!frontier.empty()) {
-            ivec2 next = frontier[0];
-            frontier.erase(frontier.begin());
+        queue.clear();
+        queue.push_back(index);
+        islands[index] = island;
+        for (uint32_t queue_index = 0; queue_index < queue.size(); queue_index++) {
+            ivec2 cell = ivec2(queue[queue_index] % map.width, queue[queue_index] / map.width);
+            island_sizes[island]++;
 
-            if (!map_is_cell_in_bounds(map, next)) {
-                continue;
+            for (int direction = 0; direction < DIRECTION_COUNT; direction += 2) {
+                ivec2 child = cell + DIRECTION_IVEC2[direction];
+                if (!map_is_cell_in_bounds(map, child)) {
+                    continue;
+                }
+                int child_index = child.x + (child.y * map.width);
+                if (islands[child_index] != MAP_ISLAND_NONE || map_is_cell_blocked(map.cells[CELL_LAYER_GROUND][child_index])) {
+                    continue;
+                }
+                islands[child_index] = island;
+                queue.push_back(child_index);
             }
-            Cell cell_value = map.cells[CELL_LAYER_GROUND][next.x + (next.y * map.width)];
-            if (map_is_cell_blocked(cell_value)) {
-                continue;
+        }
+    }
+}
+
+// The main island is the biggest one. Ties go to the island with the earliest cell, the same as a fresh flood would number them
+static uint16_t map_get_main_island(const Map& map, const uint16_t* islands, const uint16_t* island_sizes, uint32_t island_count) {
+    uint16_t main_island = MAP_ISLAND_NONE;
+    uint16_t main_island_size = 0;
+    bool is_tied = false;
+    for (uint32_t island = 0; island < island_count; island++) {
+        if (island_sizes[island] > main_island_size) {
+            main_island = (uint16_t)island;
+            main_island_size = island_sizes[island];
+            is_tied = false;
+        } else if (island_sizes[island] != 0 && island_sizes[island] == main_island_size) {
+            is_tied = true;
+        }
+    }
+
+    if (is_tied) {
+        for (int index = 0; index < map.width * map.height; index++) {
+            if (islands[index] != MAP_ISLAND_NONE && island_sizes[islands[index]] == main_island_size) {
+                return islands[index];
             }
+        }
+    }
+
+    return main_island;
+}
+
+static uint16_t map_island_create(Map& map) {
+    // Islands that were merged away or fully built over have a size of 0 and can be re-used
+    for (uint32_t island = 0; island < map.island_count; island++) {
+        if (map.island_sizes[island] == 0) {
+            return (uint16_t)island;
+        }
+    }
+
+    GOLD_ASSERT(map.island_count < MAP_ISLAND_PENDING);
+    uint16_t island = (uint16_t)map.island_count;
+    map.island_count++;
+    map.island_sizes[island] = 0;
+    return island;
+}
 
-            // skip this because we've already explored it
-            if (map_tile_islands[next.x + (next.y * map.width)] != MAP_ISLAND_UNASSIGNED) {
+// Flood fills from a cell, moving every cell of its island onto another island
+static void map_island_relabel(Map& map, int start_index, uint16_t to_island) {
+    std::vector<int>& queue = island_scratch.queue;
+    const uint16_t from_island = map.islands[start_index];
+    GOLD_ASSERT(from_island != to_island);
+
+    queue.clear();
+    queue.push_back(start_index);
+    map.islands[start_index] = to_island;
+    for (uint32_t queue_index = 0; queue_index < queue.size(); queue_index++) {
+        ivec2 cell = ivec2(queue[queue_index] % map.width, queue[queue_index] / map.width);
+        for (int direction = 0; direction < DIRECTION_COUNT; direction += 2) {
+            ivec2 child = cell + DIRECTION_IVEC2[direction];
+            if (!map_is_cell_in_bounds(map, child) || map.islands[child.x + (child.y * map.width)] != from_island) {
                 continue;
             }
+            map.islands[child.x + (child.y * map.width)] = to_island;
+            queue.push_back(child.x + (child.y * map.width));
+        }
+    }
+
+    map.island_sizes[to_island] += map.island_sizes[from_island];
+    map.island_sizes[from_island] = 0;
+}
+
+static int map_island_search_find(std::vector<int>& search_parent, int search) {
+    while (search_parent[search] != search) {
+        search_parent[search] = search_parent[search_parent[search]];
+        search = search_parent[search];
+    }
+    return search;
+}
+
+// Blocking cells may have cut an island into pieces. Every piece touches a blocked cell,
+// so a breadth-first search is run from each unblocked neighbor, all in lockstep. Searches that meet are the same piece.
+// Once all but one piece has run out of cells, the remaining piece keeps the island and every finished piece gets a new one.
+// This way the cost is bounded by the size of the pieces that were cut off rather than by the size of the island.
+static void map_island_split(Map& map, uint16_t island, const std::vector<int>& seeds) {
+    MapIslandScratch& scratch = island_scratch;
+    if (seeds.size() < 2) {
+        return;
+    }
+
+    const int search_count = (int)seeds.size();
+    scratch.search_parent.resize(search_count);
+    scratch.search_heads.resize(search_count);
+    if ((int)scratch.search_cells.size() < search_count) {
+        scratch.search_cells.resize(search_count);
+    }
+    for (int search = 0; search < search_count; search++) {
+        scratch.search_parent[search] = search;
+        scratch.search_heads[search] = 0;
+        scratch.search_cells[search].clear();
+
+        int seed = seeds[search];
+        if (scratch.cell_search[seed] != MAP_ISLAND_SEARCH_NONE) {
+            scratch.search_parent[search] = map_island_search_find(scratch.search_parent, scratch.cell_search[seed]);
+            continue;
+        }
+        scratch.cell_search[seed] = search;
+        scratch.search_cells[search].push_back(seed);
+    }
+
+    while (true) {
+        // Count the pieces and the pieces that still have cells to search
+        std::vector<int>& piece_is_active = scratch.queue;
+        piece_is_active.assign(search_count, 0);
+        for (int search = 0; search < search_count; search++) {
+            if (scratch.search_heads[search] < scratch.search_cells[search].size()) {
+                piece_is_active[map_island_search_find(scratch.search_parent, search)] = 1;
+            }
+        }
+        int piece_count = 0;
+        int active_piece_count = 0;
+        for (int search = 0; search < search_count; search++) {
+            if (scratch.search_parent[search] == search) {
+                piece_count++;
+                active_piece_count += piece_is_active[search];
+            }
+        }
+        if (piece_count == 1 || active_piece_count <= 1) {
+            break;
+        }
 
-            map_tile_islands[next.x + (next.y * map.width)] = island_index;
-            island_size[island_index]++;
+        for (int search = 0; search < search_count; search++) {
+            std::vector<int>& search_cells = scratch.search_cells[search];
+            if (scratch.search_heads[search] == search_cells.size()) {
+                continue;
+            }
 
+            int cell_index = search_cells[scratch.search_heads[search]];
+            scratch.search_heads[search]++;
+            ivec2 cell = ivec2(cell_index % map.width, cell_index / map.width);
             for (int direction = 0; direction < DIRECTION_COUNT; direction += 2) {
-                frontier.push_back(next + DIRECTION_IVEC2[direction]);
+                ivec2 child = cell + DIRECTION_IVEC2[direction];
+                if (!map_is_cell_in_bounds(map, child)) {
+                    continue;
+                }
+                int child_index = child.x + (child.y * map.width);
+                if (map.islands[child_index] != island) {
+                    continue;
+                }
+
+                int child_search = scratch.cell_search[child_index];
+                if (child_search == MAP_ISLAND_SEARCH_NONE) {
+                    scratch.cell_search[child_index] = search;
+                    search_cells.push_back(child_index);
+                    continue;
+                }
+
+                int root = map_island_search_find(scratch.search_parent, search);
+                int child_root = map_island_search_find(scratch.search_parent, child_search);
+                if (root != child_root) {
+                    scratch.search_parent[std::max(root, child_root)] = std::min(root, child_root);
+                }
+            }
+        }
+    }
+
+    // Gather the size of each piece and whether it was searched to completion
+    std::vector<int>& piece_sizes = scratch.queue;
+    piece_sizes.assign(search_count, 0);
+    int kept_piece = MAP_ISLAND_SEARCH_NONE;
+    for (int search = 0; search < search_count; search++) {
+        int root = map_island_search_find(scratch.search_parent, search);
+        piece_sizes[root] += (int)scratch.search_cells[search].size();
+        if (scratch.search_heads[search] < scratch.search_cells[search].size()) {
+            kept_piece = root;
+        }
+    }
+    // If every piece was searched to completion, the biggest one keeps the island
+    if (kept_piece == MAP_ISLAND_SEARCH_NONE) {
+        for (int search = 0; search < search_count; search++) {
+            if (scratch.search_parent[search] == search && (kept_piece == MAP_ISLAND_SEARCH_NONE || piece_sizes[search] > piece_sizes[kept_piece])) {
+                kept_piece = search;
             }
         }
     }
 
-    int main_island = 0;
-    for (int island_index = 1; island_index < (int)island_size.size(); island_index++) {
-        if (island_size[island_index] > island_size[main_island]) {
-            main_island = island_index;
+    // Move each cut off piece onto a new island
+    for (int piece = 0; piece < search_count; piece++) {
+        if (scratch.search_parent[piece] != piece || piece == kept_piece) {
+            continue;
         }
+
+        uint16_t new_island = map_island_create(map);
+        for (int search = 0; search < search_count; search++) {
+            if (map_island_search_find(scratch.search_parent, search) != piece) {
+                continue;
+            }
+            for (int cell_index : scratch.search_cells[search]) {
+                map.islands[cell_index] = new_island;
+            }
+        }
+        map.island_sizes[new_island] = (uint16_t)piece_sizes[piece];
+        map.island_sizes[island] -= (uint16_t)piece_sizes[piece];
     }
 
+    for (int search = 0; search < search_count; search++) {
+        for (int cell_index : scratch.search_cells[search]) {
+            scratch.cell_search[cell_index] = MAP_ISLAND_SEARCH_NONE;
+        }
+    }
+}
+
+static void map_apply_unreachable_cells(Map& map) {
+    uint16_t main_island = map_get_main_island(map, map.islands, map.island_sizes, map.island_count);
+
     // Everything that's not on the main "island" is considered blocked
     // This makes it so that we don't place any player spawns or gold at these locations
     for (int index = 0; index < map.width * map.height; index++) {
-        if (map.cells[CELL_LAYER_GROUND][index].type == CELL_EMPTY && map_tile_islands[index] != main_island) {
-            map.cells[CELL_LAYER_GROUND][index].type = CELL_UNREACHABLE;
+        Cell& cell = map.cells[CELL_LAYER_GROUND][index];
+        if (cell.type == CELL_EMPTY || cell.type == CELL_UNREACHABLE) {
+            cell.type = map.islands[index] == main_island ? CELL_EMPTY : CELL_UNREACHABLE;
         }
     }
+
+    map.island_dirty_cell_count = 0;
+
+    // The unreachable cells are re-written in place, so conservatively treat them as changed
+    map.blocked_cell_version++;
+}
+
+void map_calculate_unreachable_cells(Map& map) {
+    ZoneScoped;
+
+    map_flood_islands(map, map.islands, map.island_sizes, &map.island_count);
+    map_apply_unreachable_cells(map);
+}
+
+void map_update_unreachable_cells(Map& map) {
+    ZoneScoped;
+
+    if (map.island_count == 0 || map.island_dirty_cell_count > MAP_ISLAND_DIRTY_CELLS_MAX) {
+        map_calculate_unreachable_cells(map);
+        return;
+    }
+
+    MapIslandScratch& scratch = island_scratch;
+    if ((int)scratch.cell_search.size() < map.width * map.height) {
+        scratch.cell_search.resize(map.width * map.height, MAP_ISLAND_SEARCH_NONE);
+    }
+
+    // Take newly blocked cells off of their islands
+    // A cell may have flipped more than once, so compare against its island rather than trusting the queue
+    FixedVector<uint16_t, MAP_ISLAND_DIRTY_CELLS_MAX> cut_islands;
+    std::vector<int> cut_seeds[MAP_ISLAND_DIRTY_CELLS_MAX];
+    for (uint32_t dirty_index = 0; dirty_index < map.island_dirty_cell_count; dirty_index++) {
+        int cell_index = map.island_dirty_cells[dirty_index];
+        uint16_t island = map.islands[cell_index];
+        if (island == MAP_ISLAND_NONE || !map_is_cell_blocked(map.cells[CELL_LAYER_GROUND][cell_index])) {
+            continue;
+        }
+
+        map.islands[cell_index] = MAP_ISLAND_NONE;
+        map.island_sizes[island]--;
+
+        uint32_t cut_index;
+        for (cut_index = 0; cut_index < cut_islands.size(); cut_index++) {
+            if (cut_islands[cut_index] == island) {
+                break;
+            }
+        }
+        if (cut_index == cut_islands.size()) {
+            cut_islands.push_back(island);
+            cut_seeds[cut_index].clear();
+        }
+    }
+
+    // Then check whether the cut islands were split. The seeds are gathered before any splitting so that they all still have their old island
+    for (uint32_t dirty_index = 0; dirty_index < map.island_dirty_cell_count; dirty_index++) {
+        int cell_index = map.island_dirty_cells[dirty_index];
+        ivec2 cell = ivec2(cell_index % map.width, cell_index / map.width);
+        for (int direction = 0; direction < DIRECTION_COUNT; direction += 2) {
+            ivec2 child = cell + DIRECTION_IVEC2[direction];
+            if (!map_is_cell_in_bounds(map, child)) {
+                continue;
+            }
+            int child_index = child.x + (child.y * map.width);
+            for (uint32_t cut_index = 0; cut_index < cut_islands.size(); cut_index++) {
+                if (map.islands[child_index] == cut_islands[cut_index] &&
+                        std::find(cut_seeds[cut_index].begin(), cut_seeds[cut_index].end(), child_index) == cut_seeds[cut_index].end()) {
+                    cut_seeds[cut_index].push_back(child_index);
+                }
+            }
+        }
+    }
+    for (uint32_t cut_index = 0; cut_index < cut_islands.size(); cut_index++) {
+        map_island_split(map, cut_islands[cut_index], cut_seeds[cut_index]);
+    }
+
+    // Put newly unblocked cells onto an island, joining together any islands that they touch
+    std::vector<int>& queue = scratch.queue;
+    for (uint32_t dirty_index = 0; dirty_index < map.island_dirty_cell_count; dirty_index++) {
+        int start_index = map.island_dirty_cells[dirty_index];
+        if (map.islands[start_index] != MAP_ISLAND_NONE || map_is_cell_blocked(map.cells[CELL_LAYER_GROUND][start_index])) {
+            continue;
+        }
+
+        // Flood the group of newly unblocked cells, noting a cell from each island that it touches
+        FixedVector<int, MAP_ISLAND_DIRTY_CELLS_MAX * 4> touched_cells;
+        queue.clear();
+        queue.push_back(start_index);
+        map.islands[start_index] = MAP_ISLAND_PENDING;
+        for (uint32_t queue_index = 0; queue_index < queue.size(); queue_index++) {
+            ivec2 cell = ivec2(queue[queue_index] % map.width, queue[queue_index] / map.width);
+            for (int direction = 0; direction < DIRECTION_COUNT; direction += 2) {
+                ivec2 child = cell + DIRECTION_IVEC2[direction];
+                if (!map_is_cell_in_bounds(map, child)) {
+                    continue;
+                }
+                int child_index = child.x + (child.y * map.width);
+                uint16_t child_island = map.islands[child_index];
+                if (child_island == MAP_ISLAND_PENDING) {
+                    continue;
+                }
+                if (child_island == MAP_ISLAND_NONE) {
+                    if (!map_is_cell_blocked(map.cells[CELL_LAYER_GROUND][child_index])) {
+                        map.islands[child_index] = MAP_ISLAND_PENDING;
+                        queue.push_back(child_index);
+                    }
+                    continue;
+                }
+                touched_cells.push_back(child_index);
+            }
+        }
+        std::vector<int> group = queue;
+
+        // Join everything onto the biggest touched island
+        uint16_t island = MAP_ISLAND_NONE;
+        for (uint32_t touched_cell_index = 0; touched_cell_index < touched_cells.size(); touched_cell_index++) {
+            uint16_t touched_island = map.islands[touched_cells[touched_cell_index]];
+            if (island == MAP_ISLAND_NONE || map.island_sizes[touched_island] > map.island_sizes[island] ||
+                    (map.island_sizes[touched_island] == map.island_sizes[island] && touched_island < island)) {
+                island = touched_island;
+            }
+        }
+        if (island == MAP_ISLAND_NONE) {
+            island = map_island_create(map);
+        }
+        for (uint32_t touched_cell_index = 0; touched_cell_index < touched_cells.size(); touched_cell_index++) {
+            if (map.islands[touched_cells[touched_cell_index]] != island) {
+                map_island_relabel(map, touched_cells[touched_cell_index], island);
+            }
+        }
+
+        for (int cell_index : group) {
+            map.islands[cell_index] = island;
+        }
+        map.island_sizes[island] += (uint16_t)group.size();
+    }
+
+    #ifdef GOLD_DEBUG
+        // Check that the update matches a fresh flood
+        {
+            scratch.verify_islands.resize(MAP_SIZE_MAX * MAP_SIZE_MAX);
+            scratch.verify_island_sizes.resize(MAP_SIZE_MAX * MAP_SIZE_MAX);
+            uint32_t verify_island_count;
+            map_flood_islands(map, scratch.verify_islands.data(), scratch.verify_island_sizes.data(), &verify_island_count);
+            uint16_t verify_main_island = map_get_main_island(map, scratch.verify_islands.data(), scratch.verify_island_sizes.data(), verify_island_count);
+            uint16_t main_island = map_get_main_island(map, map.islands, map.island_sizes, map.island_count);
+            for (int index = 0; index < map.width * map.height; index++) {
+                GOLD_ASSERT((scratch.verify_islands[index] == MAP_ISLAND_NONE) == (map.islands[index] == MAP_ISLAND_NONE));
+                GOLD_ASSERT((scratch.verify_islands[index] == verify_main_island) == (map.islands[index] == main_island));
+            }
+        }
+    #endif
+
+    map_apply_unreachable_cells(map);
 }
 
 SpriteName map_wall_autotile_lookup(uint32_t neighbors) {
@@ -1380,7 +1970,73 @@ uint8_t map_neighbors_to_autotile_index(uint32_t p_neighbors) {
     return autotile_index[p_neighbors];
 }
 
-bool map_is_poisson_point_valid(const Map& map, const PoissonDiskParams& params, ivec2 point) {
+static void map_poisson_avoid_field_init(const Map& map, PoissonAvoidField& field) {
+    field.width = map.width;
+    field.height = map.height;
+    field.clearance = std::vector<int>(map.width * map.height, INT_MAX / 2);
+}
+
+static void map_poisson_avoid_field_add(PoissonAvoidField& field, ivec2 cell, int distance) {
+    GOLD_ASSERT(cell.x >= 0 && cell.y >= 0 && cell.x < field.width && cell.y < field.height);
+    int& clearance = field.clearance[cell.x + (cell.y * field.width)];
+    clearance = std::min(clearance, -distance);
+}
+
+// Spreads the avoid values out to every cell. Manhattan paths can always be walked as a run along one axis
+// followed by a run along the other, so a forward and a backward pass over the grid give exact distances.
+static void map_poisson_avoid_field_bake(PoissonAvoidField& field) {
+    for (int y = 0; y < field.height; y++) {
+        for (int x = 0; x < field.width; x++) {
+            int& clearance = field.clearance[x + (y * field.width)];
+            if (x > 0) {
+                clearance = std::min(clearance, field.clearance[(x - 1) + (y * field.width)] + 1);
+            }
+            if (y > 0) {
+                clearance = std::min(clearance, field.clearance[x + ((y - 1) * field.width)] + 1);
+            }
+        }
+    }
+    for (int y = field.height - 1; y >= 0; y--) {
+        for (int x = field.width - 1; x >= 0; x--) {
+            int& clearance = field.clearance[x + (y * field.width)];
+            if (x < field.width - 1) {
+                clearance = std::min(clearance, field.clearance[(x + 1) + (y * field.width)] + 1);
+            }
+            if (y < field.height - 1) {
+                clearance = std::min(clearance, field.clearance[x + ((y + 1) * field.width)] + 1);
+            }
+        }
+    }
+}
+
+static void map_poisson_sample_grid_init(const Map& map, int disk_radius, PoissonSampleGrid& grid) {
+    grid.bucket_size = std::max(disk_radius, 1);
+    grid.width = (map.width + grid.bucket_size - 1) / grid.bucket_size;
+    grid.height = (map.height + grid.bucket_size - 1) / grid.bucket_size;
+    grid.buckets = std::vector<std::vector<ivec2>>(grid.width * grid.height);
+}
+
+static void map_poisson_sample_grid_add(PoissonSampleGrid& grid, ivec2 point) {
+    grid.buckets[(point.x / grid.bucket_size) + ((point.y / grid.bucket_size) * grid.width)].push_back(point);
+}
+
+static bool map_poisson_sample_grid_has_point_within(const PoissonSampleGrid& grid, ivec2 point, int distance) {
+    GOLD_ASSERT(distance <= grid.bucket_size);
+    ivec2 bucket = ivec2(point.x / grid.bucket_size, point.y / grid.bucket_size);
+    for (int bucket_y = std::max(bucket.y - 1, 0); bucket_y <= std::min(bucket.y + 1, grid.height - 1); bucket_y++) {
+        for (int bucket_x = std::max(bucket.x - 1, 0); bucket_x <= std::min(bucket.x + 1, grid.width - 1); bucket_x++) {
+            for (ivec2 sample_point : grid.buckets[bucket_x + (bucket_y * grid.width)]) {
+                if (ivec2::manhattan_distance(point, sample_point) <= distance) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+bool map_is_poisson_point_valid(const Map& map, const PoissonDiskParams& params, const PoissonSampleGrid& sample_grid, ivec2 point) {
     // Don't allow trees on the very top cell
     if ((map.type == MAP_TYPE_KLONDIKE || map.type == MAP_TYPE_BOULDER) && point.y < 1) {
         return false;
@@ -1399,18 +2055,23 @@ bool map_is_poisson_point_valid(const Map& map, const PoissonDiskParams& params,
         return false;
     }
 
-    for (const PoissonAvoidValue& avoid_value : params.avoid_values) {
-        if (ivec2::manhattan_distance(point, avoid_value.cell) <= avoid_value.distance) {
-            return false;
-        }
+    if (params.avoid_field.clearance[point.x + (point.y * map.width)] <= 0) {
+        return false;
+    }
+    if (map_poisson_sample_grid_has_point_within(sample_grid, point, params.disk_radius)) {
+        return false;
     }
 
     return true;
 }
 
-std::vector<ivec2> map_poisson_disk(const Map& map, int* lcg_seed, PoissonDiskParams& params) {
+std::vector<ivec2> map_poisson_disk(const Map& map, int* lcg_seed, const PoissonDiskParams& params) {
+    ZoneScoped;
+
     std::vector<ivec2> sample;
     std::vector<ivec2> frontier;
+    PoissonSampleGrid sample_grid;
+    map_poisson_sample_grid_init(map, params.disk_radius, sample_grid);
 
     ivec2 first;
     uint32_t attempts = 0;
@@ -1419,18 +2080,15 @@ std::vector<ivec2> map_poisson_disk(const Map& map, int* lcg_seed, PoissonDiskPa
         first.x = 1 + (lcg_rand(lcg_seed) % (map.width - 2));
         first.y = 1 + (lcg_rand(lcg_seed) % (map.height - 2));
         attempts++;
-    } while (!map_is_poisson_point_valid(map, params, first) && attempts < MAX_ATTEMPTS);
-    if (!map_is_poisson_point_valid(map, params, first)) {
+    } while (!map_is_poisson_point_valid(map, params, sample_grid, first) && attempts < MAX_ATTEMPTS);
+    if (!map_is_poisson_point_valid(map, params, sample_grid, first)) {
         log_warn("map_poisson_disk reached max attempts.");
         return sample;
     }
 
     frontier.push_back(first);
     sample.push_back(first);
-    params.avoid_values.push_back((PoissonAvoidValue) {
-        .cell = first,
-        .distance = params.disk_radius
-    });
+    map_poisson_sample_grid_add(sample_grid, first);
 
     std::vector<ivec2> circle_offset_points;
     {
@@ -1474,15 +2132,12 @@ std::vector<ivec2> map_poisson_disk(const Map& map, int* lcg_seed, PoissonDiskPa
         while (!child_is_valid && child_attempts < 30) {
             child_attempts++;
             child = next + circle_offset_points[lcg_rand(lcg_seed) % circle_offset_points.size()];
-            child_is_valid = map_is_poisson_point_valid(map, params, child);
+            child_is_valid = map_is_poisson_point_valid(map, params, sample_grid, child);
         }
         if (child_is_valid) {
             frontier.push_back(child);
             sample.push_back(child);
-            params.avoid_values.push_back((PoissonAvoidValue) {
-                .cell = child,
-                .distance = params.disk_radius
-            });
+            map_poisson_sample_grid_add(sample_grid, child);
         } else {
             frontier.erase(frontier.begin() + next_index);
         }
@@ -1491,7 +2146,7 @@ std::vector<ivec2> map_poisson_disk(const Map& map, int* lcg_seed, PoissonDiskPa
     return sample;
 }
 
-bool map_is_tree_cell_valid(const Map& map, ivec2 cell, const std::vector<PoissonAvoidValue>& avoid_values) {
+bool map_is_tree_cell_valid(const Map& map, ivec2 cell, const PoissonAvoidField& avoid_field) {
     if (!map_is_cell_in_bounds(map, cell)) {
         return false;
     }
@@ -1522,10 +2177,9 @@ bool map_is_tree_cell_valid(const Map& map, ivec2 cell, const std::vector<Poisso
         }
     }
 
-    for (const PoissonAvoidValue& avoid_value : avoid_values) {
-        if (ivec2::manhattan_distance(cell, avoid_value.cell) < avoid_value.distance) {
-            return false;
-        }
+    // Trees are allowed right on the edge of an avoid value's distance
+    if (avoid_field.clearance[cell.x + (cell.y * map.width)] < 0) {
+        return false;
     }
 
     return true;
@@ -1585,14 +2239,36 @@ Cell map_get_cell(const Map& map, CellLayer layer, ivec2 cell) {
     return map.cells[layer][cell.x + (cell.y * map.width)];
 }
 
+static bool map_is_cell_flow_field_blocked(Cell cell) {
+    return map_is_cell_blocked(cell) || cell.type == CELL_UNREACHABLE;
+}
+
+// All cell writes during a match go through here so that flow fields and islands know which cells changed
+static void map_set_cell_at_index(Map& map, CellLayer layer, int index, Cell value) {
+    Cell& map_cell = map.cells[layer][index];
+    if (map_is_cell_flow_field_blocked(map_cell) != map_is_cell_flow_field_blocked(value)) {
+        map.blocked_cell_version++;
+    }
+    if (layer == CELL_LAYER_GROUND && map_is_cell_blocked(map_cell) != map_is_cell_blocked(value)) {
+        if (map.island_dirty_cell_count < MAP_ISLAND_DIRTY_CELLS_MAX) {
+            map.island_dirty_cells[map.island_dirty_cell_count] = (uint16_t)index;
+        }
+        // Keeps counting past the max so that the next update knows to re-flood everything
+        if (map.island_dirty_cell_count <= MAP_ISLAND_DIRTY_CELLS_MAX) {
+            map.island_dirty_cell_count++;
+        }
+    }
+    map_cell = value;
+}
+
 void map_set_cell(Map& map, CellLayer layer, ivec2 cell, Cell value) {
-    map.cells[layer][cell.x + (cell.y * map.width)] = value;
+    map_set_cell_at_index(map, layer, cell.x + (cell.y * map.width), value);
 }
 
 void map_set_cell_rect(Map& map, CellLayer layer, ivec2 cell, int size, Cell value) {
     for (int y = cell.y; y < cell.y + size; y++) {
         for (int x = cell.x; x < cell.x + size; x++) {
-            map.cells[layer][x + (y * map.width)] = value;
+            map_set_cell_at_index(map, layer, x + (y * map.width), value);
         }
     }
 }
@@ -1862,6 +2538,185 @@ bool map_are_regions_connected(const Map& map, uint8_t region_a, uint8_t region_
     return map.region_connection_indices[region_a][region_b] != MAP_REGIONS_NOT_CONNECTED;
 }
 
+// Pathfinding scratch
+
+static const int EXPLORED_INDEX_NOT_EXPLORED = -1;
+static const int EXPLORED_INDEX_IGNORE_CELL = -2;
+
+/**
+ * Working memory for map_pathfind() and map_pathfind_correct_target().
+ *
+ * The arena is allocated once per thread and re-used by every search afterwards.
+ * It is per-thread rather than stored on the Map because the replay loading thread simulates
+ * a second MatchState alongside the main thread, and because the Map is part of the checksummed state.
+ *
+ * Per-cell lookups are stamped with a generation so that the arena does not need to be cleared between searches.
+ */
+struct MapPathfindScratch {
+    uint32_t generation = 0;
+    std::vector<uint32_t> cell_generation;
+    std::vector<int> explored_indices;
+
+    // The frontier keeps the same unordered layout as the linear scan that it replaces
+    // (swap-remove on pop, replace in place, append on push). The heap orders frontier positions
+    // by (score, position), which means that ties are broken exactly the same way as the linear scan,
+    // so the resulting paths are identical.
+    std::vector<MapPathNode> frontier;
+    std::vector<int> frontier_scores;
+    std::vector<uint32_t> frontier_heap;
+    std::vector<uint32_t> frontier_heap_indices;
+    // Not generation-stamped. A lookup is valid only if it points to a frontier node with the same cell.
+    std::vector<uint32_t> frontier_positions;
+
+    std::vector<MapPathNode> explored;
+};
+static thread_local MapPathfindScratch pathfind_scratch;
+
+static void map_pathfind_scratch_begin(MapPathfindScratch& scratch) {
+    if (scratch.cell_generation.empty()) {
+        scratch.cell_generation.resize(MAP_SIZE_MAX * MAP_SIZE_MAX, 0);
+        scratch.explored_indices.resize(MAP_SIZE_MAX * MAP_SIZE_MAX, EXPLORED_INDEX_NOT_EXPLORED);
+        scratch.frontier_positions.resize(MAP_SIZE_MAX * MAP_SIZE_MAX, 0);
+        scratch.frontier.reserve(MAP_SIZE_MAX * MAP_SIZE_MAX);
+        scratch.frontier_scores.reserve(MAP_SIZE_MAX * MAP_SIZE_MAX);
+        scratch.frontier_heap.reserve(MAP_SIZE_MAX * MAP_SIZE_MAX);
+        scratch.frontier_heap_indices.reserve(MAP_SIZE_MAX * MAP_SIZE_MAX);
+        scratch.explored.reserve(PATHFIND_ITERATION_MAX + 1);
+    }
+
+    scratch.generation++;
+    if (scratch.generation == 0) {
+        std::fill(scratch.cell_generation.begin(), scratch.cell_generation.end(), 0);
+        scratch.generation = 1;
+    }
+
+    scratch.frontier.clear();
+    scratch.frontier_scores.clear();
+    scratch.frontier_heap.clear();
+    scratch.frontier_heap_indices.clear();
+    scratch.explored.clear();
+}
+
+static int map_pathfind_scratch_get_explored_index(const MapPathfindScratch& scratch, int cell_index) {
+    return scratch.cell_generation[cell_index] == scratch.generation
+        ? scratch.explored_indices[cell_index]
+        : EXPLORED_INDEX_NOT_EXPLORED;
+}
+
+static void map_pathfind_scratch_set_explored_index(MapPathfindScratch& scratch, int cell_index, int value) {
+    scratch.cell_generation[cell_index] = scratch.generation;
+    scratch.explored_indices[cell_index] = value;
+}
+
+static bool map_pathfind_frontier_is_less(const MapPathfindScratch& scratch, uint32_t position_a, uint32_t position_b) {
+    if (scratch.frontier_scores[position_a] != scratch.frontier_scores[position_b]) {
+        return scratch.frontier_scores[position_a] < scratch.frontier_scores[position_b];
+    }
+    return position_a < position_b;
+}
+
+static void map_pathfind_frontier_heap_swap(MapPathfindScratch& scratch, uint32_t heap_index_a, uint32_t heap_index_b) {
+    std::swap(scratch.frontier_heap[heap_index_a], scratch.frontier_heap[heap_index_b]);
+    scratch.frontier_heap_indices[scratch.frontier_heap[heap_index_a]] = heap_index_a;
+    scratch.frontier_heap_indices[scratch.frontier_heap[heap_index_b]] = heap_index_b;
+}
+
+static void map_pathfind_frontier_sift_up(MapPathfindScratch& scratch, uint32_t heap_index) {
+    while (heap_index > 0) {
+        uint32_t parent_index = (heap_index - 1) / 2;
+        if (!map_pathfind_frontier_is_less(scratch, scratch.frontier_heap[heap_index], scratch.frontier_heap[parent_index])) {
+            return;
+        }
+        map_pathfind_frontier_heap_swap(scratch, heap_index, parent_index);
+        heap_index = parent_index;
+    }
+}
+
+static void map_pathfind_frontier_sift_down(MapPathfindScratch& scratch, uint32_t heap_index) {
+    const uint32_t heap_size = (uint32_t)scratch.frontier_heap.size();
+    while (true) {
+        uint32_t smallest_index = heap_index;
+        uint32_t left_index = (heap_index * 2) + 1;
+        uint32_t right_index = left_index + 1;
+        if (left_index < heap_size && map_pathfind_frontier_is_less(scratch, scratch.frontier_heap[left_index], scratch.frontier_heap[smallest_index])) {
+            smallest_index = left_index;
+        }
+        if (right_index < heap_size && map_pathfind_frontier_is_less(scratch, scratch.frontier_heap[right_index], scratch.frontier_heap[smallest_index])) {
+            smallest_index = right_index;
+        }
+        if (smallest_index == heap_index) {
+            return;
+        }
+        map_pathfind_frontier_heap_swap(scratch, heap_index, smallest_index);
+        heap_index = smallest_index;
+    }
+}
+
+static void map_pathfind_frontier_clear(MapPathfindScratch& scratch) {
+    scratch.frontier.clear();
+    scratch.frontier_scores.clear();
+    scratch.frontier_heap.clear();
+    scratch.frontier_heap_indices.clear();
+}
+
+static void map_pathfind_frontier_push(MapPathfindScratch& scratch, int map_width, const MapPathNode& node, int score) {
+    uint32_t position = (uint32_t)scratch.frontier.size();
+    scratch.frontier.push_back(node);
+    scratch.frontier_scores.push_back(score);
+    scratch.frontier_heap.push_back(position);
+    scratch.frontier_heap_indices.push_back((uint32_t)scratch.frontier_heap.size() - 1);
+    scratch.frontier_positions[node.cell.x + (node.cell.y * map_width)] = position;
+    map_pathfind_frontier_sift_up(scratch, scratch.frontier_heap_indices[position]);
+}
+
+// Returns the frontier position of the node with this cell, or INDEX_INVALID if the cell is not in the frontier
+static uint32_t map_pathfind_frontier_find(const MapPathfindScratch& scratch, int map_width, ivec2 cell) {
+    uint32_t position = scratch.frontier_positions[cell.x + (cell.y * map_width)];
+    if (position < scratch.frontier.size() && scratch.frontier[position].cell == cell) {
+        return position;
+    }
+    return INDEX_INVALID;
+}
+
+// The replacement must not have a larger score than the node it replaces
+static void map_pathfind_frontier_replace(MapPathfindScratch& scratch, uint32_t position, const MapPathNode& node, int score) {
+    GOLD_ASSERT(score <= scratch.frontier_scores[position]);
+    scratch.frontier[position] = node;
+    scratch.frontier_scores[position] = score;
+    map_pathfind_frontier_sift_up(scratch, scratch.frontier_heap_indices[position]);
+}
+
+static MapPathNode map_pathfind_frontier_pop(MapPathfindScratch& scratch, int map_width) {
+    // Remove the smallest position from the heap
+    uint32_t smallest_position = scratch.frontier_heap[0];
+    MapPathNode smallest = scratch.frontier[smallest_position];
+    map_pathfind_frontier_heap_swap(scratch, 0, (uint32_t)scratch.frontier_heap.size() - 1);
+    scratch.frontier_heap.pop_back();
+    if (!scratch.frontier_heap.empty()) {
+        map_pathfind_frontier_sift_down(scratch, 0);
+    }
+
+    // Swap-remove it from the frontier. The node that moves into its position
+    // now has a smaller position, so it can only move up in the heap.
+    uint32_t back_position = (uint32_t)scratch.frontier.size() - 1;
+    if (smallest_position != back_position) {
+        scratch.frontier[smallest_position] = scratch.frontier[back_position];
+        scratch.frontier_scores[smallest_position] = scratch.frontier_scores[back_position];
+        uint32_t heap_index = scratch.frontier_heap_indices[back_position];
+        scratch.frontier_heap[heap_index] = smallest_position;
+        scratch.frontier_heap_indices[smallest_position] = heap_index;
+
+        const ivec2 moved_cell = scratch.frontier[smallest_position].cell;
+        scratch.frontier_positions[moved_cell.x + (moved_cell.y * map_width)] = smallest_position;
+        map_pathfind_frontier_sift_up(scratch, heap_index);
+    }
+    scratch.frontier.pop_back();
+    scratch.frontier_scores.pop_back();
+    scratch.frontier_heap_indices.pop_back();
+
+    return smallest;
+}
+
 ivec2 map_pathfind_correct_target(const Map& map, CellLayer layer, ivec2 from, ivec2 to, uint32_t ignore, const MapPath* ignore_cells) {
     ZoneScoped;
 
@@ -1869,14 +2724,13 @@ ivec2 map_pathfind_correct_target(const Map& map, CellLayer layer, ivec2 from, i
         return to;
     }
 
-    std::vector<MapPathNode> frontier;
-    std::vector<MapPathNode> explored;
-    std::vector<int> explored_indices = std::vector<int>(map.width * map.height, -1);
+    MapPathfindScratch& scratch = pathfind_scratch;
+    map_pathfind_scratch_begin(scratch);
 
     if (ignore_cells != NULL) {
         for (uint32_t ignore_cell_index = 0; ignore_cell_index < ignore_cells->size(); ignore_cell_index++) {
             ivec2 cell = (*ignore_cells)[ignore_cell_index];
-            explored_indices[cell.x + (cell.y * map.width)] = 1;
+            map_pathfind_scratch_set_explored_index(scratch, cell.x + (cell.y * map.width), 1);
         }
     }
 
@@ -1887,26 +2741,15 @@ ivec2 map_pathfind_correct_target(const Map& map, CellLayer layer, ivec2 from, i
     }
 
     // Reverse pathfind to find the nearest reachable cell
-    frontier.push_back((MapPathNode) {
+    map_pathfind_frontier_push(scratch, map.width, (MapPathNode) {
         .parent = -1,
         .cell = to,
         .cost = 0
-    });
-
-    while (!frontier.empty()) {
-        // Find the smallest path
-        uint32_t smallest_index = 0;
-        for (uint32_t i = 1; i < frontier.size(); i++) {
-            if (ivec2::manhattan_distance(frontier[i].cell, from) < 
-                    ivec2::manhattan_distance(frontier[smallest_index].cell, from)) {
-                smallest_index = i;
-            }
-        }
+    }, ivec2::manhattan_distance(to, from));
 
+    while (!scratch.frontier.empty()) {
         // Pop the smallest path
-        MapPathNode smallest = frontier[smallest_index];
-        frontier[smallest_index] = frontier.back();
-        frontier.pop_back();
+        MapPathNode smallest = map_pathfind_frontier_pop(scratch, map.width);
 
         // If it's the solution, return it
         if (smallest.cell == from) {
@@ -1917,7 +2760,7 @@ ivec2 map_pathfind_correct_target(const Map& map, CellLayer layer, ivec2 from, i
         }
 
         // Otherwise mark this cell as explored
-        explored_indices[smallest.cell.x + (smallest.cell.y * map.width)] = 1;
+        map_pathfind_scratch_set_explored_index(scratch, smallest.cell.x + (smallest.cell.y * map.width), 1);
 
         // Consider all children
         for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
@@ -1933,29 +2776,23 @@ ivec2 map_pathfind_correct_target(const Map& map, CellLayer layer, ivec2 from, i
             }
 
             // Don't consider explored indices
-            if (explored_indices[child.cell.x + (child.cell.y * map.width)] != -1) {
+            if (map_pathfind_scratch_get_explored_index(scratch, child.cell.x + (child.cell.y * map.width)) != EXPLORED_INDEX_NOT_EXPLORED) {
                 continue;
             }
 
             // Check if it's in the frontier
-            uint32_t frontier_index;
-            for (frontier_index = 0; frontier_index < frontier.size(); frontier_index++) {
-                MapPathNode& frontier_node = frontier[frontier_index];
-                if (frontier_node.cell == child.cell) {
-                    break;
-                }
-            }
+            int child_score = ivec2::manhattan_distance(child.cell, from);
+            uint32_t frontier_index = map_pathfind_frontier_find(scratch, map.width, child.cell);
             // If it's in the frontier...
-            if (frontier_index < frontier.size()) {
+            if (frontier_index != INDEX_INVALID) {
                 // ...and the child represents a shorter version of the frontier path, then replace the frontier version with the shorter child
-                if (ivec2::manhattan_distance(child.cell, from) <
-                        ivec2::manhattan_distance(frontier[frontier_index].cell, from)) {
-                    frontier[frontier_index] = child;
+                if (child_score < scratch.frontier_scores[frontier_index]) {
+                    map_pathfind_frontier_replace(scratch, frontier_index, child, child_score);
                 }
                 continue;
             }
             // If it's not in the frontier, then add it
-            frontier.push_back(child);
+            map_pathfind_frontier_push(scratch, map.width, child, child_score);
         } // End for each child / direction
     } // End while frontier not empty
 
@@ -1981,136 +2818,78 @@ ivec2 map_get_region_connection_cell_closest_to_cell(const Map& map, ivec2 cell,
     return nearest_connection_cell;
 }
 
-std::vector<int> map_get_region_path(const Map& map, ivec2 from, ivec2 to) {
-    ZoneScoped;
-
-    std::vector<int> path;
+// Regions are stored in reverse order, so the back of the path is the next region to walk into and the front is the region of the to cell
+using MapRegionPath = FixedVector<uint8_t, MAP_REGION_MAX>;
 
-    if (map_get_region(map, from) == map_get_region(map, to)) {
-        path.push_back(map_get_region(map, to));
-        return path;
-    }
-
-    std::vector<MapRegionPathNode> frontier;
-    std::vector<MapRegionPathNode> explored;
-    std::vector<bool> is_region_explored(map.region_count, false);
-    
-    frontier.push_back((MapRegionPathNode) {
-        .parent = -1,
-        .cell = from,
-        .connection_index = -1,
-        .cost = 0
-    });
-
-    MapRegionPathNode end_node;
-    end_node.cost = -1;
-    while (!frontier.empty()) {
-        uint32_t smallest_index = 0;
-        for (uint32_t index = 1; index < frontier.size(); index++) {
-            if (frontier[index].cost < frontier[smallest_index].cost) {
-                smallest_index = index;
-            }
-        }
-        MapRegionPathNode smallest = frontier[smallest_index];
-        frontier[smallest_index] = frontier.back();
-        frontier.pop_back();
+// Walks the region routes that were baked in map_init_regions(), so the only search is over the connections out of the from region
+// Returns false if there is no route, otherwise region_path ends with the region of the to cell
+static bool map_get_region_path(const Map& map, ivec2 from, ivec2 to, MapRegionPath& region_path) {
+    ZoneScoped;
 
-        if (smallest.cell == to) {
-            end_node = smallest.parent != -1 && 
-                map_get_region(map, explored[smallest.parent].cell) == 
-                map_get_region(map, smallest.cell)
-                    ? explored[smallest.parent]
-                    : smallest;
-            break;
+    region_path.clear();
+    uint8_t from_region = map_get_region(map, from);
+    uint8_t to_region = map_get_region(map, to);
+    if (from_region == to_region) {
+        region_path.push_back(to_region);
+        return true;
+    }
+
+    // Pick the cheapest route from a connection out of the from region to a connection into the to region
+    // This is the same cost that a search would use, with the legs at either end measured as straight lines
+    uint8_t first_connection_index = MAP_REGIONS_NOT_CONNECTED;
+    uint8_t last_connection_index = MAP_REGIONS_NOT_CONNECTED;
+    int route_cost = -1;
+    for (uint32_t first_region = 0; first_region < map.region_count; first_region++) {
+        uint8_t first_index = map.region_connection_indices[from_region][first_region];
+        if (first_index == MAP_REGIONS_NOT_CONNECTED) {
+            continue;
         }
+        int first_leg_cost = ivec2::manhattan_distance(from, map_get_region_connection_cell_closest_to_cell(map, from, to, first_region));
 
-        explored.push_back(smallest);
-        is_region_explored[map_get_region(map, smallest.cell)] = true;
-
-        if (map_get_region(map, smallest.cell) == map_get_region(map, to)) {
-            MapRegionPathNode child = (MapRegionPathNode) {
-                .parent = (int)explored.size() - 1,
-                .cell = to,
-                .connection_index = -1,
-                .cost = smallest.cost + ivec2::manhattan_distance(smallest.cell, to)
-            };
-
-            uint32_t frontier_index;
-            for (frontier_index = 0; frontier_index < frontier.size(); frontier_index++) {
-                if (frontier[frontier_index].cell == child.cell) {
-                    if (child.cost < frontier[frontier_index].cost) {
-                        frontier[frontier_index] = child;
-                    }
-                    break;
-                }
-            }
-            if (frontier_index == frontier.size()) {
-                frontier.push_back(child);
-            }
-        }
-        for (uint8_t connected_region = 0; connected_region < (uint8_t)map.region_count; connected_region++) {
-            // Skip this region if it is already explored
-            if (is_region_explored[connected_region]) {
+        for (uint32_t last_region = 0; last_region < map.region_count; last_region++) {
+            uint8_t last_index = map.region_connection_indices[last_region][to_region];
+            if (last_index == MAP_REGIONS_NOT_CONNECTED || 
+                    map.region_connection_route_cost[first_index][last_index] == MAP_REGION_COST_UNREACHABLE) {
                 continue;
             }
 
-            // Skip this region if it is not connected to the smallest node's region
-            uint8_t connection_index = map.region_connection_indices[map_get_region(map, smallest.cell)][connected_region];
-            if (connection_index == MAP_REGIONS_NOT_CONNECTED) {
-                continue;
+            const MapRegionConnection& last_connection = map.region_connections[last_index];
+            int last_leg_cost = ivec2::manhattan_distance(last_connection.cells[0], to);
+            for (uint32_t cell_index = 1; cell_index < last_connection.cell_count; cell_index++) {
+                last_leg_cost = std::min(last_leg_cost, ivec2::manhattan_distance(last_connection.cells[cell_index], to));
             }
 
-            // Determine the cell in the connection closest to the smallest node's cell
-            ivec2 nearest_cell = map_get_region_connection_cell_closest_to_cell(map, smallest.cell, to, connected_region);
-
-            // Determine the connection cost
-            uint8_t connection_cost = smallest.connection_index == -1
-                ? ivec2::manhattan_distance(smallest.cell, nearest_cell)
-                : map.region_connection_to_connection_cost[smallest.connection_index][connection_index];
-
-            MapRegionPathNode child = (MapRegionPathNode) {
-                .parent = (int)explored.size() - 1,
-                .cell = nearest_cell,
-                .connection_index = connection_index,
-                .cost = smallest.cost + connection_cost
-            };
-
-            uint32_t frontier_index;
-            for (frontier_index = 0; frontier_index < frontier.size(); frontier_index++) {
-                if (map_get_region(map, child.cell) == map_get_region(map, frontier[frontier_index].cell)) {
-                    if (child.cost < frontier[frontier_index].cost) {
-                        frontier[frontier_index] = child;
-                    }
-                    break;
-                }
-            }
-            if (frontier_index < frontier.size()) {
-                continue;
+            int cost = first_leg_cost + map.region_connection_route_cost[first_index][last_index] + last_leg_cost;
+            if (route_cost == -1 || cost < route_cost) {
+                first_connection_index = first_index;
+                last_connection_index = last_index;
+                route_cost = cost;
             }
-
-            frontier.push_back(child);
         }
-    } // End while not frontier empty
+    }
+    if (route_cost == -1) {
+        return false;
+    }
 
-    // Assert that a path was found
-    GOLD_ASSERT(end_node.cost != -1);
+    // Follow the route, then reverse it so that the next region is at the back
+    uint8_t connection_index = first_connection_index;
+    while (true) {
+        region_path.push_back(map_get_region(map, map.region_connections[connection_index].cells[0]));
+        if (connection_index == last_connection_index) {
+            break;
+        }
 
-    // Build region path
-    MapRegionPathNode current = end_node;
-    while (current.parent != -1) {
-        path.push_back(map_get_region(map, current.cell));
-        current = explored[current.parent];
+        connection_index = map.region_connection_route_next[connection_index][last_connection_index];
+        GOLD_ASSERT(connection_index != MAP_REGIONS_NOT_CONNECTED && region_path.size() < MAP_REGION_MAX);
     }
+    std::reverse(region_path.data, region_path.data + region_path.size());
 
-    return path;
+    return true;
 }
 
 void map_pathfind(const Map& map, CellLayer layer, ivec2 from, ivec2 to, int cell_size, uint32_t options, const MapPath* ignore_cells, MapPath* path) {
     ZoneScoped;
 
-    static const int EXPLORED_INDEX_NOT_EXPLORED = -1;
-    static const int EXPLORED_INDEX_IGNORE_CELL = -2;
-
     // Always clear the path because paths are grabbed from a pool
     // so they may contain garbage data that we don't want to re-use
     path->clear();
@@ -2155,9 +2934,10 @@ void map_pathfind(const Map& map, CellLayer layer, ivec2 from, ivec2 to, int cel
         }
     }
 
-    std::vector<MapPathNode> frontier;
-    std::vector<MapPathNode> explored;
-    std::vector<int> explored_indices = std::vector<int>(map.width * map.height, EXPLORED_INDEX_NOT_EXPLORED);
+    // Begin the search after the target is corrected, since map_pathfind_correct_target() uses the same scratch arena
+    MapPathfindScratch& scratch = pathfind_scratch;
+    map_pathfind_scratch_begin(scratch);
+    std::vector<MapPathNode>& explored = scratch.explored;
     uint32_t closest_explored = 0;
     bool found_path = false;
     bool avoid_landmines = (options & MAP_OPTION_AVOID_LANDMINES) == MAP_OPTION_AVOID_LANDMINES;
@@ -2167,39 +2947,32 @@ void map_pathfind(const Map& map, CellLayer layer, ivec2 from, ivec2 to, int cel
     if (ignore_cells != NULL) {
         for (uint32_t ignore_cell_index = 0; ignore_cell_index < ignore_cells->size(); ignore_cell_index++) {
             ivec2 ignore_cell = (*ignore_cells)[ignore_cell_index];
-            explored_indices[ignore_cell.x + (ignore_cell.y * map.width)] = EXPLORED_INDEX_IGNORE_CELL;
+            map_pathfind_scratch_set_explored_index(scratch, ignore_cell.x + (ignore_cell.y * map.width), EXPLORED_INDEX_IGNORE_CELL);
         }
     }
 
-    std::vector<int> region_path; 
-    ivec2 heuristic_cell; 
+    MapRegionPath region_path; 
+    ivec2 heuristic_cell = to; 
     bool no_region_path = (options & MAP_OPTION_NO_REGION_PATH) == MAP_OPTION_NO_REGION_PATH;
-    if (no_region_path || layer == CELL_LAYER_SKY || map_get_region(map, from) == map_get_region(map, to)) {
-        heuristic_cell = to;
-    } else {
-        region_path = map_get_region_path(map, from, to);
-        heuristic_cell = map_get_region_connection_cell_closest_to_cell(map, from, to, region_path.back());
+    if (!no_region_path && layer != CELL_LAYER_SKY && map_get_region(map, from) != map_get_region(map, to)) {
+        if (map_get_region_path(map, from, to, region_path)) {
+            heuristic_cell = map_get_region_connection_cell_closest_to_cell(map, from, to, region_path.back());
+        } else {
+            GOLD_ASSERT(false);
+            region_path.clear();
+        }
     }
 
-    frontier.push_back((MapPathNode) {
+    MapPathNode start_node = (MapPathNode) {
         .parent = -1,
         .cell = from,
         .cost = 0
-    });
-
-    while (!frontier.empty()) {
-        // Find the smallest path
-        uint32_t smallest_index = 0;
-        for (uint32_t i = 1; i < frontier.size(); i++) {
-            if (frontier[i].score(heuristic_cell) < frontier[smallest_index].score(heuristic_cell)) {
-                smallest_index = i;
-            }
-        }
+    };
+    map_pathfind_frontier_push(scratch, map.width, start_node, start_node.score(heuristic_cell));
 
+    while (!scratch.frontier.empty()) {
         // Pop the smallest path
-        MapPathNode smallest = frontier[smallest_index];
-        frontier[smallest_index] = frontier.back();
-        frontier.pop_back();
+        MapPathNode smallest = map_pathfind_frontier_pop(scratch, map.width);
 
         // If it's the solution, return it
         if (smallest.cell == to) {
@@ -2220,7 +2993,7 @@ void map_pathfind(const Map& map, CellLayer layer, ivec2 from, ivec2 to, int cel
             // by making it so that we prioritize new cells in the new region
             // instead of old cells from earlier in the pathing process.
             // It also means we can get away with less frontier comparisons.
-            frontier.clear();
+            map_pathfind_frontier_clear(scratch);
         // If we've reached the region of the to cell, then clear the region path and just path directly to our final target.
         // This helps handle special cases where sometimes we pathfind into our target region on the way to an intermediate region.
         // In these cases, the pathfinding was taking the unit all the way to the intermediate region and then doubling back to the
@@ -2228,12 +3001,12 @@ void map_pathfind(const Map& map, CellLayer layer, ivec2 from, ivec2 to, int cel
         } else if (region_path.size() > 1 && map_get_region(map, smallest.cell) == map_get_region(map, to)) {
             region_path.clear();
             heuristic_cell = to;
-            frontier.clear();
+            map_pathfind_frontier_clear(scratch);
         }
 
         // Otherwise, add this tile to the explored list
         explored.push_back(smallest);
-        explored_indices[smallest.cell.x + (smallest.cell.y * map.width)] = (int)explored.size() - 1;
+        map_pathfind_scratch_set_explored_index(scratch, smallest.cell.x + (smallest.cell.y * map.width), (int)explored.size() - 1);
         if (ivec2::manhattan_distance(explored.back().cell, heuristic_cell) < ivec2::manhattan_distance(explored[closest_explored].cell, heuristic_cell)) {
             closest_explored = (int)explored.size() - 1;
         }
@@ -2299,55 +3072,182 @@ void map_pathfind(const Map& map, CellLayer layer, ivec2 from, ivec2 to, int cel
             }
 
             // Don't consider already explored children
-            if (explored_indices[child.cell.x + (child.cell.y * map.width)] != EXPLORED_INDEX_NOT_EXPLORED) {
+            if (map_pathfind_scratch_get_explored_index(scratch, child.cell.x + (child.cell.y * map.width)) != EXPLORED_INDEX_NOT_EXPLORED) {
                 continue;
             }
 
-            uint32_t frontier_index;
-            for (frontier_index = 0; frontier_index < frontier.size(); frontier_index++) {
-                MapPathNode& frontier_node = frontier[frontier_index];
-                if (frontier_node.cell == child.cell) {
-                    break;
-                }
-            }
+            int child_score = child.score(heuristic_cell);
+            uint32_t frontier_index = map_pathfind_frontier_find(scratch, map.width, child.cell);
             // If it is in the frontier...
-            if (frontier_index < frontier.size()) {
+            if (frontier_index != INDEX_INVALID) {
                 // ...and the child represents a shorter version of the frontier path, then replace the frontier version with the shorter child
-                if (child.score(heuristic_cell) < frontier[frontier_index].score(heuristic_cell)) {
-                    frontier[frontier_index] = child;
+                if (child_score < scratch.frontier_scores[frontier_index]) {
+                    map_pathfind_frontier_replace(scratch, frontier_index, child, child_score);
                 }
                 continue;
             }
             // If it's not in the frontier, then add it to the frontier
-            frontier.push_back(child);
+            map_pathfind_frontier_push(scratch, map.width, child, child_score);
         } // End for each child
     } // End while not frontier empty
 
-    // Backtrack to build the path
-    MapPathNode current = found_path ? path_end : explored[closest_explored];
-    std::vector<ivec2> full_path;
-    full_path.reserve(current.cost + 1);
+    // Backtrack to measure the full path
+    const MapPathNode path_start = found_path ? path_end : explored[closest_explored];
+    uint32_t full_path_size = 0;
+    MapPathNode current = path_start;
     while (current.parent != -1) {
-        full_path.push_back(current.cell);
+        full_path_size++;
         current = explored[current.parent];
     }
 
-    // Since the full_path was formed by backtracking, it is in reverse order
+    // Since the full path is formed by backtracking, it is in reverse order
     // we want to keep it in reverse order because pop_back() is fast
-    // but the full_path might be larger than path->capacity(), so we take a 
-    // tail subslice of the full_path
+    // but the full path might be larger than path->capacity(), so we take a 
+    // tail subslice of the full path
 
     const uint32_t full_path_start_index = 
-        full_path.size() > path->capacity()
-            ? full_path.size() - path->capacity()
+        full_path_size > path->capacity()
+            ? full_path_size - path->capacity()
             : 0;
 
     // path->clear() is caused at the start of the function
-    for (uint32_t full_path_index = full_path_start_index; full_path_index < full_path.size(); full_path_index++) {
-        path->push_back(full_path[full_path_index]);
+    current = path_start;
+    for (uint32_t full_path_index = 0; full_path_index < full_path_size; full_path_index++) {
+        if (full_path_index >= full_path_start_index) {
+            path->push_back(current.cell);
+        }
+        current = explored[current.parent];
+    }
+}
+
+struct MapFlowFieldScratch {
+    std::vector<uint16_t> costs;
+    // Step costs are 2 or 3, so a bucket queue only ever needs the next 4 cost values
+    std::vector<int> buckets[4];
+};
+
+static thread_local MapFlowFieldScratch flow_field_scratch;
+
+bool map_is_cell_flow_field_walkable(const Map& map, CellLayer layer, ivec2 cell) {
+    return map_is_cell_in_bounds(map, cell) && !map_is_cell_flow_field_blocked(map_get_cell(map, layer, cell));
+}
+
+void map_flow_field_bake(const Map& map, CellLayer layer, ivec2 goal, MapFlowField& field) {
+    ZoneScoped;
+
+    GOLD_ASSERT(map_is_cell_flow_field_walkable(map, layer, goal));
+
+    field.goal = goal;
+    field.layer = layer;
+    field.blocked_cell_version = map.blocked_cell_version;
+    memset(field.directions, MAP_FLOW_FIELD_NO_DIRECTION, sizeof(field.directions));
+
+    MapFlowFieldScratch& scratch = flow_field_scratch;
+    scratch.costs.assign(map.width * map.height, UINT16_MAX);
+    for (uint32_t bucket = 0; bucket < 4; bucket++) {
+        scratch.buckets[bucket].clear();
+    }
+
+    // Dijkstra outwards from the goal. Movement costs are symmetric, so the cost from the goal to a cell is the cost from that cell to the goal
+    scratch.costs[goal.x + (goal.y * map.width)] = 0;
+    scratch.buckets[0].push_back(goal.x + (goal.y * map.width));
+    uint32_t queued_count = 1;
+    uint16_t cost = 0;
+    while (queued_count != 0) {
+        std::vector<int>& bucket = scratch.buckets[cost % 4];
+        for (uint32_t bucket_index = 0; bucket_index < bucket.size(); bucket_index++) {
+            int cell_index = bucket[bucket_index];
+            // Skip cells that were queued again later with a lower cost
+            if (scratch.costs[cell_index] != cost) {
+                continue;
+            }
+            ivec2 cell = ivec2(cell_index % map.width, cell_index / map.width);
+
+            // Same child order and diagonal rule as map_pathfind()
+            bool is_adjacent_direction_blocked[4] = { true, true, true, true };
+            const int CHILD_DIRECTIONS[DIRECTION_COUNT] = { DIRECTION_NORTH, DIRECTION_EAST, DIRECTION_SOUTH, DIRECTION_WEST, 
+                                                            DIRECTION_NORTHEAST, DIRECTION_SOUTHEAST, DIRECTION_SOUTHWEST, DIRECTION_NORTHWEST };
+            for (int direction_index = 0; direction_index < DIRECTION_COUNT; direction_index++) {
+                int direction = CHILD_DIRECTIONS[direction_index];
+                ivec2 child = cell + DIRECTION_IVEC2[direction];
+                if (!map_is_cell_flow_field_walkable(map, layer, child)) {
+                    continue;
+                }
+
+                // Don't allow diagonal movement through cracks
+                if (direction % 2 == 0) {
+                    is_adjacent_direction_blocked[direction / 2] = false;
+                } else {
+                    int next_direction = direction + 1 == DIRECTION_COUNT ? 0 : direction + 1;
+                    int prev_direction = direction - 1;
+                    if (is_adjacent_direction_blocked[next_direction / 2] && is_adjacent_direction_blocked[prev_direction / 2]) {
+                        continue;
+                    }
+                }
+
+                int child_index = child.x + (child.y * map.width);
+                uint16_t child_cost = cost + (direction % 2 == 1 ? 3 : 2);
+                if (child_cost >= scratch.costs[child_index]) {
+                    continue;
+                }
+
+                scratch.costs[child_index] = child_cost;
+                // The child steps back the way that we came
+                field.directions[child_index] = (uint8_t)((direction + (DIRECTION_COUNT / 2)) % DIRECTION_COUNT);
+                scratch.buckets[child_cost % 4].push_back(child_index);
+                queued_count++;
+            }
+        }
+
+        queued_count -= bucket.size();
+        bucket.clear();
+        cost++;
     }
 }
 
+bool map_flow_field_is_stale(const Map& map, const MapFlowField& field) {
+    return field.blocked_cell_version != map.blocked_cell_version;
+}
+
+bool map_flow_field_pathfind(const Map& map, const MapFlowField& field, ivec2 from, ivec2 to, uint32_t options, MapPath* path) {
+    ZoneScoped;
+
+    GOLD_ASSERT(!map_flow_field_is_stale(map, field));
+    path->clear();
+
+    // Walk the field forwards, then copy the steps into the path in reverse since paths are consumed from the back
+    ivec2 steps[MAP_MAX_PATH_SIZE];
+    uint32_t step_count = 0;
+    ivec2 cell = from;
+    while (step_count < MAP_MAX_PATH_SIZE && ivec2::manhattan_distance(cell, to) > MAP_FLOW_FIELD_HANDOFF_DISTANCE) {
+        uint8_t direction = field.directions[cell.x + (cell.y * map.width)];
+        if (direction == MAP_FLOW_FIELD_NO_DIRECTION) {
+            break;
+        }
+
+        // The field doesn't know about units, so bail out on the same nearby units that map_pathfind() would path around
+        ivec2 next = cell + DIRECTION_IVEC2[direction];
+        if (map_is_cell_rect_occupied(map, field.layer, next, 1, from, options)) {
+            return false;
+        }
+        if (direction % 2 == 1 &&
+                map_is_cell_rect_occupied(map, field.layer, cell + DIRECTION_IVEC2[(direction + 1) % DIRECTION_COUNT], 1, from, options) &&
+                map_is_cell_rect_occupied(map, field.layer, cell + DIRECTION_IVEC2[direction - 1], 1, from, options)) {
+            return false;
+        }
+
+        steps[step_count] = next;
+        step_count++;
+        cell = next;
+    }
+
+    for (uint32_t step_index = step_count; step_index > 0; step_index--) {
+        path->push_back(steps[step_index - 1]);
+    }
+
+    return !path->empty();
+}
+
 // This returns the hall cell that exiting miners walk toward
 ivec2 map_get_ideal_mine_exit_path_rally_cell(const Map& map, ivec2 mine_cell, ivec2 hall_cell) {
     return map_get_nearest_cell_around_rect(map, CELL_LAYER_GROUND, mine_cell + ivec2(1, 1), 1, hall_cell, 4, MAP_OPTION_IGNORE_MINERS);
@@ -14,6 +14,9 @@
 #define MAP_COST_TO_CONNECTION_MAX 16
 #define MAP_REGION_CHUNK_SIZE 32
 
+// More blocked / unblocked ground cells than this between unreachable cell updates falls back to a full re-flood
+#define MAP_ISLAND_DIRTY_CELLS_MAX 64
+
 #define MAP_MAX_PATH_SIZE 64
 using MapPath = FixedVector<ivec2, MAP_MAX_PATH_SIZE>;
 
@@ -23,6 +26,10 @@ const uint32_t MAP_OPTION_AVOID_LANDMINES = 1 << 2;
 const uint32_t MAP_OPTION_ALLOW_PATH_SQUIRRELING = 1 << 3;
 const uint32_t MAP_OPTION_NO_REGION_PATH = 1 << 4;
 
+#define MAP_FLOW_FIELD_NO_DIRECTION UINT8_MAX
+// Flow field paths stop once they get this close to their target, the rest of the way is pathed with A*
+#define MAP_FLOW_FIELD_HANDOFF_DISTANCE 8
+
 struct Tile {
     uint8_t sprite;
     uint8_t frame_x;
@@ -58,13 +65,6 @@ struct Cell {
 };
 STATIC_ASSERT(sizeof(Cell) == 4);
 
-struct MapRegionPathNode {
-    int parent;
-    ivec2 cell;
-    int connection_index;
-    int cost;
-};
-
 struct MapPathNode {
     // The parent is the previous node stepped in the path to reach this node
     // It should be an index in the explored list or -1 if it is the start node
@@ -96,6 +96,8 @@ struct Map {
     int height;
     Tile tiles[MAP_SIZE_MAX * MAP_SIZE_MAX];
     Cell cells[CELL_LAYER_COUNT][MAP_SIZE_MAX * MAP_SIZE_MAX];
+    // Incremented whenever a cell changes between blocked and walkable, so that baked flow fields can tell when they are stale
+    uint32_t blocked_cell_version;
 
     uint32_t region_count;
     uint8_t regions[MAP_SIZE_MAX * MAP_SIZE_MAX];
@@ -103,6 +105,28 @@ struct Map {
     uint32_t region_connection_count;
     MapRegionConnection region_connections[MAP_REGION_CONNECTION_MAX];
     uint8_t region_connection_to_connection_cost[MAP_REGION_CONNECTION_MAX][MAP_REGION_CONNECTION_MAX];
+    // All-pairs shortest routes over the connection graph, baked in map_init_regions()
+    // Region connections only depend on terrain, so these never need to be re-baked during a match
+    uint16_t region_connection_route_cost[MAP_REGION_CONNECTION_MAX][MAP_REGION_CONNECTION_MAX];
+    uint8_t region_connection_route_next[MAP_REGION_CONNECTION_MAX][MAP_REGION_CONNECTION_MAX];
+
+    // The 4-connected island of every unblocked ground cell, as of the last unreachable cell calculation
+    // Ground cells that flipped between blocked and unblocked since then are queued up,
+    // so that map_update_unreachable_cells() only has to re-flood the islands around them
+    uint16_t islands[MAP_SIZE_MAX * MAP_SIZE_MAX];
+    uint16_t island_sizes[MAP_SIZE_MAX * MAP_SIZE_MAX];
+    uint32_t island_count;
+    uint32_t island_dirty_cell_count;
+    uint16_t island_dirty_cells[MAP_ISLAND_DIRTY_CELLS_MAX];
+};
+
+// A flow field points every cell along its shortest path to the goal
+// Units are treated as walkable when baking, they are checked for when a path is sampled from the field instead
+struct MapFlowField {
+    ivec2 goal;
+    CellLayer layer;
+    uint32_t blocked_cell_version;
+    uint8_t directions[MAP_SIZE_MAX * MAP_SIZE_MAX];
 };
 
 void map_init(Map& map, MapType map_type, int width, int height);
@@ -110,14 +134,21 @@ void map_init_generate(Map& map, MapType map_type, Noise* noise, int* lcg_seed,
 void map_init_regions(Map& map);
 void map_cleanup_noise(const Map& map, Noise* noise);
 void map_bake_tiles(Map& map, const Noise* noise, int* lcg_seed);
+void map_bake_tiles_in_rect(Map& map, const Noise* noise, int* lcg_seed, ivec2 cell_min, ivec2 cell_max);
 void map_bake_map_tiles_and_remove_artifacts(Map& map, Noise* noise, int* lcg_seed);
 void map_bake_front_walls(Map& map);
+void map_bake_front_walls_in_rect(Map& map, ivec2 cell_min, ivec2 cell_max);
 Direction map_get_tile_stair_direction(const Tile& tile);
 bool map_should_cell_be_blocked(const Map& map, ivec2 cell);
 bool map_can_ramp_be_placed_on_tile(const Tile& tile);
 Direction map_get_tile_stair_direction(const Tile& tile);
 void map_bake_ramp(Map& map, Direction stair_direction, ivec2 stair_min, ivec2 stair_max);
 void map_bake_ramps(Map& map, const Noise* noise);
+void map_bake_ramps_in_rect(Map& map, const Noise* noise, ivec2 cell_min, ivec2 cell_max);
+// Grows a rect of changed noise cells into the rect that has to be rebaked for the tiles to match a full bake
+// Feeding the grown rect to the *_in_rect() bake functions gives the same tiles as the full bake functions,
+// except that plain ground tiles inside the rect get a new random variant
+void map_expand_bake_rect(const Map& map, const Noise* noise, ivec2* cell_min, ivec2* cell_max);
 SpriteName map_choose_ground_tile_sprite(MapType map_type, int index, int* lcg_seed);
 SpriteName map_choose_water_tile_sprite(MapType map_type);
 SpriteName map_get_plain_ground_tile_sprite(MapType map_type);
@@ -125,6 +156,8 @@ SpriteName map_get_decoration_sprite(MapType map_type);
 bool map_is_cell_blocked(Cell cell);
 bool map_is_cell_rect_blocked(const Map& map, ivec2 cell, int cell_size);
 void map_calculate_unreachable_cells(Map& map);
+// Same result as map_calculate_unreachable_cells(), but only re-floods the islands around the ground cells that changed since the last calculation
+void map_update_unreachable_cells(Map& map);
 
 uint8_t map_neighbors_to_autotile_index(uint32_t neighbors);
 void map_generate_decorations(Map& map, Noise* noise, int* lcg_seed, const std::vector<ivec2>& goldmine_cells);
@@ -156,6 +189,11 @@ uint8_t map_get_region(const Map& map, ivec2 cell);
 bool map_are_regions_connected(const Map& map, uint8_t region_a, uint8_t region_b);
 
 void map_pathfind(const Map& map, CellLayer layer, ivec2 from, ivec2 to, int cell_size, uint32_t options, const MapPath* ignore_cells, MapPath* path);
+bool map_is_cell_flow_field_walkable(const Map& map, CellLayer layer, ivec2 cell);
+void map_flow_field_bake(const Map& map, CellLayer layer, ivec2 goal, MapFlowField& field);
+bool map_flow_field_is_stale(const Map& map, const MapFlowField& field);
+// Fills path by following the field from the from cell, returns false if the path would run into a nearby unit so that the caller can use map_pathfind() instead
+bool map_flow_field_pathfind(const Map& map, const MapFlowField& field, ivec2 from, ivec2 to, uint32_t options, MapPath* path);
 ivec2 map_get_ideal_mine_exit_path_rally_cell(const Map& map, ivec2 mine_cell, ivec2 hall_cell);
 void map_get_ideal_mine_exit_path(const Map& map, ivec2 mine_cell, ivec2 hall_cell, MapPath* path);
 ivec2 map_get_ideal_mine_entrance_cell(const Map& map, ivec2 mine_cell, ivec2 hall_cell);
@@ -1,73 +1,101 @@
 #include "noise.h"
 
 #include "core/asserts.h"
+#include "core/job.h"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <vector>
 
+/**
+ * noise_generate() fills the map one row at a time, splitting the rows into bands that are generated as parallel jobs,
+ * and evaluates the simplex noise for NOISE_BATCH_SIZE cells of a row at once.
+ *
+ * The generated maps have to match the ones from older versions exactly, otherwise seeds and replays would
+ * no longer reproduce, so the batched kernel performs the same operations in the same order and precision as
+ * simplex_noise(). Branches become per-lane selects of the vertex offsets, and a skipped vertex becomes a zero contribution.
+ */
+
+#define NOISE_BATCH_SIZE 4
+#define NOISE_BAND_ROW_COUNT 16
+
+static const double SKEW_2D = 0.366025403784439;
+static const double UNSKEW_2D = -0.21132486540518713;
+static const float RSQUARED_2D = 2.0f / 3.0f;
+static const uint64_t PRIME_X = 5910200641878280303;
+static const uint64_t PRIME_Y = 6452764530575939509;
+static const uint64_t HASH_MULTIPLIER = 6026932503003350773;
+static const int N_GRADS_2D_EXPONENT = 7;
+static const int N_GRADS_2D = 1 << N_GRADS_2D_EXPONENT;
+
+struct NoiseGradients {
+    float values[N_GRADS_2D * 2];
+};
+
 int fast_floor(double x) {
     int xi = (int)x;
     return x < xi ? xi - 1 : xi;
 }
 
-float grad(uint64_t seed, uint64_t xsvp, uint64_t ysvp, float dx, float dy) {
-    const uint64_t HASH_MULTIPLIER = 6026932503003350773;
-    const int N_GRADS_2D_EXPONENT = 7;
-    const int N_GRADS_2D = 1 << N_GRADS_2D_EXPONENT;
+static NoiseGradients noise_create_gradients() {
     const double NORMALIZER_2D = 0.05481866495625118;
-    static float GRADIENTS_2D[N_GRADS_2D * 2];
-    static bool gradients_initialized = false;
-
-    if (!gradients_initialized) {
-        float grad2[48] = {
-            0.38268343236509f,   0.923879532511287f,
-            0.923879532511287f,  0.38268343236509f,
-            0.923879532511287f, -0.38268343236509f,
-            0.38268343236509f,  -0.923879532511287f,
-            -0.38268343236509f,  -0.923879532511287f,
-            -0.923879532511287f, -0.38268343236509f,
-            -0.923879532511287f,  0.38268343236509f,
-            -0.38268343236509f,   0.923879532511287f,
-            //-------------------------------------//
-            0.130526192220052f,  0.99144486137381f,
-            0.608761429008721f,  0.793353340291235f,
-            0.793353340291235f,  0.608761429008721f,
-            0.99144486137381f,   0.130526192220051f,
-            0.99144486137381f,  -0.130526192220051f,
-            0.793353340291235f, -0.60876142900872f,
-            0.608761429008721f, -0.793353340291235f,
-            0.130526192220052f, -0.99144486137381f,
-            -0.130526192220052f, -0.99144486137381f,
-            -0.608761429008721f, -0.793353340291235f,
-            -0.793353340291235f, -0.608761429008721f,
-            -0.99144486137381f,  -0.130526192220052f,
-            -0.99144486137381f,   0.130526192220051f,
-            -0.793353340291235f,  0.608761429008721f,
-            -0.608761429008721f,  0.793353340291235f,
-            -0.130526192220052f,  0.99144486137381f,
-        };
-        for (int i = 0; i < 48; i++) {
-            grad2[i] = (float)(grad2[i] / NORMALIZER_2D);
-        }
-        for (int i = 0; i < N_GRADS_2D * 2; i++) {
-            GRADIENTS_2D[i] = grad2[i % 48];
-        }
-        gradients_initialized = true;
+    float grad2[48] = {
+        0.38268343236509f,   0.923879532511287f,
+        0.923879532511287f,  0.38268343236509f,
+        0.923879532511287f, -0.38268343236509f,
+        0.38268343236509f,  -0.923879532511287f,
+        -0.38268343236509f,  -0.923879532511287f,
+        -0.923879532511287f, -0.38268343236509f,
+        -0.923879532511287f,  0.38268343236509f,
+        -0.38268343236509f,   0.923879532511287f,
+        //-------------------------------------//
+        0.130526192220052f,  0.99144486137381f,
+        0.608761429008721f,  0.793353340291235f,
+        0.793353340291235f,  0.608761429008721f,
+        0.99144486137381f,   0.130526192220051f,
+        0.99144486137381f,  -0.130526192220051f,
+        0.793353340291235f, -0.60876142900872f,
+        0.608761429008721f, -0.793353340291235f,
+        0.130526192220052f, -0.99144486137381f,
+        -0.130526192220052f, -0.99144486137381f,
+        -0.608761429008721f, -0.793353340291235f,
+        -0.793353340291235f, -0.608761429008721f,
+        -0.99144486137381f,  -0.130526192220052f,
+        -0.99144486137381f,   0.130526192220051f,
+        -0.793353340291235f,  0.608761429008721f,
+        -0.608761429008721f,  0.793353340291235f,
+        -0.130526192220052f,  0.99144486137381f,
+    };
+    for (int i = 0; i < 48; i++) {
+        grad2[i] = (float)(grad2[i] / NORMALIZER_2D);
+    }
+
+    NoiseGradients gradients;
+    for (int i = 0; i < N_GRADS_2D * 2; i++) {
+        gradients.values[i] = grad2[i % 48];
     }
+    return gradients;
+}
+
+// Function-local static so that the table is built exactly once, even when the first calls come from worker threads
+static const float* noise_get_gradients() {
+    static const NoiseGradients gradients = noise_create_gradients();
+    return gradients.values;
+}
 
+static int noise_gradient_index(uint64_t seed, uint64_t xsvp, uint64_t ysvp) {
     uint64_t hash = (seed ^ xsvp ^ ysvp) * HASH_MULTIPLIER;
     hash ^= hash >> (64 - N_GRADS_2D_EXPONENT + 1);
-    int gi = (int)hash & ((N_GRADS_2D - 1) << 1);
-    return GRADIENTS_2D[gi | 0] * dx + GRADIENTS_2D[gi | 1] * dy;
+    return (int)hash & ((N_GRADS_2D - 1) << 1);
 }
 
-float simplex_noise(uint64_t seed, double x, double y) {
-    const double SKEW_2D = 0.366025403784439;
-    const double UNSKEW_2D = -0.21132486540518713;
-    const float RSQUARED_2D = 2.0f / 3.0f;
-    const uint64_t PRIME_X = 5910200641878280303;
-    const uint64_t PRIME_Y = 6452764530575939509;
+float grad(uint64_t seed, uint64_t xsvp, uint64_t ysvp, float dx, float dy) {
+    const float* gradients = noise_get_gradients();
+    int gi = noise_gradient_index(seed, xsvp, ysvp);
+    return gradients[gi | 0] * dx + gradients[gi | 1] * dy;
+}
 
+float simplex_noise(uint64_t seed, double x, double y) {
     double skew = SKEW_2D * (x + y);
     double xs = x + skew;
     double ys = y + skew;
@@ -162,6 +190,164 @@ float simplex_noise(uint64_t seed, double x, double y) {
     return value;
 }
 
+// Evaluates simplex_noise(seed, x[lane], y) for NOISE_BATCH_SIZE cells of the same row
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+struct NoiseVertexOffset {
+    float dx;
+    float dy;
+    int lattice_x;
+    int lattice_y;
+};
+
+// The third and fourth vertices of simplex_noise(), indexed by which branch the lane took.
+// A vertex that simplex_noise() reaches by adding to dx0 and dy0 is stored here as subtracting the negated offset, which gives the same result.
+static const NoiseVertexOffset NOISE_VERTEX2_OFFSETS[4] = {
+    { (float)(3 * UNSKEW_2D + 2), (float)(3 * UNSKEW_2D + 1), 2, 1 },
+    { (float)UNSKEW_2D, (float)(UNSKEW_2D + 1), 0, 1 },
+    { -(float)(1 + UNSKEW_2D), -(float)UNSKEW_2D, -1, 0 },
+    { (float)(UNSKEW_2D + 1), (float)UNSKEW_2D, 1, 0 }
+};
+static const NoiseVertexOffset NOISE_VERTEX3_OFFSETS[4] = {
+    { (float)(3 * UNSKEW_2D + 1), (float)(3 * UNSKEW_2D + 2), 1, 2 },
+    { (float)(UNSKEW_2D + 1), (float)UNSKEW_2D, 1, 0 },
+    { -(float)UNSKEW_2D, -(float)(UNSKEW_2D + 1), 0, -1 },
+    { (float)UNSKEW_2D, (float)(UNSKEW_2D + 1), 0, 1 }
+};
+
+// fast_floor() for two lanes, returned in the low two lanes
+static __m128i noise_fast_floor2(__m128d x) {
+    __m128i xi = _mm_cvttpd_epi32(x);
+    __m128d is_below = _mm_cmplt_pd(x, _mm_cvtepi32_pd(xi));
+    // Narrow the 64-bit masks to 32 bits, each mask lane is all ones so adding it subtracts one
+    return _mm_add_epi32(xi, _mm_shuffle_epi32(_mm_castpd_si128(is_below), _MM_SHUFFLE(3, 3, 2, 0)));
+}
+
+static __m128 noise_vertex_contribution(__m128 a, __m128 gradient_x, __m128 gradient_y, __m128 dx, __m128 dy) {
+    __m128 gradient = _mm_add_ps(_mm_mul_ps(gradient_x, dx), _mm_mul_ps(gradient_y, dy));
+    __m128 a_squared = _mm_mul_ps(a, a);
+    return _mm_mul_ps(_mm_mul_ps(a_squared, a_squared), gradient);
+}
+
+static void simplex_noise_batch(uint64_t seed, const double* x, double y, float* values) {
+    const float* gradients = noise_get_gradients();
+
+    // Skew in double precision, two lanes at a time
+    int xsb[NOISE_BATCH_SIZE];
+    int ysb[NOISE_BATCH_SIZE];
+    __m128 xi_halves[2];
+    __m128 yi_halves[2];
+    const __m128d y2 = _mm_set1_pd(y);
+    for (int half = 0; half < 2; half++) {
+        __m128d x2 = _mm_loadu_pd(x + (half * 2));
+        __m128d skew = _mm_mul_pd(_mm_set1_pd(SKEW_2D), _mm_add_pd(x2, y2));
+        __m128d xs = _mm_add_pd(x2, skew);
+        __m128d ys = _mm_add_pd(y2, skew);
+
+        __m128i xsb2 = noise_fast_floor2(xs);
+        __m128i ysb2 = noise_fast_floor2(ys);
+        _mm_storel_epi64((__m128i*)(xsb + (half * 2)), xsb2);
+        _mm_storel_epi64((__m128i*)(ysb + (half * 2)), ysb2);
+        xi_halves[half] = _mm_cvtpd_ps(_mm_sub_pd(xs, _mm_cvtepi32_pd(xsb2)));
+        yi_halves[half] = _mm_cvtpd_ps(_mm_sub_pd(ys, _mm_cvtepi32_pd(ysb2)));
+    }
+    const __m128 xi = _mm_movelh_ps(xi_halves[0], xi_halves[1]);
+    const __m128 yi = _mm_movelh_ps(yi_halves[0], yi_halves[1]);
+
+    const __m128 t = _mm_mul_ps(_mm_add_ps(xi, yi), _mm_set1_ps((float)UNSKEW_2D));
+    const __m128 dx0 = _mm_add_ps(xi, t);
+    const __m128 dy0 = _mm_add_ps(yi, t);
+    const __m128 rsquared = _mm_set1_ps(RSQUARED_2D);
+    const __m128 a0 = _mm_sub_ps(_mm_sub_ps(rsquared, _mm_mul_ps(dx0, dx0)), _mm_mul_ps(dy0, dy0));
+
+    const __m128 a1 = _mm_add_ps(
+        _mm_mul_ps(_mm_set1_ps((float)(2 * (1 + 2 * UNSKEW_2D) * (1 / UNSKEW_2D + 2))), t),
+        _mm_add_ps(_mm_set1_ps((float)(-2 * (1 + 2 * UNSKEW_2D) * (1 + 2 * UNSKEW_2D))), a0));
+    const __m128 dx1 = _mm_sub_ps(dx0, _mm_set1_ps((float)(1 + 2 * UNSKEW_2D)));
+    const __m128 dy1 = _mm_sub_ps(dy0, _mm_set1_ps((float)(1 + 2 * UNSKEW_2D)));
+
+    // Pick the branch of each lane. simplex_noise() compares t against UNSKEW_2D in double precision.
+    const __m128 xmyi = _mm_sub_ps(xi, yi);
+    const __m128 xi_plus_xmyi = _mm_add_ps(xi, xmyi);
+    const __m128d unskew2 = _mm_set1_pd(UNSKEW_2D);
+    const __m128d is_lower_low = _mm_cmplt_pd(_mm_cvtps_pd(t), unskew2);
+    const __m128d is_lower_high = _mm_cmplt_pd(_mm_cvtps_pd(_mm_movehl_ps(t, t)), unskew2);
+    const int is_lower_mask = _mm_movemask_pd(is_lower_low) | (_mm_movemask_pd(is_lower_high) << 2);
+    const int vertex2_lower_mask = _mm_movemask_ps(_mm_cmpgt_ps(xi_plus_xmyi, _mm_set1_ps(1.0f)));
+    const int vertex2_upper_mask = _mm_movemask_ps(_mm_cmplt_ps(xi_plus_xmyi, _mm_setzero_ps()));
+    const int vertex3_lower_mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_sub_ps(yi, xmyi), _mm_set1_ps(1.0f)));
+    const int vertex3_upper_mask = _mm_movemask_ps(_mm_cmplt_ps(yi, xmyi));
+
+    // Gather the vertex offsets and gradients for each lane
+    alignas(16) float vertex2_dx[NOISE_BATCH_SIZE];
+    alignas(16) float vertex2_dy[NOISE_BATCH_SIZE];
+    alignas(16) float vertex3_dx[NOISE_BATCH_SIZE];
+    alignas(16) float vertex3_dy[NOISE_BATCH_SIZE];
+    alignas(16) float gradient_x[4][NOISE_BATCH_SIZE];
+    alignas(16) float gradient_y[4][NOISE_BATCH_SIZE];
+    for (int lane = 0; lane < NOISE_BATCH_SIZE; lane++) {
+        const int lane_bit = 1 << lane;
+        const bool is_lower = (is_lower_mask & lane_bit) != 0;
+        const NoiseVertexOffset& vertex2 = is_lower
+            ? NOISE_VERTEX2_OFFSETS[(vertex2_lower_mask & lane_bit) ? 0 : 1]
+            : NOISE_VERTEX2_OFFSETS[(vertex2_upper_mask & lane_bit) ? 2 : 3];
+        const NoiseVertexOffset& vertex3 = is_lower
+            ? NOISE_VERTEX3_OFFSETS[(vertex3_lower_mask & lane_bit) ? 0 : 1]
+            : NOISE_VERTEX3_OFFSETS[(vertex3_upper_mask & lane_bit) ? 2 : 3];
+        vertex2_dx[lane] = vertex2.dx;
+        vertex2_dy[lane] = vertex2.dy;
+        vertex3_dx[lane] = vertex3.dx;
+        vertex3_dy[lane] = vertex3.dy;
+
+        // Like simplex_noise(), the y lattice coordinate is scaled by PRIME_X and stepped by PRIME_Y
+        const uint64_t xsbp = (uint64_t)xsb[lane] * PRIME_X;
+        const uint64_t ysbp = (uint64_t)ysb[lane] * PRIME_X;
+        const int gradient_indices[4] = {
+            noise_gradient_index(seed, xsbp, ysbp),
+            noise_gradient_index(seed, xsbp + PRIME_X, ysbp + PRIME_Y),
+            noise_gradient_index(seed, xsbp + ((uint64_t)(int64_t)vertex2.lattice_x * PRIME_X), ysbp + ((uint64_t)(int64_t)vertex2.lattice_y * PRIME_Y)),
+            noise_gradient_index(seed, xsbp + ((uint64_t)(int64_t)vertex3.lattice_x * PRIME_X), ysbp + ((uint64_t)(int64_t)vertex3.lattice_y * PRIME_Y))
+        };
+        for (int vertex = 0; vertex < 4; vertex++) {
+            gradient_x[vertex][lane] = gradients[gradient_indices[vertex] | 0];
+            gradient_y[vertex][lane] = gradients[gradient_indices[vertex] | 1];
+        }
+    }
+
+    const __m128 dx2 = _mm_sub_ps(dx0, _mm_load_ps(vertex2_dx));
+    const __m128 dy2 = _mm_sub_ps(dy0, _mm_load_ps(vertex2_dy));
+    const __m128 a2 = _mm_sub_ps(_mm_sub_ps(rsquared, _mm_mul_ps(dx2, dx2)), _mm_mul_ps(dy2, dy2));
+    const __m128 dx3 = _mm_sub_ps(dx0, _mm_load_ps(vertex3_dx));
+    const __m128 dy3 = _mm_sub_ps(dy0, _mm_load_ps(vertex3_dy));
+    const __m128 a3 = _mm_sub_ps(_mm_sub_ps(rsquared, _mm_mul_ps(dx3, dx3)), _mm_mul_ps(dy3, dy3));
+
+    __m128 value = noise_vertex_contribution(a0, _mm_load_ps(gradient_x[0]), _mm_load_ps(gradient_y[0]), dx0, dy0);
+    value = _mm_add_ps(value, noise_vertex_contribution(a1, _mm_load_ps(gradient_x[1]), _mm_load_ps(gradient_y[1]), dx1, dy1));
+    // Vertices outside of the radius add nothing, the same as simplex_noise() skipping them
+    value = _mm_add_ps(value, _mm_and_ps(
+        _mm_cmpgt_ps(a2, _mm_setzero_ps()),
+        noise_vertex_contribution(a2, _mm_load_ps(gradient_x[2]), _mm_load_ps(gradient_y[2]), dx2, dy2)));
+    value = _mm_add_ps(value, _mm_and_ps(
+        _mm_cmpgt_ps(a3, _mm_setzero_ps()),
+        noise_vertex_contribution(a3, _mm_load_ps(gradient_x[3]), _mm_load_ps(gradient_y[3]), dx3, dy3)));
+
+    _mm_storeu_ps(values, value);
+}
+
+#else
+
+// Without SSE2 the lanes are evaluated one at a time. This also keeps targets that fuse multiply-adds,
+// such as ARM, on the exact same expressions as simplex_noise().
+static void simplex_noise_batch(uint64_t seed, const double* x, double y, float* values) {
+    for (int lane = 0; lane < NOISE_BATCH_SIZE; lane++) {
+        values[lane] = simplex_noise(seed, x[lane], y);
+    }
+}
+
+#endif
+
 NoiseGenParams noise_create_noise_gen_params(MapType map_type, MapSize map_size, uint64_t map_seed, uint64_t forest_seed) {
     NoiseGenParams params;
 
@@ -223,23 +409,59 @@ Noise* noise_init(int width, int height) {
     return noise;
 }
 
-Noise* noise_generate(const NoiseGenParams& params) {
-    Noise* noise = noise_init(params.width, params.height);
-
+static void noise_generate_row(const NoiseGenParams& params, Noise* noise, int y) {
     const double FREQUENCY = 1.0 / 56.0;
     const double FOREST_FREQUENCY = 1.0 / 8.0;
 
-    for (int x = 0; x < noise->width; x++) {
-        for (int y = 0; y < noise->height; y++) {
-            // simplex_noise generates a result from -1 to 1, so we convert to the range 0 to 1
-            double perlin_result = (1.0 + simplex_noise(params.map_seed, x * FREQUENCY, y * FREQUENCY)) * 0.5;
-            noise->map[x + (y * noise->width)] = noise_value_from_result(params, perlin_result);
+    uint8_t* map_row = noise->map + (y * noise->width);
+    uint8_t* forest_row = noise->forest + (y * noise->width);
+
+    int x = 0;
+    for (; x + NOISE_BATCH_SIZE <= noise->width; x += NOISE_BATCH_SIZE) {
+        double map_x[NOISE_BATCH_SIZE];
+        double forest_x[NOISE_BATCH_SIZE];
+        for (int lane = 0; lane < NOISE_BATCH_SIZE; lane++) {
+            map_x[lane] = (x + lane) * FREQUENCY;
+            forest_x[lane] = (x + lane) * FOREST_FREQUENCY;
+        }
 
-            double forest_result = (1.0 + simplex_noise(params.forest_seed, x * FOREST_FREQUENCY, y * FOREST_FREQUENCY)) * 0.5;
-            noise->forest[x + (y * noise->width)] = noise_forest_value_from_result(params, forest_result);
+        float map_values[NOISE_BATCH_SIZE];
+        float forest_values[NOISE_BATCH_SIZE];
+        simplex_noise_batch(params.map_seed, map_x, y * FREQUENCY, map_values);
+        simplex_noise_batch(params.forest_seed, forest_x, y * FOREST_FREQUENCY, forest_values);
+
+        for (int lane = 0; lane < NOISE_BATCH_SIZE; lane++) {
+            // simplex_noise generates a result from -1 to 1, so we convert to the range 0 to 1
+            map_row[x + lane] = noise_value_from_result(params, (1.0 + map_values[lane]) * 0.5);
+            forest_row[x + lane] = noise_forest_value_from_result(params, (1.0 + forest_values[lane]) * 0.5);
         }
     }
 
+    // Leftover cells when the width is not a multiple of the batch size
+    for (; x < noise->width; x++) {
+        double perlin_result = (1.0 + simplex_noise(params.map_seed, x * FREQUENCY, y * FREQUENCY)) * 0.5;
+        map_row[x] = noise_value_from_result(params, perlin_result);
+
+        double forest_result = (1.0 + simplex_noise(params.forest_seed, x * FOREST_FREQUENCY, y * FOREST_FREQUENCY)) * 0.5;
+        forest_row[x] = noise_forest_value_from_result(params, forest_result);
+    }
+}
+
+Noise* noise_generate(const NoiseGenParams& params) {
+    Noise* noise = noise_init(params.width, params.height);
+
+    // Build the gradient table before any of the jobs need it
+    noise_get_gradients();
+
+    // Every cell only depends on its own coordinates, so the rows can be split into bands that are generated in parallel
+    const uint32_t band_count = (uint32_t)((noise->height + NOISE_BAND_ROW_COUNT - 1) / NOISE_BAND_ROW_COUNT);
+    job_parallel_for(band_count, [&params, noise](uint32_t band_index) {
+        const int row_end = std::min(((int)band_index + 1) * NOISE_BAND_ROW_COUNT, noise->height);
+        for (int y = (int)band_index * NOISE_BAND_ROW_COUNT; y < row_end; y++) {
+            noise_generate_row(params, noise, y);
+        }
+    });
+
     return noise;
 }
 
@@ -5,6 +5,8 @@
 #include "match/lcg.h"
 #include "render/render.h"
 #include "profile/profile.h"
+#include <SDL3/SDL.h>
+#include <algorithm>
 
 static const uint32_t MATCH_PLAYER_STARTING_GOLD = 50;
 static const uint32_t MATCH_GOLDMINE_STARTING_GOLD = 7500;
@@ -28,8 +30,17 @@ static const uint32_t MINE_PRIME_DURATION = 6 * 6;
 static const uint32_t FOG_REVEAL_DURATION = 60;
 static const fixed BLEED_SPEED_PERCENTAGE = fixed::from_int_and_raw_decimal(0, 192);
 static const uint32_t MATCH_LOW_GOLD_THRESHOLD = 1000;
+static const uint16_t MATCH_ENTITY_GRID_BUCKET_NONE = UINT16_MAX;
+
+static void match_entity_grid_init(MatchEntityGrid& grid);
+static void match_entity_grid_insert(MatchEntityGrid& grid, EntityId entity_id, ivec2 cell);
+static void match_entity_grid_remove(MatchEntityGrid& grid, EntityId entity_id);
+static MapFlowField* match_flow_field_find(MatchState& state, CellLayer layer, ivec2 goal);
+static void match_flow_field_bake(MatchState& state, CellLayer layer, ivec2 goal);
 
 void match_init(MatchState& state, int32_t lcg_seed, MatchPlayer players[MAX_PLAYERS], MatchInitMapParams map_params) {
+    ZoneScoped;
+
     // LCG seed
     #ifdef GOLD_RAND_SEED
         state.lcg_seed = GOLD_RAND_SEED;
@@ -40,6 +51,13 @@ void match_init(MatchState& state, int32_t lcg_seed, MatchPlayer players[MAX_PLA
     // Players
     memcpy(state.players, players, sizeof(state.players));
 
+    // Entity grid
+    match_entity_grid_init(state.entity_grid);
+
+    // Flow fields
+    state.flow_fields.count = 0;
+    state.flow_fields.use_count = 0;
+
     // Fog and detection
     const int map_width = map_params.type == MATCH_INIT_MAP_FROM_NOISE
         ? map_params.noise.noise->width
@@ -53,6 +71,7 @@ void match_init(MatchState& state, int32_t lcg_seed, MatchPlayer players[MAX_PLA
             state.detection[team][index] = 0;
         }
     }
+    match_fog_mark_all_pages_dirty(state);
 
     // Map
     if (map_params.type == MATCH_INIT_MAP_FROM_NOISE) {
@@ -70,8 +89,10 @@ void match_init(MatchState& state, int32_t lcg_seed, MatchPlayer players[MAX_PLA
     } else if (map_params.type == MATCH_INIT_MAP_FROM_COPY) {
         memcpy(&state.map, map_params.copy.map, sizeof(state.map));
     }
+    uint64_t region_start_time = SDL_GetTicksNS();
     map_calculate_unreachable_cells(state.map);
     map_init_regions(state.map);
+    log_info("Initialized map regions in %.2fms.", (double)(SDL_GetTicksNS() - region_start_time) / 1000000.0);
 
     memset(state.fire_cells, 0, sizeof(state.fire_cells));
 }
@@ -143,7 +164,7 @@ void match_spawn_players(MatchState& state, const std::vector<ivec2>& map_spawn_
             EntityId hall_id = entity_create(state, ENTITY_HALL, town_hall_cell, player_id);
             Entity& hall = state.entities.get_by_id(hall_id);
             const EntityData& hall_data = entity_get_data(hall.type);
-            hall.health = hall_data.max_health;
+            entity_set_health(state, hall, hall_data.max_health);
             hall.mode = MODE_BUILDING_FINISHED;
 
             // Place miners
@@ -359,6 +380,31 @@ void match_handle_input(MatchState& state, const MatchInput& input) {
                     entity_target_queue_push(state, entity, target);
                 }
             } // End for each unit in move input
+
+            // Bake a shared flow field so that a large group doesn't run a long A* per unit
+            {
+                uint32_t layer_unit_count[CELL_LAYER_COUNT] = { 0, 0, 0 };
+                for (uint32_t id_index = 0; id_index < input.move.entity_count; id_index++) {
+                    uint32_t entity_index = state.entities.get_index_of(input.move.entity_ids[id_index]);
+                    if (entity_index == INDEX_INVALID || !entity_can_be_given_orders(state, state.entities[entity_index])) {
+                        continue;
+                    }
+                    const Entity& entity = state.entities[entity_index];
+                    const EntityData& entity_data = entity_get_data(entity.type);
+                    if (!entity_is_unit(entity.type) || entity_data.cell_size != 1 ||
+                            ivec2::manhattan_distance(entity.cell, input.move.target_cell) <= MAP_FLOW_FIELD_HANDOFF_DISTANCE) {
+                        continue;
+                    }
+                    layer_unit_count[entity_data.cell_layer]++;
+                }
+
+                for (uint32_t layer = 0; layer < CELL_LAYER_COUNT; layer++) {
+                    if (layer_unit_count[layer] >= MATCH_FLOW_FIELD_GROUP_SIZE_MIN &&
+                            map_is_cell_flow_field_walkable(state.map, (CellLayer)layer, input.move.target_cell)) {
+                        match_flow_field_bake(state, (CellLayer)layer, input.move.target_cell);
+                    }
+                }
+            }
             break;
         } // End case MATCH_INPUT_MOVE
         case MATCH_INPUT_MOVE_MOLOTOV: {
@@ -499,7 +545,7 @@ void match_handle_input(MatchState& state, const MatchInput& input) {
                 if (state.entities[entity_index].target.type == TARGET_BUILD && state.entities[entity_index].target.id == input.build_cancel.building_id) {
                     Entity& builder = state.entities[entity_index];
                     const EntityData& builder_data = entity_get_data(builder.type);
-                    builder.cell = builder.target.build.building_cell;
+                    entity_set_cell(state, state.entities.get_id_of(entity_index), builder.target.build.building_cell);
                     builder.position = entity_get_target_position(builder);
                     builder.target = target_none();
                     builder.mode = MODE_UNIT_IDLE;
@@ -514,7 +560,7 @@ void match_handle_input(MatchState& state, const MatchInput& input) {
             }
 
             // Destroy the building
-            state.entities[building_index].health = 0;
+            entity_set_health(state, state.entities[building_index], 0);
             break;
         }
         case MATCH_INPUT_BUILDING_ENQUEUE: {
@@ -523,8 +569,10 @@ void match_handle_input(MatchState& state, const MatchInput& input) {
             uint32_t shortest_building_queue_duration = 0;
             for (int index = 0; index < input.building_enqueue.building_count; index++) {
                 uint32_t candidate_index = state.entities.get_index_of(input.building_enqueue.building_ids[index]);
+                // The building might have been destroyed while the input was in flight, and its id handed to a new building that is still being built
                 if (candidate_index == INDEX_INVALID ||
                         !entity_is_selectable(state.entities[candidate_index]) ||
+                        state.entities[candidate_index].mode != MODE_BUILDING_FINISHED ||
                         state.entities[candidate_index].queue.size() == BUILDING_QUEUE_MAX) {
                     continue;
                 }
@@ -690,6 +738,16 @@ void match_handle_input(MatchState& state, const MatchInput& input) {
 
 void match_update(MatchState& state) {
     ZoneScoped;
+
+    #ifdef GOLD_DEBUG
+        // Catches any write to a mirrored entity field that went around the setters
+        for (uint32_t entity_index = 0; entity_index < state.entities.size(); entity_index++) {
+            const Entity& entity = state.entities[entity_index];
+            const EntityHot& entity_hot = state.entities.get_hot(entity_index);
+            GOLD_ASSERT(entity_hot.cell == entity.cell && entity_hot.health == entity.health &&
+                entity_hot.type == entity.type && entity_hot.player_id == entity.player_id);
+        }
+    #endif
     
     // Update entities
     for (uint32_t entity_index = 0; entity_index < state.entities.size(); entity_index++) {
@@ -810,6 +868,7 @@ void match_update(MatchState& state) {
                 }
                 const EntityData& entity_data = entity_get_data(state.entities[entity_index].type);
                 log_info("Removing entity %s ID %u player id %u", entity_data.name, state.entities.get_id_of(entity_index), state.entities[entity_index].player_id);
+                match_entity_grid_remove(state.entity_grid, state.entities.get_id_of(entity_index));
                 state.entities.remove_at(entity_index);
             } else {
                 entity_index++;
@@ -824,7 +883,7 @@ void match_update(MatchState& state) {
         while (remembered_entity_index < state.remembered_entities[team].size()) {
             const RememberedEntity& remembered_entity = state.remembered_entities[team][remembered_entity_index];
             uint32_t entity_index = state.entities.get_index_of(remembered_entity.entity_id);
-            if ((entity_index == INDEX_INVALID || state.entities[entity_index].health == 0) && 
+            if ((entity_index == INDEX_INVALID || state.entities.get_hot(entity_index).health == 0) && 
                     match_is_cell_rect_revealed(state, team, remembered_entity.cell, entity_get_data(remembered_entity.type).cell_size)) {
                 // Remove remembered entity
                 state.remembered_entities[team].remove_at_unordered(remembered_entity_index);
@@ -894,6 +953,198 @@ EntityList match_find_entities(const MatchState& state, std::function<bool(const
     return entity_list;
 }
 
+// ENTITY GRID
+
+static uint16_t match_entity_grid_get_bucket(ivec2 cell) {
+    GOLD_ASSERT(cell.x >= 0 && cell.y >= 0 && cell.x < MAP_SIZE_MAX && cell.y < MAP_SIZE_MAX);
+    return (uint16_t)((cell.x / MATCH_ENTITY_GRID_BUCKET_SIZE) + ((cell.y / MATCH_ENTITY_GRID_BUCKET_SIZE) * MATCH_ENTITY_GRID_WIDTH));
+}
+
+static void match_entity_grid_init(MatchEntityGrid& grid) {
+    for (uint32_t bucket = 0; bucket < MATCH_ENTITY_GRID_WIDTH * MATCH_ENTITY_GRID_WIDTH; bucket++) {
+        grid.bucket_head[bucket] = ID_NULL;
+    }
+    for (uint32_t entity_id = 0; entity_id < ID_MAX; entity_id++) {
+        grid.next[entity_id] = ID_NULL;
+        grid.prev[entity_id] = ID_NULL;
+        grid.bucket[entity_id] = MATCH_ENTITY_GRID_BUCKET_NONE;
+    }
+}
+
+static void match_entity_grid_insert(MatchEntityGrid& grid, EntityId entity_id, ivec2 cell) {
+    GOLD_ASSERT(grid.bucket[entity_id] == MATCH_ENTITY_GRID_BUCKET_NONE);
+
+    uint16_t bucket = match_entity_grid_get_bucket(cell);
+    EntityId head_id = grid.bucket_head[bucket];
+    grid.bucket[entity_id] = bucket;
+    grid.prev[entity_id] = ID_NULL;
+    grid.next[entity_id] = head_id;
+    if (head_id != ID_NULL) {
+        grid.prev[head_id] = entity_id;
+    }
+    grid.bucket_head[bucket] = entity_id;
+}
+
+static void match_entity_grid_remove(MatchEntityGrid& grid, EntityId entity_id) {
+    uint16_t bucket = grid.bucket[entity_id];
+    GOLD_ASSERT(bucket != MATCH_ENTITY_GRID_BUCKET_NONE);
+
+    EntityId prev_id = grid.prev[entity_id];
+    EntityId next_id = grid.next[entity_id];
+    if (prev_id == ID_NULL) {
+        grid.bucket_head[bucket] = next_id;
+    } else {
+        grid.next[prev_id] = next_id;
+    }
+    if (next_id != ID_NULL) {
+        grid.prev[next_id] = prev_id;
+    }
+
+    grid.next[entity_id] = ID_NULL;
+    grid.prev[entity_id] = ID_NULL;
+    grid.bucket[entity_id] = MATCH_ENTITY_GRID_BUCKET_NONE;
+}
+
+// Returns the field whose goal is closest to the given goal, as long as the given goal can be reached through it
+static MapFlowField* match_flow_field_find(MatchState& state, CellLayer layer, ivec2 goal) {
+    MatchFlowFieldCache& cache = state.flow_fields;
+    uint32_t best_index = INDEX_INVALID;
+    int best_distance = 0;
+    for (uint32_t index = 0; index < cache.count; index++) {
+        const MapFlowField& field = cache.fields[index];
+        if (field.layer != layer || map_flow_field_is_stale(state.map, field)) {
+            continue;
+        }
+
+        int goal_distance = ivec2::manhattan_distance(field.goal, goal);
+        if (goal_distance > MATCH_FLOW_FIELD_GOAL_SHARE_DISTANCE ||
+                (goal_distance != 0 && field.directions[goal.x + (goal.y * state.map.width)] == MAP_FLOW_FIELD_NO_DIRECTION)) {
+            continue;
+        }
+
+        if (best_index == INDEX_INVALID || goal_distance < best_distance) {
+            best_index = index;
+            best_distance = goal_distance;
+        }
+    }
+
+    if (best_index == INDEX_INVALID) {
+        return NULL;
+    }
+
+    cache.use_count++;
+    cache.last_used[best_index] = cache.use_count;
+    return &cache.fields[best_index];
+}
+
+static void match_flow_field_bake(MatchState& state, CellLayer layer, ivec2 goal) {
+    if (match_flow_field_find(state, layer, goal) != NULL) {
+        return;
+    }
+
+    // Stale fields are replaced first, otherwise the least recently used one is
+    MatchFlowFieldCache& cache = state.flow_fields;
+    uint32_t slot;
+    if (cache.count < MATCH_FLOW_FIELD_CACHE_SIZE) {
+        slot = cache.count;
+        cache.count++;
+    } else {
+        slot = 0;
+        for (uint32_t index = 0; index < cache.count; index++) {
+            if (map_flow_field_is_stale(state.map, cache.fields[index])) {
+                slot = index;
+                break;
+            }
+            if (cache.last_used[index] < cache.last_used[slot]) {
+                slot = index;
+            }
+        }
+    }
+
+    map_flow_field_bake(state.map, layer, goal, cache.fields[slot]);
+    cache.use_count++;
+    cache.last_used[slot] = cache.use_count;
+}
+
+void match_find_entity_indices_in_rect(const MatchState& state, Rect rect, EntityIndexList& entity_indices) {
+    entity_indices.clear();
+
+    // An entity can overlap the rect from up to MAX_CELL_SIZE - 1 cells above or to the left of it
+    int min_x = std::max(rect.x - (MATCH_ENTITY_GRID_MAX_CELL_SIZE - 1), 0);
+    int min_y = std::max(rect.y - (MATCH_ENTITY_GRID_MAX_CELL_SIZE - 1), 0);
+    int max_x = std::min(rect.x + rect.w - 1, MAP_SIZE_MAX - 1);
+    int max_y = std::min(rect.y + rect.h - 1, MAP_SIZE_MAX - 1);
+    if (max_x < min_x || max_y < min_y) {
+        return;
+    }
+
+    for (int bucket_y = min_y / MATCH_ENTITY_GRID_BUCKET_SIZE; bucket_y <= max_y / MATCH_ENTITY_GRID_BUCKET_SIZE; bucket_y++) {
+        for (int bucket_x = min_x / MATCH_ENTITY_GRID_BUCKET_SIZE; bucket_x <= max_x / MATCH_ENTITY_GRID_BUCKET_SIZE; bucket_x++) {
+            EntityId entity_id = state.entity_grid.bucket_head[bucket_x + (bucket_y * MATCH_ENTITY_GRID_WIDTH)];
+            while (entity_id != ID_NULL) {
+                entity_indices.push_back((uint16_t)state.entities.get_index_of(entity_id));
+                entity_id = state.entity_grid.next[entity_id];
+            }
+        }
+    }
+
+    // Bucket order depends on insertion history, so sort to keep the same order as a linear scan
+    std::sort(entity_indices.data, entity_indices.data + entity_indices.size());
+}
+
+EntityId match_find_nearest_entity(const MatchState& state, ivec2 cell, std::function<bool(const Entity& entity, EntityId entity_id)> filter) {
+    // Clamping the search origin is safe because entities are always in bounds, so it can only make them look closer
+    ivec2 center_bucket = ivec2(
+        std::clamp(cell.x, 0, MAP_SIZE_MAX - 1) / MATCH_ENTITY_GRID_BUCKET_SIZE,
+        std::clamp(cell.y, 0, MAP_SIZE_MAX - 1) / MATCH_ENTITY_GRID_BUCKET_SIZE);
+
+    uint32_t nearest_index = INDEX_INVALID;
+    int nearest_dist = -1;
+    for (int radius = 0; radius < MATCH_ENTITY_GRID_WIDTH; radius++) {
+        // Every entity in this ring of buckets is at least this far away from cell
+        // Ties are broken by the lowest index, so we have to keep going if an entity in this ring could still tie
+        int ring_min_dist = radius == 0 ? 0 : ((radius - 1) * MATCH_ENTITY_GRID_BUCKET_SIZE) + 1;
+        if (nearest_index != INDEX_INVALID && nearest_dist < ring_min_dist) {
+            break;
+        }
+
+        for (int bucket_y = center_bucket.y - radius; bucket_y <= center_bucket.y + radius; bucket_y++) {
+            if (bucket_y < 0 || bucket_y >= MATCH_ENTITY_GRID_WIDTH) {
+                continue;
+            }
+
+            // Only the edges of the ring, the inside was searched by the previous radii
+            bool is_ring_edge_row = bucket_y == center_bucket.y - radius || bucket_y == center_bucket.y + radius;
+            int bucket_x_step = is_ring_edge_row || radius == 0 ? 1 : 2 * radius;
+            for (int bucket_x = center_bucket.x - radius; bucket_x <= center_bucket.x + radius; bucket_x += bucket_x_step) {
+                if (bucket_x < 0 || bucket_x >= MATCH_ENTITY_GRID_WIDTH) {
+                    continue;
+                }
+
+                EntityId entity_id = state.entity_grid.bucket_head[bucket_x + (bucket_y * MATCH_ENTITY_GRID_WIDTH)];
+                while (entity_id != ID_NULL) {
+                    // Only run the filter on entities that would become the nearest, so that the rest are never pulled out of the entity array
+                    uint32_t entity_index = state.entities.get_index_of(entity_id);
+                    int entity_dist = ivec2::manhattan_distance(state.entities.get_hot(entity_index).cell, cell);
+                    if ((nearest_index == INDEX_INVALID || entity_dist < nearest_dist || 
+                            (entity_dist == nearest_dist && entity_index < nearest_index)) &&
+                            filter(state.entities[entity_index], entity_id)) {
+                        nearest_index = entity_index;
+                        nearest_dist = entity_dist;
+                    }
+                    entity_id = state.entity_grid.next[entity_id];
+                }
+            }
+        }
+    }
+
+    if (nearest_index == INDEX_INVALID) {
+        return ID_NULL;
+    }
+
+    return state.entities.get_id_of(nearest_index);
+}
+
 EntityId match_get_nearest_builder(const MatchState& state, const std::vector<EntityId>& builders, ivec2 cell) {
     EntityId nearest_unit_id; 
     int nearest_unit_dist = -1;
@@ -1046,7 +1297,9 @@ EntityId entity_create(MatchState& state, EntityType type, ivec2 cell, uint8_t p
         entity_set_flag(entity, ENTITY_FLAG_CHARGED, true);
     }
 
+    GOLD_ASSERT(entity_data.cell_size <= MATCH_ENTITY_GRID_MAX_CELL_SIZE);
     EntityId id = state.entities.push_back(entity);
+    match_entity_grid_insert(state.entity_grid, id, entity.cell);
     map_set_cell_rect(state.map, entity_data.cell_layer, entity.cell, entity_data.cell_size, (Cell) {
         .type = entity_is_unit(type) ? CELL_UNIT : CELL_BUILDING,
         .id = id
@@ -1054,7 +1307,7 @@ EntityId entity_create(MatchState& state, EntityType type, ivec2 cell, uint8_t p
     match_fog_update(state, state.players[entity.player_id].team, entity.cell, entity_data.cell_size, entity_data.sight, entity_has_detection(state, entity), entity_data.cell_layer, true);
 
     if (entity_is_building(type)) {
-        map_calculate_unreachable_cells(state.map);
+        map_update_unreachable_cells(state.map);
     }
 
     log_info("Created entity %s ID %u player %u cell <%i, %i>", entity_data.name, id, player_id, cell.x, cell.y);
@@ -1108,6 +1361,7 @@ EntityId entity_misc_create(MatchState& state, EntityType type, ivec2 cell, uint
     entity.bleed_animation = animation_create(ANIMATION_PARTICLE_BLEED);
 
     EntityId id = state.entities.push_back(entity);
+    match_entity_grid_insert(state.entity_grid, id, entity.cell);
     map_set_cell_rect(state.map, CELL_LAYER_GROUND, entity.cell, entity_get_data(entity.type).cell_size, (Cell) {
         .type = type == ENTITY_GOLDMINE 
             ? CELL_GOLDMINE
@@ -1118,6 +1372,40 @@ EntityId entity_misc_create(MatchState& state, EntityType type, ivec2 cell, uint
     return id;
 }
 
+EntityHot EntityHot::from(const Entity& entity) {
+    EntityHot hot;
+    hot.cell = entity.cell;
+    hot.health = entity.health;
+    hot.type = (uint8_t)entity.type;
+    hot.player_id = entity.player_id;
+    memset(hot.padding, 0, sizeof(hot.padding));
+
+    return hot;
+}
+
+void entity_set_cell(MatchState& state, EntityId entity_id, ivec2 cell) {
+    uint32_t entity_index = state.entities.get_index_of(entity_id);
+    Entity& entity = state.entities[entity_index];
+    entity.cell = cell;
+    state.entities.get_hot(entity_index).cell = cell;
+
+    uint16_t bucket = match_entity_grid_get_bucket(cell);
+    if (state.entity_grid.bucket[entity_id] != bucket) {
+        match_entity_grid_remove(state.entity_grid, entity_id);
+        match_entity_grid_insert(state.entity_grid, entity_id, cell);
+    }
+}
+
+void entity_set_health(MatchState& state, Entity& entity, int health) {
+    entity.health = health;
+
+    // Entities that are still being set up before entity_create() pushes them don't have a mirror yet
+    uint32_t entity_index = state.entities.get_index_of_item(entity);
+    if (entity_index != INDEX_INVALID) {
+        state.entities.get_hot(entity_index).health = health;
+    }
+}
+
 void entity_update(MatchState& state, uint32_t entity_index) {
     ZoneScoped;
 
@@ -1183,7 +1471,7 @@ void entity_update(MatchState& state, uint32_t entity_index) {
                         }
                     }
                 }
-                map_calculate_unreachable_cells(state.map);
+                map_update_unreachable_cells(state.map);
             }
         }
 
@@ -1446,13 +1734,12 @@ void entity_update(MatchState& state, uint32_t entity_index) {
                                 .id = ID_NULL
                             });
                         }
-                        match_fog_update(state, state.players[entity.player_id].team, entity.cell, entity_data.cell_size, entity_data.sight, entity_has_detection(state, entity), entity_data.cell_layer, false);
-                        entity.cell = entity_path->back();
+                        match_fog_move(state, state.players[entity.player_id].team, entity.cell, entity_path->back(), entity_data.cell_size, entity_data.sight, entity_has_detection(state, entity), entity_data.cell_layer);
+                        entity_set_cell(state, entity_id, entity_path->back());
                         map_set_cell_rect(state.map, entity_data.cell_layer, entity.cell, entity_data.cell_size, (Cell) {
                             .type = entity_is_mining(state, entity) ? CELL_MINER : CELL_UNIT,
                             .id = entity_id
                         });
-                        match_fog_update(state, state.players[entity.player_id].team, entity.cell, entity_data.cell_size, entity_data.sight, entity_has_detection(state, entity), entity_data.cell_layer, true);
                         entity_path->pop_back();
                         if (entity_path->empty()) {
                             state.entity_paths.release(entity.path_index);
@@ -1850,7 +2137,7 @@ void entity_update(MatchState& state, uint32_t entity_index) {
                     // Building tick
                     Entity& building = state.entities[building_index];
 
-                    building.health++;
+                    entity_set_health(state, building, building.health + 1);
                     building.timer--;
                     if (building.timer == 0) {
                         entity_building_finish(state, entity.target.id);
@@ -1886,7 +2173,7 @@ void entity_update(MatchState& state, uint32_t entity_index) {
 
                 entity.timer--;
                 if (entity.timer == 0) {
-                    target.health++;
+                    entity_set_health(state, target, target.health + 1);
                     if (entity.mode == MODE_UNIT_BUILD_ASSIST) {
                         target.timer--;
                     }
@@ -1960,7 +2247,7 @@ void entity_update(MatchState& state, uint32_t entity_index) {
                             entity.goldmine_id = ID_NULL;
                         }
                         match_fog_update(state, state.players[entity.player_id].team, entity.cell, entity_data.cell_size, entity_data.sight, entity_has_detection(state, entity), entity_data.cell_layer, false);
-                        entity.cell = exit_cell;
+                        entity_set_cell(state, entity_id, exit_cell);
                         ivec2 exit_from_cell = get_nearest_cell_in_rect(exit_cell, mine.cell, mine_data.cell_size);
                         entity.direction = enum_from_ivec2_direction(exit_cell - exit_from_cell);
                         entity.position = cell_center(exit_from_cell);
@@ -2194,7 +2481,7 @@ void entity_update(MatchState& state, uint32_t entity_index) {
                 entity.fire_damage_timer--;
             }
             if (entity.fire_damage_timer == 0) {
-                entity.health--;
+                entity_set_health(state, entity, entity.health - 1);
                 entity.fire_damage_timer = ENTITY_FIRE_DAMAGE_COOLDOWN;
                 entity_on_damage_taken(entity);
             } 
@@ -2225,7 +2512,7 @@ void entity_update(MatchState& state, uint32_t entity_index) {
     if (entity_is_unit(entity.type) && entity.health_regen_timer != 0) {
         entity.health_regen_timer--;
         if (entity.health_regen_timer == 0) {
-            entity.health++;
+            entity_set_health(state, entity, entity.health + 1);
             if (entity.health != entity_data.max_health) {
                 entity.health_regen_timer = UNIT_HEALTH_REGEN_DURATION;
             }
@@ -2253,7 +2540,7 @@ void entity_update(MatchState& state, uint32_t entity_index) {
                 entity.bleed_damage_timer--;
             }
             if (entity.bleed_damage_timer == 0) {
-                entity.health--;
+                entity_set_health(state, entity, entity.health - 1);
                 entity.bleed_damage_timer = BLEED_DAMAGE_RATE;
                 entity_on_damage_taken(entity);
             }
@@ -2701,7 +2988,19 @@ void entity_pathfind(MatchState& state, Entity& entity, ivec2 to, uint32_t optio
 
     entity.path_index = state.entity_paths.reserve();
     MapPath* entity_path = state.entity_paths.get(entity.path_index);
-    map_pathfind(state.map, entity_data.cell_layer, entity.cell, to, entity_data.cell_size, options, ignore_cells, entity_path);
+
+    // Sample a shared flow field if one was baked for this goal, but only for plain moves that are still far from the goal
+    MapFlowField* flow_field = NULL;
+    if (entity_data.cell_size == 1 && 
+            (ignore_cells == NULL || ignore_cells->empty()) &&
+            (options & (MAP_OPTION_IGNORE_MINERS | MAP_OPTION_AVOID_LANDMINES | MAP_OPTION_NO_REGION_PATH)) == 0 &&
+            map_is_cell_in_bounds(state.map, to) &&
+            ivec2::manhattan_distance(entity.cell, to) > MAP_FLOW_FIELD_HANDOFF_DISTANCE) {
+        flow_field = match_flow_field_find(state, entity_data.cell_layer, to);
+    }
+    if (flow_field == NULL || !map_flow_field_pathfind(state.map, *flow_field, entity.cell, to, options, entity_path)) {
+        map_pathfind(state.map, entity_data.cell_layer, entity.cell, to, entity_data.cell_size, options, ignore_cells, entity_path);
+    }
 
     if (entity_path->empty()) {
         entity_path_clear(state, entity);
@@ -3012,11 +3311,8 @@ ivec2 entity_get_target_cell(const MatchState& state, const Entity& entity) {
 }
 
 Target entity_target_nearest_goldmine(const MatchState& state, const Entity& entity) {
-    EntityId goldmine_id = match_find_best_entity(state, (MatchFindBestEntityParams) {
-        .filter = [](const Entity& goldmine, EntityId /*entity_id*/) {
-            return goldmine.type == ENTITY_GOLDMINE && goldmine.gold_held != 0;
-        },
-        .compare = match_compare_closest_manhattan_distance_to(entity.cell)
+    EntityId goldmine_id = match_find_nearest_entity(state, entity.cell, [](const Entity& goldmine, EntityId /*entity_id*/) {
+        return goldmine.type == ENTITY_GOLDMINE && goldmine.gold_held != 0;
     });
     if (goldmine_id != ID_NULL) {
         return target_entity(goldmine_id);
@@ -3098,18 +3394,32 @@ Target entity_target_nearest_enemy(const MatchState& state, const Entity& entity
     int nearest_enemy_dist = -1;
     uint32_t nearest_attack_priority;
 
-    for (uint32_t other_index = 0; other_index < state.entities.size(); other_index++) {
-        const Entity& other = state.entities[other_index];
-        const EntityData& other_data = entity_get_data(other.type);
+    EntityIndexList nearby_entity_indices;
+    match_find_entity_indices_in_rect(state, entity_sight_rect, nearby_entity_indices);
+    for (uint32_t nearby_index = 0; nearby_index < nearby_entity_indices.size(); nearby_index++) {
+        uint32_t other_index = nearby_entity_indices[nearby_index];
+        const EntityHot& other_hot = state.entities.get_hot(other_index);
+        const EntityData& other_data = entity_get_data((EntityType)other_hot.type);
 
         // Goldmines are not enemies
-        if (entity_is_misc(other.type)) {
+        if (entity_is_misc((EntityType)other_hot.type)) {
             continue;
         }
         // Allies are not enemies
-        if (state.players[other.player_id].team == state.players[entity.player_id].team) {
+        if (state.players[other_hot.player_id].team == state.players[entity.player_id].team) {
             continue;
         } 
+        // Don't attack entities that this unit can't see
+        Rect other_rect = (Rect) { 
+            .x = other_hot.cell.x, .y = other_hot.cell.y, 
+            .w = other_data.cell_size, .h = other_data.cell_size
+        };
+        if (!entity_sight_rect.intersects(other_rect)) {
+            continue;
+        }
+
+        // Only the entities that made it through the filters above are read from the entity array
+        const Entity& other = state.entities[other_index];
         // Don't attack non-selectable entities
         if (!entity_is_selectable(other)) {
             continue;
@@ -3134,15 +3444,6 @@ Target entity_target_nearest_enemy(const MatchState& state, const Entity& entity
         if (entity.garrison_id != ID_NULL && !entity_is_target_in_range(state, entity, other, TARGET_ATTACK_ENTITY)) {
             continue;
         }
-        // Don't attack entities that this unit can't see
-        Rect other_rect = (Rect) { 
-            .x = other.cell.x, .y = other.cell.y, 
-            .w = other_data.cell_size, .h = other_data.cell_size
-        };
-        if (!entity_sight_rect.intersects(other_rect)) {
-            continue;
-        }
-
         int other_dist = Rect::euclidean_distance_squared_between(entity_rect, other_rect);
         uint32_t other_attack_priority = entity_get_target_attack_priority(entity, other); 
         if (nearest_enemy_index == INDEX_INVALID || other_attack_priority > nearest_attack_priority || (other_dist < nearest_enemy_dist && other_attack_priority == nearest_attack_priority)) {
@@ -3288,7 +3589,7 @@ void entity_attack_target(MatchState& state, EntityId attacker_id) {
     if (!attack_missed) {
         int attacker_damage = attack_with_bayonets ? SOLDIER_BAYONET_DAMAGE : attacker_data.unit_data.damage;
         int damage = std::max(1, attacker_damage - entity_get_armor(state, defender));
-        defender.health = std::max(0, defender.health - damage);
+        entity_set_health(state, defender, std::max(0, defender.health - damage));
         if (attacker.type == ENTITY_BANDIT && match_player_has_upgrade(state, attacker.player_id, UPGRADE_SERRATED_KNIVES) && entity_is_unit(defender.type)) {
             defender.bleed_timer = BLEED_DURATION;
         }
@@ -3314,7 +3615,7 @@ void entity_attack_target(MatchState& state, EntityId attacker_id) {
             Rect entity_rect = entity_get_rect(entity);
             if (entity_rect.intersects(splash_damage_rect)) {
                 int damage = std::max(1, splash_damage - entity_get_armor(state, entity));
-                entity.health = std::max(0, entity.health - damage);
+                entity_set_health(state, entity, std::max(0, entity.health - damage));
                 entity_on_attack(state, attacker_id, entity);
             }
         }
@@ -3370,7 +3671,7 @@ void entity_unload_unit(MatchState& state, Entity& carrier, EntityId garrisoned_
             }
 
             // Place the unit in the world
-            garrisoned_unit.cell = exit_cell;
+            entity_set_cell(state, carrier.garrisoned_units[index], exit_cell);
             garrisoned_unit.position = entity_get_target_position(garrisoned_unit);
             map_set_cell_rect(state.map, CELL_LAYER_GROUND, garrisoned_unit.cell, garrisoned_unit_data.cell_size, (Cell) {
                 .type = CELL_UNIT, .id = carrier.garrisoned_units[index]
@@ -3403,7 +3704,7 @@ void entity_release_garrisoned_units_on_death(MatchState& state, Entity& entity)
         for (int x = entity.cell.x; x < entity.cell.x + entity_data.cell_size; x++) {
             for (int y = entity.cell.y; y < entity.cell.y + entity_data.cell_size; y++) {
                 if (!map_is_cell_rect_occupied(state.map, CELL_LAYER_GROUND, ivec2(x, y), garrisoned_unit_data.cell_size)) {
-                    garrisoned_unit.cell = ivec2(x, y);
+                    entity_set_cell(state, garrisoned_unit_id, ivec2(x, y));
                     garrisoned_unit.position = entity_get_target_position(garrisoned_unit);
                     garrisoned_unit.garrison_id = ID_NULL;
                     garrisoned_unit.mode = MODE_UNIT_IDLE;
@@ -3452,13 +3753,13 @@ void entity_explode(MatchState& state, EntityId entity_id) {
 
         Rect defender_rect = entity_get_rect(defender);
         if (explosion_rect.intersects(defender_rect)) {
-            defender.health = std::max(defender.health - explosion_damage, 0);
+            entity_set_health(state, defender, std::max(defender.health - explosion_damage, 0));
             entity_on_attack(state, entity_id, defender);
         }
     }
 
     // Kill the entity
-    entity.health = 0;
+    entity_set_health(state, entity, 0);
     if (entity.type == ENTITY_SAPPER) {
         entity.target = target_none();
         entity.mode = MODE_UNIT_DEATH_FADE;
@@ -3545,7 +3846,7 @@ void entity_stop_building(MatchState& state, EntityId entity_id) {
         }
     }
 
-    entity.cell = exit_cell;
+    entity_set_cell(state, entity_id, exit_cell);
     entity.position = entity_get_target_position(entity);
     entity.target = target_none();
     entity.mode = MODE_UNIT_IDLE;
@@ -3855,12 +4156,47 @@ bool match_is_cell_rect_explored(const MatchState& state, uint8_t team, ivec2 ce
     return false;
 }
 
-void match_fog_update(MatchState& state, uint8_t team, ivec2 cell, int cell_size, int sight, bool has_detection, CellLayer cell_layer, bool increment) {
+/**
+ * Fog stencils
+ *
+ * The rays that match_fog_update() traces only depend on the sight and cell size of the unit, not on where the unit is,
+ * so each (sight, cell_size) pair is traced once against an empty, unbounded map and stored as a list of rays,
+ * each holding the cells it passes through relative to the unit's cell, already cut off at the sight radius.
+ * At runtime the only things left to check are map bounds and elevation, which are both per-map.
+ *
+ * Rays are stored in the same order and with the same overlaps as the original raytrace,
+ * so cells that are crossed by several rays are still counted several times.
+ */
+
+static const int FOG_STENCIL_SIGHT_MAX = 16;
+static const int FOG_STENCIL_CELL_SIZE_MAX = 4;
+// The widest area touched by a single-cell move, that is both the old and the new stencil
+static const int FOG_MOVE_WINDOW_SIZE_MAX = (2 * FOG_STENCIL_SIGHT_MAX) + FOG_STENCIL_CELL_SIZE_MAX + 1;
+
+struct FogStencilRay {
+    uint32_t cell_begin;
+    uint32_t cell_end;
+};
+
+struct FogStencil {
+    std::vector<FogStencilRay> rays;
+    std::vector<ivec2> cells;
+    // Bounding box of all cells, relative to the unit's cell
+    ivec2 min;
+    ivec2 max;
+};
+
+static FogStencil match_fog_stencil_create(int cell_size, int sight) {
     /*
     * This function does a raytrace from the cell center outwards to determine what this unit can see
     * Raytracing is done using Bresenham's Line Generation Algorithm (https://www.geeksforgeeks.org/bresenhams-line-generation-algorithm/)
     */
 
+    FogStencil stencil;
+    stencil.min = ivec2(0, 0);
+    stencil.max = ivec2(0, 0);
+
+    const ivec2 cell = ivec2(0, 0);
     ivec2 search_corners[4] = {
         cell - ivec2(sight, sight),
         cell + ivec2((cell_size - 1) + sight, -sight),
@@ -3921,62 +4257,19 @@ void match_fog_update(MatchState& state, uint8_t team, ivec2 cell, int cell_size
                 line_step = ivec2(0, 1) * (line_end.y >= line_start.y ? 1 : -1);
                 line_opposite_step = ivec2(1, 0) * (line_end.x >= line_start.x ? 1 : -1);
             }
+
+            FogStencilRay ray;
+            ray.cell_begin = (uint32_t)stencil.cells.size();
             for (ivec2 line_cell = line_start; line_cell != line_end; line_cell += line_step) {
-                if (!map_is_cell_in_bounds(state.map, line_cell) || ivec2::euclidean_distance_squared(line_start, line_cell) > sight * sight) {
+                if (ivec2::euclidean_distance_squared(line_start, line_cell) > sight * sight) {
                     break;
                 }
 
-                if (increment) {
-                    if (state.fog[team][line_cell.x + (line_cell.y * state.map.width)] == FOG_HIDDEN) {
-                        state.fog[team][line_cell.x + (line_cell.y * state.map.width)] = 1;
-                    } else {
-                        state.fog[team][line_cell.x + (line_cell.y * state.map.width)]++;
-                    }
-                    if (has_detection) {
-                        state.detection[team][line_cell.x + (line_cell.y * state.map.width)]++;
-                    }
-                } else {
-                    state.fog[team][line_cell.x + (line_cell.y * state.map.width)]--;
-                    if (has_detection) {
-                        state.detection[team][line_cell.x + (line_cell.y * state.map.width)]--;
-                    }
-
-                    // Remember revealed entities
-                    Cell map_cell = map_get_cell(state.map, CELL_LAYER_GROUND, line_cell);
-                    // landmines are not shown in remembered entities so don't add them to this list, maybe
-                    if (map_cell.type == CELL_BUILDING || map_cell.type == CELL_GOLDMINE) {
-                        Entity& entity = state.entities.get_by_id(map_cell.id);
-                        if (entity_is_selectable(entity) && entity.type != ENTITY_LANDMINE) {
-                            ivec2 frame = entity_get_animation_frame(entity);
-
-                            // When remembering goldmines, remember them as empty, not full
-                            if (entity.type == ENTITY_GOLDMINE && frame.x == 1) {
-                                frame.x = 0;
-                            }
-
-                            RememberedEntity remembered_entity = (RememberedEntity) {
-                                .entity_id = map_cell.id,
-                                .recolor_id = entity.mode == MODE_BUILDING_DESTROYED || entity_is_misc(entity.type)
-                                    ? (uint16_t)0U 
-                                    : (uint16_t)state.players[entity.player_id].recolor_id,
-                                .type = entity.type,
-                                .frame = frame,
-                                .cell = entity.cell
-                            };
-
-                            uint32_t remembered_entity_index = match_team_find_remembered_entity_index(state, team, map_cell.id);
-                            if (remembered_entity_index == MATCH_ENTITY_NOT_REMEMBERED) {
-                                state.remembered_entities[team].push_back(remembered_entity);
-                            } else {
-                                state.remembered_entities[team][remembered_entity_index] = remembered_entity;
-                            }
-                        }
-                    } // End if cell value < cell empty
-                } // End if !increment
-
-                if (map_get_tile(state.map, line_cell).elevation > map_get_tile(state.map, line_start).elevation && cell_layer != CELL_LAYER_SKY) {
-                    break;
-                }
+                stencil.cells.push_back(line_cell);
+                stencil.min.x = std::min(stencil.min.x, line_cell.x);
+                stencil.min.y = std::min(stencil.min.y, line_cell.y);
+                stencil.max.x = std::max(stencil.max.x, line_cell.x);
+                stencil.max.y = std::max(stencil.max.y, line_cell.y);
 
                 slope_error += slope;
                 if (slope_error >= 0) {
@@ -3984,8 +4277,255 @@ void match_fog_update(MatchState& state, uint8_t team, ivec2 cell, int cell_size
                     slope_error -= 2 * std::abs((use_x_step ? (line_end.x - line_start.x) : (line_end.y - line_start.y)));
                 }
             } // End for each line cell in line
+            ray.cell_end = (uint32_t)stencil.cells.size();
+
+            if (ray.cell_end != ray.cell_begin) {
+                stencil.rays.push_back(ray);
+            }
         } // End for each line end from corner to corner
     } // End for each search index
+
+    return stencil;
+}
+
+struct FogStencilTable {
+    FogStencil stencils[FOG_STENCIL_CELL_SIZE_MAX][FOG_STENCIL_SIGHT_MAX + 1];
+};
+
+static FogStencilTable* match_fog_stencil_table_create() {
+    FogStencilTable* table = new FogStencilTable();
+    for (int cell_size = 1; cell_size <= FOG_STENCIL_CELL_SIZE_MAX; cell_size++) {
+        for (int sight = 0; sight <= FOG_STENCIL_SIGHT_MAX; sight++) {
+            table->stencils[cell_size - 1][sight] = match_fog_stencil_create(cell_size, sight);
+        }
+    }
+    return table;
+}
+
+// Returns NULL if the stencil is not in the table, in which case the caller needs to create its own
+static const FogStencil* match_fog_get_stencil(int cell_size, int sight) {
+    // Function-local statics are initialized exactly once even if the sim is running on multiple threads
+    static const FogStencilTable* table = match_fog_stencil_table_create();
+
+    if (cell_size < 1 || cell_size > FOG_STENCIL_CELL_SIZE_MAX || sight < 0 || sight > FOG_STENCIL_SIGHT_MAX) {
+        return NULL;
+    }
+    return &table->stencils[cell_size - 1][sight];
+}
+
+/**
+ * Calls visit(line_cell, line_cell_index) for each map cell that the stencil placed at cell can see, in ray order.
+ * A ray stops when it leaves the map or after it hits a tile that is higher than the tile it started on.
+ */
+template <typename F>
+static void match_fog_stencil_for_each(const MatchState& state, const FogStencil& stencil, ivec2 cell, CellLayer cell_layer, F visit) {
+    // If the whole stencil is on the map, then the rays can skip their bounds checks
+    bool is_stencil_in_bounds = map_is_cell_in_bounds(state.map, cell + stencil.min) && 
+                                    map_is_cell_in_bounds(state.map, cell + stencil.max);
+    bool is_elevation_ignored = cell_layer == CELL_LAYER_SKY;
+    const ivec2* stencil_cells = stencil.cells.data();
+
+    for (const FogStencilRay& ray : stencil.rays) {
+        // The first cell of each ray is its line start
+        ivec2 line_start = cell + stencil_cells[ray.cell_begin];
+        if (!is_stencil_in_bounds && !map_is_cell_in_bounds(state.map, line_start)) {
+            continue;
+        }
+        uint8_t line_start_elevation = state.map.tiles[line_start.x + (line_start.y * state.map.width)].elevation;
+
+        for (uint32_t stencil_cell_index = ray.cell_begin; stencil_cell_index < ray.cell_end; stencil_cell_index++) {
+            ivec2 line_cell = cell + stencil_cells[stencil_cell_index];
+            if (!is_stencil_in_bounds && !map_is_cell_in_bounds(state.map, line_cell)) {
+                break;
+            }
+
+            int line_cell_index = line_cell.x + (line_cell.y * state.map.width);
+            visit(line_cell, line_cell_index);
+
+            if (!is_elevation_ignored && state.map.tiles[line_cell_index].elevation > line_start_elevation) {
+                break;
+            }
+        }
+    }
+}
+
+static void match_team_remember_entity_at_cell(MatchState& state, uint8_t team, int cell_index) {
+    Cell map_cell = state.map.cells[CELL_LAYER_GROUND][cell_index];
+    // landmines are not shown in remembered entities so don't add them to this list, maybe
+    if (map_cell.type != CELL_BUILDING && map_cell.type != CELL_GOLDMINE) {
+        return;
+    }
+
+    Entity& entity = state.entities.get_by_id(map_cell.id);
+    if (!entity_is_selectable(entity) || entity.type == ENTITY_LANDMINE) {
+        return;
+    }
+
+    ivec2 frame = entity_get_animation_frame(entity);
+
+    // When remembering goldmines, remember them as empty, not full
+    if (entity.type == ENTITY_GOLDMINE && frame.x == 1) {
+        frame.x = 0;
+    }
+
+    RememberedEntity remembered_entity = (RememberedEntity) {
+        .entity_id = map_cell.id,
+        .recolor_id = entity.mode == MODE_BUILDING_DESTROYED || entity_is_misc(entity.type)
+            ? (uint16_t)0U 
+            : (uint16_t)state.players[entity.player_id].recolor_id,
+        .type = entity.type,
+        .frame = frame,
+        .cell = entity.cell
+    };
+
+    uint32_t remembered_entity_index = match_team_find_remembered_entity_index(state, team, map_cell.id);
+    if (remembered_entity_index == MATCH_ENTITY_NOT_REMEMBERED) {
+        state.remembered_entities[team].push_back(remembered_entity);
+    } else {
+        state.remembered_entities[team][remembered_entity_index] = remembered_entity;
+    }
+}
+
+void match_fog_mark_all_pages_dirty(MatchState& state) {
+    memset(state.fog_dirty_pages, 0xFF, sizeof(state.fog_dirty_pages));
+}
+
+static void match_fog_mark_pages_dirty(MatchState& state, const int* begin, const int* end) {
+    size_t begin_offset = (size_t)((const uint8_t*)begin - (const uint8_t*)state.fog);
+    size_t end_offset = (size_t)((const uint8_t*)end - (const uint8_t*)state.fog);
+    for (size_t page = begin_offset / MATCH_FOG_PAGE_SIZE; page <= (end_offset - 1) / MATCH_FOG_PAGE_SIZE; page++) {
+        state.fog_dirty_pages[page / 64U] |= 1ULL << (page % 64U);
+    }
+}
+
+// Marks every row between row_min and row_max as dirty, since rays can touch any cell in those rows
+static void match_fog_mark_rows_dirty(MatchState& state, uint8_t team, int row_min, int row_max, bool has_detection) {
+    row_min = std::max(row_min, 0);
+    row_max = std::min(row_max, state.map.height - 1);
+    if (row_min > row_max) {
+        return;
+    }
+
+    int begin_index = row_min * state.map.width;
+    int end_index = (row_max + 1) * state.map.width;
+    match_fog_mark_pages_dirty(state, state.fog[team] + begin_index, state.fog[team] + end_index);
+    if (has_detection) {
+        match_fog_mark_pages_dirty(state, state.detection[team] + begin_index, state.detection[team] + end_index);
+    }
+}
+
+void match_fog_update(MatchState& state, uint8_t team, ivec2 cell, int cell_size, int sight, bool has_detection, CellLayer cell_layer, bool increment) {
+    const FogStencil* stencil = match_fog_get_stencil(cell_size, sight);
+    FogStencil uncached_stencil;
+    if (stencil == NULL) {
+        uncached_stencil = match_fog_stencil_create(cell_size, sight);
+        stencil = &uncached_stencil;
+    }
+
+    match_fog_mark_rows_dirty(state, team, cell.y + stencil->min.y, cell.y + stencil->max.y, has_detection);
+
+    int* fog = state.fog[team];
+    int* detection = state.detection[team];
+    if (increment) {
+        match_fog_stencil_for_each(state, *stencil, cell, cell_layer, [&](ivec2 /*line_cell*/, int line_cell_index) {
+            if (fog[line_cell_index] == FOG_HIDDEN) {
+                fog[line_cell_index] = 1;
+            } else {
+                fog[line_cell_index]++;
+            }
+            if (has_detection) {
+                detection[line_cell_index]++;
+            }
+        });
+    } else {
+        match_fog_stencil_for_each(state, *stencil, cell, cell_layer, [&](ivec2 /*line_cell*/, int line_cell_index) {
+            fog[line_cell_index]--;
+            if (has_detection) {
+                detection[line_cell_index]--;
+            }
+
+            // Remember revealed entities
+            match_team_remember_entity_at_cell(state, team, line_cell_index);
+        });
+    }
+}
+
+void match_fog_move(MatchState& state, uint8_t team, ivec2 from_cell, ivec2 to_cell, int cell_size, int sight, bool has_detection, CellLayer cell_layer) {
+    const FogStencil* stencil = match_fog_get_stencil(cell_size, sight);
+    if (stencil == NULL || std::abs(from_cell.x - to_cell.x) > 1 || std::abs(from_cell.y - to_cell.y) > 1) {
+        match_fog_update(state, team, from_cell, cell_size, sight, has_detection, cell_layer, false);
+        match_fog_update(state, team, to_cell, cell_size, sight, has_detection, cell_layer, true);
+        return;
+    }
+
+    /*
+    * Most cells that the unit could see from its old cell are still visible from its new one,
+    * so instead of decrementing the whole old stencil and then incrementing the whole new one,
+    * count how many times each cell is hit by each stencil in a small window around the unit
+    * and only write the fog / detection of cells whose value actually changes.
+    */
+
+    ivec2 window_min = ivec2(std::min(from_cell.x, to_cell.x), std::min(from_cell.y, to_cell.y)) + stencil->min;
+    ivec2 window_max = ivec2(std::max(from_cell.x, to_cell.x), std::max(from_cell.y, to_cell.y)) + stencil->max;
+    window_min.x = std::max(window_min.x, 0);
+    window_min.y = std::max(window_min.y, 0);
+    window_max.x = std::min(window_max.x, state.map.width - 1);
+    window_max.y = std::min(window_max.y, state.map.height - 1);
+    int window_width = window_max.x - window_min.x + 1;
+    int window_height = window_max.y - window_min.y + 1;
+    GOLD_ASSERT(window_width <= FOG_MOVE_WINDOW_SIZE_MAX && window_height <= FOG_MOVE_WINDOW_SIZE_MAX);
+
+    uint8_t decrement_count[FOG_MOVE_WINDOW_SIZE_MAX * FOG_MOVE_WINDOW_SIZE_MAX];
+    uint8_t increment_count[FOG_MOVE_WINDOW_SIZE_MAX * FOG_MOVE_WINDOW_SIZE_MAX];
+    memset(decrement_count, 0, window_width * window_height);
+    memset(increment_count, 0, window_width * window_height);
+
+    match_fog_stencil_for_each(state, *stencil, from_cell, cell_layer, [&](ivec2 line_cell, int line_cell_index) {
+        int window_index = (line_cell.x - window_min.x) + ((line_cell.y - window_min.y) * window_width);
+
+        // Remembering the same entity twice in the same update has no effect, so it is only done on the first visit
+        if (decrement_count[window_index] == 0) {
+            match_team_remember_entity_at_cell(state, team, line_cell_index);
+        }
+        decrement_count[window_index]++;
+    });
+    match_fog_stencil_for_each(state, *stencil, to_cell, cell_layer, [&](ivec2 line_cell, int /*line_cell_index*/) {
+        int window_index = (line_cell.x - window_min.x) + ((line_cell.y - window_min.y) * window_width);
+        increment_count[window_index]++;
+    });
+
+    match_fog_mark_rows_dirty(state, team, window_min.y, window_max.y, has_detection);
+
+    int* fog = state.fog[team];
+    int* detection = state.detection[team];
+    for (int y = 0; y < window_height; y++) {
+        for (int x = 0; x < window_width; x++) {
+            int window_index = x + (y * window_width);
+            int decrement = decrement_count[window_index];
+            int increment = increment_count[window_index];
+            if (decrement == 0 && increment == 0) {
+                continue;
+            }
+
+            // Same result as decrementing and then incrementing one at a time.
+            // Fog values are not always in sync with the number of rays that see a cell, so the decrement
+            // can take a cell below FOG_EXPLORED, in which case an increment that lands on FOG_HIDDEN jumps to 1
+            int cell_index = (window_min.x + x) + ((window_min.y + y) * state.map.width);
+            int fog_value = fog[cell_index] - decrement;
+            int increments_until_hidden = FOG_HIDDEN - fog_value;
+            if (fog_value <= FOG_HIDDEN && increment > increments_until_hidden) {
+                fog_value = 1 + (increment - increments_until_hidden - 1);
+            } else {
+                fog_value += increment;
+            }
+            if (fog_value != fog[cell_index]) {
+                fog[cell_index] = fog_value;
+            }
+            if (has_detection && decrement != increment) {
+                detection[cell_index] += increment - decrement;
+            }
+        }
+    }
 }
 
 // FIRE
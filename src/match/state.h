@@ -59,7 +59,24 @@
 
 #define MATCH_EVENT_STATUS_MESSAGE_BUFFER_SIZE 63
 
+#define MATCH_ENTITY_GRID_BUCKET_SIZE 8
+#define MATCH_ENTITY_GRID_WIDTH (MAP_SIZE_MAX / MATCH_ENTITY_GRID_BUCKET_SIZE)
+// The largest entity cell_size. Entities are bucketed by their top-left cell, so rect queries are widened by this much
+#define MATCH_ENTITY_GRID_MAX_CELL_SIZE 4
+
+// Fog and detection are tracked in pages so that the desync checksum only has to re-hash the pages that were written to
+#define MATCH_FOG_PAGE_SIZE 4096U
+#define MATCH_FOG_PAGE_COUNT (((2U * MAX_PLAYERS * MAP_SIZE_MAX * MAP_SIZE_MAX * sizeof(int)) + MATCH_FOG_PAGE_SIZE - 1) / MATCH_FOG_PAGE_SIZE)
+
+// Group moves share a flow field instead of running an A* per unit
+#define MATCH_FLOW_FIELD_CACHE_SIZE 4U
+// A move order needs at least this many units pathing on a layer before a flow field is baked for it
+#define MATCH_FLOW_FIELD_GROUP_SIZE_MIN 4U
+// Units that were given group move cells may sample a field whose goal is this close to their own target
+#define MATCH_FLOW_FIELD_GOAL_SHARE_DISTANCE 6
+
 using EntityList = FixedVector<EntityId, MATCH_MAX_POPULATION>;
+using EntityIndexList = FixedVector<uint16_t, MATCH_MAX_ENTITIES>;
 
 const int FOG_HIDDEN = -1;
 const int FOG_EXPLORED = 0;
@@ -214,6 +231,18 @@ struct Entity {
     Animation bleed_animation;
 };
 
+// Mirrors the fields of Entity that per-frame scans filter on, see IdArray
+// Type and player ID never change after an entity is created, cell is written by entity_set_cell() and health by entity_set_health()
+struct EntityHot {
+    ivec2 cell;
+    int health;
+    uint8_t type;
+    uint8_t player_id;
+    uint8_t padding[2];
+
+    static EntityHot from(const Entity& entity);
+};
+
 // Match Player
 
 struct MatchPlayer {
@@ -374,16 +403,37 @@ struct MatchInitMapParams {
     };
 };
 
+// Buckets entities by the cell they are in so that neighborhood queries only touch nearby entities
+// Each bucket is an intrusive doubly linked list of entity IDs
+struct MatchEntityGrid {
+    EntityId bucket_head[MATCH_ENTITY_GRID_WIDTH * MATCH_ENTITY_GRID_WIDTH];
+    EntityId next[ID_MAX];
+    EntityId prev[ID_MAX];
+    uint16_t bucket[ID_MAX];
+};
+
+// Least recently used flow fields are evicted first
+struct MatchFlowFieldCache {
+    uint32_t count;
+    uint32_t use_count;
+    uint32_t last_used[MATCH_FLOW_FIELD_CACHE_SIZE];
+    MapFlowField fields[MATCH_FLOW_FIELD_CACHE_SIZE];
+};
+
 struct MatchState {
     int lcg_seed;
     Map map;
     int fog[MAX_PLAYERS][MAP_SIZE_MAX * MAP_SIZE_MAX];
     int detection[MAX_PLAYERS][MAP_SIZE_MAX * MAP_SIZE_MAX];
+    // One bit per MATCH_FOG_PAGE_SIZE bytes of fog and detection, set when a page is written and cleared by the checksum
+    uint64_t fog_dirty_pages[(MATCH_FOG_PAGE_COUNT + 63U) / 64U];
     FixedVector<RememberedEntity, MATCH_MAX_REMEMBERED_ENTITIES> remembered_entities[MAX_PLAYERS];
 
-    IdArray<Entity, MATCH_MAX_ENTITIES> entities;
+    IdArray<Entity, MATCH_MAX_ENTITIES, EntityHot> entities;
+    MatchEntityGrid entity_grid;
     Pool<MapPath, MATCH_MAX_UNITS> entity_paths;
     Pool<TargetQueue, MATCH_MAX_UNITS> entity_target_queues;
+    MatchFlowFieldCache flow_fields;
 
     CircularVector<Particle, MATCH_MAX_PARTICLES> particles;
     CircularVector<Projectile, MATCH_MAX_PROJECTILES> projectiles;
@@ -415,6 +465,10 @@ EntityId match_find_entity(const MatchState& state, std::function<bool(const Ent
 EntityId match_find_best_entity(const MatchState& state, const MatchFindBestEntityParams& params);
 std::function<bool(const Entity& a, const Entity& b)> match_compare_closest_manhattan_distance_to(ivec2 cell);
 EntityList match_find_entities(const MatchState& state, std::function<bool(const Entity& entity, EntityId entity_id)> filter);
+// Returns the index of every entity whose cell rect might intersect rect, in ascending index order
+void match_find_entity_indices_in_rect(const MatchState& state, Rect rect, EntityIndexList& entity_indices);
+// Same result as match_find_best_entity() with match_compare_closest_manhattan_distance_to(cell), but only searches the grid buckets near cell
+EntityId match_find_nearest_entity(const MatchState& state, ivec2 cell, std::function<bool(const Entity& entity, EntityId entity_id)> filter);
 EntityId match_get_nearest_builder(const MatchState& state, const std::vector<EntityId>& builders, ivec2 cell);
 
 bool match_is_target_invalid(const MatchState& state, const Target& target, uint8_t player_id);
@@ -428,6 +482,9 @@ bool match_team_remembers_entity(const MatchState& state, uint8_t team, EntityId
 
 EntityId entity_create(MatchState& state, EntityType type, ivec2 cell, uint8_t player_id);
 EntityId entity_misc_create(MatchState& state, EntityType type, ivec2 cell, uint32_t gold_left);
+// Entity cells must only be changed through here so that the entity grid stays up to date
+void entity_set_cell(MatchState& state, EntityId entity_id, ivec2 cell);
+void entity_set_health(MatchState& state, Entity& entity, int health);
 void entity_update(MatchState& state, uint32_t entity_index);
 
 SpriteName entity_get_sprite(const MatchState& state, const Entity& entity);
@@ -525,6 +582,9 @@ int match_get_fog(const MatchState& state, uint8_t team, ivec2 cell);
 bool match_is_cell_rect_revealed(const MatchState& state, uint8_t team, ivec2 cell, int cell_size);
 bool match_is_cell_rect_explored(const MatchState& state, uint8_t team, ivec2 cell, int cell_size);
 void match_fog_update(MatchState& state, uint8_t team, ivec2 cell, int cell_size, int sight, bool has_detection, CellLayer cell_layer, bool increment);
+void match_fog_mark_all_pages_dirty(MatchState& state);
+// Same as decrementing the fog at from_cell and then incrementing it at to_cell, but only writes the cells whose visibility changed
+void match_fog_move(MatchState& state, uint8_t team, ivec2 from_cell, ivec2 to_cell, int cell_size, int sight, bool has_detection, CellLayer cell_layer);
 
 // Fire
 
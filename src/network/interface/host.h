@@ -58,6 +58,8 @@ public:
 
     virtual void send(uint16_t peer_id, void* data, size_t length) = 0;
     virtual void broadcast(void* data, size_t length) = 0;
+    // Unreliable messages can be lost, duplicated or arrive out of order
+    virtual void broadcast_unreliable(void* data, size_t length) = 0;
     virtual void flush() = 0;
     virtual void service() = 0;
 
@@ -3,6 +3,12 @@
 #include "core/logger.h"
 #include "network/network.h"
 
+// Reliable messages share a channel, so that they arrive in the order that they were sent.
+// Unreliable messages get a channel of their own, so that they are never held up behind a reliable message that is being resent.
+static const enet_uint8 LAN_CHANNEL_RELIABLE = 0;
+static const enet_uint8 LAN_CHANNEL_UNRELIABLE = 1;
+static const size_t LAN_CHANNEL_COUNT = 2;
+
 NetworkHostLan::NetworkHostLan() {
     memset(host_lobby_name, 0, sizeof(host_lobby_name));
 
@@ -12,7 +18,7 @@ NetworkHostLan::NetworkHostLan() {
 
     host = NULL;
     while (host == NULL && address.port < NETWORK_BASE_PORT + MAX_PLAYERS) {
-        host = enet_host_create(&address, MAX_PLAYERS - 0, 1, 0, 0);
+        host = enet_host_create(&address, MAX_PLAYERS - 0, LAN_CHANNEL_COUNT, 0, 0);
         log_info("Created host with port %u", address.port);
         if (host == NULL) {
             address.port++;
@@ -104,7 +110,7 @@ bool NetworkHostLan::connect(const NetworkConnectionInfo& connection_info) {
     host_address.port = connection_info.lan.port;
     enet_address_set_host_ip(&host_address, connection_info.lan.ip);
 
-    ENetPeer* host_peer = enet_host_connect(host, &host_address, 1, 0);
+    ENetPeer* host_peer = enet_host_connect(host, &host_address, LAN_CHANNEL_COUNT, 0);
     if (host_peer == NULL) {
         log_error("Failed to connect to LAN host.");
         return false;
@@ -154,12 +160,17 @@ void NetworkHostLan::disconnect_peers() {
 
 void NetworkHostLan::send(uint16_t peer_id, void* data, size_t length) {
     ENetPacket* packet = enet_packet_create(data, length, ENET_PACKET_FLAG_RELIABLE);
-    enet_peer_send(&host->peers[peer_id], 0, packet);
+    enet_peer_send(&host->peers[peer_id], LAN_CHANNEL_RELIABLE, packet);
 }
 
 void NetworkHostLan::broadcast(void* data, size_t length) {
     ENetPacket* packet = enet_packet_create(data, length, ENET_PACKET_FLAG_RELIABLE);
-    enet_host_broadcast(host, 0, packet);
+    enet_host_broadcast(host, LAN_CHANNEL_RELIABLE, packet);
+}
+
+void NetworkHostLan::broadcast_unreliable(void* data, size_t length) {
+    ENetPacket* packet = enet_packet_create(data, length, 0);
+    enet_host_broadcast(host, LAN_CHANNEL_UNRELIABLE, packet);
 }
 
 void NetworkHostLan::flush() {
@@ -196,8 +207,9 @@ void NetworkHostLan::service() {
     }
 
     // Service host
+    // Each input turn arrives twice, once on each channel, so drain every event instead of one per service
     ENetEvent enet_event;
-    if (enet_host_service(host, &enet_event, 0) > 0) {
+    while (enet_host_service(host, &enet_event, 0) > 0) {
         switch (enet_event.type) {
             case ENET_EVENT_TYPE_CONNECT: {
                 host_events.push((NetworkHostEvent) {
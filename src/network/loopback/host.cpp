@@ -0,0 +1,290 @@
+#include "host.h"
+
+#include "core/logger.h"
+#include "core/asserts.h"
+#include "match/lcg.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+static const uint64_t LOOPBACK_US_PER_MS = 1000U;
+static const uint64_t LOOPBACK_US_PER_SECOND = 1000000U;
+// Resends wait for about a round trip, which is roughly where ENet and Steam end up once they have measured the link
+static const uint64_t LOOPBACK_RETRANSMIT_TIMEOUT_MIN = 20U * LOOPBACK_US_PER_MS;
+
+// 30 random bits, since a single LCG roll only has 15
+static uint32_t network_loopback_rand(NetworkLoopback& loopback) {
+    uint32_t high = (uint32_t)lcg_rand(&loopback.lcg_seed);
+    uint32_t low = (uint32_t)lcg_rand(&loopback.lcg_seed);
+    return (high << 15) | low;
+}
+
+static bool network_loopback_roll_percent(NetworkLoopback& loopback, uint32_t percent) {
+    return percent != 0 && network_loopback_rand(loopback) % 100U < percent;
+}
+
+void network_loopback_init(NetworkLoopback& loopback, const NetworkLoopbackImpairment& impairment, int32_t lcg_seed) {
+    // Reliable packets are resent until they get through, so they would never arrive
+    GOLD_ASSERT(impairment.loss_percent < 100U);
+
+    loopback.impairment = impairment;
+    loopback.lcg_seed = lcg_seed;
+    loopback.time = 0;
+    loopback.send_index = 0;
+    loopback.hosts.clear();
+    memset(loopback.links, 0, sizeof(loopback.links));
+    for (uint16_t host_id = 0; host_id < MAX_PLAYERS; host_id++) {
+        loopback.in_flight[host_id] = std::priority_queue<NetworkLoopbackPacket, std::vector<NetworkLoopbackPacket>, NetworkLoopbackPacketCompare>();
+    }
+    memset(&loopback.stats, 0, sizeof(loopback.stats));
+}
+
+void network_loopback_free(NetworkLoopback& loopback) {
+    for (uint16_t host_id = 0; host_id < MAX_PLAYERS; host_id++) {
+        while (!loopback.in_flight[host_id].empty()) {
+            free(loopback.in_flight[host_id].top().data);
+            loopback.in_flight[host_id].pop();
+        }
+    }
+}
+
+void network_loopback_set_time(NetworkLoopback& loopback, uint64_t time) {
+    GOLD_ASSERT(time >= loopback.time);
+    loopback.time = time;
+}
+
+void network_loopback_send(NetworkLoopback& loopback, uint16_t sender_id, uint16_t receiver_id, const void* data, size_t length, bool is_reliable) {
+    const NetworkLoopbackImpairment& impairment = loopback.impairment;
+    NetworkLoopbackLink& link = loopback.links[sender_id][receiver_id];
+    loopback.stats.packets_sent++;
+    loopback.stats.bytes_sent += length;
+
+    // Packets queue up behind each other on a throttled link
+    uint64_t send_time = loopback.time;
+    if (impairment.bandwidth != 0) {
+        link.busy_until = std::max(link.busy_until, loopback.time) + (((uint64_t)length * LOOPBACK_US_PER_SECOND) / impairment.bandwidth);
+        send_time = link.busy_until;
+    }
+
+    uint64_t deliver_time = send_time + ((uint64_t)impairment.latency_ms * LOOPBACK_US_PER_MS);
+    if (impairment.jitter_ms != 0) {
+        deliver_time += network_loopback_rand(loopback) % (((uint64_t)impairment.jitter_ms * LOOPBACK_US_PER_MS) + 1U);
+    }
+
+    if (is_reliable) {
+        uint64_t retransmit_timeout = std::max(LOOPBACK_RETRANSMIT_TIMEOUT_MIN,
+                                                2U * (uint64_t)(impairment.latency_ms + impairment.jitter_ms) * LOOPBACK_US_PER_MS);
+        while (network_loopback_roll_percent(loopback, impairment.loss_percent)) {
+            deliver_time += retransmit_timeout;
+            loopback.stats.packets_resent++;
+        }
+
+        // A reliable packet holds up the reliable packets behind it until it gets through
+        deliver_time = std::max(deliver_time, link.reliable_deliver_time);
+        link.reliable_deliver_time = deliver_time;
+    } else {
+        if (network_loopback_roll_percent(loopback, impairment.loss_percent)) {
+            loopback.stats.packets_dropped++;
+            return;
+        }
+        if (network_loopback_roll_percent(loopback, impairment.reorder_percent)) {
+            deliver_time += (uint64_t)impairment.latency_ms * LOOPBACK_US_PER_MS;
+            loopback.stats.packets_reordered++;
+        }
+    }
+
+    uint64_t delay = deliver_time - loopback.time;
+    loopback.stats.total_delay += delay;
+    loopback.stats.max_delay = std::max(loopback.stats.max_delay, delay);
+
+    NetworkLoopbackPacket packet;
+    packet.deliver_time = deliver_time;
+    packet.send_index = loopback.send_index;
+    packet.sender_id = sender_id;
+    packet.data = (uint8_t*)malloc(length);
+    packet.length = length;
+    memcpy(packet.data, data, length);
+    loopback.in_flight[receiver_id].push(packet);
+    loopback.send_index++;
+}
+
+NetworkConnectionInfo network_loopback_get_connection_info(uint16_t host_id) {
+    NetworkConnectionInfo connection_info;
+    strncpy(connection_info.lan.ip, "127.0.0.1", NETWORK_IP_BUFFER_SIZE);
+    connection_info.lan.port = (uint16_t)(NETWORK_BASE_PORT + host_id);
+
+    return connection_info;
+}
+
+NetworkHostLoopback::NetworkHostLoopback(NetworkLoopback* loopback) {
+    memset(host_lobby_name, 0, sizeof(host_lobby_name));
+
+    GOLD_ASSERT(loopback->hosts.size() < MAX_PLAYERS);
+    host_loopback = loopback;
+    host_id = (uint16_t)loopback->hosts.size();
+    host_peer_count = 0;
+    loopback->hosts.push_back(this);
+
+    log_info("Created loopback host %u.", host_id);
+}
+
+NetworkHostLoopback::~NetworkHostLoopback() {
+    disconnect_peers();
+    host_loopback->hosts[host_id] = nullptr;
+
+    log_info("Destroyed loopback host %u.", host_id);
+}
+
+bool NetworkHostLoopback::is_initialized_successfully() const {
+    return true;
+}
+
+NetworkBackend NetworkHostLoopback::get_backend() const {
+    // Loopback hosts stand in for LAN hosts, since they use the same connection info
+    return NETWORK_BACKEND_LAN;
+}
+
+void NetworkHostLoopback::open_lobby(const char* lobby_name, NetworkLobbyPrivacy privacy) {
+    strncpy(host_lobby_name, lobby_name, NETWORK_LOBBY_NAME_BUFFER_SIZE);
+    host_events.push((NetworkHostEvent) {
+        .type = NETWORK_HOST_EVENT_LOBBY_CREATE_SUCCESS
+    });
+
+    log_info("Loopback host %u opened %s lobby.", host_id, privacy == NETWORK_LOBBY_PRIVACY_SINGLEPLAYER ? "singleplayer" : "multiplayer");
+}
+
+void NetworkHostLoopback::close_lobby() {
+}
+
+bool NetworkHostLoopback::connect(const NetworkConnectionInfo& connection_info) {
+    uint16_t peer_host_id = (uint16_t)(connection_info.lan.port - NETWORK_BASE_PORT);
+    if (peer_host_id >= host_loopback->hosts.size() || host_loopback->hosts[peer_host_id] == nullptr || peer_host_id == host_id) {
+        log_error("Failed to connect to loopback host %u.", peer_host_id);
+        return false;
+    }
+
+    // Connections are made right away rather than after a handshake
+    add_peer(peer_host_id);
+    host_loopback->hosts[peer_host_id]->add_peer(host_id);
+
+    return true;
+}
+
+uint16_t NetworkHostLoopback::get_peer_count() const {
+    return host_peer_count;
+}
+
+uint8_t NetworkHostLoopback::get_peer_player_id(uint16_t peer_id) const {
+    return host_peer_player_ids[peer_id];
+}
+
+void NetworkHostLoopback::set_peer_player_id(uint16_t peer_id, uint8_t player_id) {
+    host_peer_player_ids[peer_id] = player_id;
+}
+
+NetworkConnectionInfo NetworkHostLoopback::get_peer_connection_info(uint16_t peer_id) const {
+    return network_loopback_get_connection_info(host_peers[peer_id]);
+}
+
+void NetworkHostLoopback::disconnect_peers() {
+    for (uint16_t peer_id = 0; peer_id < host_peer_count; peer_id++) {
+        NetworkHostLoopback* peer_host = host_loopback->hosts[host_peers[peer_id]];
+        if (peer_host != nullptr) {
+            peer_host->remove_peer(host_id);
+        }
+    }
+    host_peer_count = 0;
+}
+
+void NetworkHostLoopback::send(uint16_t peer_id, void* data, size_t length) {
+    network_loopback_send(*host_loopback, host_id, host_peers[peer_id], data, length, true);
+}
+
+void NetworkHostLoopback::broadcast(void* data, size_t length) {
+    for (uint16_t peer_id = 0; peer_id < host_peer_count; peer_id++) {
+        network_loopback_send(*host_loopback, host_id, host_peers[peer_id], data, length, true);
+    }
+}
+
+void NetworkHostLoopback::broadcast_unreliable(void* data, size_t length) {
+    for (uint16_t peer_id = 0; peer_id < host_peer_count; peer_id++) {
+        network_loopback_send(*host_loopback, host_id, host_peers[peer_id], data, length, false);
+    }
+}
+
+void NetworkHostLoopback::flush() {
+    // Packets are put in flight as soon as they are sent
+}
+
+void NetworkHostLoopback::service() {
+    auto& in_flight = host_loopback->in_flight[host_id];
+    while (!in_flight.empty() && in_flight.top().deliver_time <= host_loopback->time) {
+        NetworkLoopbackPacket packet = in_flight.top();
+        in_flight.pop();
+
+        uint16_t peer_id;
+        for (peer_id = 0; peer_id < host_peer_count; peer_id++) {
+            if (host_peers[peer_id] == packet.sender_id) {
+                break;
+            }
+        }
+        if (peer_id == host_peer_count) {
+            log_warn("Loopback host %u received packet from host %u who is not in the peer list.", host_id, packet.sender_id);
+            free(packet.data);
+            continue;
+        }
+
+        host_loopback->stats.packets_delivered++;
+        host_events.push((NetworkHostEvent) {
+            .type = NETWORK_HOST_EVENT_RECEIVED,
+            .received = (NetworkHostEventReceived) {
+                .peer_id = peer_id,
+                .packet = (NetworkHostPacket) {
+                    .data = packet.data,
+                    .length = packet.length,
+                    ._impl = NULL
+                }
+            }
+        });
+    }
+}
+
+void NetworkHostLoopback::destroy_packet(NetworkHostPacket* packet) {
+    free(packet->data);
+}
+
+uint16_t NetworkHostLoopback::get_host_id() const {
+    return host_id;
+}
+
+void NetworkHostLoopback::add_peer(uint16_t peer_host_id) {
+    GOLD_ASSERT(host_peer_count < MAX_PLAYERS - 1);
+    host_peers[host_peer_count] = peer_host_id;
+    host_peer_player_ids[host_peer_count] = PLAYER_NONE;
+    host_events.push((NetworkHostEvent) {
+        .type = NETWORK_HOST_EVENT_CONNECTED,
+        .connected = (NetworkHostEventConnected) {
+            .peer_id = host_peer_count
+        }
+    });
+    host_peer_count++;
+}
+
+void NetworkHostLoopback::remove_peer(uint16_t peer_host_id) {
+    for (uint16_t peer_id = 0; peer_id < host_peer_count; peer_id++) {
+        if (host_peers[peer_id] != peer_host_id) {
+            continue;
+        }
+
+        host_events.push((NetworkHostEvent) {
+            .type = NETWORK_HOST_EVENT_DISCONNECTED,
+            .disconnected = (NetworkHostEventDisconnected) {
+                .player_id = host_peer_player_ids[peer_id]
+            }
+        });
+        host_peers[peer_id] = host_peers[host_peer_count - 1];
+        host_peer_player_ids[peer_id] = host_peer_player_ids[host_peer_count - 1];
+        host_peer_count--;
+        return;
+    }
+}
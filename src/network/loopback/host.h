@@ -0,0 +1,125 @@
+#pragma once
+
+#include "defines.h"
+#include "network/interface/host.h"
+#include <cstdint>
+#include <vector>
+#include <queue>
+
+/**
+ * An in-process network for connecting several hosts inside one process, with a simulated link between each pair of them.
+ *
+ * Packets are delayed, lost, reordered and throttled according to the impairment params, using an LCG seeded by the caller,
+ * and time only moves when the caller sets it, so a given seed and sequence of sends always produces the same deliveries.
+ * Reliable packets keep the guarantees of the real backends: they are never lost, only resent after a timeout,
+ * and they arrive in the order that they were sent. Unreliable packets can be lost or overtaken.
+ */
+
+struct NetworkLoopbackImpairment {
+    // One way
+    uint32_t latency_ms;
+    // Each packet is delayed by an extra 0 to jitter_ms
+    uint32_t jitter_ms;
+    // Out of 100. A lost reliable packet is resent after a retransmit timeout, while a lost unreliable packet is dropped
+    uint32_t loss_percent;
+    // Out of 100. A reordered unreliable packet is held back by another latency_ms, so that the packets behind it overtake it
+    uint32_t reorder_percent;
+    // Bytes per second in each direction of each link, or 0 for no limit
+    uint32_t bandwidth;
+};
+
+struct NetworkLoopbackPacket {
+    uint64_t deliver_time;
+    // Breaks ties between packets that are due at the same time, so that they are delivered in the order they were sent
+    uint32_t send_index;
+    uint16_t sender_id;
+    uint8_t* data;
+    size_t length;
+};
+
+struct NetworkLoopbackPacketCompare {
+    bool operator()(const NetworkLoopbackPacket& a, const NetworkLoopbackPacket& b) const {
+        return a.deliver_time != b.deliver_time
+                    ? a.deliver_time > b.deliver_time
+                    : a.send_index > b.send_index;
+    }
+};
+
+struct NetworkLoopbackLink {
+    // The time that the link finishes sending the packets that are already queued on it
+    uint64_t busy_until;
+    // Reliable packets cannot be delivered ahead of this
+    uint64_t reliable_deliver_time;
+};
+
+struct NetworkLoopbackStats {
+    uint32_t packets_sent;
+    uint32_t packets_delivered;
+    uint32_t packets_dropped;
+    uint32_t packets_resent;
+    uint32_t packets_reordered;
+    uint64_t bytes_sent;
+    uint64_t total_delay;
+    uint64_t max_delay;
+};
+
+class NetworkHostLoopback;
+
+// Times are in microseconds
+struct NetworkLoopback {
+    NetworkLoopbackImpairment impairment;
+    int32_t lcg_seed;
+    uint64_t time;
+    uint32_t send_index;
+    std::vector<NetworkHostLoopback*> hosts;
+    NetworkLoopbackLink links[MAX_PLAYERS][MAX_PLAYERS];
+    // Packets in flight, indexed by the id of the receiving host
+    std::priority_queue<NetworkLoopbackPacket, std::vector<NetworkLoopbackPacket>, NetworkLoopbackPacketCompare> in_flight[MAX_PLAYERS];
+    NetworkLoopbackStats stats;
+};
+
+void network_loopback_init(NetworkLoopback& loopback, const NetworkLoopbackImpairment& impairment, int32_t lcg_seed);
+// Frees the packets that are still in flight. The hosts should be destroyed first
+void network_loopback_free(NetworkLoopback& loopback);
+void network_loopback_set_time(NetworkLoopback& loopback, uint64_t time);
+void network_loopback_send(NetworkLoopback& loopback, uint16_t sender_id, uint16_t receiver_id, const void* data, size_t length, bool is_reliable);
+// Connection info for the host, for passing to another host's connect()
+NetworkConnectionInfo network_loopback_get_connection_info(uint16_t host_id);
+
+class NetworkHostLoopback : public INetworkHost {
+public:
+    NetworkHostLoopback(NetworkLoopback* loopback);
+    ~NetworkHostLoopback() override;
+
+    bool is_initialized_successfully() const override;
+    NetworkBackend get_backend() const override;
+
+    void open_lobby(const char* lobby_name, NetworkLobbyPrivacy privacy) override;
+    void close_lobby() override;
+    bool connect(const NetworkConnectionInfo& connection_info) override;
+
+    uint16_t get_peer_count() const override;
+    uint8_t get_peer_player_id(uint16_t peer_id) const override;
+    void set_peer_player_id(uint16_t peer_id, uint8_t player_id) override;
+    NetworkConnectionInfo get_peer_connection_info(uint16_t peer_id) const override;
+    void disconnect_peers() override;
+
+    void send(uint16_t peer_id, void* data, size_t length) override;
+    void broadcast(void* data, size_t length) override;
+    void broadcast_unreliable(void* data, size_t length) override;
+    void flush() override;
+    void service() override;
+
+    void destroy_packet(NetworkHostPacket* packet) override;
+
+    uint16_t get_host_id() const;
+private:
+    NetworkLoopback* host_loopback;
+    uint16_t host_id;
+    uint16_t host_peers[MAX_PLAYERS - 1];
+    uint8_t host_peer_player_ids[MAX_PLAYERS - 1];
+    uint16_t host_peer_count;
+
+    void add_peer(uint16_t peer_host_id);
+    void remove_peer(uint16_t peer_host_id);
+};
@@ -562,9 +562,19 @@ void network_send_input(uint8_t* out_buffer, size_t out_buffer_length) {
     state->host->flush();
 }
 
-void network_send_checksum(uint32_t checksum) {
+void network_send_input_unreliable(uint8_t* out_buffer, size_t out_buffer_length) {
+    out_buffer[0] = NETWORK_MESSAGE_INPUT;
+    state->host->broadcast_unreliable(out_buffer, out_buffer_length);
+    state->host->flush();
+}
+
+void network_send_checksum(uint32_t checksum, const uint32_t* section_checksums, uint32_t section_count) {
+    GOLD_ASSERT(section_count <= NETWORK_CHECKSUM_SECTION_MAX);
+
     NetworkMessageChecksum message;
     message.checksum = checksum;
+    memset(message.section_checksums, 0, sizeof(message.section_checksums));
+    memcpy(message.section_checksums, section_checksums, section_count * sizeof(uint32_t));
 
     state->host->broadcast(&message, sizeof(message));
     state->host->flush();
@@ -949,11 +959,15 @@ void network_handle_message(uint16_t incoming_peer_id, uint8_t* data, size_t len
                 return;
             }
 
+            if (length > NETWORK_INPUT_BUFFER_SIZE) {
+                log_warn("Dropped input message of length %u from peer %u, which is larger than the input buffer.", (uint32_t)length, incoming_peer_id);
+                return;
+            }
+
             NetworkEvent event;
             event.type = NETWORK_EVENT_INPUT;
             event.input.in_buffer_length = (uint32_t)length;
             event.input.player_id = state->host->get_peer_player_id(incoming_peer_id);
-            GOLD_ASSERT(length <= 1024);
             memcpy(event.input.in_buffer, data, length);
 
             state->events.push(event);
@@ -969,13 +983,12 @@ void network_handle_message(uint16_t incoming_peer_id, uint8_t* data, size_t len
 
             NetworkMessageChecksum* incoming_message = (NetworkMessageChecksum*)data;
 
-            state->events.push((NetworkEvent) {
-                .type = NETWORK_EVENT_CHECKSUM,
-                .checksum = (NetworkEventChecksum) {
-                    .player_id = player_id,
-                    .checksum = incoming_message->checksum
-                }
-            });
+            NetworkEvent event;
+            event.type = NETWORK_EVENT_CHECKSUM;
+            event.checksum.player_id = player_id;
+            event.checksum.checksum = incoming_message->checksum;
+            memcpy(event.checksum.section_checksums, incoming_message->section_checksums, sizeof(event.checksum.section_checksums));
+            state->events.push(event);
             break;
         }
         case NETWORK_MESSAGE_SERIALIZED_FRAME: {
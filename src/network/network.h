@@ -56,5 +56,6 @@ void network_remove_bot(uint8_t player_id);
 void network_begin_load_match_countdown();
 void network_begin_loading_match(int32_t lcg_seed, const Noise* noise);
 void network_send_input(uint8_t* out_buffer, size_t out_buffer_length);
-void network_send_checksum(uint32_t checksum);
+void network_send_input_unreliable(uint8_t* out_buffer, size_t out_buffer_length);
+void network_send_checksum(uint32_t checksum, const uint32_t* section_checksums, uint32_t section_count);
 void network_send_serialized_frame(uint8_t* state_buffer, size_t state_buffer_length);
\ No newline at end of file
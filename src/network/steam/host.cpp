@@ -108,6 +108,12 @@ void NetworkHostSteam::broadcast(void* data, size_t length) {
     }
 }
 
+void NetworkHostSteam::broadcast_unreliable(void* data, size_t length) {
+    for (uint16_t peer_id = 0; peer_id < host_peer_count; peer_id++) {
+        SteamNetworkingSockets()->SendMessageToConnection(host_peers[peer_id], data, length, k_nSteamNetworkingSend_UnreliableNoNagle, NULL);
+    }
+}
+
 void NetworkHostSteam::flush() {
     for (uint16_t peer_id = 0; peer_id < host_peer_count; peer_id++) {
         SteamNetworkingSockets()->FlushMessagesOnConnection(host_peers[peer_id]);
@@ -27,6 +27,7 @@ public:
 
     void send(uint16_t peer_id, void* data, size_t length) override;
     void broadcast(void* data, size_t length) override;
+    void broadcast_unreliable(void* data, size_t length) override;
     void flush() override;
     void service() override;
 
@@ -21,6 +21,7 @@
 #define NETWORK_PLAYER_NAME_BUFFER_SIZE 36
 #define NETWORK_APP_VERSION_BUFFER_SIZE 16
 #define NETWORK_CHAT_BUFFER_SIZE 128
+#define NETWORK_CHECKSUM_SECTION_MAX 8
 #define NETWORK_SCANNER_PORT 6529
 #define NETWORK_BASE_PORT 6530
 
@@ -138,6 +139,7 @@ struct NetworkEventInput {
 struct NetworkEventChecksum {
     uint8_t player_id;
     uint32_t checksum;
+    uint32_t section_checksums[NETWORK_CHECKSUM_SECTION_MAX];
 };
 
 struct NetworkEventSerializedFrame {
@@ -260,4 +262,5 @@ struct NetworkMessageChecksum {
     const uint8_t type = NETWORK_MESSAGE_CHECKSUM;
     uint8_t padding[3];
     uint32_t checksum;
+    uint32_t section_checksums[NETWORK_CHECKSUM_SECTION_MAX];
 };
\ No newline at end of file
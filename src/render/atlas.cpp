@@ -0,0 +1,854 @@
+#include "atlas.h"
+
+#include "render/ui_color.h"
+#include "core/logger.h"
+#include "core/filesystem.h"
+#include "core/asserts.h"
+#include <SDL3/SDL_ttf.h>
+#include <unordered_map>
+#include <string>
+#include <cstdio>
+
+#define RENDER_ATLAS_CACHE_FILENAME "sprite_atlas.cache"
+#define RENDER_ATLAS_CACHE_SIGNATURE 0x534C5441U
+#define RENDER_ATLAS_CACHE_VERSION 0U
+
+static const SDL_Color RECOLOR_CLOTHES_REF = (SDL_Color) { .r = 255, .g = 0, .b = 255, .a = 255 };
+static const SDL_Color RECOLOR_SKIN_REF = (SDL_Color) { .r = 123, .g = 174, .b = 121, .a = 255 };
+static const std::unordered_map<RenderColor, SDL_Color> RENDER_COLOR_VALUES = {
+    { RENDER_COLOR_WHITE, (SDL_Color) { .r = 255, .g = 255, .b = 255, .a = 255 }},
+    { RENDER_COLOR_OFFBLACK, (SDL_Color) { .r = 40, .g = 37, .b = 45, .a = 255 }},
+    { RENDER_COLOR_OFFBLACK_A200, (SDL_Color) { .r = 40, .g = 37, .b = 45, .a = 200 }},
+    { RENDER_COLOR_OFFBLACK_A128, (SDL_Color) { .r = 40, .g = 37, .b = 45, .a = 128 }},
+    { RENDER_COLOR_DARK_GRAY, (SDL_Color) { .r = 94, .g = 88, .b = 89, .a = 255 }},
+    { RENDER_COLOR_BLUE, (SDL_Color) { .r = 92, .g = 132, .b = 153, .a = 255 }},
+    { RENDER_COLOR_DIM_BLUE, (SDL_Color) { .r = 70, .g = 100, .b = 115, .a = 255 }},
+    { RENDER_COLOR_LIGHT_BLUE, (SDL_Color) { .r = 134, .g = 191, .b = 186, .a = 255 }},
+    { RENDER_COLOR_RED, (SDL_Color) { .r = 186, .g = 97, .b = 95, .a = 255 }},
+    { RENDER_COLOR_RED_TRANSPARENT, (SDL_Color) { .r = 186, .g = 97, .b = 95, .a = 128 }},
+    { RENDER_COLOR_LIGHT_RED, (SDL_Color) { .r = 219, .g = 151, .b = 114, .a = 255 }},
+    { RENDER_COLOR_GOLD, (SDL_Color) { .r = 238, .g = 209, .b = 158, .a = 255 }},
+    { RENDER_COLOR_DIM_SAND, (SDL_Color) { .r = 204, .g = 162, .b = 139, .a = 255 }},
+    { RENDER_COLOR_GREEN, (SDL_Color) { .r = 123, .g = 174, .b = 121, .a = 255 }},
+    { RENDER_COLOR_GREEN_TRANSPARENT, (SDL_Color) { .r = 123, .g = 174, .b = 121, .a = 128 }},
+    { RENDER_COLOR_DARK_GREEN, (SDL_Color) { .r = 77, .g = 135, .b = 115, .a = 255 }},
+    { RENDER_COLOR_PURPLE, (SDL_Color) { .r = 144, .g = 119, .b = 153, .a = 255 }},
+    { RENDER_COLOR_LIGHT_PURPLE, (SDL_Color) { .r = 184, .g = 169, .b = 204, .a = 255 }},
+    { RENDER_COLOR_PLAYER_UI0, PLAYER_UI_COLOR[0] },
+    { RENDER_COLOR_PLAYER_UI1, PLAYER_UI_COLOR[1] },
+    { RENDER_COLOR_PLAYER_UI2, PLAYER_UI_COLOR[2] },
+    { RENDER_COLOR_PLAYER_UI3, PLAYER_UI_COLOR[3] },
+};
+
+enum LoadedSurfaceType {
+    LOADED_SURFACE_FONT,
+    LOADED_SURFACE_SPRITE
+};
+
+struct LoadedSurface {
+    LoadedSurfaceType type;
+    int name;
+    SDL_Surface* surface;
+};
+
+struct RenderAtlasCacheHeader {
+    uint32_t signature;
+    uint32_t version;
+    uint64_t key;
+    uint32_t atlas_count;
+    uint32_t reserved;
+};
+
+int render_sort_surfaces_partition(LoadedSurface* surfaces, int low, int high);
+void render_sort_surfaces(LoadedSurface* surfaces, int low, int high);
+
+bool render_atlas_load(RenderAtlasData& data) {
+    uint64_t key = render_atlas_cache_key();
+    if (render_atlas_cache_load(data, key)) {
+        log_info("Loaded %u sprite atlases from cache.", data.atlas_count);
+        return true;
+    }
+
+    if (!render_atlas_bake(data)) {
+        return false;
+    }
+    log_info("Baked %u sprite atlases.", data.atlas_count);
+
+    // The atlases are still usable if the cache can't be written, they will just be baked again next time
+    render_atlas_cache_save(data, key);
+
+    return true;
+}
+
+bool render_atlas_bake(RenderAtlasData& data) {
+    // First, load all of the surfaces
+    LoadedSurface surfaces[(int)FONT_COUNT + (int)SPRITE_COUNT];
+
+    // Load the font surfaces
+    for (int font = 0; font < FONT_COUNT; font++) {
+        surfaces[font].surface = render_load_font((FontName)font, data.fonts[font]);
+        if (surfaces[font].surface == NULL) {
+            return false;
+        }
+        surfaces[font].type = LOADED_SURFACE_FONT;
+        surfaces[font].name = font;
+    }
+
+    // Load the tileset surfaces because we'll need them for the tile sprites
+    SDL_Surface* tileset_surfaces[TILESET_COUNT];
+    for (int tileset = 0; tileset < TILESET_COUNT; tileset++) {
+        const TilesetParams& params = render_get_tileset_params((Tileset)tileset);
+        std::string tileset_path = filesystem_get_resource_path() + "sprite/" + params.path;
+        tileset_surfaces[tileset] = SDL_LoadPNG(tileset_path.c_str());
+        if (tileset_surfaces[tileset] == NULL) {
+            log_error("Unable to load tileset %s: %s", tileset_path.c_str(), SDL_GetError());
+            return false;
+        }
+    }
+
+    // Load the sprite surfaces
+    for (int sprite = 0; sprite < SPRITE_COUNT; sprite++) {
+        const SpriteParams& params = render_get_sprite_params((SpriteName)sprite);
+        surfaces[FONT_COUNT + sprite].type = LOADED_SURFACE_SPRITE;
+        surfaces[FONT_COUNT + sprite].name = sprite;
+        if (params.strategy == SPRITE_IMPORT_TILE) {
+            SDL_Surface* tile_surface = params.tile.type == TILE_TYPE_SINGLE
+                                                ? render_create_single_tile_surface(tileset_surfaces[params.tile.tileset], params)
+                                                : render_create_auto_tile_surface(tileset_surfaces[params.tile.tileset], params);
+            if (tile_surface == NULL) {
+                return false;
+            }
+
+            surfaces[FONT_COUNT + sprite].surface = tile_surface;
+        } else if (params.strategy == SPRITE_IMPORT_SWATCH) {
+            SDL_Surface* swatch_surface = SDL_CreateSurface(RENDER_COLOR_COUNT, 1, SDL_PIXELFORMAT_BGRA8888);
+            if (swatch_surface == NULL) {
+                log_error("Unable to create swatch surface: %s", SDL_GetError());
+                return false;
+            }
+            const SDL_PixelFormatDetails* format_details = SDL_GetPixelFormatDetails(swatch_surface->format);
+            uint32_t* swatch_pixels = (uint32_t*)swatch_surface->pixels;
+            for (uint32_t render_color = 0; render_color < RENDER_COLOR_COUNT; render_color++) {
+                SDL_Color value = RENDER_COLOR_VALUES.at((RenderColor)render_color);
+                uint32_t color_value = SDL_MapRGBA(format_details, NULL, value.r, value.g, value.b, value.a);
+                swatch_pixels[render_color] = color_value;
+            }
+
+            surfaces[FONT_COUNT + sprite].surface = swatch_surface;
+        } else {
+            std::string sprite_path = filesystem_get_resource_path() + "sprite/" + params.sheet.path;
+            SDL_Surface* sprite_surface = SDL_LoadPNG(sprite_path.c_str());
+            if (sprite_surface == NULL) {
+                log_error("Unable to load sprite %s: %s", sprite_path.c_str(), SDL_GetError());
+                return false;
+            }
+
+            if (params.strategy == SPRITE_IMPORT_PLAYER_COLOR || params.strategy == SPRITE_IMPORT_PLAYER_COLOR_AND_LOW_ALPHA) {
+                sprite_surface = render_create_player_color_surface(sprite_surface, params.strategy == SPRITE_IMPORT_PLAYER_COLOR_AND_LOW_ALPHA);
+                if (sprite_surface == NULL) {
+                    return false;
+                }
+            } 
+            surfaces[FONT_COUNT + sprite].surface = sprite_surface;
+        }
+        SDL_SetSurfaceBlendMode(surfaces[FONT_COUNT + sprite].surface, SDL_BLENDMODE_NONE);
+    }
+
+    // Sort the surfaces by size, from biggest to smallest
+    render_sort_surfaces(surfaces, 0, (int)FONT_COUNT + (int)SPRITE_COUNT - 1);
+
+    // Place the surfaces inside packed texture atlases
+    ivec2 surface_sizes[(int)FONT_COUNT + (int)SPRITE_COUNT];
+    RenderAtlasPlacement placements[(int)FONT_COUNT + (int)SPRITE_COUNT];
+    for (int surface_index = 0; surface_index < (int)FONT_COUNT + (int)SPRITE_COUNT; surface_index++) {
+        surface_sizes[surface_index] = ivec2(surfaces[surface_index].surface->w, surfaces[surface_index].surface->h);
+    }
+    data.atlas_count = render_atlas_pack(surface_sizes, (int)FONT_COUNT + (int)SPRITE_COUNT, placements);
+    if (data.atlas_count == 0) {
+        log_error("Unable to pack sprites into atlases of size %u.", ATLAS_SIZE);
+        return false;
+    }
+
+    std::vector<SDL_Surface*> atlas_surfaces;
+    for (uint32_t atlas = 0; atlas < data.atlas_count; atlas++) {
+        SDL_Surface* atlas_surface = SDL_CreateSurface(ATLAS_SIZE, ATLAS_SIZE, SDL_PIXELFORMAT_ABGR8888);
+        if (atlas_surface == NULL) {
+            log_error("Error creating atlas surface: %s", SDL_GetError());
+            return false;
+        }
+        atlas_surfaces.push_back(atlas_surface);
+    }
+
+    // Render each surface onto its place in the atlases
+    for (int surface_index = 0; surface_index < (int)FONT_COUNT + (int)SPRITE_COUNT; surface_index++) {
+        SDL_Surface* surface = surfaces[surface_index].surface;
+        const RenderAtlasPlacement& placement = placements[surface_index];
+        SDL_Rect dst_rect = (SDL_Rect) { 
+            .x = placement.x,
+            .y = placement.y,
+            .w = surface->w, .h = surface->h
+        };
+        SDL_BlitSurface(surface, NULL, atlas_surfaces[placement.atlas], &dst_rect);
+
+        // Set sprite info for this surface
+        if (surfaces[surface_index].type == LOADED_SURFACE_FONT) {
+            int font_name = surfaces[surface_index].name;
+            data.fonts[font_name].atlas = placement.atlas;
+            data.fonts[font_name].atlas_x = placement.x;
+            data.fonts[font_name].atlas_y = placement.y;
+        } else {
+            int sprite_name = surfaces[surface_index].name;
+            SpriteInfo sprite_info = render_create_sprite_info((SpriteName)sprite_name, surface->w, surface->h);
+            sprite_info.atlas = placement.atlas;
+            sprite_info.atlas_x = placement.x;
+            sprite_info.atlas_y = placement.y;
+            data.sprite_info[sprite_name] = sprite_info;
+        }
+    }
+
+    // Copy the atlases out in the layout that they are uploaded in
+    const size_t atlas_pixel_count = (size_t)ATLAS_SIZE * (size_t)ATLAS_SIZE;
+    data.pixels.resize(data.atlas_count * atlas_pixel_count);
+    for (uint32_t atlas = 0; atlas < data.atlas_count; atlas++) {
+        render_flip_sdl_surface_vertically(atlas_surfaces[atlas]);
+        for (int row = 0; row < ATLAS_SIZE; row++) {
+            memcpy(&data.pixels[(atlas * atlas_pixel_count) + (row * ATLAS_SIZE)], 
+                (uint8_t*)atlas_surfaces[atlas]->pixels + (row * atlas_surfaces[atlas]->pitch), 
+                ATLAS_SIZE * sizeof(uint32_t));
+        }
+        SDL_DestroySurface(atlas_surfaces[atlas]);
+    }
+
+    // Cleanup 
+    for (int surface_index = 0; surface_index < (int)FONT_COUNT + (int)SPRITE_COUNT; surface_index++) {
+        SDL_DestroySurface(surfaces[surface_index].surface);
+    }
+    for (int tileset = 0; tileset < TILESET_COUNT; tileset++) {
+        SDL_DestroySurface(tileset_surfaces[tileset]);
+    }
+
+    return true;
+}
+
+uint32_t render_atlas_pack(const ivec2* sizes, uint32_t count, RenderAtlasPlacement* placements) {
+    // Setup a list to keep track of which rects have been stored
+    std::vector<bool> is_stored(count, false);
+    uint32_t stored_count = 0;
+    uint32_t atlas_count = 0;
+
+    while (stored_count < count) {
+        // Store of a list of empty spaces inside the atlas
+        std::vector<Rect> empty_spaces;
+        empty_spaces.push_back({ .x = 0, .y = 0, .w = ATLAS_SIZE, .h = ATLAS_SIZE });
+        uint32_t atlas_stored_count = 0;
+
+        // For each rect that still needs to be stored, search through the empty spaces list to find a place for the rect to go
+        for (uint32_t index = 0; index < count; index++) {
+            if (is_stored[index]) {
+                continue;
+            }
+            ivec2 size = sizes[index];
+
+            // Search through the empty spaces backwards so that we choose the smallest one that will fit first
+            int space_index_int;
+            for (space_index_int = (int)empty_spaces.size() - 1; space_index_int >= 0; space_index_int--) {
+                if (size.x <= empty_spaces[(size_t)space_index_int].w && size.y <= empty_spaces[(size_t)space_index_int].h) {
+                    break;
+                }
+            }
+            // No space was found, so skip this rect (it will be stored in a different atlas)
+            if (space_index_int == -1) {
+                continue;
+            }
+            size_t space_index = (size_t)space_index_int;
+
+            placements[index] = (RenderAtlasPlacement) {
+                .atlas = (int)atlas_count,
+                .x = empty_spaces[space_index].x,
+                .y = empty_spaces[space_index].y
+            };
+            is_stored[index] = true;
+            stored_count++;
+            atlas_stored_count++;
+
+            // Split the empty space
+            Rect vsplit;
+            vsplit.x = -1; // mark as uninitialized
+            if (size.x < empty_spaces[space_index].w) {
+                vsplit = (Rect) {
+                    .x = empty_spaces[space_index].x + size.x,
+                    .y = empty_spaces[space_index].y,
+                    .w = empty_spaces[space_index].w - size.x,
+                    .h = size.y
+                };
+            }
+
+            Rect hsplit;
+            hsplit.x = -1;
+            if (size.y < empty_spaces[space_index].h) {
+                hsplit = (Rect) {
+                    .x = empty_spaces[space_index].x,
+                    .y = empty_spaces[space_index].y + size.y,
+                    .w = empty_spaces[space_index].w,
+                    .h = empty_spaces[space_index].h - size.y
+                };
+            }
+
+            // Remove the empty space by swapping and popping
+            empty_spaces[space_index] = empty_spaces.back();
+            empty_spaces.pop_back();
+
+            // Add the splits to the list
+            // Note: it is possible for no splits to be added if the rect was a perfect fit
+            if (vsplit.x != -1 && hsplit.x != -1) {
+                // Push back the bigger of the two first
+                if (vsplit.w * vsplit.h >= hsplit.w * hsplit.h) {
+                    empty_spaces.push_back(vsplit);
+                    empty_spaces.push_back(hsplit);
+                } else {
+                    empty_spaces.push_back(hsplit);
+                    empty_spaces.push_back(vsplit);
+                }
+            } else if (vsplit.x != -1) {
+                empty_spaces.push_back(vsplit);
+            } else if (hsplit.x != -1) {
+                empty_spaces.push_back(hsplit);
+            }
+        } // End for each rect
+
+        // If nothing fit in an empty atlas, then the remaining rects are too big to ever be stored
+        if (atlas_stored_count == 0) {
+            return 0;
+        }
+        atlas_count++;
+    }
+
+    return atlas_count;
+}
+
+// FNV-1a
+static void render_atlas_hash_bytes(uint64_t* hash, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t index = 0; index < length; index++) {
+        *hash ^= bytes[index];
+        *hash *= 1099511628211ULL;
+    }
+}
+
+static void render_atlas_hash_int(uint64_t* hash, int value) {
+    render_atlas_hash_bytes(hash, &value, sizeof(value));
+}
+
+static void render_atlas_hash_str(uint64_t* hash, const char* str) {
+    render_atlas_hash_bytes(hash, str, strlen(str) + 1);
+}
+
+static void render_atlas_hash_color(uint64_t* hash, SDL_Color color) {
+    render_atlas_hash_bytes(hash, &color, sizeof(color));
+}
+
+static void render_atlas_hash_file(uint64_t* hash, const std::string& path) {
+    render_atlas_hash_str(hash, path.c_str());
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        // A missing file fails the bake anyway, so there's no need to report it here
+        return;
+    }
+
+    uint8_t buffer[4096];
+    size_t read_length;
+    while ((read_length = fread(buffer, 1, sizeof(buffer), file)) != 0) {
+        render_atlas_hash_bytes(hash, buffer, read_length);
+    }
+    fclose(file);
+}
+
+uint64_t render_atlas_cache_key() {
+    uint64_t hash = 14695981039346656037ULL;
+
+    // Anything that changes the layout or the contents of the atlases
+    render_atlas_hash_int(&hash, RENDER_ATLAS_CACHE_VERSION);
+    render_atlas_hash_int(&hash, ATLAS_SIZE);
+    render_atlas_hash_int(&hash, SPRITE_COUNT);
+    render_atlas_hash_int(&hash, FONT_COUNT);
+    // The sprite and font tables are stored as raw structs, so a change to their layout invalidates the cache
+    render_atlas_hash_int(&hash, (int)sizeof(RenderAtlasCacheHeader));
+    render_atlas_hash_int(&hash, (int)sizeof(SpriteInfo));
+    render_atlas_hash_int(&hash, (int)sizeof(Font));
+    render_atlas_hash_int(&hash, (int)sizeof(FontGlyph));
+    render_atlas_hash_int(&hash, SDL_GetVersion());
+    render_atlas_hash_int(&hash, TTF_Version());
+
+    for (int sprite = 0; sprite < SPRITE_COUNT; sprite++) {
+        const SpriteParams& params = render_get_sprite_params((SpriteName)sprite);
+        render_atlas_hash_int(&hash, params.strategy);
+        if (params.strategy == SPRITE_IMPORT_TILE) {
+            render_atlas_hash_int(&hash, params.tile.tileset);
+            render_atlas_hash_int(&hash, params.tile.type);
+            render_atlas_hash_int(&hash, params.tile.source_x);
+            render_atlas_hash_int(&hash, params.tile.source_y);
+        } else if (params.strategy != SPRITE_IMPORT_SWATCH) {
+            render_atlas_hash_int(&hash, params.sheet.hframes);
+            render_atlas_hash_int(&hash, params.sheet.vframes);
+            render_atlas_hash_file(&hash, filesystem_get_resource_path() + "sprite/" + params.sheet.path);
+        }
+    }
+
+    for (int tileset = 0; tileset < TILESET_COUNT; tileset++) {
+        const TilesetParams& params = render_get_tileset_params((Tileset)tileset);
+        render_atlas_hash_file(&hash, filesystem_get_resource_path() + "sprite/" + params.path);
+    }
+
+    for (int font = 0; font < FONT_COUNT; font++) {
+        const FontParams& params = resource_get_font_params((FontName)font);
+        render_atlas_hash_int(&hash, (int)params.options);
+        render_atlas_hash_int(&hash, params.size);
+        render_atlas_hash_color(&hash, params.color);
+        render_atlas_hash_file(&hash, filesystem_get_resource_path() + "font/" + params.path);
+    }
+
+    for (int render_color = 0; render_color < RENDER_COLOR_COUNT; render_color++) {
+        render_atlas_hash_color(&hash, render_get_color_value((RenderColor)render_color));
+    }
+    for (int player = 0; player < MAX_PLAYERS; player++) {
+        render_atlas_hash_int(&hash, RENDER_PLAYER_COLORS[player]);
+        render_atlas_hash_int(&hash, RENDER_PLAYER_SKIN_COLORS[player]);
+    }
+    render_atlas_hash_color(&hash, RECOLOR_CLOTHES_REF);
+    render_atlas_hash_color(&hash, RECOLOR_SKIN_REF);
+
+    return hash;
+}
+
+bool render_atlas_cache_load(RenderAtlasData& data, uint64_t key) {
+    std::string path = filesystem_get_data_path() + RENDER_ATLAS_CACHE_FILENAME;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    // Read the whole cache at once
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<uint8_t> buffer(file_size > 0 ? (size_t)file_size : 0);
+    size_t read_size = fread(buffer.data(), 1, buffer.size(), file);
+    fclose(file);
+    if (read_size != buffer.size()) {
+        log_warn("Unable to read sprite atlas cache %s.", path.c_str());
+        return false;
+    }
+
+    RenderAtlasCacheHeader header;
+    size_t offset = 0;
+    if (buffer.size() < sizeof(header) + sizeof(data.sprite_info) + sizeof(data.fonts)) {
+        log_warn("Sprite atlas cache %s is truncated.", path.c_str());
+        return false;
+    }
+    memcpy(&header, &buffer[offset], sizeof(header));
+    offset += sizeof(header);
+    if (header.signature != RENDER_ATLAS_CACHE_SIGNATURE || 
+            header.version != RENDER_ATLAS_CACHE_VERSION || 
+            header.atlas_count == 0) {
+        log_warn("Sprite atlas cache %s is invalid.", path.c_str());
+        return false;
+    }
+    if (header.key != key) {
+        log_info("Sprite atlas cache is out of date.");
+        return false;
+    }
+
+    memcpy(data.sprite_info, &buffer[offset], sizeof(data.sprite_info));
+    offset += sizeof(data.sprite_info);
+    memcpy(data.fonts, &buffer[offset], sizeof(data.fonts));
+    offset += sizeof(data.fonts);
+    for (int sprite = 0; sprite < SPRITE_COUNT; sprite++) {
+        if (data.sprite_info[sprite].atlas < 0 || (uint32_t)data.sprite_info[sprite].atlas >= header.atlas_count) {
+            log_warn("Sprite atlas cache %s has sprite %i in atlas %i, but only has %u atlases.", path.c_str(), sprite, data.sprite_info[sprite].atlas, header.atlas_count);
+            return false;
+        }
+    }
+    for (int font = 0; font < FONT_COUNT; font++) {
+        if (data.fonts[font].atlas < 0 || (uint32_t)data.fonts[font].atlas >= header.atlas_count) {
+            log_warn("Sprite atlas cache %s has font %i in atlas %i, but only has %u atlases.", path.c_str(), font, data.fonts[font].atlas, header.atlas_count);
+            return false;
+        }
+    }
+
+    const size_t atlas_pixel_count = (size_t)ATLAS_SIZE * (size_t)ATLAS_SIZE;
+    data.atlas_count = header.atlas_count;
+    data.pixels.assign(data.atlas_count * atlas_pixel_count, 0);
+    for (uint32_t atlas = 0; atlas < data.atlas_count; atlas++) {
+        uint32_t first_row;
+        if (buffer.size() - offset < sizeof(first_row)) {
+            log_warn("Sprite atlas cache %s is truncated.", path.c_str());
+            return false;
+        }
+        memcpy(&first_row, &buffer[offset], sizeof(first_row));
+        offset += sizeof(first_row);
+
+        size_t rows_size = first_row > ATLAS_SIZE ? SIZE_MAX : (ATLAS_SIZE - first_row) * ATLAS_SIZE * sizeof(uint32_t);
+        if (buffer.size() - offset < rows_size) {
+            log_warn("Sprite atlas cache %s is truncated.", path.c_str());
+            return false;
+        }
+        memcpy(&data.pixels[(atlas * atlas_pixel_count) + (first_row * ATLAS_SIZE)], &buffer[offset], rows_size);
+        offset += rows_size;
+    }
+
+    return true;
+}
+
+bool render_atlas_cache_save(const RenderAtlasData& data, uint64_t key) {
+    std::string path = filesystem_get_data_path() + RENDER_ATLAS_CACHE_FILENAME;
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+        log_warn("Unable to open sprite atlas cache %s for writing.", path.c_str());
+        return false;
+    }
+
+    RenderAtlasCacheHeader header = (RenderAtlasCacheHeader) {
+        .signature = RENDER_ATLAS_CACHE_SIGNATURE,
+        .version = RENDER_ATLAS_CACHE_VERSION,
+        .key = key,
+        .atlas_count = data.atlas_count,
+        .reserved = 0
+    };
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(data.sprite_info, sizeof(data.sprite_info), 1, file);
+    fwrite(data.fonts, sizeof(data.fonts), 1, file);
+
+    const size_t atlas_pixel_count = (size_t)ATLAS_SIZE * (size_t)ATLAS_SIZE;
+    for (uint32_t atlas = 0; atlas < data.atlas_count; atlas++) {
+        // Atlases are filled from the top down and then flipped, so the empty rows are all at the start
+        const uint32_t* atlas_pixels = &data.pixels[atlas * atlas_pixel_count];
+        uint32_t first_row = 0;
+        while (first_row < ATLAS_SIZE) {
+            bool is_row_empty = true;
+            for (int x = 0; x < ATLAS_SIZE; x++) {
+                if (atlas_pixels[(first_row * ATLAS_SIZE) + x] != 0) {
+                    is_row_empty = false;
+                    break;
+                }
+            }
+            if (!is_row_empty) {
+                break;
+            }
+            first_row++;
+        }
+
+        fwrite(&first_row, sizeof(first_row), 1, file);
+        fwrite(atlas_pixels + (first_row * ATLAS_SIZE), sizeof(uint32_t), (ATLAS_SIZE - first_row) * ATLAS_SIZE, file);
+    }
+
+    bool success = ferror(file) == 0;
+    fclose(file);
+    if (!success) {
+        log_warn("Error writing sprite atlas cache %s.", path.c_str());
+        remove(path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+SDL_Color render_get_color_value(RenderColor color) {
+    return RENDER_COLOR_VALUES.at(color);
+}
+
+SpriteInfo render_create_sprite_info(SpriteName name, int surface_width, int surface_height) {
+    const SpriteParams& params = render_get_sprite_params(name);
+    SpriteInfo sprite_info;
+    if (params.strategy == SPRITE_IMPORT_TILE) {
+        if (params.tile.type == TILE_TYPE_SINGLE) {
+            sprite_info.hframes = 1;
+            sprite_info.vframes = 1;
+        } else if (params.tile.type == TILE_TYPE_AUTO) {
+            sprite_info.hframes = AUTOTILE_HFRAMES;
+            sprite_info.vframes = AUTOTILE_VFRAMES;
+        }
+        sprite_info.frame_width = TILE_SRC_SIZE;
+        sprite_info.frame_height = TILE_SRC_SIZE;
+    } else if (params.strategy == SPRITE_IMPORT_SWATCH) {
+        sprite_info.hframes = RENDER_COLOR_COUNT;
+        sprite_info.vframes = 1;
+        sprite_info.frame_width = 1;
+        sprite_info.frame_height = 1;
+    } else {
+        sprite_info.hframes = params.sheet.hframes;
+        sprite_info.vframes = params.sheet.vframes;
+        sprite_info.frame_width = surface_width / sprite_info.hframes;
+        sprite_info.frame_height = (params.strategy == SPRITE_IMPORT_PLAYER_COLOR || params.strategy == SPRITE_IMPORT_PLAYER_COLOR_AND_LOW_ALPHA)
+                                        ? surface_height / (sprite_info.vframes * MAX_PLAYERS)
+                                        : surface_height / sprite_info.vframes;
+    }
+
+    return sprite_info;
+}
+
+void render_flip_sdl_surface_vertically(SDL_Surface* surface) {
+    SDL_LockSurface(surface);
+    int sprite_surface_pitch = surface->pitch;
+    uint8_t* temp = (uint8_t*)malloc((size_t)sprite_surface_pitch);
+    uint8_t* sprite_surface_pixels = (uint8_t*)surface->pixels;
+
+    for (int row = 0; row < surface->h / 2; ++row) {
+        uint8_t* row1 = sprite_surface_pixels + (row * sprite_surface_pitch);
+        uint8_t* row2 = sprite_surface_pixels + ((surface->h - row - 1) * sprite_surface_pitch);
+
+        memcpy(temp, row1, (size_t)sprite_surface_pitch);
+        memcpy(row1, row2, (size_t)sprite_surface_pitch);
+        memcpy(row2, temp, (size_t)sprite_surface_pitch);
+    }
+    free(temp);
+    SDL_UnlockSurface(surface);
+}
+
+SDL_Surface* render_create_player_color_surface(SDL_Surface* sprite_surface, bool recolor_low_alpha) {
+    // Create a surface big enough to hold the recolor atlas
+    SDL_Surface* recolor_surface = SDL_CreateSurface(sprite_surface->w, sprite_surface->h * MAX_PLAYERS, sprite_surface->format);
+    if (recolor_surface == NULL) {
+        log_error("Error creating recolor surface for sprite: %s", SDL_GetError());
+        return NULL;
+    }
+
+    // Get the reference pixels into a packed byte
+    const SDL_PixelFormatDetails* format_details = SDL_GetPixelFormatDetails(sprite_surface->format);
+    uint32_t clothes_reference_pixel = SDL_MapRGBA(format_details, NULL, RECOLOR_CLOTHES_REF.r, RECOLOR_CLOTHES_REF.g, RECOLOR_CLOTHES_REF.b, RECOLOR_CLOTHES_REF.a);
+    uint32_t skin_reference_pixel = SDL_MapRGBA(format_details, NULL, RECOLOR_SKIN_REF.r, RECOLOR_SKIN_REF.g, RECOLOR_SKIN_REF.b, RECOLOR_SKIN_REF.a);
+
+    // Lock the surface so that we can edit pixel values
+    SDL_LockSurface(recolor_surface);
+    uint32_t* recolor_surface_pixels = (uint32_t*)recolor_surface->pixels;
+    uint32_t* sprite_surface_pixels = (uint32_t*)sprite_surface->pixels;
+
+    // Copy the original sprite onto our recolor atlas 4 times, once for each player color
+    for (int recolor_id = 0; recolor_id < MAX_PLAYERS; recolor_id++) {
+        // Get the replacement pixel bytes from the player color
+        SDL_Color player_color = RENDER_COLOR_VALUES.at(RENDER_PLAYER_COLORS[recolor_id]);
+        uint32_t clothes_replacement_pixel = SDL_MapRGBA(format_details, NULL, player_color.r, player_color.g, player_color.b, player_color.a);
+        SDL_Color skin_color = RENDER_COLOR_VALUES.at(RENDER_PLAYER_SKIN_COLORS[recolor_id]);
+        uint32_t skin_replacement_pixel = SDL_MapRGBA(format_details, NULL, skin_color.r, skin_color.g, skin_color.b, skin_color.a);
+
+        // Loop through each pixel of the original sprite
+        for (int y = 0; y < sprite_surface->h; y++) {
+            for (int x = 0; x < sprite_surface->w; x++) {
+                // Determine which source pixel to use
+                uint32_t source_pixel = sprite_surface_pixels[(y * sprite_surface->w) + x];
+                if (source_pixel == clothes_reference_pixel) {
+                    source_pixel = clothes_replacement_pixel;
+                } else if (source_pixel == skin_reference_pixel) {
+                    source_pixel = skin_replacement_pixel;
+                }
+                if (recolor_low_alpha) {
+                    uint8_t r, g, b, a;
+                    SDL_GetRGBA(source_pixel, format_details, NULL, &r, &g, &b, &a);
+                    if (a != 0) {
+                        a = 200;
+                    }
+                    source_pixel = SDL_MapRGBA(format_details, NULL, r, g, b, a);
+                }
+
+                // Put the source pixel onto the recolor surface
+                recolor_surface_pixels[((y + (sprite_surface->h * recolor_id)) * recolor_surface->w) + x] = source_pixel;
+            }
+        }
+    }
+
+    SDL_UnlockSurface(recolor_surface);
+
+    // Handoff the recolor surface into the sprite surface variable
+    // Allows the rest of the sprite loading to work the same as with normal sprites
+    SDL_DestroySurface(sprite_surface);
+    return recolor_surface;
+}
+
+SDL_Surface* render_create_single_tile_surface(SDL_Surface* tileset_surface, const SpriteParams& params) {
+    SDL_Surface* tile_surface = SDL_CreateSurface(TILE_SRC_SIZE, TILE_SRC_SIZE, tileset_surface->format);
+    if (tile_surface == NULL) {
+        log_error("Could not create single tile surface: %s", SDL_GetError());
+        return NULL;
+    }
+
+    SDL_Rect src_rect = (SDL_Rect) { 
+        .x = params.tile.source_x, 
+        .y = params.tile.source_y,
+        .w = TILE_SRC_SIZE,
+        .h = TILE_SRC_SIZE
+    };
+    SDL_Rect dst_rect = (SDL_Rect) {
+        .x = 0, .y = 0,
+        .w = TILE_SRC_SIZE, .h = TILE_SRC_SIZE
+    };
+
+    SDL_BlitSurface(tileset_surface, &src_rect, tile_surface, &dst_rect);
+
+    return tile_surface;
+}
+
+SDL_Surface* render_create_auto_tile_surface(SDL_Surface* tileset_surface, const SpriteParams& params) {
+    SDL_Surface* tile_surface = SDL_CreateSurface(TILE_SRC_SIZE * AUTOTILE_HFRAMES, TILE_SRC_SIZE * AUTOTILE_VFRAMES, tileset_surface->format);
+    if (tile_surface == NULL) {
+        log_error("Could not create auto tile surface: %s", SDL_GetError());
+        return NULL;
+    }
+
+    // To generate an autotile, we iterate through each combination of neighbors
+    ivec2 autotile_frame = ivec2(0, 0);
+    for (uint32_t neighbors = 0; neighbors < 256; neighbors++) {
+        // There are 256 neighbor combinations, but only 47 of them are unique because
+        // a diagonal neighbor does not affect what tile we render when autotiling 
+        // unless there is an adjacent tile in both directions. 
+        // for example: neighbor in NE by itself does not affect which tile we render
+        // but neighbor in NE and neighbor in N and neighbor in E does (both adjacent directions are required)
+        bool is_unique = true;
+        for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+            if (direction % 2 == 1 && (DIRECTION_MASK[direction] & neighbors) == DIRECTION_MASK[direction]) {
+                int prev_direction = direction - 1;
+                int next_direction = (direction + 1) % DIRECTION_COUNT;
+                if ((DIRECTION_MASK[prev_direction] & neighbors) != DIRECTION_MASK[prev_direction] ||
+                    (DIRECTION_MASK[next_direction] & neighbors) != DIRECTION_MASK[next_direction]) {
+                    is_unique = false;
+                    break;
+                }
+            }
+        }
+        if (!is_unique) {
+            continue;
+        }
+
+        // Each unique autotile is formed by sampling corners off of the source tile
+        // https://gamedev.stackexchange.com/questions/46594/elegant-autotiling
+        for (uint32_t edge = 0; edge < 4; edge++) {
+            ivec2 edge_source_pos = ivec2(params.tile.source_x, params.tile.source_y) + (autotile_edge_lookup(edge, neighbors & AUTOTILE_EDGE_MASK[edge]) * (TILE_SRC_SIZE / 2));
+            SDL_Rect subtile_src_rect = (SDL_Rect) {
+                .x = edge_source_pos.x,
+                .y = edge_source_pos.y,
+                .w = TILE_SRC_SIZE / 2,
+                .h = TILE_SRC_SIZE / 2
+            };
+            SDL_Rect subtile_dst_rect = (SDL_Rect) {
+                .x = (autotile_frame.x * TILE_SRC_SIZE) + (AUTOTILE_EDGE_OFFSETS[edge].x * (TILE_SRC_SIZE / 2)),
+                .y = (autotile_frame.y * TILE_SRC_SIZE) + (AUTOTILE_EDGE_OFFSETS[edge].y * (TILE_SRC_SIZE / 2)),
+                .w = TILE_SRC_SIZE / 2,
+                .h = TILE_SRC_SIZE / 2
+            };
+
+            SDL_BlitSurface(tileset_surface, &subtile_src_rect, tile_surface, &subtile_dst_rect);
+        } 
+
+        autotile_frame.x++;
+        if (autotile_frame.x == AUTOTILE_HFRAMES) {
+            autotile_frame.x = 0;
+            autotile_frame.y++;
+        }
+    } // End for each neighbor combo
+
+    return tile_surface;
+}
+
+SDL_Surface* render_load_font(FontName name, Font& font) {
+    const FontParams& params = resource_get_font_params((FontName)name);
+    const bool font_option_ignore_bearing = (params.options & FONT_OPTION_IGNORE_BEARING) == FONT_OPTION_IGNORE_BEARING;
+
+    // Open the font
+    std::string font_path = filesystem_get_resource_path() + "font/" + params.path;
+    TTF_Font* ttf_font = TTF_OpenFont(font_path.c_str(), (float)params.size);
+    if (ttf_font == NULL) {
+        log_error("Unable to open font %s: %s", font_path.c_str(), SDL_GetError());
+        return NULL;
+    }
+
+    // Render each glyph to a surface
+    SDL_Surface* glyphs[FONT_GLYPH_COUNT];
+    ivec2 glyph_surface_position = ivec2(0, 0);
+    int glyph_max_width = 0;
+    int glyph_max_height = 0;
+
+    SDL_Color font_color = params.color;
+    for (uint32_t glyph_index = 0; glyph_index < FONT_GLYPH_COUNT; glyph_index++) {
+        char text[2] = { (char)(FONT_FIRST_CHAR + glyph_index), '\0'};
+        glyphs[glyph_index] = TTF_RenderText_Solid(ttf_font, text, 0, font_color);
+        if (glyphs[glyph_index] == NULL) {
+            log_error("Error rendering glyph %s for font %s: %s", text, font_path.c_str(), SDL_GetError());
+            return NULL;
+        }
+
+        glyph_max_width = std::max(glyph_max_width, glyphs[glyph_index]->w);
+        glyph_max_height = std::max(glyph_max_height, glyphs[glyph_index]->h);
+    }
+
+    // Create a surface to render each glyph onto
+    SDL_Surface* font_surface = SDL_CreateSurface(glyph_max_width * FONT_HFRAMES, glyph_max_height * FONT_VFRAMES, SDL_PIXELFORMAT_RGBA8888);
+    if (font_surface == NULL) {
+        log_error("Error creating font surface: %s", SDL_GetError());
+        return NULL;
+    }
+
+    // Render each surface glyph onto a single atlas surface
+    for (int glyph_index = 0; glyph_index < FONT_GLYPH_COUNT; glyph_index++) {
+        int glyph_index_x = glyph_index % FONT_HFRAMES;
+        int glyph_index_y = glyph_index / FONT_HFRAMES;
+
+        SDL_Rect dest_rect = (SDL_Rect) { 
+            .x = glyph_index_x * glyph_max_width, 
+            .y = glyph_index_y * glyph_max_height, 
+            .w = glyphs[glyph_index]->w, 
+            .h = glyphs[glyph_index]->h 
+        };
+        if (!SDL_BlitSurface(glyphs[glyph_index], NULL, font_surface, &dest_rect)) {
+            log_error("Error blitting surface: %s", SDL_GetError());
+        }
+    }
+
+    // Finish filling out the font struct
+    font.glyph_width = glyph_max_width;
+    font.glyph_height = glyph_max_height;
+    for (uint32_t glyph_index = 0; glyph_index < FONT_GLYPH_COUNT; glyph_index++) {
+        int bearing_y;
+        TTF_GetGlyphMetrics(ttf_font, FONT_FIRST_CHAR + glyph_index, &font.glyphs[glyph_index].bearing_x, NULL, NULL, &bearing_y, &font.glyphs[glyph_index].advance);
+        font.glyphs[glyph_index].bearing_y = glyph_max_height - bearing_y;
+        if (font_option_ignore_bearing) {
+            font.glyphs[glyph_index].bearing_x = 0;
+            font.glyphs[glyph_index].bearing_y = 0;
+        }
+    }
+
+    // Free all the resources
+    for (int glyph_index = 0; glyph_index < FONT_GLYPH_COUNT; glyph_index++) {
+        SDL_DestroySurface(glyphs[glyph_index]);
+    }
+    TTF_CloseFont(ttf_font);
+
+    return font_surface;
+}
+
+int render_sort_surfaces_partition(LoadedSurface* surfaces, int low, int high) {
+    LoadedSurface pivot = surfaces[high];
+    int i = low - 1;
+
+    for (int j = low; j <= high - 1; j++) {
+        if (surfaces[j].surface->w * surfaces[j].surface->h > pivot.surface->w * pivot.surface->h) {
+            i++;
+            LoadedSurface temp = surfaces[j];
+            surfaces[j] = surfaces[i];
+            surfaces[i] = temp;
+        }
+    }
+
+    LoadedSurface temp = surfaces[high];
+    surfaces[high] = surfaces[i + 1];
+    surfaces[i + 1] = temp;
+
+    return i + 1;
+}
+
+void render_sort_surfaces(LoadedSurface* surfaces, int low, int high) {
+    if (low < high) {
+        int partition_index = render_sort_surfaces_partition(surfaces, low, high);
+        render_sort_surfaces(surfaces, low, partition_index - 1);
+        render_sort_surfaces(surfaces, partition_index + 1, high);
+    }
+}
+
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "defines.h"
+#include "render/render.h"
+#include <SDL3/SDL.h>
+#include <vector>
+
+/**
+ * Sprite atlas baking. Sprite sheets are decoded, recolored and autotiled, fonts are rasterized,
+ * and everything is packed into ATLAS_SIZE texture atlases along with the SpriteInfo and Font tables.
+ *
+ * Baking only touches the CPU, so it works without a GL context. The result is cached in the data folder,
+ * keyed by a hash of the sprite, tileset and font sources and of the tables that describe them,
+ * so that after the first run the renderer only has to read the cache and upload the atlases.
+ */
+
+#define ATLAS_SIZE 2048
+#define FONT_GLYPH_COUNT 95
+#define FONT_FIRST_CHAR 32U // space
+#define FONT_HFRAMES 16
+#define FONT_VFRAMES 6
+#define TILE_SRC_SIZE 16
+
+struct FontGlyph {
+    int bearing_x;
+    int bearing_y;
+    int advance;
+};
+
+struct Font {
+    int atlas;
+    int atlas_x;
+    int atlas_y;
+    int glyph_width;
+    int glyph_height;
+    FontGlyph glyphs[FONT_GLYPH_COUNT];
+};
+
+struct RenderAtlasPlacement {
+    int atlas;
+    int x;
+    int y;
+};
+
+struct RenderAtlasData {
+    SpriteInfo sprite_info[SPRITE_COUNT];
+    Font fonts[FONT_COUNT];
+    uint32_t atlas_count;
+    // ATLAS_SIZE * ATLAS_SIZE ABGR8888 pixels per atlas, already flipped vertically for upload
+    std::vector<uint32_t> pixels;
+};
+
+// Uses the cached atlases if they are up to date, otherwise bakes them and writes the cache
+bool render_atlas_load(RenderAtlasData& data);
+bool render_atlas_bake(RenderAtlasData& data);
+uint64_t render_atlas_cache_key();
+bool render_atlas_cache_load(RenderAtlasData& data, uint64_t key);
+bool render_atlas_cache_save(const RenderAtlasData& data, uint64_t key);
+
+// Packs rects into as many atlases as it takes, returns the atlas count or 0 if a rect does not fit in an atlas
+// Rects should be sorted from biggest to smallest
+uint32_t render_atlas_pack(const ivec2* sizes, uint32_t count, RenderAtlasPlacement* placements);
+
+SDL_Color render_get_color_value(RenderColor color);
+SpriteInfo render_create_sprite_info(SpriteName name, int surface_width, int surface_height);
+void render_flip_sdl_surface_vertically(SDL_Surface* surface);
+// Frees the sprite surface and returns a surface with one copy of the sprite for each player color
+SDL_Surface* render_create_player_color_surface(SDL_Surface* sprite_surface, bool recolor_low_alpha);
+SDL_Surface* render_create_single_tile_surface(SDL_Surface* tileset_surface, const SpriteParams& params);
+SDL_Surface* render_create_auto_tile_surface(SDL_Surface* tileset_surface, const SpriteParams& params);
+SDL_Surface* render_load_font(FontName name, Font& font);
@@ -101,6 +101,8 @@ const uint32_t RENDER_SPRITE_FLIP_H = 2;
 const uint32_t RENDER_SPRITE_CENTERED = 4;
 
 bool render_init(SDL_Window* window);
+// Loads sprite info without a window or GL context, for simulating matches headlessly
+bool render_init_headless();
 void render_quit();
 void render_set_display(RenderDisplay display);
 void render_set_vsync(RenderVsync vsync);
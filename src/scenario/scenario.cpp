@@ -5,6 +5,7 @@
 #include "util/bitflag.h"
 #include "util/json.h"
 #include "util/util.h"
+#include "profile/profile.h"
 
 Scenario* scenario_base_init() {
     Scenario* scenario = new Scenario();
@@ -51,23 +52,18 @@ void scenario_init_map(Scenario* scenario, MapType map_type) {
     scenario_bake_map(scenario, true);
 }
 
-void scenario_bake_map(Scenario* scenario, bool remove_artifacts) {
-    int lcg_seed = rand();
-    if (remove_artifacts) {
-        map_bake_map_tiles_and_remove_artifacts(scenario->map, scenario->noise, &lcg_seed);
-    } else {
-        map_bake_tiles(scenario->map, scenario->noise, &lcg_seed);
-    }
-    map_bake_front_walls(scenario->map);
-    map_bake_ramps(scenario->map, scenario->noise);
-    for (int index = 0; index < scenario->map.width * scenario->map.height; index++) {
-        if (scenario->map.cells[CELL_LAYER_GROUND][index].type == CELL_BLOCKED) {
-            scenario->map.cells[CELL_LAYER_GROUND][index].type = CELL_EMPTY;
+static void scenario_bake_blocked_cells(Scenario* scenario, ivec2 cell_min, ivec2 cell_max) {
+    for (int y = cell_min.y; y <= cell_max.y; y++) {
+        for (int x = cell_min.x; x <= cell_max.x; x++) {
+            int index = x + (y * scenario->map.width);
+            if (scenario->map.cells[CELL_LAYER_GROUND][index].type == CELL_BLOCKED) {
+                scenario->map.cells[CELL_LAYER_GROUND][index].type = CELL_EMPTY;
+            }
         }
     }
 
-    for (int y = 0; y < scenario->map.height; y++) {
-        for (int x = 0; x < scenario->map.width; x++) {
+    for (int y = cell_min.y; y <= cell_max.y; y++) {
+        for (int x = cell_min.x; x <= cell_max.x; x++) {
             if (map_should_cell_be_blocked(scenario->map, ivec2(x, y)) &&
                     map_get_cell(scenario->map, CELL_LAYER_GROUND, ivec2(x,y)).type == CELL_EMPTY) {
                 map_set_cell(scenario->map, CELL_LAYER_GROUND, ivec2(x, y), (Cell) {
@@ -79,6 +75,28 @@ void scenario_bake_map(Scenario* scenario, bool remove_artifacts) {
     }
 }
 
+void scenario_bake_map(Scenario* scenario, bool remove_artifacts) {
+    int lcg_seed = rand();
+    if (remove_artifacts) {
+        map_bake_map_tiles_and_remove_artifacts(scenario->map, scenario->noise, &lcg_seed);
+    } else {
+        map_bake_tiles(scenario->map, scenario->noise, &lcg_seed);
+    }
+    map_bake_front_walls(scenario->map);
+    map_bake_ramps(scenario->map, scenario->noise);
+    scenario_bake_blocked_cells(scenario, ivec2(0, 0), ivec2(scenario->map.width - 1, scenario->map.height - 1));
+}
+
+void scenario_bake_map_rect(Scenario* scenario, ivec2 cell_min, ivec2 cell_max) {
+    map_expand_bake_rect(scenario->map, scenario->noise, &cell_min, &cell_max);
+
+    int lcg_seed = rand();
+    map_bake_tiles_in_rect(scenario->map, scenario->noise, &lcg_seed, cell_min, cell_max);
+    map_bake_front_walls_in_rect(scenario->map, cell_min, cell_max);
+    map_bake_ramps_in_rect(scenario->map, scenario->noise, cell_min, cell_max);
+    scenario_bake_blocked_cells(scenario, cell_min, cell_max);
+}
+
 Scenario* scenario_init_blank(MapType map_type, MapSize map_size) {
     // Init base scenario
     Scenario* scenario = scenario_base_init();
@@ -200,12 +218,32 @@ uint8_t scenario_get_noise_map_value(Scenario* scenario, ivec2 cell) {
 void scenario_set_noise_map_value(Scenario* scenario, ivec2 cell, uint8_t value) {
     scenario->noise->map[cell.x + (cell.y * scenario->noise->width)] = value;
 
-    scenario_bake_map(scenario);
+    scenario_bake_map_rect(scenario, cell, cell);
 }
 
-bool scenario_save_file(const Scenario* scenario, const char* json_full_path, const char* script_short_path) {
-    const std::string folder_path = filesystem_get_path_folder(json_full_path);
+static MapType scenario_map_type_from_str(const char* str) {
+    for (uint32_t map_type_index = 0; map_type_index < MAP_TYPE_COUNT; map_type_index++) {
+        if (match_setting_data(MATCH_SETTING_MAP_TYPE).values.at(map_type_index) == str) {
+            return (MapType)map_type_index;
+        }
+    }
+
+    return MAP_TYPE_COUNT;
+}
+
+static void scenario_push_entity(Scenario* scenario, const ScenarioEntity& entity) {
+    // Set map cell
+    const EntityData& entity_data = entity_get_data(entity.type);
+    map_set_cell_rect(scenario->map, entity_data.cell_layer, entity.cell, entity_data.cell_size, (Cell) {
+        .type = CELL_UNIT,
+        .id = (EntityId)scenario->entity_count
+    });
 
+    scenario->entities[scenario->entity_count] = entity;
+    scenario->entity_count++;
+}
+
+static bool scenario_save_file_json(const Scenario* scenario, const char* json_full_path, const char* script_short_path) {
     // Build scenario json
     Json* scenario_json = json_object();
     {
@@ -397,9 +435,7 @@ bool scenario_save_file(const Scenario* scenario, const char* json_full_path, co
     return json_save_success;
 }
 
-Scenario* scenario_open_file(const char* json_path, std::string* script_short_path) {
-    const std::string folder_path = filesystem_get_path_folder(json_path);
-
+static Scenario* scenario_open_file_json(const char* json_path, std::string* script_short_path) {
     Json* scenario_json = NULL;
     Scenario* scenario = NULL;
 
@@ -418,14 +454,7 @@ Scenario* scenario_open_file(const char* json_path, std::string* script_short_pa
         }
 
         // Map type
-        const std::string map_type_string = json_object_get_string(scenario_json, "map_type");
-        MapType map_type = MAP_TYPE_COUNT;
-        for (uint32_t map_type_index = 0; map_type_index < MAP_TYPE_COUNT; map_type_index++) {
-            if (match_setting_data(MATCH_SETTING_MAP_TYPE).values.at(map_type_index) == map_type_string) {
-                map_type = (MapType)map_type_index;
-                break;
-            }
-        }
+        MapType map_type = scenario_map_type_from_str(json_object_get_string(scenario_json, "map_type"));
         GOLD_ASSERT(map_type != MAP_TYPE_COUNT);
 
         // Grab script short path
@@ -584,15 +613,7 @@ Scenario* scenario_open_file(const char* json_path, std::string* script_short_pa
             entity.gold_held = (uint32_t)json_object_get_number(entity_json, "gold_held");
             entity.cell = json_to_ivec2(json_object_get(entity_json, "cell"));
 
-            // Set map cell
-            const EntityData& entity_data = entity_get_data(entity.type);
-            map_set_cell_rect(scenario->map, entity_data.cell_layer, entity.cell, entity_data.cell_size, (Cell) {
-                .type = CELL_UNIT,
-                .id = (EntityId)scenario->entity_count
-            });
-
-            scenario->entities[scenario->entity_count] = entity;
-            scenario->entity_count++;
+            scenario_push_entity(scenario, entity);
         }
 
         // Squads
@@ -679,4 +700,710 @@ error:
     }
 
     return NULL;
-}
\ No newline at end of file
+}
+
+// BINARY FILE
+
+/**
+ * Binary scenarios are a signature and version followed by a list of chunks.
+ * Each chunk is a type and a byte size followed by its payload, so readers skip over chunks they don't know about.
+ *
+ * Noise planes are run-length encoded, since they are mostly long runs of the same value.
+ * Enums are written by name, the same as in the JSON files, so that reordering an enum doesn't break old scenarios.
+ * Entities store their type as an index into a table of entity names at the start of the entities chunk.
+ *
+ * The whole file is read with a single read and then parsed in place.
+ */
+
+static const uint32_t SCENARIO_FILE_SIGNATURE = 0x53434E47;
+static const uint32_t SCENARIO_FILE_VERSION = 0;
+
+enum ScenarioChunkType {
+    SCENARIO_CHUNK_INFO,
+    SCENARIO_CHUNK_NOISE,
+    SCENARIO_CHUNK_DECORATIONS,
+    SCENARIO_CHUNK_PLAYERS,
+    SCENARIO_CHUNK_ENTITIES,
+    SCENARIO_CHUNK_SQUADS,
+    SCENARIO_CHUNK_CONSTANTS
+};
+
+struct ScenarioFileReader {
+    const uint8_t* data;
+    size_t length;
+    size_t head;
+    bool has_error;
+};
+
+static void scenario_file_write(std::vector<uint8_t>& buffer, const void* value, size_t size) {
+    buffer.insert(buffer.end(), (const uint8_t*)value, (const uint8_t*)value + size);
+}
+
+static void scenario_file_write_u8(std::vector<uint8_t>& buffer, uint8_t value) {
+    buffer.push_back(value);
+}
+
+static void scenario_file_write_u32(std::vector<uint8_t>& buffer, uint32_t value) {
+    scenario_file_write(buffer, &value, sizeof(value));
+}
+
+static void scenario_file_write_ivec2(std::vector<uint8_t>& buffer, ivec2 value) {
+    scenario_file_write(buffer, &value.x, sizeof(value.x));
+    scenario_file_write(buffer, &value.y, sizeof(value.y));
+}
+
+static void scenario_file_write_string(std::vector<uint8_t>& buffer, const char* value) {
+    uint32_t length = (uint32_t)strlen(value);
+    scenario_file_write_u32(buffer, length);
+    scenario_file_write(buffer, value, length);
+}
+
+// Returns the offset of the chunk's size so that it can be filled in by scenario_file_end_chunk()
+static size_t scenario_file_begin_chunk(std::vector<uint8_t>& buffer, ScenarioChunkType type) {
+    scenario_file_write_u32(buffer, (uint32_t)type);
+    size_t size_offset = buffer.size();
+    scenario_file_write_u32(buffer, 0);
+
+    return size_offset;
+}
+
+static void scenario_file_end_chunk(std::vector<uint8_t>& buffer, size_t size_offset) {
+    uint32_t chunk_size = (uint32_t)(buffer.size() - size_offset - sizeof(uint32_t));
+    memcpy(&buffer[size_offset], &chunk_size, sizeof(chunk_size));
+}
+
+// Written as pairs of run length and value
+static void scenario_file_write_rle(std::vector<uint8_t>& buffer, const uint8_t* values, size_t length) {
+    size_t index = 0;
+    while (index < length) {
+        uint8_t value = values[index];
+        uint8_t run_length = 1;
+        while (index + run_length < length && values[index + run_length] == value && run_length < UINT8_MAX) {
+            run_length++;
+        }
+
+        scenario_file_write_u8(buffer, run_length);
+        scenario_file_write_u8(buffer, value);
+        index += run_length;
+    }
+}
+
+static const uint8_t* scenario_file_read(ScenarioFileReader& reader, size_t size) {
+    if (reader.has_error || reader.length - reader.head < size) {
+        reader.has_error = true;
+        return NULL;
+    }
+
+    const uint8_t* value = reader.data + reader.head;
+    reader.head += size;
+
+    return value;
+}
+
+static uint8_t scenario_file_read_u8(ScenarioFileReader& reader) {
+    const uint8_t* value = scenario_file_read(reader, sizeof(uint8_t));
+    return value == NULL ? 0 : *value;
+}
+
+static uint32_t scenario_file_read_u32(ScenarioFileReader& reader) {
+    uint32_t value = 0;
+    const uint8_t* data = scenario_file_read(reader, sizeof(uint32_t));
+    if (data != NULL) {
+        memcpy(&value, data, sizeof(value));
+    }
+
+    return value;
+}
+
+static ivec2 scenario_file_read_ivec2(ScenarioFileReader& reader) {
+    ivec2 value = ivec2(0, 0);
+    value.x = (int)scenario_file_read_u32(reader);
+    value.y = (int)scenario_file_read_u32(reader);
+
+    return value;
+}
+
+static std::string scenario_file_read_string(ScenarioFileReader& reader) {
+    uint32_t length = scenario_file_read_u32(reader);
+    const uint8_t* data = scenario_file_read(reader, length);
+    if (data == NULL) {
+        return std::string();
+    }
+
+    return std::string((const char*)data, length);
+}
+
+static void scenario_file_read_rle(ScenarioFileReader& reader, uint8_t* values, size_t length) {
+    size_t index = 0;
+    while (index < length && !reader.has_error) {
+        uint8_t run_length = scenario_file_read_u8(reader);
+        uint8_t value = scenario_file_read_u8(reader);
+        if (run_length == 0 || index + run_length > length) {
+            reader.has_error = true;
+            return;
+        }
+
+        memset(values + index, value, run_length);
+        index += run_length;
+    }
+}
+
+static bool scenario_save_file_binary(const Scenario* scenario, const char* full_path, const char* script_short_path) {
+    std::vector<uint8_t> buffer;
+    scenario_file_write_u32(buffer, SCENARIO_FILE_SIGNATURE);
+    scenario_file_write_u32(buffer, SCENARIO_FILE_VERSION);
+
+    // Info
+    size_t chunk = scenario_file_begin_chunk(buffer, SCENARIO_CHUNK_INFO);
+    scenario_file_write_string(buffer, script_short_path);
+    scenario_file_write_string(buffer, match_setting_data(MATCH_SETTING_MAP_TYPE).values.at(scenario->map.type).c_str());
+    scenario_file_write_ivec2(buffer, scenario->player_spawn);
+    scenario_file_end_chunk(buffer, chunk);
+
+    // Noise
+    chunk = scenario_file_begin_chunk(buffer, SCENARIO_CHUNK_NOISE);
+    scenario_file_write_u32(buffer, (uint32_t)scenario->noise->width);
+    scenario_file_write_u32(buffer, (uint32_t)scenario->noise->height);
+    scenario_file_write_rle(buffer, scenario->noise->map, scenario->noise->width * scenario->noise->height);
+    scenario_file_write_rle(buffer, scenario->noise->forest, scenario->noise->width * scenario->noise->height);
+    scenario_file_end_chunk(buffer, chunk);
+
+    // Decorations
+    chunk = scenario_file_begin_chunk(buffer, SCENARIO_CHUNK_DECORATIONS);
+    size_t decoration_count_offset = buffer.size();
+    uint32_t decoration_count = 0;
+    scenario_file_write_u32(buffer, 0);
+    for (int index = 0; index < scenario->map.width * scenario->map.height; index++) {
+        Cell map_cell = scenario->map.cells[CELL_LAYER_GROUND][index];
+        if (map_cell.type != CELL_DECORATION) {
+            continue;
+        }
+
+        scenario_file_write_u32(buffer, (uint32_t)index);
+        scenario_file_write(buffer, &map_cell.decoration_hframe, sizeof(map_cell.decoration_hframe));
+        decoration_count++;
+    }
+    memcpy(&buffer[decoration_count_offset], &decoration_count, sizeof(decoration_count));
+    scenario_file_end_chunk(buffer, chunk);
+
+    // Players
+    chunk = scenario_file_begin_chunk(buffer, SCENARIO_CHUNK_PLAYERS);
+    for (size_t index = 0; index < MAX_PLAYERS; index++) {
+        // Base player properties
+        scenario_file_write_string(buffer, scenario->players[index].name);
+        scenario_file_write_u8(buffer, scenario->players[index].team);
+        scenario_file_write_u8(buffer, scenario->players[index].recolor_id);
+        scenario_file_write_u32(buffer, scenario->players[index].starting_gold);
+
+        // Player config
+        if (index != 0) {
+            const BotConfig& bot_config = scenario->bot_config[index - 1];
+            scenario_file_write_string(buffer, bot_config_opener_str(bot_config.opener));
+            scenario_file_write_string(buffer, bot_config_unit_comp_str(bot_config.preferred_unit_comp));
+
+            uint32_t flag_count = 0;
+            for (uint32_t flag_index = 0; flag_index < BOT_CONFIG_FLAG_COUNT; flag_index++) {
+                flag_count += (uint32_t)bitflag_check(bot_config.flags, 1U << flag_index);
+            }
+            scenario_file_write_u32(buffer, flag_count);
+            for (uint32_t flag_index = 0; flag_index < BOT_CONFIG_FLAG_COUNT; flag_index++) {
+                uint32_t flag = 1U << flag_index;
+                if (bitflag_check(bot_config.flags, flag)) {
+                    scenario_file_write_string(buffer, bot_config_flag_str(flag));
+                }
+            }
+
+            scenario_file_write_u32(buffer, bot_config.target_base_count);
+            scenario_file_write_u32(buffer, bot_config.macro_cycle_cooldown);
+        }
+
+        // Allowed upgrades
+        uint32_t allowed_upgrades = index == 0
+            ? scenario->player_allowed_upgrades
+            : scenario->bot_config[index - 1].allowed_upgrades;
+        uint32_t upgrade_count = 0;
+        for (uint32_t upgrade_index = 0; upgrade_index < UPGRADE_COUNT; upgrade_index++) {
+            upgrade_count += (uint32_t)bitflag_check(allowed_upgrades, 1U << upgrade_index);
+        }
+        scenario_file_write_u32(buffer, upgrade_count);
+        for (uint32_t upgrade_index = 0; upgrade_index < UPGRADE_COUNT; upgrade_index++) {
+            uint32_t upgrade = 1U << upgrade_index;
+            if (bitflag_check(allowed_upgrades, upgrade)) {
+                scenario_file_write_string(buffer, upgrade_get_data(upgrade).name);
+            }
+        }
+
+        // Allowed entities
+        const bool* allowed_entities = index == 0
+            ? scenario->player_allowed_entities
+            : scenario->bot_config[index - 1].is_entity_allowed;
+        uint32_t allowed_entity_count = 0;
+        for (uint32_t entity_type = 0; entity_type < ENTITY_TYPE_COUNT; entity_type++) {
+            allowed_entity_count += (uint32_t)allowed_entities[entity_type];
+        }
+        scenario_file_write_u32(buffer, allowed_entity_count);
+        for (uint32_t entity_type = 0; entity_type < ENTITY_TYPE_COUNT; entity_type++) {
+            if (allowed_entities[entity_type]) {
+                scenario_file_write_string(buffer, entity_get_data((EntityType)entity_type).name);
+            }
+        }
+    }
+    scenario_file_end_chunk(buffer, chunk);
+
+    // Entities
+    chunk = scenario_file_begin_chunk(buffer, SCENARIO_CHUNK_ENTITIES);
+    scenario_file_write_u32(buffer, ENTITY_TYPE_COUNT);
+    for (uint32_t entity_type = 0; entity_type < ENTITY_TYPE_COUNT; entity_type++) {
+        scenario_file_write_string(buffer, entity_get_data((EntityType)entity_type).name);
+    }
+    scenario_file_write_u32(buffer, scenario->entity_count);
+    for (uint32_t entity_index = 0; entity_index < scenario->entity_count; entity_index++) {
+        const ScenarioEntity& entity = scenario->entities[entity_index];
+        scenario_file_write_u8(buffer, (uint8_t)entity.type);
+        scenario_file_write_u8(buffer, entity.player_id);
+        scenario_file_write_u32(buffer, entity.gold_held);
+        scenario_file_write_ivec2(buffer, entity.cell);
+    }
+    scenario_file_end_chunk(buffer, chunk);
+
+    // Squads
+    chunk = scenario_file_begin_chunk(buffer, SCENARIO_CHUNK_SQUADS);
+    scenario_file_write_u32(buffer, (uint32_t)scenario->squads.size());
+    for (const ScenarioSquad& squad : scenario->squads) {
+        scenario_file_write_string(buffer, squad.name);
+        scenario_file_write_u8(buffer, squad.player_id);
+        scenario_file_write_string(buffer, bot_squad_type_str(squad.type));
+        scenario_file_write_ivec2(buffer, squad.patrol_cell);
+        scenario_file_write_u32(buffer, squad.entity_count);
+        scenario_file_write(buffer, squad.entities, squad.entity_count * sizeof(uint32_t));
+    }
+    scenario_file_end_chunk(buffer, chunk);
+
+    // Constants
+    chunk = scenario_file_begin_chunk(buffer, SCENARIO_CHUNK_CONSTANTS);
+    scenario_file_write_u32(buffer, (uint32_t)scenario->constants.size());
+    for (const ScenarioConstant& constant : scenario->constants) {
+        scenario_file_write_string(buffer, constant.name);
+        scenario_file_write_string(buffer, scenario_constant_type_str(constant.type));
+        switch (constant.type) {
+            case SCENARIO_CONSTANT_TYPE_ENTITY: {
+                scenario_file_write_u32(buffer, constant.entity_index);
+                break;
+            }
+            case SCENARIO_CONSTANT_TYPE_CELL: {
+                scenario_file_write_ivec2(buffer, constant.cell);
+                break;
+            }
+            case SCENARIO_CONSTANT_TYPE_COUNT: {
+                GOLD_ASSERT(false);
+                break;
+            }
+        }
+    }
+    scenario_file_end_chunk(buffer, chunk);
+
+    FILE* file = fopen(full_path, "wb");
+    if (file == NULL) {
+        log_error("Unable to save scenario at path %s", full_path);
+        return false;
+    }
+    size_t bytes_written = fwrite(buffer.data(), 1, buffer.size(), file);
+    fclose(file);
+    if (bytes_written != buffer.size()) {
+        log_error("Unable to save scenario at path %s. Wrote %u of %u bytes.", full_path, bytes_written, buffer.size());
+        return false;
+    }
+
+    log_info("Scenario %s saved successfully.", full_path);
+    return true;
+}
+
+static bool scenario_file_read_info_chunk(ScenarioFileReader& reader, MapType* map_type, ivec2* player_spawn, std::string* script_short_path) {
+    *script_short_path = scenario_file_read_string(reader);
+    std::string map_type_str = scenario_file_read_string(reader);
+    *map_type = scenario_map_type_from_str(map_type_str.c_str());
+    *player_spawn = scenario_file_read_ivec2(reader);
+
+    if (*map_type == MAP_TYPE_COUNT) {
+        log_error("Scenario map type %s not recognized.", map_type_str.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void scenario_file_read_players_chunk(ScenarioFileReader& reader, Scenario* scenario) {
+    for (size_t index = 0; index < MAX_PLAYERS; index++) {
+        // Base player properties
+        strncpy(scenario->players[index].name, scenario_file_read_string(reader).c_str(), MAX_USERNAME_LENGTH);
+        scenario->players[index].team = scenario_file_read_u8(reader);
+        scenario->players[index].recolor_id = scenario_file_read_u8(reader);
+        scenario->players[index].starting_gold = scenario_file_read_u32(reader);
+
+        // Player config
+        if (index != 0) {
+            scenario->bot_config[index - 1] = bot_config_init();
+            BotConfig& bot_config = scenario->bot_config[index - 1];
+            bot_config.opener = bot_config_opener_from_str(scenario_file_read_string(reader).c_str());
+            bot_config.preferred_unit_comp = bot_config_unit_comp_from_str(scenario_file_read_string(reader).c_str());
+
+            uint32_t flag_count = scenario_file_read_u32(reader);
+            for (uint32_t flag_index = 0; flag_index < flag_count && !reader.has_error; flag_index++) {
+                std::string flag_str = scenario_file_read_string(reader);
+                uint32_t flag = bot_config_flag_from_str(flag_str.c_str());
+                if (flag == BOT_CONFIG_FLAG_COUNT) {
+                    log_warn("Bot config flag %s for player %u not recognized.", flag_str.c_str(), index);
+                    continue;
+                }
+                bot_config.flags |= flag;
+            }
+
+            bot_config.target_base_count = scenario_file_read_u32(reader);
+            bot_config.macro_cycle_cooldown = scenario_file_read_u32(reader);
+        }
+
+        // Allowed upgrades
+        uint32_t* allowed_upgrades = index == 0
+            ? &scenario->player_allowed_upgrades
+            : &scenario->bot_config[index - 1].allowed_upgrades;
+        *allowed_upgrades = 0;
+        uint32_t upgrade_count = scenario_file_read_u32(reader);
+        for (uint32_t upgrade_count_index = 0; upgrade_count_index < upgrade_count && !reader.has_error; upgrade_count_index++) {
+            std::string upgrade_str = scenario_file_read_string(reader);
+            uint32_t upgrade_index;
+            for (upgrade_index = 0; upgrade_index < UPGRADE_COUNT; upgrade_index++) {
+                if (strcmp(upgrade_str.c_str(), upgrade_get_data(1U << upgrade_index).name) == 0) {
+                    break;
+                }
+            }
+
+            if (upgrade_index < UPGRADE_COUNT) {
+                *allowed_upgrades |= 1U << upgrade_index;
+            } else {
+                log_warn("Allowed upgrade %s for player %u not recognized.", upgrade_str.c_str(), index);
+            }
+        }
+
+        // Allowed entities
+        bool* allowed_entities = index == 0
+            ? scenario->player_allowed_entities
+            : scenario->bot_config[index - 1].is_entity_allowed;
+        memset(allowed_entities, 0, ENTITY_TYPE_COUNT * sizeof(bool));
+        uint32_t allowed_entity_count = scenario_file_read_u32(reader);
+        for (uint32_t allowed_entity_index = 0; allowed_entity_index < allowed_entity_count && !reader.has_error; allowed_entity_index++) {
+            std::string entity_str = scenario_file_read_string(reader);
+            EntityType entity_type = entity_type_from_str(entity_str.c_str());
+            if (entity_type < ENTITY_TYPE_COUNT) {
+                allowed_entities[entity_type] = true;
+            } else {
+                log_warn("Allowed entity %s for player %u not recognized.", entity_str.c_str(), index);
+            }
+        }
+    }
+}
+
+static void scenario_file_read_entities_chunk(ScenarioFileReader& reader, Scenario* scenario) {
+    // Map the entity types as they were when the file was saved onto the current ones
+    EntityType entity_types[UINT8_MAX + 1];
+    uint32_t entity_type_count = scenario_file_read_u32(reader);
+    if (entity_type_count > UINT8_MAX + 1) {
+        reader.has_error = true;
+        return;
+    }
+    for (uint32_t index = 0; index < entity_type_count; index++) {
+        std::string entity_str = scenario_file_read_string(reader);
+        entity_types[index] = entity_type_from_str(entity_str.c_str());
+    }
+
+    uint32_t entity_count = scenario_file_read_u32(reader);
+    for (uint32_t entity_index = 0; entity_index < entity_count && !reader.has_error; entity_index++) {
+        uint8_t entity_type_index = scenario_file_read_u8(reader);
+
+        ScenarioEntity entity;
+        entity.player_id = scenario_file_read_u8(reader);
+        entity.gold_held = scenario_file_read_u32(reader);
+        entity.cell = scenario_file_read_ivec2(reader);
+        if (reader.has_error) {
+            break;
+        }
+
+        if (entity_type_index >= entity_type_count || entity_types[entity_type_index] == ENTITY_TYPE_COUNT) {
+            log_warn("Entity type index %u for entity index %u not recognized.", entity_type_index, entity_index);
+            continue;
+        }
+        entity.type = entity_types[entity_type_index];
+        if (scenario->entity_count == MATCH_MAX_ENTITIES ||
+                !map_is_cell_rect_in_bounds(scenario->map, entity.cell, entity_get_data(entity.type).cell_size)) {
+            reader.has_error = true;
+            break;
+        }
+
+        scenario_push_entity(scenario, entity);
+    }
+}
+
+static void scenario_file_read_squads_chunk(ScenarioFileReader& reader, Scenario* scenario) {
+    uint32_t squad_count = scenario_file_read_u32(reader);
+    for (uint32_t squad_index = 0; squad_index < squad_count && !reader.has_error; squad_index++) {
+        ScenarioSquad squad;
+        strncpy(squad.name, scenario_file_read_string(reader).c_str(), MAX_USERNAME_LENGTH);
+        squad.player_id = scenario_file_read_u8(reader);
+        std::string squad_type_str = scenario_file_read_string(reader);
+        squad.patrol_cell = scenario_file_read_ivec2(reader);
+
+        uint32_t squad_entity_count = scenario_file_read_u32(reader);
+        const uint8_t* squad_entities = scenario_file_read(reader, (size_t)squad_entity_count * sizeof(uint32_t));
+        if (reader.has_error) {
+            break;
+        }
+
+        squad.type = bot_squad_type_from_str(squad_type_str.c_str());
+        if (squad.type == BOT_SQUAD_TYPE_COUNT) {
+            log_warn("Squad type %s for squad %u not recognized.", squad_type_str.c_str(), squad_index);
+            continue;
+        }
+
+        squad.entity_count = 0;
+        for (uint32_t squad_entities_index = 0; squad_entities_index < squad_entity_count; squad_entities_index++) {
+            uint32_t entity_index;
+            memcpy(&entity_index, squad_entities + (squad_entities_index * sizeof(uint32_t)), sizeof(uint32_t));
+            if (entity_index >= scenario->entity_count || squad.entity_count == SCENARIO_SQUAD_MAX_ENTITIES) {
+                log_warn("Entity index %u for squad %u (%s) is out of range.", entity_index, squad_index, squad.name);
+                continue;
+            }
+            squad.entities[squad.entity_count] = entity_index;
+            squad.entity_count++;
+        }
+
+        scenario->squads.push_back(squad);
+    }
+}
+
+static void scenario_file_read_constants_chunk(ScenarioFileReader& reader, Scenario* scenario) {
+    uint32_t constant_count = scenario_file_read_u32(reader);
+    for (uint32_t constant_index = 0; constant_index < constant_count && !reader.has_error; constant_index++) {
+        ScenarioConstant constant;
+        strncpy(constant.name, scenario_file_read_string(reader).c_str(), SCENARIO_CONSTANT_NAME_BUFFER_LENGTH - 1);
+        constant.name[SCENARIO_CONSTANT_NAME_BUFFER_LENGTH - 1] = '\0';
+
+        std::string constant_type_str = scenario_file_read_string(reader);
+        constant.type = scenario_constant_type_from_str(constant_type_str.c_str());
+        switch (constant.type) {
+            case SCENARIO_CONSTANT_TYPE_ENTITY: {
+                constant.entity_index = scenario_file_read_u32(reader);
+                break;
+            }
+            case SCENARIO_CONSTANT_TYPE_CELL: {
+                constant.cell = scenario_file_read_ivec2(reader);
+                break;
+            }
+            case SCENARIO_CONSTANT_TYPE_COUNT: {
+                // The payload size depends on the type, so the rest of the chunk can't be read
+                log_warn("Constant type %s for constant %u:%s not recognized.", constant_type_str.c_str(), constant_index, constant.name);
+                return;
+            }
+        }
+
+        if (!reader.has_error) {
+            scenario->constants.push_back(constant);
+        }
+    }
+}
+
+static Scenario* scenario_open_file_binary(const char* path, std::string* script_short_path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        log_error("Unable to open scenario at path %s", path);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<uint8_t> data(file_length > 0 ? (size_t)file_length : 0);
+    size_t bytes_read = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+    if (file_length <= 0 || bytes_read != data.size()) {
+        log_error("Unable to read scenario at path %s", path);
+        return NULL;
+    }
+
+    ScenarioFileReader reader = (ScenarioFileReader) {
+        .data = data.data(),
+        .length = data.size(),
+        .head = 0,
+        .has_error = false
+    };
+    Scenario* scenario = NULL;
+    MapType map_type = MAP_TYPE_COUNT;
+
+    {
+        // Signature
+        uint32_t signature = scenario_file_read_u32(reader);
+        if (signature != SCENARIO_FILE_SIGNATURE) {
+            log_error("Scenario file signature was invalid %s.", path);
+            goto error;
+        }
+
+        // Version
+        uint32_t version = scenario_file_read_u32(reader);
+        log_debug("Scenario version: %u", version);
+        if (version > SCENARIO_FILE_VERSION) {
+            log_error("Scenario file version %u is newer than supported version %u.", version, SCENARIO_FILE_VERSION);
+            goto error;
+        }
+
+        // Init scenario
+        scenario = scenario_base_init();
+
+        while (reader.head < reader.length && !reader.has_error) {
+            uint32_t chunk_type = scenario_file_read_u32(reader);
+            uint32_t chunk_size = scenario_file_read_u32(reader);
+            const uint8_t* chunk_data = scenario_file_read(reader, chunk_size);
+            if (chunk_data == NULL) {
+                break;
+            }
+
+            ScenarioFileReader chunk_reader = (ScenarioFileReader) {
+                .data = chunk_data,
+                .length = chunk_size,
+                .head = 0,
+                .has_error = false
+            };
+
+            // The map is baked after the noise is read, so info and noise have to come before the chunks that write to the map
+            if (chunk_type != SCENARIO_CHUNK_INFO && chunk_type != SCENARIO_CHUNK_NOISE && scenario->noise == NULL) {
+                log_error("Scenario chunk %u came before the noise chunk.", chunk_type);
+                goto error;
+            }
+
+            switch (chunk_type) {
+                case SCENARIO_CHUNK_INFO: {
+                    if (!scenario_file_read_info_chunk(chunk_reader, &map_type, &scenario->player_spawn, script_short_path)) {
+                        goto error;
+                    }
+                    break;
+                }
+                case SCENARIO_CHUNK_NOISE: {
+                    if (map_type == MAP_TYPE_COUNT || scenario->noise != NULL) {
+                        log_error("Scenario noise chunk was out of order.");
+                        goto error;
+                    }
+
+                    int noise_width = (int)scenario_file_read_u32(chunk_reader);
+                    int noise_height = (int)scenario_file_read_u32(chunk_reader);
+                    if (noise_width <= 0 || noise_width > MAP_SIZE_MAX || noise_height <= 0 || noise_height > MAP_SIZE_MAX) {
+                        log_error("Scenario noise size %ix%i is invalid.", noise_width, noise_height);
+                        goto error;
+                    }
+
+                    scenario->noise = noise_init(noise_width, noise_height);
+                    scenario_file_read_rle(chunk_reader, scenario->noise->map, noise_width * noise_height);
+                    scenario_file_read_rle(chunk_reader, scenario->noise->forest, noise_width * noise_height);
+                    if (chunk_reader.has_error) {
+                        break;
+                    }
+
+                    // Init map
+                    map_init(scenario->map, map_type, scenario->noise->width, scenario->noise->height);
+                    scenario_bake_map(scenario, false);
+                    break;
+                }
+                case SCENARIO_CHUNK_DECORATIONS: {
+                    uint32_t decoration_count = scenario_file_read_u32(chunk_reader);
+                    for (uint32_t decoration_index = 0; decoration_index < decoration_count && !chunk_reader.has_error; decoration_index++) {
+                        uint32_t cell_index = scenario_file_read_u32(chunk_reader);
+                        uint16_t decoration_hframe;
+                        const uint8_t* decoration_hframe_data = scenario_file_read(chunk_reader, sizeof(decoration_hframe));
+                        if (decoration_hframe_data == NULL || cell_index >= (uint32_t)(scenario->map.width * scenario->map.height)) {
+                            chunk_reader.has_error = true;
+                            break;
+                        }
+
+                        memcpy(&decoration_hframe, decoration_hframe_data, sizeof(decoration_hframe));
+                        scenario->map.cells[CELL_LAYER_GROUND][cell_index] = (Cell) {
+                            .type = CELL_DECORATION,
+                            .decoration_hframe = decoration_hframe
+                        };
+                    }
+                    break;
+                }
+                case SCENARIO_CHUNK_PLAYERS: {
+                    scenario_file_read_players_chunk(chunk_reader, scenario);
+                    break;
+                }
+                case SCENARIO_CHUNK_ENTITIES: {
+                    scenario_file_read_entities_chunk(chunk_reader, scenario);
+                    break;
+                }
+                case SCENARIO_CHUNK_SQUADS: {
+                    scenario_file_read_squads_chunk(chunk_reader, scenario);
+                    break;
+                }
+                case SCENARIO_CHUNK_CONSTANTS: {
+                    scenario_file_read_constants_chunk(chunk_reader, scenario);
+                    break;
+                }
+                default: {
+                    log_warn("Scenario chunk type %u not recognized. Skipping.", chunk_type);
+                    break;
+                }
+            }
+
+            if (chunk_reader.has_error) {
+                log_error("Scenario chunk %u in %s is corrupt.", chunk_type, path);
+                goto error;
+            }
+        }
+
+        if (reader.has_error || scenario->noise == NULL) {
+            log_error("Scenario file %s is truncated.", path);
+            goto error;
+        }
+
+        log_info("Loaded scenario %s.", path);
+
+        return scenario;
+    }
+error:
+    if (scenario != NULL) {
+        scenario_free(scenario);
+    }
+
+    return NULL;
+}
+
+bool scenario_save_file(const Scenario* scenario, const char* full_path, const char* script_short_path) {
+    if (string_ends_with(full_path, SCENARIO_BINARY_FILE_EXTENSION)) {
+        return scenario_save_file_binary(scenario, full_path, script_short_path);
+    }
+
+    return scenario_save_file_json(scenario, full_path, script_short_path);
+}
+
+Scenario* scenario_open_file(const char* path, std::string* script_short_path) {
+    ZoneScoped;
+
+    if (string_ends_with(path, SCENARIO_BINARY_FILE_EXTENSION)) {
+        return scenario_open_file_binary(path, script_short_path);
+    }
+
+    return scenario_open_file_json(path, script_short_path);
+}
+
+bool scenario_convert_file(const char* path) {
+    std::string out_path = std::string(path);
+    out_path = out_path.substr(0, out_path.find_last_of('.'));
+    out_path += string_ends_with(path, SCENARIO_BINARY_FILE_EXTENSION) ? ".json" : SCENARIO_BINARY_FILE_EXTENSION;
+
+    std::string script_short_path;
+    Scenario* scenario = scenario_open_file(path, &script_short_path);
+    if (scenario == NULL) {
+        return false;
+    }
+
+    bool success = scenario_save_file(scenario, out_path.c_str(), script_short_path.c_str());
+    scenario_free(scenario);
+
+    return success;
+}
@@ -10,6 +10,7 @@
 
 #define SCENARIO_SQUAD_MAX_ENTITIES SELECTION_LIMIT
 #define SCENARIO_CONSTANT_NAME_BUFFER_LENGTH 32
+#define SCENARIO_BINARY_FILE_EXTENSION ".scn"
 
 struct ScenarioPlayer {
     uint8_t team;
@@ -71,6 +72,8 @@ struct Scenario {
 Scenario* scenario_init_blank(MapType map_type, MapSize map_size);
 Scenario* scenario_init_generated(MapType map_type, const NoiseGenParams& params);
 void scenario_bake_map(Scenario* scenario, bool remove_artifacts = false);
+// Rebakes only the part of the map that is affected by noise changes inside the rect (inclusive)
+void scenario_bake_map_rect(Scenario* scenario, ivec2 cell_min, ivec2 cell_max);
 void scenario_free(Scenario* scenario);
 
 ScenarioSquad scenario_squad_init();
@@ -83,5 +86,8 @@ void scenario_constant_set_type(ScenarioConstant& constant, ScenarioConstantType
 uint8_t scenario_get_noise_map_value(Scenario* scenario, ivec2 cell);
 void scenario_set_noise_map_value(Scenario* scenario, ivec2 cell, uint8_t value);
 
-bool scenario_save_file(const Scenario* scenario, const char* json_full_path, const char* script_short_path);
-Scenario* scenario_open_file(const char* path, std::string* script_short_path);
\ No newline at end of file
+// Scenarios are saved and opened as binary if the path ends with SCENARIO_BINARY_FILE_EXTENSION, and as JSON otherwise
+bool scenario_save_file(const Scenario* scenario, const char* full_path, const char* script_short_path);
+Scenario* scenario_open_file(const char* path, std::string* script_short_path);
+// Converts a JSON scenario to binary or a binary scenario to JSON, saving it next to the original
+bool scenario_convert_file(const char* path);
\ No newline at end of file
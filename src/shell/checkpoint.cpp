@@ -0,0 +1,311 @@
+#include "checkpoint.h"
+
+#include "core/asserts.h"
+#include "profile/profile.h"
+#include <algorithm>
+#include <cstring>
+
+void replay_checkpoint_store_init(ReplayCheckpointStore& store, size_t memory_budget) {
+    store.checkpoints.clear();
+    store.memory_usage = 0;
+    store.memory_budget = memory_budget;
+    store.focus_frame = 0;
+}
+
+void replay_checkpoint_encoder_reset(ReplayCheckpointEncoder& encoder, const MatchState& state) {
+    const uint8_t* state_data = (const uint8_t*)&state;
+    encoder.previous_state.assign(state_data, state_data + sizeof(MatchState));
+}
+
+ReplayCheckpoint replay_checkpoint_encode_keyframe(ReplayCheckpointEncoder& encoder, const MatchState& state, uint32_t frame) {
+    ZoneScoped;
+    GOLD_ASSERT(frame % REPLAY_CHECKPOINT_CHAIN_DURATION == 0);
+
+    const uint8_t* state_data = (const uint8_t*)&state;
+
+    ReplayCheckpoint checkpoint;
+    checkpoint.frame = frame;
+    checkpoint.is_keyframe = true;
+    replay_checkpoint_xor_encode(NULL, state_data, sizeof(MatchState), checkpoint.data);
+    checkpoint.data.shrink_to_fit();
+
+    replay_checkpoint_encoder_reset(encoder, state);
+
+    return checkpoint;
+}
+
+ReplayCheckpoint replay_checkpoint_encode_delta(ReplayCheckpointEncoder& encoder, const MatchState& state, uint32_t frame) {
+    ZoneScoped;
+    GOLD_ASSERT(frame % REPLAY_CHECKPOINT_FREQ == 0 && frame % REPLAY_CHECKPOINT_CHAIN_DURATION != 0);
+    GOLD_ASSERT(encoder.previous_state.size() == sizeof(MatchState));
+
+    const uint8_t* state_data = (const uint8_t*)&state;
+
+    ReplayCheckpoint checkpoint;
+    checkpoint.frame = frame;
+    checkpoint.is_keyframe = false;
+    replay_checkpoint_xor_encode(encoder.previous_state.data(), state_data, sizeof(MatchState), checkpoint.data);
+    checkpoint.data.shrink_to_fit();
+
+    replay_checkpoint_encoder_reset(encoder, state);
+
+    return checkpoint;
+}
+
+static uint32_t replay_checkpoint_get_chain_frame(uint32_t frame) {
+    return frame - (frame % REPLAY_CHECKPOINT_CHAIN_DURATION);
+}
+
+static uint32_t replay_checkpoint_get_distance_to_focus(const ReplayCheckpointStore& store, uint32_t chain_frame) {
+    uint32_t focus_chain_frame = replay_checkpoint_get_chain_frame(store.focus_frame);
+    return chain_frame > focus_chain_frame 
+        ? chain_frame - focus_chain_frame 
+        : focus_chain_frame - chain_frame;
+}
+
+static void replay_checkpoint_store_enforce_memory_budget(ReplayCheckpointStore& store) {
+    if (store.memory_usage <= store.memory_budget) {
+        return;
+    }
+
+    // Drop whole delta chains, furthest from the focus frame first, until we are back under budget
+    // The focus chain itself is never dropped because that is where the replay is being watched
+    std::vector<uint32_t> chain_frames;
+    for (const ReplayCheckpoint& checkpoint : store.checkpoints) {
+        uint32_t chain_frame = replay_checkpoint_get_chain_frame(checkpoint.frame);
+        if (!checkpoint.is_keyframe && (chain_frames.empty() || chain_frames.back() != chain_frame) &&
+                chain_frame != replay_checkpoint_get_chain_frame(store.focus_frame)) {
+            chain_frames.push_back(chain_frame);
+        }
+    }
+    std::sort(chain_frames.begin(), chain_frames.end(), [&store](uint32_t a, uint32_t b) {
+        return replay_checkpoint_get_distance_to_focus(store, a) > replay_checkpoint_get_distance_to_focus(store, b);
+    });
+
+    for (uint32_t chain_frame : chain_frames) {
+        if (store.memory_usage <= store.memory_budget) {
+            break;
+        }
+
+        auto chain_begin = std::lower_bound(store.checkpoints.begin(), store.checkpoints.end(), chain_frame + 1, [](const ReplayCheckpoint& checkpoint, uint32_t value) {
+            return checkpoint.frame < value;
+        });
+        auto chain_end = std::lower_bound(chain_begin, store.checkpoints.end(), chain_frame + REPLAY_CHECKPOINT_CHAIN_DURATION, [](const ReplayCheckpoint& checkpoint, uint32_t value) {
+            return checkpoint.frame < value;
+        });
+        for (auto it = chain_begin; it != chain_end; it++) {
+            store.memory_usage -= it->data.capacity();
+        }
+        store.checkpoints.erase(chain_begin, chain_end);
+    }
+
+    // If that wasn't enough, thin out the keyframes that no longer have a chain by removing every other one
+    // The first keyframe is always kept so that every frame can still be reached
+    while (store.memory_usage > store.memory_budget) {
+        size_t write_index = 0;
+        bool should_remove_next_keyframe = false;
+        bool has_removed_keyframe = false;
+        for (size_t read_index = 0; read_index < store.checkpoints.size(); read_index++) {
+            ReplayCheckpoint& checkpoint = store.checkpoints[read_index];
+            bool has_chain = read_index + 1 < store.checkpoints.size() && !store.checkpoints[read_index + 1].is_keyframe;
+            if (checkpoint.is_keyframe && read_index != 0 && !has_chain) {
+                if (should_remove_next_keyframe) {
+                    store.memory_usage -= checkpoint.data.capacity();
+                    has_removed_keyframe = true;
+                    should_remove_next_keyframe = false;
+                    continue;
+                }
+                should_remove_next_keyframe = true;
+            }
+
+            if (write_index != read_index) {
+                store.checkpoints[write_index] = std::move(checkpoint);
+            }
+            write_index++;
+        }
+        store.checkpoints.resize(write_index);
+
+        if (!has_removed_keyframe) {
+            break;
+        }
+    }
+}
+
+static size_t replay_checkpoint_store_lower_bound(const ReplayCheckpointStore& store, uint32_t frame) {
+    auto it = std::lower_bound(store.checkpoints.begin(), store.checkpoints.end(), frame, [](const ReplayCheckpoint& checkpoint, uint32_t value) {
+        return checkpoint.frame < value;
+    });
+    return (size_t)(it - store.checkpoints.begin());
+}
+
+bool replay_checkpoint_store_insert(ReplayCheckpointStore& store, ReplayCheckpoint&& checkpoint) {
+    GOLD_ASSERT(checkpoint.frame % REPLAY_CHECKPOINT_FREQ == 0);
+    GOLD_ASSERT(checkpoint.is_keyframe == (checkpoint.frame % REPLAY_CHECKPOINT_CHAIN_DURATION == 0));
+
+    if (replay_checkpoint_store_has_frame(store, checkpoint.frame)) {
+        return true;
+    }
+    if (!checkpoint.is_keyframe && !replay_checkpoint_store_has_frame(store, checkpoint.frame - REPLAY_CHECKPOINT_FREQ)) {
+        return false;
+    }
+
+    size_t index = replay_checkpoint_store_lower_bound(store, checkpoint.frame);
+    store.memory_usage += checkpoint.data.capacity();
+    store.checkpoints.insert(store.checkpoints.begin() + index, std::move(checkpoint));
+    replay_checkpoint_store_enforce_memory_budget(store);
+
+    return true;
+}
+
+void replay_checkpoint_store_set_focus_frame(ReplayCheckpointStore& store, uint32_t frame) {
+    store.focus_frame = frame;
+}
+
+bool replay_checkpoint_store_is_empty(const ReplayCheckpointStore& store) {
+    return store.checkpoints.empty();
+}
+
+bool replay_checkpoint_store_has_room_for_chain(const ReplayCheckpointStore& store) {
+    if (store.checkpoints.empty()) {
+        return true;
+    }
+
+    // Keyframes are larger than deltas, so this overestimates, which is what we want here
+    size_t estimated_chain_size = (store.memory_usage / store.checkpoints.size()) * (REPLAY_CHECKPOINT_KEYFRAME_INTERVAL - 1);
+    return store.memory_usage + estimated_chain_size <= store.memory_budget;
+}
+
+bool replay_checkpoint_store_has_frame(const ReplayCheckpointStore& store, uint32_t frame) {
+    size_t index = replay_checkpoint_store_lower_bound(store, frame);
+    return index < store.checkpoints.size() && store.checkpoints[index].frame == frame;
+}
+
+static size_t replay_checkpoint_store_get_nearest_index(const ReplayCheckpointStore& store, uint32_t frame) {
+    GOLD_ASSERT(!store.checkpoints.empty() && store.checkpoints[0].frame <= frame);
+
+    auto it = std::upper_bound(store.checkpoints.begin(), store.checkpoints.end(), frame, [](uint32_t value, const ReplayCheckpoint& checkpoint) {
+        return value < checkpoint.frame;
+    });
+    return (size_t)(it - store.checkpoints.begin()) - 1;
+}
+
+uint32_t replay_checkpoint_store_get_nearest_frame(const ReplayCheckpointStore& store, uint32_t frame) {
+    return store.checkpoints[replay_checkpoint_store_get_nearest_index(store, frame)].frame;
+}
+
+uint32_t replay_checkpoint_store_load(const ReplayCheckpointStore& store, uint32_t frame, MatchState& state) {
+    ZoneScoped;
+
+    size_t checkpoint_index = replay_checkpoint_store_get_nearest_index(store, frame);
+    size_t keyframe_index = checkpoint_index;
+    while (!store.checkpoints[keyframe_index].is_keyframe) {
+        keyframe_index--;
+    }
+
+    uint8_t* state_data = (uint8_t*)&state;
+    memset(state_data, 0, sizeof(MatchState));
+    for (size_t index = keyframe_index; index <= checkpoint_index; index++) {
+        replay_checkpoint_xor_apply(store.checkpoints[index].data, state_data, sizeof(MatchState));
+    }
+
+    return store.checkpoints[checkpoint_index].frame;
+}
+
+// Encoding
+
+static void replay_checkpoint_write_varint(std::vector<uint8_t>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static size_t replay_checkpoint_read_varint(const std::vector<uint8_t>& in, size_t& head) {
+    size_t value = 0;
+    uint32_t shift = 0;
+    while (true) {
+        GOLD_ASSERT(head < in.size());
+        uint8_t byte = in[head];
+        head++;
+        value |= (size_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+static bool replay_checkpoint_is_word_unchanged(const uint8_t* base, const uint8_t* data, size_t index) {
+    uint64_t data_word;
+    memcpy(&data_word, data + index, sizeof(data_word));
+    if (base == NULL) {
+        return data_word == 0;
+    }
+
+    uint64_t base_word;
+    memcpy(&base_word, base + index, sizeof(base_word));
+    return data_word == base_word;
+}
+
+static bool replay_checkpoint_is_byte_unchanged(const uint8_t* base, const uint8_t* data, size_t index) {
+    return data[index] == (base == NULL ? 0 : base[index]);
+}
+
+/**
+ * Encodes data as a list of runs. Each run is a varint count of bytes that are unchanged from base,
+ * followed by a varint count of changed bytes, followed by the changed bytes XOR'd with base.
+ * A base of NULL is treated as all zeroes. Runs are found at 8-byte granularity.
+ */
+void replay_checkpoint_xor_encode(const uint8_t* base, const uint8_t* data, size_t length, std::vector<uint8_t>& out) {
+    out.clear();
+
+    size_t index = 0;
+    while (index < length) {
+        // Skip unchanged bytes
+        size_t skip_start = index;
+        while (index + sizeof(uint64_t) <= length && replay_checkpoint_is_word_unchanged(base, data, index)) {
+            index += sizeof(uint64_t);
+        }
+        if (index + sizeof(uint64_t) > length) {
+            while (index < length && replay_checkpoint_is_byte_unchanged(base, data, index)) {
+                index++;
+            }
+        }
+        if (index == length) {
+            break;
+        }
+
+        // Collect changed bytes
+        size_t literal_start = index;
+        while (index + sizeof(uint64_t) <= length && !replay_checkpoint_is_word_unchanged(base, data, index)) {
+            index += sizeof(uint64_t);
+        }
+        if (index + sizeof(uint64_t) > length) {
+            index = length;
+        }
+
+        replay_checkpoint_write_varint(out, literal_start - skip_start);
+        replay_checkpoint_write_varint(out, index - literal_start);
+        for (size_t literal_index = literal_start; literal_index < index; literal_index++) {
+            out.push_back(base == NULL ? data[literal_index] : data[literal_index] ^ base[literal_index]);
+        }
+    }
+}
+
+void replay_checkpoint_xor_apply(const std::vector<uint8_t>& encoded, uint8_t* data, size_t length) {
+    size_t head = 0;
+    size_t index = 0;
+    while (head < encoded.size()) {
+        index += replay_checkpoint_read_varint(encoded, head);
+        size_t literal_length = replay_checkpoint_read_varint(encoded, head);
+        GOLD_ASSERT(index + literal_length <= length && head + literal_length <= encoded.size());
+
+        const uint8_t* literal = encoded.data() + head;
+        for (size_t literal_index = 0; literal_index < literal_length; literal_index++) {
+            data[index + literal_index] ^= literal[literal_index];
+        }
+        head += literal_length;
+        index += literal_length;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "defines.h"
+#include "match/state.h"
+#include <vector>
+
+/**
+ * Replay checkpoints are stored as a keyframe followed by a chain of deltas.
+ *
+ * Both keyframes and deltas are XOR / zero-run encoded against the bytes of a base state.
+ * A keyframe's base is an all-zero state, while a delta's base is the checkpoint before it.
+ * Restoring a checkpoint costs one keyframe decode plus at most REPLAY_CHECKPOINT_KEYFRAME_INTERVAL - 1 delta applies.
+ *
+ * Checkpoints are REPLAY_CHECKPOINT_FREQ frames apart and every chain covers REPLAY_CHECKPOINT_CHAIN_DURATION frames,
+ * so the keyframe of every chain can be recorded first and the deltas filled in later, in any chain order.
+ *
+ * When the store goes over its memory budget, it first drops the delta chains that are furthest from the focus frame,
+ * and then thins out the remaining keyframes. Either way, loading falls back to the nearest checkpoint that is still available.
+ */
+
+const uint32_t REPLAY_CHECKPOINT_FREQ = 32U;
+const uint32_t REPLAY_CHECKPOINT_KEYFRAME_INTERVAL = 16U;
+const uint32_t REPLAY_CHECKPOINT_CHAIN_DURATION = REPLAY_CHECKPOINT_FREQ * REPLAY_CHECKPOINT_KEYFRAME_INTERVAL;
+const size_t REPLAY_CHECKPOINT_MEMORY_BUDGET_DEFAULT = 512ULL * 1024ULL * 1024ULL;
+
+struct ReplayCheckpoint {
+    uint32_t frame;
+    bool is_keyframe;
+    std::vector<uint8_t> data;
+};
+
+struct ReplayCheckpointStore {
+    // Sorted by frame
+    std::vector<ReplayCheckpoint> checkpoints;
+    size_t memory_usage;
+    size_t memory_budget;
+    // The chain around this frame is the last to be dropped when over budget
+    uint32_t focus_frame;
+};
+
+// Each thread that encodes deltas owns one of these
+struct ReplayCheckpointEncoder {
+    std::vector<uint8_t> previous_state;
+};
+
+void replay_checkpoint_store_init(ReplayCheckpointStore& store, size_t memory_budget);
+// Used when a thread resumes encoding from a checkpoint that was loaded from the store
+void replay_checkpoint_encoder_reset(ReplayCheckpointEncoder& encoder, const MatchState& state);
+
+// Encoding does not touch the store, so it can be done without holding the lock that guards the store
+ReplayCheckpoint replay_checkpoint_encode_keyframe(ReplayCheckpointEncoder& encoder, const MatchState& state, uint32_t frame);
+// Encodes state against the state that was last encoded by this encoder
+ReplayCheckpoint replay_checkpoint_encode_delta(ReplayCheckpointEncoder& encoder, const MatchState& state, uint32_t frame);
+
+// Returns false without inserting if the checkpoint is a delta and the checkpoint it was encoded against is not in the store
+bool replay_checkpoint_store_insert(ReplayCheckpointStore& store, ReplayCheckpoint&& checkpoint);
+void replay_checkpoint_store_set_focus_frame(ReplayCheckpointStore& store, uint32_t frame);
+
+bool replay_checkpoint_store_is_empty(const ReplayCheckpointStore& store);
+// Estimates the size of a full chain from the checkpoints already in the store
+bool replay_checkpoint_store_has_room_for_chain(const ReplayCheckpointStore& store);
+bool replay_checkpoint_store_has_frame(const ReplayCheckpointStore& store, uint32_t frame);
+// Returns the frame of the latest checkpoint at or before the given frame
+uint32_t replay_checkpoint_store_get_nearest_frame(const ReplayCheckpointStore& store, uint32_t frame);
+// Restores the latest checkpoint at or before the given frame into state and returns the checkpoint's frame
+uint32_t replay_checkpoint_store_load(const ReplayCheckpointStore& store, uint32_t frame, MatchState& state);
+
+void replay_checkpoint_xor_encode(const uint8_t* base, const uint8_t* data, size_t length, std::vector<uint8_t>& out);
+void replay_checkpoint_xor_apply(const std::vector<uint8_t>& encoded, uint8_t* data, size_t length);
@@ -5,6 +5,7 @@
 #include "profile/profile.h"
 #include "network/network.h"
 #include "util/adler32.h"
+#include "shell/shell.h"
 #include <algorithm>
 #include <cstdlib>
 
@@ -13,6 +14,7 @@ STATIC_ASSERT(sizeof(MapType) == 4ULL);
 STATIC_ASSERT(sizeof(MapRegionConnection) == 260ULL);
 STATIC_ASSERT(sizeof(RememberedEntity) == 24ULL);
 STATIC_ASSERT(sizeof(Entity) == 256ULL);
+STATIC_ASSERT(sizeof(EntityHot) == 16ULL);
 STATIC_ASSERT(sizeof(BuildingQueueItem) == 8ULL);
 STATIC_ASSERT(sizeof(Particle) == 44ULL);
 STATIC_ASSERT(sizeof(Projectile) == 20ULL);
@@ -24,7 +26,7 @@ STATIC_ASSERT(sizeof(EntityCount) == 92ULL);
 STATIC_ASSERT(sizeof(BotSquadType) == 4ULL);
 STATIC_ASSERT(sizeof(BotDesiredSquad) == 96ULL);
 STATIC_ASSERT(sizeof(BotBaseInfo) == 220);
-STATIC_ASSERT(sizeof(MatchState) == 2434244ULL);
+STATIC_ASSERT(sizeof(MatchState) == 2874096ULL);
 STATIC_ASSERT(sizeof(Bot) == 16208ULL);
 
 #ifdef GOLD_DEBUG
@@ -226,6 +228,14 @@ void desync_compare_frames(uint8_t* state_buffer_a, uint8_t* state_buffer_b) {
         }
     }
 
+    // Islands
+    GOLD_ASSERT(state_a->map.island_count == state_b->map.island_count);
+    for (size_t index = 0; index < MAP_SIZE_MAX * MAP_SIZE_MAX; index++) {
+        GOLD_ASSERT(state_a->map.islands[index] == state_b->map.islands[index]);
+        GOLD_ASSERT(state_a->map.island_sizes[index] == state_b->map.island_sizes[index]);
+    }
+    GOLD_ASSERT(state_a->map.island_dirty_cell_count == state_b->map.island_dirty_cell_count);
+
     GOLD_ASSERT(memcmp(&state_a->map, &state_b->map, sizeof(state_a->map)) == 0);
 
     // Fog
@@ -335,6 +345,17 @@ void desync_compare_frames(uint8_t* state_buffer_a, uint8_t* state_buffer_b) {
     desync_assert_fixed_queues_equal(state_a->entities.available_ids, state_b->entities.available_ids);
     GOLD_ASSERT(memcmp(&state_a->entities, &state_b->entities, sizeof(state_a->entities)) == 0);
 
+    // Entity grid
+    for (uint32_t bucket = 0; bucket < MATCH_ENTITY_GRID_WIDTH * MATCH_ENTITY_GRID_WIDTH; bucket++) {
+        GOLD_ASSERT(state_a->entity_grid.bucket_head[bucket] == state_b->entity_grid.bucket_head[bucket]);
+    }
+    for (EntityId entity_id = 0; entity_id < ID_MAX; entity_id++) {
+        GOLD_ASSERT(state_a->entity_grid.next[entity_id] == state_b->entity_grid.next[entity_id]);
+        GOLD_ASSERT(state_a->entity_grid.prev[entity_id] == state_b->entity_grid.prev[entity_id]);
+        GOLD_ASSERT(state_a->entity_grid.bucket[entity_id] == state_b->entity_grid.bucket[entity_id]);
+    }
+    GOLD_ASSERT(memcmp(&state_a->entity_grid, &state_b->entity_grid, sizeof(state_a->entity_grid)) == 0);
+
     // Path pool
     for (uint32_t index = 0; index < MATCH_MAX_UNITS; index++) {
         desync_assert_fixed_vectors_equal(state_a->entity_paths.data[index], state_b->entity_paths.data[index]);
@@ -345,6 +366,21 @@ void desync_compare_frames(uint8_t* state_buffer_a, uint8_t* state_buffer_b) {
     GOLD_ASSERT(state_a->entity_paths.head == state_b->entity_paths.head);
     GOLD_ASSERT(memcmp(&state_a->entity_paths, &state_b->entity_paths, sizeof(state_a->entity_paths)) == 0);
 
+    // Flow fields
+    GOLD_ASSERT(state_a->flow_fields.count == state_b->flow_fields.count);
+    GOLD_ASSERT(state_a->flow_fields.use_count == state_b->flow_fields.use_count);
+    for (uint32_t index = 0; index < state_a->flow_fields.count; index++) {
+        const MapFlowField& field_a = state_a->flow_fields.fields[index];
+        const MapFlowField& field_b = state_b->flow_fields.fields[index];
+
+        GOLD_ASSERT(state_a->flow_fields.last_used[index] == state_b->flow_fields.last_used[index]);
+        GOLD_ASSERT(field_a.goal == field_b.goal);
+        GOLD_ASSERT(field_a.layer == field_b.layer);
+        GOLD_ASSERT(field_a.blocked_cell_version == field_b.blocked_cell_version);
+        GOLD_ASSERT(memcmp(field_a.directions, field_b.directions, sizeof(field_a.directions)) == 0);
+    }
+    GOLD_ASSERT(memcmp(&state_a->flow_fields, &state_b->flow_fields, sizeof(state_a->flow_fields)) == 0);
+
     // Target queue pool
     for (uint32_t index = 0; index < MATCH_MAX_UNITS; index++) {
         const TargetQueue& queue_a = state_a->entity_target_queues.data[index];
@@ -548,10 +584,194 @@ void desync_compare_frames(uint8_t* state_buffer_a, uint8_t* state_buffer_b) {
 #endif
 
 uint32_t desync_get_checksum_frequency() {
-#ifdef GOLD_DEBUG
-    if (state.desync_debug) {
-        return 4U;
+    // Sectioned checksums are cheap enough to run once per turn
+    return TURN_DURATION;
+}
+
+// CHECKSUM
+
+// In debug builds the cached sections are checked against a full re-hash every this many checksums
+static const uint32_t DESYNC_CHECKSUM_VERIFY_INTERVAL = 64U;
+static const uint32_t DESYNC_CHECKSUM_SECTION_RANGE_MAX = 4U;
+
+STATIC_ASSERT(sizeof(MatchState::fog) + sizeof(MatchState::detection) == MATCH_FOG_PAGE_COUNT * MATCH_FOG_PAGE_SIZE);
+STATIC_ASSERT(DESYNC_CHECKSUM_SECTION_COUNT <= NETWORK_CHECKSUM_SECTION_MAX);
+
+struct DesyncChecksumRange {
+    const uint8_t* begin;
+    const uint8_t* end;
+};
+
+static uint32_t desync_checksum_ranges(std::initializer_list<DesyncChecksumRange> ranges) {
+    GOLD_ASSERT(ranges.size() != 0 && ranges.size() <= DESYNC_CHECKSUM_SECTION_RANGE_MAX);
+    if (ranges.size() == 1) {
+        const DesyncChecksumRange& range = *ranges.begin();
+        return adler32_simd((uint8_t*)range.begin, (size_t)(range.end - range.begin));
+    }
+
+    uint32_t range_checksums[DESYNC_CHECKSUM_SECTION_RANGE_MAX];
+    uint32_t range_count = 0;
+    for (const DesyncChecksumRange& range : ranges) {
+        range_checksums[range_count] = adler32_simd((uint8_t*)range.begin, (size_t)(range.end - range.begin));
+        range_count++;
+    }
+    return adler32_simd((uint8_t*)range_checksums, range_count * sizeof(uint32_t));
+}
+
+// Only hashes the pool slots that are in use, since the released ones are never read again until they are reserved and overwritten
+template <typename T, uint32_t capacity>
+static uint32_t desync_checksum_pool(const Pool<T, capacity>& pool) {
+    bool is_slot_free[capacity];
+    memset(is_slot_free, 0, sizeof(is_slot_free));
+    uint32_t free_index = pool.head;
+    for (uint32_t step = 0; step < capacity && free_index < capacity; step++) {
+        is_slot_free[free_index] = true;
+        free_index = pool.free_list[free_index];
+    }
+
+    uint32_t slot_checksums[capacity];
+    for (uint32_t index = 0; index < capacity; index++) {
+        slot_checksums[index] = is_slot_free[index]
+            ? 0U
+            : adler32_simd((uint8_t*)&pool.data[index], sizeof(T));
+    }
+
+    uint32_t checksums[2] = {
+        adler32_simd((uint8_t*)slot_checksums, sizeof(slot_checksums)),
+        adler32_simd((uint8_t*)pool.free_list, (size_t)((const uint8_t*)(&pool + 1) - (const uint8_t*)pool.free_list))
+    };
+    return adler32_simd((uint8_t*)checksums, sizeof(checksums));
+}
+
+// Only the cache bookkeeping and field headers are hashed
+// The directions are baked from the map cells and goal, so they are already covered by the map cells section
+static uint32_t desync_checksum_flow_fields(const MatchFlowFieldCache& cache) {
+    uint32_t field_checksums[MATCH_FLOW_FIELD_CACHE_SIZE + 1];
+    field_checksums[0] = adler32_simd((uint8_t*)&cache, (size_t)((const uint8_t*)cache.fields - (const uint8_t*)&cache));
+    for (uint32_t index = 0; index < MATCH_FLOW_FIELD_CACHE_SIZE; index++) {
+        field_checksums[index + 1] = index < cache.count
+            ? adler32_simd((uint8_t*)&cache.fields[index], offsetof(MapFlowField, directions))
+            : 0U;
+    }
+    return adler32_simd((uint8_t*)field_checksums, sizeof(field_checksums));
+}
+
+static uint32_t desync_checksum_map_static(const MatchState& match_state) {
+    const Map& map = match_state.map;
+    // The islands at the end of the map change during the match, but they are left out
+    // since they are only bookkeeping for the unreachable cells, which are hashed with the rest of the cells
+    return desync_checksum_ranges({
+        { (const uint8_t*)&map, (const uint8_t*)&map.cells },
+        { (const uint8_t*)&map.region_count, (const uint8_t*)&map.islands }
+    });
+}
+
+static uint32_t desync_checksum_fog_page(const MatchState& match_state, uint32_t page) {
+    // Fog and detection are laid out back to back, so the pages run across both of them
+    const uint8_t* page_begin = (const uint8_t*)match_state.fog + (page * MATCH_FOG_PAGE_SIZE);
+    return adler32_simd((uint8_t*)page_begin, MATCH_FOG_PAGE_SIZE);
+}
+
+void desync_checksum_cache_init(DesyncChecksumCache& cache) {
+    cache.has_map_static_checksum = false;
+    cache.map_static_checksum = 0;
+    memset(cache.fog_page_checksums, 0, sizeof(cache.fog_page_checksums));
+    cache.compute_count = 0;
+}
+
+DesyncChecksum desync_checksum_compute(DesyncChecksumCache& cache, MatchState& match_state, const Bot bots[MAX_PLAYERS]) {
+    ZoneScoped;
+
+    GOLD_ASSERT((uint8_t*)match_state.detection == (uint8_t*)match_state.fog + sizeof(match_state.fog));
+
+    DesyncChecksum checksum;
+
+    // Map static, the map never changes its tiles or regions once the match has started
+    if (!cache.has_map_static_checksum) {
+        cache.map_static_checksum = desync_checksum_map_static(match_state);
+        cache.has_map_static_checksum = true;
+    }
+    checksum.section_checksums[DESYNC_CHECKSUM_SECTION_MAP_STATIC] = cache.map_static_checksum;
+
+    // Map cells
+    checksum.section_checksums[DESYNC_CHECKSUM_SECTION_MAP_CELLS] = desync_checksum_ranges({
+        { (const uint8_t*)&match_state.map.cells, (const uint8_t*)&match_state.map.region_count }
+    });
+
+    // Fog, only the dirty pages are re-hashed
+    for (uint32_t page = 0; page < MATCH_FOG_PAGE_COUNT; page++) {
+        if (match_state.fog_dirty_pages[page / 64U] & (1ULL << (page % 64U))) {
+            cache.fog_page_checksums[page] = desync_checksum_fog_page(match_state, page);
+        }
+    }
+    memset(match_state.fog_dirty_pages, 0, sizeof(match_state.fog_dirty_pages));
+    checksum.section_checksums[DESYNC_CHECKSUM_SECTION_FOG] = adler32_simd((uint8_t*)cache.fog_page_checksums, sizeof(cache.fog_page_checksums));
+
+    // Entities, only the live part of the entity array is hashed
+    checksum.section_checksums[DESYNC_CHECKSUM_SECTION_ENTITIES] = desync_checksum_ranges({
+        { (const uint8_t*)match_state.entities.data, (const uint8_t*)(match_state.entities.data + match_state.entities.size()) },
+        { (const uint8_t*)match_state.entities.hot, (const uint8_t*)(match_state.entities.hot + match_state.entities.size()) },
+        { (const uint8_t*)match_state.entities.ids, (const uint8_t*)(&match_state.entities + 1) },
+        { (const uint8_t*)&match_state.entity_grid, (const uint8_t*)&match_state.entity_paths }
+    });
+
+    // Pools
+    uint32_t pool_checksums[4] = {
+        desync_checksum_pool(match_state.entity_paths),
+        desync_checksum_pool(match_state.entity_target_queues),
+        desync_checksum_flow_fields(match_state.flow_fields),
+        desync_checksum_ranges({
+            { (const uint8_t*)&match_state.particles, (const uint8_t*)&match_state.players }
+        })
+    };
+    checksum.section_checksums[DESYNC_CHECKSUM_SECTION_POOLS] = adler32_simd((uint8_t*)pool_checksums, sizeof(pool_checksums));
+
+    // Players, this is everything else in the match state except for the fog dirty pages
+    checksum.section_checksums[DESYNC_CHECKSUM_SECTION_PLAYERS] = desync_checksum_ranges({
+        { (const uint8_t*)&match_state, (const uint8_t*)&match_state.map },
+        { (const uint8_t*)&match_state.remembered_entities, (const uint8_t*)&match_state.entities },
+        { (const uint8_t*)&match_state.players, (const uint8_t*)(&match_state + 1) }
+    });
+
+    // Bots
+    checksum.section_checksums[DESYNC_CHECKSUM_SECTION_BOTS] = desync_checksum_ranges({
+        { (const uint8_t*)bots, (const uint8_t*)(bots + MAX_PLAYERS) }
+    });
+
+    checksum.checksum = adler32_simd((uint8_t*)checksum.section_checksums, sizeof(checksum.section_checksums));
+
+    #ifdef GOLD_DEBUG
+        // Catches any writes to the cached sections that didn't mark them as dirty
+        if (cache.compute_count % DESYNC_CHECKSUM_VERIFY_INTERVAL == 0) {
+            GOLD_ASSERT(cache.map_static_checksum == desync_checksum_map_static(match_state));
+            for (uint32_t page = 0; page < MATCH_FOG_PAGE_COUNT; page++) {
+                GOLD_ASSERT(cache.fog_page_checksums[page] == desync_checksum_fog_page(match_state, page));
+            }
+        }
+    #endif
+    cache.compute_count++;
+
+    return checksum;
+}
+
+const char* desync_checksum_section_str(DesyncChecksumSection section) {
+    switch (section) {
+        case DESYNC_CHECKSUM_SECTION_MAP_STATIC:
+            return "MAP_STATIC";
+        case DESYNC_CHECKSUM_SECTION_MAP_CELLS:
+            return "MAP_CELLS";
+        case DESYNC_CHECKSUM_SECTION_FOG:
+            return "FOG";
+        case DESYNC_CHECKSUM_SECTION_ENTITIES:
+            return "ENTITIES";
+        case DESYNC_CHECKSUM_SECTION_POOLS:
+            return "POOLS";
+        case DESYNC_CHECKSUM_SECTION_PLAYERS:
+            return "PLAYERS";
+        case DESYNC_CHECKSUM_SECTION_BOTS:
+            return "BOTS";
+        case DESYNC_CHECKSUM_SECTION_COUNT:
+            GOLD_ASSERT(false);
+            return "";
     }
-#endif
-    return 60U;
 }
@@ -9,6 +9,37 @@ constexpr size_t DESYNC_BUFFER_SIZE = sizeof(MatchState) + (MAX_PLAYERS * sizeof
 constexpr size_t DESYNC_STATE_BUFFER_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t);
 constexpr size_t DESYNC_STATE_BUFFER_LENGTH = DESYNC_STATE_BUFFER_HEADER_SIZE + DESYNC_BUFFER_SIZE;
 
+/**
+ * The checksum is split into sections, each of which is hashed separately and then combined.
+ * The static parts of the map are hashed once per match, fog and detection only re-hash the pages
+ * that have been written to since the last checksum, and everything else changes often enough
+ * that it is re-hashed every time, skipping the entity and pool slots that are not in use. Because each peer sends its section checksums along with the
+ * combined one, a desync can be narrowed down to the section that diverged.
+ */
+
+enum DesyncChecksumSection {
+    DESYNC_CHECKSUM_SECTION_MAP_STATIC,
+    DESYNC_CHECKSUM_SECTION_MAP_CELLS,
+    DESYNC_CHECKSUM_SECTION_FOG,
+    DESYNC_CHECKSUM_SECTION_ENTITIES,
+    DESYNC_CHECKSUM_SECTION_POOLS,
+    DESYNC_CHECKSUM_SECTION_PLAYERS,
+    DESYNC_CHECKSUM_SECTION_BOTS,
+    DESYNC_CHECKSUM_SECTION_COUNT
+};
+
+struct DesyncChecksum {
+    uint32_t checksum;
+    uint32_t section_checksums[DESYNC_CHECKSUM_SECTION_COUNT];
+};
+
+struct DesyncChecksumCache {
+    bool has_map_static_checksum;
+    uint32_t map_static_checksum;
+    uint32_t fog_page_checksums[MATCH_FOG_PAGE_COUNT];
+    uint32_t compute_count;
+};
+
 #ifdef GOLD_DEBUG
 
 bool desync_init(const char* desync_foldername);
@@ -30,4 +61,9 @@ void desync_compare_frames(uint8_t* state_buffer, uint8_t* state_buffer2);
 
 #endif
 
-uint32_t desync_get_checksum_frequency();
\ No newline at end of file
+uint32_t desync_get_checksum_frequency();
+
+void desync_checksum_cache_init(DesyncChecksumCache& cache);
+// Clears the fog dirty pages of match_state, which is why it takes a non-const reference
+DesyncChecksum desync_checksum_compute(DesyncChecksumCache& cache, MatchState& match_state, const Bot bots[MAX_PLAYERS]);
+const char* desync_checksum_section_str(DesyncChecksumSection section);
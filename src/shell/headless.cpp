@@ -0,0 +1,588 @@
+#include "headless.h"
+
+#include "core/logger.h"
+#include "core/asserts.h"
+#include "match/state.h"
+#include "match/noise.h"
+#include "match/lcg.h"
+#include "bot/bot.h"
+#include "shell/shell.h"
+#include "shell/desync.h"
+#include "shell/input_stream.h"
+#include "network/types.h"
+#include "util/adler32.h"
+#include "profile/profile.h"
+#include <SDL3/SDL.h>
+#include <queue>
+#include <algorithm>
+
+// Laid out the same way as MatchShellState so that the checksum covers the same bytes as in a real match
+struct HeadlessSimState {
+    MatchState match_state;
+    Bot bots[MAX_PLAYERS];
+};
+
+enum HeadlessSimTimer {
+    HEADLESS_SIM_TIMER_NOISE_GENERATE,
+    HEADLESS_SIM_TIMER_MATCH_INIT,
+    HEADLESS_SIM_TIMER_BOT_INIT,
+    HEADLESS_SIM_TIMER_BOT_INPUT,
+    HEADLESS_SIM_TIMER_MATCH_INPUT,
+    HEADLESS_SIM_TIMER_MATCH_UPDATE,
+    HEADLESS_SIM_TIMER_CHECKSUM,
+    HEADLESS_SIM_TIMER_NETWORK,
+    HEADLESS_SIM_TIMER_COUNT
+};
+
+struct HeadlessSimTimerData {
+    const char* name;
+    uint64_t total;
+    uint64_t max;
+    uint32_t count;
+};
+
+// A network sim gives up once every peer has been stalled for this long
+static const uint32_t HEADLESS_SIM_NETWORK_STALL_LIMIT = 60U * 60U;
+static const uint64_t HEADLESS_SIM_US_PER_MS = SDL_US_PER_SECOND / SDL_MS_PER_SECOND;
+
+// A player in a network sim, with its own copy of the match
+struct HeadlessSimPeer {
+    HeadlessSimState* state;
+    NetworkHostLoopback* host;
+    InputStream input_stream;
+    std::queue<std::vector<MatchInput>> inputs[MAX_PLAYERS];
+    uint32_t match_timer;
+
+    // The bot waits for its last input to be executed before it decides on the next one, the same as it does with TURN_OFFSET
+    std::vector<MatchInput> input_queue;
+    bool has_bot_input_in_flight;
+    uint32_t bot_input_turn_index;
+    uint32_t sent_turn_count;
+    uint32_t executed_turn_count;
+
+    // Checked against the other peers at the end
+    DesyncChecksumCache checksum_cache;
+    std::vector<uint32_t> checksums;
+
+    uint32_t stall_frame_count;
+    uint32_t stall_count;
+    uint32_t stall_longest;
+    uint32_t stall_current;
+    uint64_t turn_offset_total;
+};
+
+static uint32_t headless_sim_compute_checksum(HeadlessSimState* state) {
+    return adler32_simd((uint8_t*)&state->match_state, DESYNC_BUFFER_SIZE);
+}
+
+// Each peer only keeps its own bot up to date, so the bots are left out
+static uint32_t headless_sim_compute_peer_checksum(HeadlessSimPeer& peer) {
+    DesyncChecksum checksum = desync_checksum_compute(peer.checksum_cache, peer.state->match_state, peer.state->bots);
+    checksum.section_checksums[DESYNC_CHECKSUM_SECTION_BOTS] = 0;
+    return adler32_simd((uint8_t*)checksum.section_checksums, sizeof(checksum.section_checksums));
+}
+
+static void headless_sim_timer_add(HeadlessSimTimerData& timer, uint64_t start_time) {
+    uint64_t duration = SDL_GetTicksNS() - start_time;
+    timer.total += duration;
+    timer.max = std::max(timer.max, duration);
+    timer.count++;
+}
+
+static void headless_sim_init_timers(HeadlessSimTimerData timers[HEADLESS_SIM_TIMER_COUNT]) {
+    static const char* TIMER_NAMES[HEADLESS_SIM_TIMER_COUNT] = {
+        "noise_generate",
+        "match_init",
+        "bot_init",
+        "bot_get_turn_input",
+        "match_handle_input",
+        "match_update",
+        "checksum",
+        "network"
+    };
+    for (uint32_t timer = 0; timer < HEADLESS_SIM_TIMER_COUNT; timer++) {
+        timers[timer] = (HeadlessSimTimerData) { .name = TIMER_NAMES[timer], .total = 0, .max = 0, .count = 0 };
+    }
+}
+
+static void headless_sim_print_timers(const HeadlessSimTimerData timers[HEADLESS_SIM_TIMER_COUNT]) {
+    printf("\n%-20s %12s %8s %12s %12s\n", "subsystem", "total ms", "calls", "avg us", "max us");
+    for (uint32_t timer = 0; timer < HEADLESS_SIM_TIMER_COUNT; timer++) {
+        if (timers[timer].count == 0) {
+            continue;
+        }
+        printf("%-20s %12.2f %8u %12.2f %12.2f\n",
+            timers[timer].name,
+            (double)timers[timer].total / (double)SDL_NS_PER_MS,
+            timers[timer].count,
+            (double)timers[timer].total / (double)(timers[timer].count * SDL_NS_PER_US),
+            (double)timers[timer].max / (double)SDL_NS_PER_US);
+    }
+}
+
+// Generates noise the same way that the menu does when the host starts a match
+static Noise* headless_sim_generate_noise(const HeadlessSimParams& params, HeadlessSimTimerData timers[HEADLESS_SIM_TIMER_COUNT]) {
+    uint64_t start_time = SDL_GetTicksNS();
+    int noise_lcg_seed = params.lcg_seed;
+    uint64_t map_seed = (uint64_t)noise_lcg_seed;
+    uint64_t forest_seed = (uint64_t)lcg_rand(&noise_lcg_seed);
+    NoiseGenParams noise_params = noise_create_noise_gen_params(params.map_type, params.map_size, map_seed, forest_seed);
+    Noise* noise = noise_generate(noise_params);
+    headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_NOISE_GENERATE], start_time);
+
+    return noise;
+}
+
+static HeadlessSimState* headless_sim_init_state(const HeadlessSimParams& params, Noise* noise, HeadlessSimTimerData timers[HEADLESS_SIM_TIMER_COUNT]) {
+    // Populate match players
+    MatchPlayer players[MAX_PLAYERS];
+    memset(players, 0, sizeof(players));
+    for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+        players[player_id].active = true;
+        sprintf(players[player_id].name, "Bot %u", player_id + 1);
+        players[player_id].team = params.teams ? player_id % 2 : player_id;
+        players[player_id].recolor_id = player_id;
+    }
+
+    // Heap allocated because the state is too big for the stack
+    HeadlessSimState* state = new HeadlessSimState();
+
+    // Init match
+    uint64_t start_time = SDL_GetTicksNS();
+    match_init(state->match_state, params.lcg_seed, players, (MatchInitMapParams) {
+        .type = MATCH_INIT_MAP_FROM_NOISE,
+        .noise = (MatchInitMapParamsNoise) {
+            .type = params.map_type,
+            .noise = noise
+        }
+    });
+    headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_MATCH_INIT], start_time);
+
+    // Init bots
+    start_time = SDL_GetTicksNS();
+    int bot_lcg_seed = params.lcg_seed;
+    for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+        if (player_id >= params.bot_count) {
+            state->bots[player_id] = bot_empty();
+            continue;
+        }
+
+        Difficulty difficulty = params.bot_difficulty[player_id];
+        BotConfig bot_config = bot_config_init_from_difficulty(difficulty);
+        bot_config.opener = bot_config_roll_opener(&bot_lcg_seed, difficulty);
+        bot_config.preferred_unit_comp = bot_config_roll_preferred_unit_comp(&bot_lcg_seed);
+        state->bots[player_id] = bot_init(state->match_state, player_id, bot_config);
+    }
+    headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_BOT_INIT], start_time);
+
+    return state;
+}
+
+static int headless_sim_run_network(const HeadlessSimParams& params);
+
+int headless_sim_run(const HeadlessSimParams& params) {
+    ZoneScoped;
+
+    if (params.has_network) {
+        return headless_sim_run_network(params);
+    }
+
+    HeadlessSimTimerData timers[HEADLESS_SIM_TIMER_COUNT];
+    headless_sim_init_timers(timers);
+
+    printf("Headless sim: seed %i, map type %s, map size %s, %u bots, %u frames.\n",
+        params.lcg_seed,
+        match_setting_data(MATCH_SETTING_MAP_TYPE).values[params.map_type].c_str(),
+        match_setting_data(MATCH_SETTING_MAP_SIZE).values[params.map_size].c_str(),
+        params.bot_count,
+        params.frame_count);
+
+    Noise* noise = headless_sim_generate_noise(params, timers);
+    HeadlessSimState* state = headless_sim_init_state(params, noise, timers);
+    noise_free(noise);
+
+    // Init input queues
+    std::queue<MatchInput> inputs[MAX_PLAYERS];
+    for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+        for (uint32_t index = 0; index < TURN_OFFSET - 1; index++) {
+            inputs[player_id].push((MatchInput) { .type = MATCH_INPUT_NONE });
+        }
+    }
+
+    uint64_t start_time;
+    uint64_t sim_start_time = SDL_GetTicksNS();
+    for (uint32_t match_timer = 0; match_timer < params.frame_count; match_timer++) {
+        // Begin turn
+        if (match_timer % TURN_DURATION == 0) {
+            // Bot inputs
+            start_time = SDL_GetTicksNS();
+            for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+                if (!state->match_state.players[player_id].active || !inputs[player_id].empty()) {
+                    continue;
+                }
+
+                inputs[player_id].push(bot_get_turn_input(state->match_state, state->bots[player_id], match_timer));
+                for (uint32_t index = 0; index < TURN_OFFSET - 1; index++) {
+                    inputs[player_id].push((MatchInput) { .type = MATCH_INPUT_NONE });
+                }
+
+                if (bot_should_surrender(state->match_state, state->bots[player_id], match_timer)) {
+                    log_info("Headless sim: player %u surrendered on frame %u.", player_id, match_timer);
+                    state->match_state.players[player_id].active = false;
+                }
+            }
+            headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_BOT_INPUT], start_time);
+
+            // Handle input
+            start_time = SDL_GetTicksNS();
+            for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+                if (!state->match_state.players[player_id].active) {
+                    continue;
+                }
+
+                GOLD_ASSERT(!inputs[player_id].empty());
+                match_handle_input(state->match_state, inputs[player_id].front());
+                inputs[player_id].pop();
+            }
+            headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_MATCH_INPUT], start_time);
+        }
+
+        // Checksum
+        if (params.checksum_frequency != 0 && match_timer % params.checksum_frequency == 0) {
+            start_time = SDL_GetTicksNS();
+            uint32_t checksum = headless_sim_compute_checksum(state);
+            headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_CHECKSUM], start_time);
+            printf("frame %u checksum %08x entities %u\n", match_timer, checksum, (uint32_t)state->match_state.entities.size());
+        }
+
+        // Match update
+        start_time = SDL_GetTicksNS();
+        match_update(state->match_state);
+        headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_MATCH_UPDATE], start_time);
+
+        // There's no shell to consume the events, so throw them away
+        state->match_state.events.clear();
+    }
+    uint64_t sim_duration = SDL_GetTicksNS() - sim_start_time;
+
+    uint32_t final_checksum = headless_sim_compute_checksum(state);
+
+    // Report timings
+    headless_sim_print_timers(timers);
+
+    double sim_seconds = (double)sim_duration / (double)SDL_NS_PER_SECOND;
+    double ticks_per_second = sim_seconds > 0.0 ? (double)params.frame_count / sim_seconds : 0.0;
+    printf("\nSimulated %u frames in %.3f s: %.1f ticks/sec (%.1fx realtime).\n",
+        params.frame_count, sim_seconds, ticks_per_second, ticks_per_second / (double)UPDATES_PER_SECOND);
+    printf("Final checksum: %08x\n", final_checksum);
+    log_info("Headless sim finished. %.1f ticks/sec. Final checksum %08x.", ticks_per_second, final_checksum);
+
+    delete state;
+
+    if (params.has_expected_checksum && final_checksum != params.expected_checksum) {
+        printf("Checksum mismatch! Expected %08x but got %08x.\n", params.expected_checksum, final_checksum);
+        log_error("Headless sim checksum mismatch. Expected %08x but got %08x.", params.expected_checksum, final_checksum);
+        return 1;
+    }
+
+    return 0;
+}
+
+static void headless_sim_peer_send_turn(HeadlessSimPeer& peer, uint8_t player_id, const bool is_peer[MAX_PLAYERS], const std::vector<MatchInput>& inputs, uint64_t now) {
+    uint8_t reliable_buffer[NETWORK_INPUT_BUFFER_SIZE];
+    size_t reliable_buffer_length;
+    uint8_t unreliable_buffer[NETWORK_INPUT_BUFFER_SIZE];
+    size_t unreliable_buffer_length;
+    input_stream_write_turn(peer.input_stream, is_peer, inputs, now,
+                            reliable_buffer, reliable_buffer_length,
+                            unreliable_buffer, unreliable_buffer_length);
+    peer.inputs[player_id].push(inputs);
+    peer.sent_turn_count++;
+
+    reliable_buffer[0] = NETWORK_MESSAGE_INPUT;
+    unreliable_buffer[0] = NETWORK_MESSAGE_INPUT;
+    peer.host->broadcast(reliable_buffer, reliable_buffer_length);
+    peer.host->broadcast_unreliable(unreliable_buffer, unreliable_buffer_length);
+    peer.host->flush();
+}
+
+// Follows the turn rules of match_shell_update(), with the bot standing in for the local player
+// Bots never surrender here, since each bot is only kept up to date by the peer that it belongs to
+static void headless_sim_peer_update(HeadlessSimPeer& peer, uint8_t player_id, uint64_t now, HeadlessSimTimerData timers[HEADLESS_SIM_TIMER_COUNT]) {
+    MatchState& match_state = peer.state->match_state;
+
+    // Begin turn
+    if (peer.match_timer % TURN_DURATION == 0) {
+        // Check that all inputs have been received
+        for (uint8_t input_player_id = 0; input_player_id < MAX_PLAYERS; input_player_id++) {
+            if (match_state.players[input_player_id].active && peer.inputs[input_player_id].empty()) {
+                if (peer.stall_current == 0) {
+                    peer.stall_count++;
+                }
+                peer.stall_current++;
+                peer.stall_frame_count++;
+                peer.stall_longest = std::max(peer.stall_longest, peer.stall_current);
+                return;
+            }
+        }
+        peer.stall_current = 0;
+
+        // Handle input
+        uint64_t start_time = SDL_GetTicksNS();
+        for (uint8_t input_player_id = 0; input_player_id < MAX_PLAYERS; input_player_id++) {
+            if (!match_state.players[input_player_id].active) {
+                continue;
+            }
+
+            for (const MatchInput& input : peer.inputs[input_player_id].front()) {
+                match_handle_input(match_state, input);
+            }
+            peer.inputs[input_player_id].pop();
+        }
+        peer.executed_turn_count++;
+        headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_MATCH_INPUT], start_time);
+
+        // The bot queues its input the way the local player would, and waits for its last input to run before it queues another
+        if (peer.input_queue.empty() && (!peer.has_bot_input_in_flight || peer.executed_turn_count > peer.bot_input_turn_index)) {
+            start_time = SDL_GetTicksNS();
+            peer.input_queue.push_back(bot_get_turn_input(match_state, peer.state->bots[player_id], peer.match_timer));
+            headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_BOT_INPUT], start_time);
+            peer.has_bot_input_in_flight = true;
+        }
+        bool is_bot_input_queued = !peer.input_queue.empty();
+
+        // Flush input
+        const bool is_bot[MAX_PLAYERS] = { false };
+        bool is_peer[MAX_PLAYERS];
+        input_stream_get_peers(match_state, player_id, is_bot, is_peer);
+        std::vector<std::vector<MatchInput>> turns;
+        input_stream_get_turns_to_send(peer.input_stream, is_peer, peer.input_queue, turns);
+        peer.turn_offset_total += peer.input_stream.latency.turn_offset;
+        for (const std::vector<MatchInput>& turn : turns) {
+            headless_sim_peer_send_turn(peer, player_id, is_peer, turn, now);
+        }
+
+        // The queued input goes out in the last turn that was sent, unless this turn was skipped
+        if (is_bot_input_queued && peer.input_queue.empty()) {
+            peer.bot_input_turn_index = peer.sent_turn_count - 1U;
+        }
+    }
+
+    // Checksum
+    if (peer.match_timer % desync_get_checksum_frequency() == 0) {
+        uint64_t start_time = SDL_GetTicksNS();
+        peer.checksums.push_back(headless_sim_compute_peer_checksum(peer));
+        headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_CHECKSUM], start_time);
+    }
+
+    // Match update
+    uint64_t start_time = SDL_GetTicksNS();
+    match_update(match_state);
+    headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_MATCH_UPDATE], start_time);
+    match_state.events.clear();
+    peer.match_timer++;
+}
+
+static int headless_sim_run_network(const HeadlessSimParams& params) {
+    ZoneScoped;
+
+    HeadlessSimTimerData timers[HEADLESS_SIM_TIMER_COUNT];
+    headless_sim_init_timers(timers);
+
+    const NetworkLoopbackImpairment& impairment = params.network_impairment;
+    printf("Headless network sim: seed %i, map type %s, map size %s, %u peers, %u frames.\n",
+        params.lcg_seed,
+        match_setting_data(MATCH_SETTING_MAP_TYPE).values[params.map_type].c_str(),
+        match_setting_data(MATCH_SETTING_MAP_SIZE).values[params.map_size].c_str(),
+        params.bot_count,
+        params.frame_count);
+    printf("Network: seed %i, latency %ums, jitter %ums, loss %u%%, reorder %u%%, bandwidth %u bytes/sec.\n",
+        params.network_lcg_seed,
+        impairment.latency_ms,
+        impairment.jitter_ms,
+        impairment.loss_percent,
+        impairment.reorder_percent,
+        impairment.bandwidth);
+
+    NetworkLoopback* loopback = new NetworkLoopback();
+    network_loopback_init(*loopback, impairment, params.network_lcg_seed);
+
+    // Each bot gets a peer, and the peer's player id matches its host id
+    HeadlessSimPeer* peers = new HeadlessSimPeer[params.bot_count];
+    for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+        HeadlessSimPeer& peer = peers[player_id];
+        // Every peer generates its own noise, the same as in a real match, since match_init() writes to it
+        Noise* noise = headless_sim_generate_noise(params, timers);
+        peer.state = headless_sim_init_state(params, noise, timers);
+        noise_free(noise);
+        peer.host = new NetworkHostLoopback(loopback);
+        input_stream_init(peer.input_stream, TURN_OFFSET);
+        for (uint8_t input_player_id = 0; input_player_id < params.bot_count; input_player_id++) {
+            for (uint32_t index = 0; index < TURN_OFFSET - 1; index++) {
+                peer.inputs[input_player_id].push({ (MatchInput) { .type = MATCH_INPUT_NONE } });
+            }
+        }
+        peer.match_timer = 0;
+        desync_checksum_cache_init(peer.checksum_cache);
+        peer.input_queue.clear();
+        peer.has_bot_input_in_flight = false;
+        peer.bot_input_turn_index = 0;
+        peer.sent_turn_count = TURN_OFFSET - 1;
+        peer.executed_turn_count = 0;
+        peer.stall_frame_count = 0;
+        peer.stall_count = 0;
+        peer.stall_longest = 0;
+        peer.stall_current = 0;
+        peer.turn_offset_total = 0;
+    }
+
+    // Connect every peer to every other peer
+    for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+        for (uint8_t other_player_id = player_id + 1; other_player_id < params.bot_count; other_player_id++) {
+            peers[player_id].host->connect(network_loopback_get_connection_info(other_player_id));
+        }
+    }
+    for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+        NetworkHostLoopback* host = peers[player_id].host;
+        for (uint16_t peer_id = 0; peer_id < host->get_peer_count(); peer_id++) {
+            host->set_peer_player_id(peer_id, (uint8_t)(host->get_peer_connection_info(peer_id).lan.port - NETWORK_BASE_PORT));
+        }
+    }
+
+    // Time only moves forward one frame at a time, so the peers can take as long as they need to each frame
+    uint64_t sim_start_time = SDL_GetTicksNS();
+    uint32_t frame = 0;
+    bool is_deadlocked = false;
+    while (true) {
+        bool is_finished = true;
+        bool is_stalled = true;
+        for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+            if (peers[player_id].match_timer < params.frame_count) {
+                is_finished = false;
+                is_stalled = is_stalled && peers[player_id].stall_current >= HEADLESS_SIM_NETWORK_STALL_LIMIT;
+            }
+        }
+        if (is_finished) {
+            break;
+        }
+        if (is_stalled) {
+            is_deadlocked = true;
+            break;
+        }
+
+        uint64_t now = ((uint64_t)frame * SDL_US_PER_SECOND) / UPDATES_PER_SECOND;
+        network_loopback_set_time(*loopback, now);
+
+        // Receive
+        uint64_t start_time = SDL_GetTicksNS();
+        for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+            HeadlessSimPeer& peer = peers[player_id];
+            peer.host->service();
+
+            NetworkHostEvent event;
+            while (peer.host->poll_events(&event)) {
+                if (event.type != NETWORK_HOST_EVENT_RECEIVED) {
+                    continue;
+                }
+
+                GOLD_ASSERT(event.received.packet.data[0] == NETWORK_MESSAGE_INPUT);
+                uint8_t input_player_id = peer.host->get_peer_player_id(event.received.peer_id);
+                input_stream_read_message(peer.input_stream, player_id, input_player_id, now / HEADLESS_SIM_US_PER_MS,
+                                            event.received.packet.data, event.received.packet.length, peer.inputs[input_player_id]);
+                peer.host->destroy_packet(&event.received.packet);
+            }
+        }
+        headless_sim_timer_add(timers[HEADLESS_SIM_TIMER_NETWORK], start_time);
+
+        // Update
+        for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+            if (peers[player_id].match_timer < params.frame_count) {
+                headless_sim_peer_update(peers[player_id], player_id, now / HEADLESS_SIM_US_PER_MS, timers);
+            }
+        }
+
+        frame++;
+    }
+    uint64_t sim_duration = SDL_GetTicksNS() - sim_start_time;
+
+    // Report timings
+    headless_sim_print_timers(timers);
+
+    // Report stalls and input delay
+    const double frame_ms = 1000.0 / (double)UPDATES_PER_SECOND;
+    uint32_t final_checksum = 0;
+    printf("\n%-6s %14s %10s %8s %18s %16s %10s\n", "peer", "stalled frames", "stall %", "stalls", "longest stall ms", "avg delay ms", "checksum");
+    for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+        HeadlessSimPeer& peer = peers[player_id];
+        uint32_t checksum = headless_sim_compute_peer_checksum(peer);
+        if (player_id == 0) {
+            final_checksum = checksum;
+        }
+        double average_turn_offset = peer.executed_turn_count == 0 ? 0.0 : (double)peer.turn_offset_total / (double)peer.executed_turn_count;
+        printf("%-6u %14u %9.2f%% %8u %18.1f %16.1f %10.8x\n",
+            player_id,
+            peer.stall_frame_count,
+            100.0 * (double)peer.stall_frame_count / (double)(peer.match_timer + peer.stall_frame_count),
+            peer.stall_count,
+            (double)peer.stall_longest * frame_ms,
+            average_turn_offset * (double)TURN_DURATION * frame_ms,
+            checksum);
+    }
+
+    // Compare the checksums that every peer got to
+    uint32_t desync_frame = UINT32_MAX;
+    for (uint8_t player_id = 1; player_id < params.bot_count; player_id++) {
+        const HeadlessSimPeer& peer = peers[player_id];
+        for (uint32_t index = 0; index < std::min(peer.checksums.size(), peers[0].checksums.size()); index++) {
+            if (peer.checksums[index] != peers[0].checksums[index]) {
+                desync_frame = std::min(desync_frame, index * desync_get_checksum_frequency());
+                break;
+            }
+        }
+    }
+    bool is_desynced = desync_frame != UINT32_MAX;
+
+    const NetworkLoopbackStats& stats = loopback->stats;
+    printf("\nPackets: %u sent, %u delivered, %u dropped, %u resent, %u reordered. %.1f KB sent.\n",
+        stats.packets_sent,
+        stats.packets_delivered,
+        stats.packets_dropped,
+        stats.packets_resent,
+        stats.packets_reordered,
+        (double)stats.bytes_sent / 1024.0);
+    uint32_t packet_count = stats.packets_sent - stats.packets_dropped;
+    printf("Packet delay: %.1f ms avg, %.1f ms max.\n",
+        packet_count == 0 ? 0.0 : (double)stats.total_delay / (double)(packet_count * HEADLESS_SIM_US_PER_MS),
+        (double)stats.max_delay / (double)HEADLESS_SIM_US_PER_MS);
+
+    double sim_seconds = (double)sim_duration / (double)SDL_NS_PER_SECOND;
+    printf("\nSimulated %u frames of network time in %.3f s.\n", frame, sim_seconds);
+    printf("Final checksum: %08x\n", final_checksum);
+    log_info("Headless network sim finished. Final checksum %08x.", final_checksum);
+
+    for (uint8_t player_id = 0; player_id < params.bot_count; player_id++) {
+        delete peers[player_id].host;
+        delete peers[player_id].state;
+    }
+    delete [] peers;
+    network_loopback_free(*loopback);
+    delete loopback;
+
+    if (is_deadlocked) {
+        printf("Network sim stalled for more than %u frames.\n", HEADLESS_SIM_NETWORK_STALL_LIMIT);
+        log_error("Headless network sim stalled for more than %u frames.", HEADLESS_SIM_NETWORK_STALL_LIMIT);
+        return 1;
+    }
+    if (is_desynced) {
+        printf("Desync! The peers diverged on frame %u.\n", desync_frame);
+        log_error("Headless network sim desynced on frame %u.", desync_frame);
+        return 1;
+    }
+    if (params.has_expected_checksum && final_checksum != params.expected_checksum) {
+        printf("Checksum mismatch! Expected %08x but got %08x.\n", params.expected_checksum, final_checksum);
+        log_error("Headless sim checksum mismatch. Expected %08x but got %08x.", params.expected_checksum, final_checksum);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "defines.h"
+#include "core/match_setting.h"
+#include "network/loopback/host.h"
+#include <cstdint>
+
+/**
+ * The headless sim runs a bot-only match without a window, renderer, sound or network.
+ * It follows the same turn and input-delay rules as match_shell_update(), so a given set of params
+ * always produces the same sequence of checksums, which makes it usable both as a throughput benchmark
+ * and as a determinism regression check.
+ *
+ * With has_network set, each bot gets a simulated peer of its own instead, with its own copy of the match,
+ * and the peers send their input turns to each other over an impaired loopback network using the same input stream as a real match.
+ * Time is simulated, so a given set of params always gives the same stalls as well as the same checksums,
+ * and at the end the peers are checked against each other for desyncs.
+ */
+
+const uint32_t HEADLESS_SIM_FRAME_COUNT_DEFAULT = 60U * 60U * 10U;
+
+struct HeadlessSimParams {
+    int32_t lcg_seed;
+    MapType map_type;
+    MapSize map_size;
+    bool teams;
+    uint8_t bot_count;
+    Difficulty bot_difficulty[MAX_PLAYERS];
+    uint32_t frame_count;
+    // Prints the checksum every checksum_frequency frames. 0 only prints the final checksum
+    uint32_t checksum_frequency;
+    bool has_expected_checksum;
+    uint32_t expected_checksum;
+    bool has_network;
+    NetworkLoopbackImpairment network_impairment;
+    int32_t network_lcg_seed;
+};
+
+// Returns the process exit code, which is non-zero if the final checksum does not match the expected one
+int headless_sim_run(const HeadlessSimParams& params);
@@ -0,0 +1,186 @@
+#include "input_stream.h"
+
+#include "core/logger.h"
+#include "core/asserts.h"
+#include "network/types.h"
+#include <cstring>
+
+static size_t input_stream_write_message(const InputStream& stream, uint64_t now, uint8_t* out_buffer, uint32_t first_turn_index);
+
+void input_stream_init(InputStream& stream, uint32_t turn_offset) {
+    latency_init(stream.latency, turn_offset);
+    stream.sent_sequence = 0;
+    memset(stream.received_sequence, 0, sizeof(stream.received_sequence));
+    match_input_codec_init(stream.sent_codec);
+    for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+        match_input_codec_init(stream.received_codec[player_id]);
+    }
+    stream.unacked_turns.clear();
+}
+
+void input_stream_get_peers(const MatchState& match_state, uint8_t local_player_id, const bool is_bot[MAX_PLAYERS], bool is_peer[MAX_PLAYERS]) {
+    for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+        is_peer[player_id] = player_id != local_player_id &&
+                                match_state.players[player_id].active &&
+                                !is_bot[player_id];
+    }
+}
+
+void input_stream_get_turns_to_send(InputStream& stream, const bool is_peer[MAX_PLAYERS], std::vector<MatchInput>& input_queue,
+                                        std::vector<std::vector<MatchInput>>& turns) {
+    turns.clear();
+    int turn_offset_change = latency_update_turn_offset(stream.latency, is_peer);
+
+    // Growing the input delay sends an extra empty turn ahead of this one
+    if (turn_offset_change > 0) {
+        turns.push_back(std::vector<MatchInput>({ (MatchInput) { .type = MATCH_INPUT_NONE } }));
+    }
+
+    // Shrinking the input delay skips sending this turn, and the queued inputs go out with the next one instead
+    if (turn_offset_change >= 0) {
+        // Always send at least one input per turn
+        if (input_queue.empty()) {
+            input_queue.push_back((MatchInput) { .type = MATCH_INPUT_NONE });
+        }
+        turns.push_back(input_queue);
+        input_queue.clear();
+    }
+}
+
+void input_stream_write_turn(InputStream& stream, const bool is_peer[MAX_PLAYERS], const std::vector<MatchInput>& inputs, uint64_t now,
+                                uint8_t* reliable_buffer, size_t& reliable_buffer_length,
+                                uint8_t* unreliable_buffer, size_t& unreliable_buffer_length) {
+    // Drop the turns that every peer has acked
+    while (!stream.unacked_turns.empty()) {
+        bool is_acked = true;
+        for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+            if (is_peer[player_id] && !latency_is_input_acked(stream.latency, player_id, stream.unacked_turns.front().sequence)) {
+                is_acked = false;
+                break;
+            }
+        }
+        if (!is_acked && stream.unacked_turns.size() < INPUT_STREAM_REDUNDANT_TURN_COUNT) {
+            break;
+        }
+        stream.unacked_turns.pop_front();
+    }
+
+    // Serialize the inputs
+    InputStreamTurn turn;
+    turn.sequence = stream.sent_sequence;
+    uint8_t turn_buffer[NETWORK_INPUT_BUFFER_SIZE];
+    size_t turn_buffer_length = 0;
+    for (const MatchInput& input : inputs) {
+        match_input_serialize(turn_buffer, turn_buffer_length, input, stream.sent_codec);
+        GOLD_ASSERT(turn_buffer_length <= NETWORK_INPUT_BUFFER_SIZE);
+    }
+    turn.data = std::vector<uint8_t>(turn_buffer, turn_buffer + turn_buffer_length);
+    stream.unacked_turns.push_back(turn);
+    stream.sent_sequence++;
+    latency_set_input_sent(stream.latency, turn.sequence, now);
+
+    reliable_buffer_length = input_stream_write_message(stream, now, reliable_buffer, (uint32_t)stream.unacked_turns.size() - 1U);
+
+    // Resend as many of the unacked turns as will fit
+    uint32_t first_turn_index = 0;
+    size_t redundant_length = reliable_buffer_length;
+    for (uint32_t turn_index = (uint32_t)stream.unacked_turns.size() - 1U; turn_index > 0; turn_index--) {
+        redundant_length += sizeof(uint16_t) + stream.unacked_turns[turn_index - 1U].data.size();
+        if (redundant_length > NETWORK_INPUT_BUFFER_SIZE) {
+            first_turn_index = turn_index;
+            break;
+        }
+    }
+    unreliable_buffer_length = input_stream_write_message(stream, now, unreliable_buffer, first_turn_index);
+}
+
+static size_t input_stream_write_message(const InputStream& stream, uint64_t now, uint8_t* out_buffer, uint32_t first_turn_index) {
+    // The first byte is left for the network message type
+    size_t out_buffer_length = 1;
+    latency_write_input_acks(stream.latency, now, out_buffer, out_buffer_length);
+
+    uint16_t last_sequence = stream.unacked_turns.back().sequence;
+    memcpy(out_buffer + out_buffer_length, &last_sequence, sizeof(last_sequence));
+    out_buffer_length += sizeof(last_sequence);
+    out_buffer[out_buffer_length] = (uint8_t)(stream.unacked_turns.size() - first_turn_index);
+    out_buffer_length++;
+
+    for (uint32_t turn_index = first_turn_index; turn_index < stream.unacked_turns.size(); turn_index++) {
+        const InputStreamTurn& turn = stream.unacked_turns[turn_index];
+        uint16_t turn_length = (uint16_t)turn.data.size();
+        GOLD_ASSERT(out_buffer_length + sizeof(turn_length) + turn_length <= NETWORK_INPUT_BUFFER_SIZE);
+        memcpy(out_buffer + out_buffer_length, &turn_length, sizeof(turn_length));
+        out_buffer_length += sizeof(turn_length);
+        memcpy(out_buffer + out_buffer_length, turn.data.data(), turn_length);
+        out_buffer_length += turn_length;
+    }
+
+    return out_buffer_length;
+}
+
+void input_stream_read_message(InputStream& stream, uint8_t local_player_id, uint8_t player_id, uint64_t now,
+                                const uint8_t* in_buffer, size_t in_buffer_length, std::queue<std::vector<MatchInput>>& turns) {
+    // The whole message is checked before any of it is used, so that a truncated or corrupt message is dropped as a whole.
+    // The head starts past the network message type and the acks, which are read once the rest of the message checks out.
+    size_t in_buffer_head = 1 + LATENCY_INPUT_ACKS_SIZE;
+    if (in_buffer_length < in_buffer_head + sizeof(uint16_t) + sizeof(uint8_t)) {
+        log_warn("Dropped input message from player %u with a truncated header. Length %u.", player_id, (uint32_t)in_buffer_length);
+        return;
+    }
+
+    uint16_t last_sequence;
+    memcpy(&last_sequence, in_buffer + in_buffer_head, sizeof(last_sequence));
+    in_buffer_head += sizeof(last_sequence);
+    uint8_t turn_count = in_buffer[in_buffer_head];
+    in_buffer_head++;
+
+    uint16_t received_sequence = stream.received_sequence[player_id];
+    MatchInputCodec received_codec = stream.received_codec[player_id];
+    std::vector<std::vector<MatchInput>> received_turns;
+    for (uint8_t turn_index = 0; turn_index < turn_count; turn_index++) {
+        uint16_t sequence = (uint16_t)(last_sequence - (turn_count - 1U - turn_index));
+        uint16_t turn_length;
+        if (in_buffer_length - in_buffer_head < sizeof(turn_length)) {
+            log_warn("Dropped input message from player %u with a truncated turn. Length %u.", player_id, (uint32_t)in_buffer_length);
+            return;
+        }
+        memcpy(&turn_length, in_buffer + in_buffer_head, sizeof(turn_length));
+        in_buffer_head += sizeof(turn_length);
+        if (in_buffer_length - in_buffer_head < turn_length) {
+            log_warn("Dropped input message from player %u with a turn of length %u that runs past the message length %u.", player_id, turn_length, (uint32_t)in_buffer_length);
+            return;
+        }
+        size_t turn_end = in_buffer_head + turn_length;
+
+        // Turns are only taken in order. Anything older is a copy of a turn that we already have,
+        // and anything newer means that the turns in between were lost, so it waits for the reliable copy of them.
+        if (sequence != received_sequence) {
+            in_buffer_head = turn_end;
+            continue;
+        }
+
+        // Deserialize input
+        std::vector<MatchInput> inputs;
+        while (in_buffer_head < turn_end) {
+            MatchInput input;
+            if (!match_input_deserialize(in_buffer, turn_end, in_buffer_head, received_codec, input)) {
+                log_warn("Dropped input message from player %u with a corrupt input in turn %u.", player_id, sequence);
+                return;
+            }
+            inputs.push_back(input);
+        }
+        received_turns.push_back(inputs);
+        received_sequence++;
+    }
+
+    // The acks were checked to fit along with the header
+    size_t ack_head = 1;
+    latency_read_input_acks(stream.latency, local_player_id, player_id, now, in_buffer, in_buffer_length, ack_head);
+
+    for (const std::vector<MatchInput>& inputs : received_turns) {
+        turns.push(inputs);
+        latency_set_input_received(stream.latency, player_id, stream.received_sequence[player_id], now);
+        stream.received_sequence[player_id]++;
+    }
+    stream.received_codec[player_id] = received_codec;
+}
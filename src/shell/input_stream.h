@@ -0,0 +1,56 @@
+#pragma once
+
+#include "defines.h"
+#include "match/input.h"
+#include "match/state.h"
+#include "shell/latency.h"
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <queue>
+
+/**
+ * The transport for each player's stream of input turns. Every turn is sent twice: a reliable message carries just the newest turn
+ * and makes sure that every turn gets there eventually, while an unreliable message resends the recent turns that have not been acked,
+ * so that a lost message does not hold up the turns behind it while it waits to be resent.
+ *
+ * Input turns are numbered so that receivers can drop the copies they already have.
+ * Since every turn is serialized once and read once, in order, the input codec carries over from one turn to the next.
+ * Message layout: [message type][acks][uint16 last sequence][uint8 turn count] and then for each turn, [uint16 length][serialized inputs]
+ */
+
+// Each unreliable input message resends up to this many of the most recent turns that have not been acked by every peer
+const uint32_t INPUT_STREAM_REDUNDANT_TURN_COUNT = 8U;
+
+struct InputStreamTurn {
+    uint16_t sequence;
+    std::vector<uint8_t> data;
+};
+
+struct InputStream {
+    LatencyState latency;
+    uint16_t sent_sequence;
+    uint16_t received_sequence[MAX_PLAYERS];
+    MatchInputCodec sent_codec;
+    MatchInputCodec received_codec[MAX_PLAYERS];
+    // Serialized, oldest first
+    std::deque<InputStreamTurn> unacked_turns;
+};
+
+void input_stream_init(InputStream& stream, uint32_t turn_offset);
+// A peer is any active player other than the local player who sends input over the network, so bots run by the host are left out
+void input_stream_get_peers(const MatchState& match_state, uint8_t local_player_id, const bool is_bot[MAX_PLAYERS], bool is_peer[MAX_PLAYERS]);
+// Called once per turn, after the turn's inputs have been handled. Adjusts the input delay and fills turns with the turns to send now:
+// usually one turn made of the queued inputs, two when the delay grows, since an extra empty turn goes out ahead of it,
+// and none when the delay shrinks, in which case the queued inputs wait for the next turn
+void input_stream_get_turns_to_send(InputStream& stream, const bool is_peer[MAX_PLAYERS], std::vector<MatchInput>& input_queue,
+                                        std::vector<std::vector<MatchInput>>& turns);
+// Writes the reliable and the unreliable message for this turn. The first byte of each message is left for the network message type
+// is_peer should be true for each player who sends input over the network, other than the local player
+void input_stream_write_turn(InputStream& stream, const bool is_peer[MAX_PLAYERS], const std::vector<MatchInput>& inputs, uint64_t now,
+                                uint8_t* reliable_buffer, size_t& reliable_buffer_length,
+                                uint8_t* unreliable_buffer, size_t& unreliable_buffer_length);
+// Pushes each turn in the message that comes next in player_id's stream onto turns, and skips the rest.
+// A message that is truncated or corrupt is dropped as a whole
+void input_stream_read_message(InputStream& stream, uint8_t local_player_id, uint8_t player_id, uint64_t now,
+                                const uint8_t* in_buffer, size_t in_buffer_length, std::queue<std::vector<MatchInput>>& turns);
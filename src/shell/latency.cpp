@@ -0,0 +1,135 @@
+#include "latency.h"
+
+#include "shell/shell.h"
+#include "core/logger.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static const uint16_t LATENCY_HOLD_TIME_NONE = UINT16_MAX;
+// Growing happens right away to head off stalls, but shrinking waits until the link has been fast for a while
+static const uint32_t LATENCY_SHRINK_TURN_COUNT = 30U;
+static const float LATENCY_FRAME_MS = 1000.0f / (float)UPDATES_PER_SECOND;
+static const float LATENCY_TURN_MS = LATENCY_FRAME_MS * (float)TURN_DURATION;
+
+void latency_init(LatencyState& latency, uint32_t turn_offset) {
+    memset(&latency, 0, sizeof(latency));
+    latency.turn_offset = turn_offset;
+}
+
+void latency_set_input_sent(LatencyState& latency, uint16_t sequence, uint64_t now) {
+    latency.sent_times[sequence % LATENCY_SENT_TIME_COUNT] = (LatencySentTime) {
+        .sequence = sequence,
+        .time = now
+    };
+}
+
+void latency_set_input_received(LatencyState& latency, uint8_t player_id, uint16_t sequence, uint64_t now) {
+    LatencyPeer& peer = latency.peers[player_id];
+    peer.has_received = true;
+    peer.received_sequence = sequence;
+    peer.received_time = now;
+}
+
+bool latency_is_input_acked(const LatencyState& latency, uint8_t player_id, uint16_t sequence) {
+    const LatencyPeer& peer = latency.peers[player_id];
+    return peer.has_acked && (int16_t)(uint16_t)(peer.acked_sequence - sequence) >= 0;
+}
+
+void latency_write_input_acks(const LatencyState& latency, uint64_t now, uint8_t* out_buffer, size_t& out_buffer_length) {
+    for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+        const LatencyPeer& peer = latency.peers[player_id];
+        uint16_t ack_sequence = peer.has_received ? peer.received_sequence : 0;
+        uint16_t hold_time = peer.has_received
+                                ? (uint16_t)std::min(now - peer.received_time, (uint64_t)(LATENCY_HOLD_TIME_NONE - 1))
+                                : LATENCY_HOLD_TIME_NONE;
+        memcpy(out_buffer + out_buffer_length, &ack_sequence, sizeof(ack_sequence));
+        out_buffer_length += sizeof(ack_sequence);
+        memcpy(out_buffer + out_buffer_length, &hold_time, sizeof(hold_time));
+        out_buffer_length += sizeof(hold_time);
+    }
+}
+
+bool latency_read_input_acks(LatencyState& latency, uint8_t local_player_id, uint8_t player_id, uint64_t now,
+                                const uint8_t* in_buffer, size_t in_buffer_length, size_t& in_buffer_head) {
+    if (in_buffer_head > in_buffer_length || in_buffer_length - in_buffer_head < LATENCY_INPUT_ACKS_SIZE) {
+        return false;
+    }
+
+    LatencyPeer& peer = latency.peers[player_id];
+
+    for (uint8_t ack_player_id = 0; ack_player_id < MAX_PLAYERS; ack_player_id++) {
+        uint16_t ack_sequence;
+        uint16_t hold_time;
+        memcpy(&ack_sequence, in_buffer + in_buffer_head, sizeof(ack_sequence));
+        in_buffer_head += sizeof(ack_sequence);
+        memcpy(&hold_time, in_buffer + in_buffer_head, sizeof(hold_time));
+        in_buffer_head += sizeof(hold_time);
+
+        // Only look at the acks of our own input turns, and only sample each turn once.
+        // Messages can arrive out of order, so older acks are ignored.
+        if (ack_player_id != local_player_id ||
+                hold_time == LATENCY_HOLD_TIME_NONE ||
+                (peer.has_acked && (int16_t)(uint16_t)(ack_sequence - peer.acked_sequence) <= 0)) {
+            continue;
+        }
+        peer.has_acked = true;
+        peer.acked_sequence = ack_sequence;
+
+        const LatencySentTime& sent_time = latency.sent_times[ack_sequence % LATENCY_SENT_TIME_COUNT];
+        if (sent_time.sequence != ack_sequence) {
+            continue;
+        }
+
+        float rtt = (float)std::max((int64_t)(now - sent_time.time) - (int64_t)hold_time, (int64_t)0);
+        if (!peer.has_sample) {
+            peer.smoothed_rtt = rtt;
+            peer.rtt_variance = rtt / 2.0f;
+        } else {
+            peer.rtt_variance = (0.75f * peer.rtt_variance) + (0.25f * fabsf(peer.smoothed_rtt - rtt));
+            peer.smoothed_rtt = (0.875f * peer.smoothed_rtt) + (0.125f * rtt);
+        }
+        peer.has_sample = true;
+    }
+
+    return true;
+}
+
+int latency_update_turn_offset(LatencyState& latency, const bool is_peer[MAX_PLAYERS]) {
+    float required_time = 0.0f;
+    for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+        if (!is_peer[player_id]) {
+            continue;
+        }
+        // Hold steady until every peer has been measured
+        if (!latency.peers[player_id].has_sample) {
+            return 0;
+        }
+        required_time = std::max(required_time, latency.peers[player_id].smoothed_rtt + (4.0f * latency.peers[player_id].rtt_variance));
+    }
+
+    // Inputs have to reach the other players before they get to the turn that the inputs are for.
+    // Turns begin on frame boundaries, so allow for an extra frame.
+    uint32_t delay_turns = (uint32_t)ceilf((required_time + LATENCY_FRAME_MS) / LATENCY_TURN_MS);
+    uint32_t target_turn_offset = std::clamp(delay_turns + 1U, TURN_OFFSET_MIN, TURN_OFFSET_MAX);
+
+    if (target_turn_offset > latency.turn_offset) {
+        latency.shrink_turn_count = 0;
+        latency.turn_offset++;
+        log_info("Input delay grown to %u turns. Required time %.1fms.", latency.turn_offset, required_time);
+        return 1;
+    }
+    if (target_turn_offset < latency.turn_offset) {
+        latency.shrink_turn_count++;
+        if (latency.shrink_turn_count < LATENCY_SHRINK_TURN_COUNT) {
+            return 0;
+        }
+        latency.shrink_turn_count = 0;
+        latency.turn_offset--;
+        log_info("Input delay shrunk to %u turns. Required time %.1fms.", latency.turn_offset, required_time);
+        return -1;
+    }
+
+    latency.shrink_turn_count = 0;
+    return 0;
+}
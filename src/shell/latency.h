@@ -0,0 +1,63 @@
+#pragma once
+
+#include "defines.h"
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Input delay is measured in turns. Each player's inputs are a stream, and every peer executes the
+ * front of each stream on every turn, so the turn that an input is executed on is decided by its position in the stream,
+ * not by when it arrives. This means a player can change the delay of their own stream without any handshake:
+ * sending an extra empty turn grows it by one, and skipping a turn shrinks it by one, and since every peer
+ * consumes the same stream in the same order, the simulation stays in lockstep either way.
+ *
+ * The delay is chosen from the round-trip time to the other players, which is measured off of the input messages themselves.
+ * Each input turn has a sequence number, and each input message acks, for every other player, the last sequence number received from them
+ * along with how long ago it was received. When a player sees their own sequence number acked, the round-trip time
+ * is the time since it was sent minus the time the peer held onto it.
+ *
+ * Times are in milliseconds and are passed in by the caller, so that the same code can run against a simulated clock.
+ */
+
+const size_t LATENCY_INPUT_ACKS_SIZE = MAX_PLAYERS * 2 * sizeof(uint16_t);
+const uint32_t LATENCY_SENT_TIME_COUNT = 64U;
+
+struct LatencyPeer {
+    // Their input turns that we have received
+    bool has_received;
+    uint16_t received_sequence;
+    uint64_t received_time;
+
+    // Our input turns that they have received
+    bool has_acked;
+    uint16_t acked_sequence;
+
+    bool has_sample;
+    float smoothed_rtt;
+    float rtt_variance;
+};
+
+struct LatencySentTime {
+    uint16_t sequence;
+    uint64_t time;
+};
+
+struct LatencyState {
+    LatencySentTime sent_times[LATENCY_SENT_TIME_COUNT];
+    LatencyPeer peers[MAX_PLAYERS];
+
+    uint32_t turn_offset;
+    uint32_t shrink_turn_count;
+};
+
+void latency_init(LatencyState& latency, uint32_t turn_offset);
+void latency_set_input_sent(LatencyState& latency, uint16_t sequence, uint64_t now);
+void latency_set_input_received(LatencyState& latency, uint8_t player_id, uint16_t sequence, uint64_t now);
+bool latency_is_input_acked(const LatencyState& latency, uint8_t player_id, uint16_t sequence);
+void latency_write_input_acks(const LatencyState& latency, uint64_t now, uint8_t* out_buffer, size_t& out_buffer_length);
+// Returns false if the acks run past the end of the buffer, in which case the message should be dropped
+bool latency_read_input_acks(LatencyState& latency, uint8_t local_player_id, uint8_t player_id, uint64_t now,
+                                const uint8_t* in_buffer, size_t in_buffer_length, size_t& in_buffer_head);
+// Called once per turn. Returns 1 if the local input stream should grow by a turn, -1 if it should shrink by a turn, and 0 otherwise
+// is_peer should be true for each player who sends input over the network, other than the local player
+int latency_update_turn_offset(LatencyState& latency, const bool is_peer[MAX_PLAYERS]);
@@ -3,10 +3,12 @@
 #include "network/types.h"
 #include "core/filesystem.h"
 #include "core/logger.h"
+#include "core/asserts.h"
 #include "profile/profile.h"
 
 static const uint32_t REPLAY_FILE_SIGNATURE = 0x46591214;
-static const uint32_t REPLAY_FILE_VERSION = 0;
+// Version 1 switched the inputs over to the compact input encoding
+static const uint32_t REPLAY_FILE_VERSION = 1;
 
 #ifdef GOLD_DEBUG
 
@@ -65,7 +67,7 @@ void replay_file_close(FILE* file) {
     fclose(file);
 }
 
-void replay_file_write_entry(FILE* file, const ReplayEntry& entry) {
+void replay_file_write_entry(FILE* file, MatchInputCodec& codec, const ReplayEntry& entry) {
     if (file == NULL) {
         return;
     }
@@ -77,8 +79,10 @@ void replay_file_write_entry(FILE* file, const ReplayEntry& entry) {
             uint8_t out_buffer[NETWORK_INPUT_BUFFER_SIZE];
             size_t out_buffer_length = 0;
 
-            match_input_serialize(out_buffer, out_buffer_length, entry.input);
-            fwrite(&out_buffer_length, 1, sizeof(size_t), file);
+            match_input_serialize(out_buffer, out_buffer_length, entry.input, codec);
+            GOLD_ASSERT(out_buffer_length <= UINT8_MAX);
+            uint8_t out_buffer_length_byte = (uint8_t)out_buffer_length;
+            fwrite(&out_buffer_length_byte, 1, sizeof(uint8_t), file);
             fwrite(out_buffer, 1, out_buffer_length, file);
 
             break;
@@ -118,6 +122,11 @@ bool replay_file_read(const char* path, MatchState& state, std::vector<std::vect
     uint32_t replay_version;
     fread(&replay_version, 1, sizeof(uint32_t), file);
     log_debug("Replay version: %u", replay_version);
+    if (replay_version != REPLAY_FILE_VERSION) {
+        log_error("Replay file version %u is not supported. Expected version %u.", replay_version, REPLAY_FILE_VERSION);
+        fclose(file);
+        return false;
+    }
 
     // LCG seed
     int32_t lcg_seed;
@@ -146,6 +155,9 @@ bool replay_file_read(const char* path, MatchState& state, std::vector<std::vect
         }
     });
 
+    MatchInputCodec input_codec;
+    match_input_codec_init(input_codec);
+
     while (true) {
         uint8_t entry_type;
         size_t bytes_read = fread(&entry_type, 1, sizeof(uint8_t), file);
@@ -155,12 +167,12 @@ bool replay_file_read(const char* path, MatchState& state, std::vector<std::vect
 
         switch (entry_type) {
             case REPLAY_ENTRY_INPUT: {
-                size_t in_buffer_length;
+                uint8_t in_buffer_length;
                 uint8_t in_buffer[NETWORK_INPUT_BUFFER_SIZE];
 
-                bytes_read = fread(&in_buffer_length, 1, sizeof(size_t), file);
-                if (bytes_read != sizeof(size_t)) {
-                    log_error("Replay file bytes read mismatch. Read %u Expected %u", bytes_read, sizeof(size_t));
+                bytes_read = fread(&in_buffer_length, 1, sizeof(uint8_t), file);
+                if (bytes_read != sizeof(uint8_t)) {
+                    log_error("Replay file bytes read mismatch. Read %u Expected %u", bytes_read, sizeof(uint8_t));
                     goto fail;
                 }
                 bytes_read = fread(in_buffer, 1, in_buffer_length, file);
@@ -170,7 +182,11 @@ bool replay_file_read(const char* path, MatchState& state, std::vector<std::vect
                 }
 
                 size_t in_buffer_head = 0;
-                MatchInput input = match_input_deserialize(in_buffer, in_buffer_head);
+                MatchInput input;
+                if (!match_input_deserialize(in_buffer, in_buffer_length, in_buffer_head, input_codec, input) || in_buffer_head != in_buffer_length) {
+                    log_error("Replay file has a corrupt input entry.");
+                    goto fail;
+                }
 
                 if (input.type != MATCH_INPUT_NONE) {
                     char print_buffer[1024];
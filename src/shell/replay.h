@@ -33,5 +33,6 @@ void replay_set_filename(const char* argv);
 #endif
 FILE* replay_file_open(int32_t lcg_seed, MapType map_type, const Noise* noise, MatchPlayer players[MAX_PLAYERS]);
 void replay_file_close(FILE* file);
-void replay_file_write_entry(FILE* file, const ReplayEntry& entry);
+// Inputs are written relative to the ones before them, so the same codec should be passed in for every entry in the file
+void replay_file_write_entry(FILE* file, MatchInputCodec& codec, const ReplayEntry& entry);
 bool replay_file_read(const char* path, MatchState& state, std::vector<std::vector<ReplayEntry>>* replay_entries);
\ No newline at end of file
@@ -78,7 +78,8 @@ static const ivec2 GARRISON_ICON_POSITIONS[4] = {
 
 // Replay
 static const double UPDATE_DURATION = 1.0 / UPDATES_PER_SECOND;
-static const uint32_t REPLAY_CHECKPOINT_FREQ = 32U;
+static const uint32_t REPLAY_PREFETCH_CHAIN_COUNT = 4U;
+static const uint32_t REPLAY_WORKER_IDLE_TIMEOUT_MS = 100U;
 static const uint32_t REPLAY_FOG_NONE = 0U;
 static const uint32_t REPLAY_FOG_EVERYONE = 1U;
 
@@ -101,7 +102,7 @@ static const Rect SOUND_LISTEN_RECT = (Rect) {
     .h = SCREEN_HEIGHT + (SOUND_LISTEN_MARGIN * 2),
 };
 static const uint32_t SOUND_COOLDOWN_DURATION = 5;
-static const uint32_t SOUND_FIRE_NOT_PLAYING = UINT32_MAX;
+static const uint32_t SOUND_FIRE_NOT_PLAYING = SOUND_VOICE_NULL;
 
 // Alerts
 static const int ATTACK_ALERT_DISTANCE = 20;
@@ -182,6 +183,10 @@ MatchShellState* match_shell_base_init() {
 
     // Replay file
     state->replay_file = NULL;
+    match_input_codec_init(state->replay_input_codec);
+
+    // Checksum
+    desync_checksum_cache_init(state->checksum_cache);
 
     #ifdef GOLD_DEBUG
         state->debug_fog = DEBUG_FOG_ENABLED;
@@ -201,6 +206,8 @@ void match_shell_init_input_queues(MatchShellState* state) {
             state->inputs[player_id].push({ (MatchInput) { .type = MATCH_INPUT_NONE } });
         }
     }
+
+    input_stream_init(state->input_stream, TURN_OFFSET);
 }
 
 MatchShellState* match_shell_init(int lcg_seed, Noise* noise) {
@@ -348,7 +355,7 @@ MatchShellState* match_shell_init_from_scenario(const Scenario* scenario, const
         if (entity_is_building(entity.type)) {
             Entity& building = state->match_state.entities.get_by_id(entity_id);
             building.mode = MODE_BUILDING_FINISHED;
-            building.health = entity_get_data(building.type).max_health;
+            entity_set_health(state->match_state, building, entity_get_data(building.type).max_health);
         }
     }
 
@@ -418,8 +425,48 @@ MatchShellState* match_shell_init_from_scenario(const Scenario* scenario, const
     return state;
 }
 
-static int match_shell_load_replay_checkpoints(void* state_ptr) {
+static uint32_t match_shell_replay_get_chain_last_frame(const MatchShellState* state, uint32_t chain_index) {
+    uint32_t chain_last_frame = (chain_index * REPLAY_CHECKPOINT_CHAIN_DURATION) + REPLAY_CHECKPOINT_CHAIN_DURATION - REPLAY_CHECKPOINT_FREQ;
+    uint32_t last_checkpoint_frame = (uint32_t)match_shell_replay_end_of_tape(state) - ((uint32_t)match_shell_replay_end_of_tape(state) % REPLAY_CHECKPOINT_FREQ);
+    return std::min(chain_last_frame, last_checkpoint_frame);
+}
+
+// Assumes that the loading mutex is held
+static bool match_shell_replay_should_fill_chain(const MatchShellState* state, uint32_t chain_index) {
+    uint32_t chain_frame = chain_index * REPLAY_CHECKPOINT_CHAIN_DURATION;
+    return !state->replay_chain_is_filling[chain_index] &&
+        replay_checkpoint_store_has_frame(state->replay_checkpoints, chain_frame) &&
+        !replay_checkpoint_store_has_frame(state->replay_checkpoints, match_shell_replay_get_chain_last_frame(state, chain_index));
+}
+
+// Assumes that the loading mutex is held
+// Returns the chain closest to the replay cursor which still needs filling, looking ahead of the cursor first
+// Chains outside of the prefetch window are only filled if the store has room for them
+static uint32_t match_shell_replay_get_next_chain_to_fill(const MatchShellState* state) {
+    uint32_t chain_count = (uint32_t)state->replay_chain_is_filling.size();
+    uint32_t cursor_chain_index = std::min(state->replay_checkpoints.focus_frame / REPLAY_CHECKPOINT_CHAIN_DURATION, chain_count - 1);
+    bool has_room_for_chain = replay_checkpoint_store_has_room_for_chain(state->replay_checkpoints);
+
+    for (uint32_t distance = 0; distance < chain_count; distance++) {
+        if (distance > REPLAY_PREFETCH_CHAIN_COUNT && !has_room_for_chain) {
+            break;
+        }
+        if (cursor_chain_index + distance < chain_count && 
+                match_shell_replay_should_fill_chain(state, cursor_chain_index + distance)) {
+            return cursor_chain_index + distance;
+        }
+        if (distance != 0 && distance <= cursor_chain_index && 
+                match_shell_replay_should_fill_chain(state, cursor_chain_index - distance)) {
+            return cursor_chain_index - distance;
+        }
+    }
+
+    return chain_count;
+}
+
+static int match_shell_load_replay_keyframes(void* state_ptr) {
     MatchShellState* state = (MatchShellState*)state_ptr;
+    ReplayCheckpointEncoder encoder;
 
     while (state->replay_loading_match_timer < match_shell_replay_end_of_tape(state)) {
         // Match update
@@ -429,23 +476,79 @@ static int match_shell_load_replay_checkpoints(void* state_ptr) {
         match_update(state->replay_loading_match_state);
         state->replay_loading_match_state.events.clear();
 
-        // Increment timer and save replay checkpoint
+        // Encode the keyframe outside of the lock since only this thread touches the encoder
+        uint32_t next_match_timer = state->replay_loading_match_timer + 1;
+        ReplayCheckpoint keyframe;
+        bool has_keyframe = next_match_timer % REPLAY_CHECKPOINT_CHAIN_DURATION == 0;
+        if (has_keyframe) {
+            keyframe = replay_checkpoint_encode_keyframe(encoder, state->replay_loading_match_state, next_match_timer);
+        }
+
+        // Increment timer, save keyframe, and check for early exit
         SDL_LockMutex(state->replay_loading_mutex);
-        state->replay_loading_match_timer++;
-        if (state->replay_loading_match_timer % REPLAY_CHECKPOINT_FREQ == 0) {
-            state->replay_checkpoints.push_back(state->replay_loading_match_state);
+        state->replay_loading_match_timer = next_match_timer;
+        if (has_keyframe) {
+            replay_checkpoint_store_insert(state->replay_checkpoints, std::move(keyframe));
+            SDL_BroadcastCondition(state->replay_loading_condition);
         }
+        bool should_break = state->replay_loading_early_exit;
         SDL_UnlockMutex(state->replay_loading_mutex);
 
-        // Check for early exit
-        if (SDL_TryLockMutex(state->replay_loading_early_exit_mutex)) {
-            bool should_break = state->replay_loading_early_exit;
-            SDL_UnlockMutex(state->replay_loading_early_exit_mutex);
-            if (should_break) {
-                break;
+        if (should_break) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static int match_shell_fill_replay_checkpoint_chains(void* state_ptr) {
+    MatchShellState* state = (MatchShellState*)state_ptr;
+    ReplayCheckpointEncoder encoder;
+    // Heap allocated because the state is too big for the thread's stack
+    MatchState* match_state = new MatchState();
+
+    SDL_LockMutex(state->replay_loading_mutex);
+    while (!state->replay_loading_early_exit) {
+        uint32_t chain_index = match_shell_replay_get_next_chain_to_fill(state);
+        if (chain_index == state->replay_chain_is_filling.size()) {
+            SDL_WaitConditionTimeout(state->replay_loading_condition, state->replay_loading_mutex, REPLAY_WORKER_IDLE_TIMEOUT_MS);
+            continue;
+        }
+
+        // Resume from the latest checkpoint in the chain
+        uint32_t chain_last_frame = match_shell_replay_get_chain_last_frame(state, chain_index);
+        uint32_t match_timer = replay_checkpoint_store_load(state->replay_checkpoints, chain_last_frame, *match_state);
+        state->replay_chain_is_filling[chain_index] = true;
+        SDL_UnlockMutex(state->replay_loading_mutex);
+
+        replay_checkpoint_encoder_reset(encoder, *match_state);
+        bool should_stop_filling = false;
+        while (match_timer < chain_last_frame && !should_stop_filling) {
+            if (match_timer % TURN_DURATION == 0) {
+                match_shell_replay_handle_entries_for_turn(state->replay_entries, *match_state, nullptr, match_timer / TURN_DURATION);
             }
-        } 
+            match_update(*match_state);
+            match_state->events.clear();
+            match_timer++;
+
+            if (match_timer % REPLAY_CHECKPOINT_FREQ == 0) {
+                ReplayCheckpoint checkpoint = replay_checkpoint_encode_delta(encoder, *match_state, match_timer);
+
+                // If the insert fails, the store dropped this chain to stay within its budget, so stop filling it
+                SDL_LockMutex(state->replay_loading_mutex);
+                should_stop_filling = !replay_checkpoint_store_insert(state->replay_checkpoints, std::move(checkpoint)) ||
+                    state->replay_loading_early_exit;
+                SDL_UnlockMutex(state->replay_loading_mutex);
+            }
+        }
+
+        SDL_LockMutex(state->replay_loading_mutex);
+        state->replay_chain_is_filling[chain_index] = false;
     }
+    SDL_UnlockMutex(state->replay_loading_mutex);
+
+    delete match_state;
 
     return 0;
 }
@@ -462,24 +565,37 @@ MatchShellState* replay_shell_init(const char* replay_path) {
         return nullptr;
     }
 
-    state->replay_checkpoints.reserve(((match_shell_replay_end_of_tape(state) + 1) / REPLAY_CHECKPOINT_FREQ) + 1);
-    state->replay_checkpoints.push_back(state->match_state);
+    ReplayCheckpointEncoder encoder;
+    replay_checkpoint_store_init(state->replay_checkpoints, REPLAY_CHECKPOINT_MEMORY_BUDGET_DEFAULT);
+    replay_checkpoint_store_insert(state->replay_checkpoints, replay_checkpoint_encode_keyframe(encoder, state->match_state, 0));
 
     state->replay_loading_mutex = SDL_CreateMutex();
+    state->replay_loading_condition = SDL_CreateCondition();
     state->replay_loading_match_timer = 0;
     state->replay_loaded_match_timer = 0;
-
-    state->replay_loading_early_exit_mutex = SDL_CreateMutex();
     state->replay_loading_early_exit = false;
+    state->replay_chain_is_filling = std::vector<bool>((match_shell_replay_end_of_tape(state) / REPLAY_CHECKPOINT_CHAIN_DURATION) + 1, false);
 
     state->replay_loading_match_state = state->match_state;
-    state->replay_loading_thread = SDL_CreateThread(match_shell_load_replay_checkpoints, "replay_loading_thread", state);
+    state->replay_loading_thread = SDL_CreateThread(match_shell_load_replay_keyframes, "replay_loading_thread", state);
     if (!state->replay_loading_thread) {
         log_error("Error creating loading thread %s", SDL_GetError());
         delete state;
         return nullptr;
     }
 
+    // Leave a core each for the main thread and the keyframe thread
+    state->replay_worker_count = (uint32_t)std::clamp(SDL_GetNumLogicalCPUCores() - 2, 1, (int)REPLAY_WORKER_COUNT_MAX);
+    for (uint32_t worker_index = 0; worker_index < state->replay_worker_count; worker_index++) {
+        state->replay_worker_threads[worker_index] = SDL_CreateThread(match_shell_fill_replay_checkpoint_chains, "replay_worker_thread", state);
+        if (!state->replay_worker_threads[worker_index]) {
+            log_warn("Error creating replay worker thread %s", SDL_GetError());
+            state->replay_worker_count = worker_index;
+            break;
+        }
+    }
+    log_info("Loading replay with %u worker threads.", state->replay_worker_count);
+
     match_shell_replay_scrub(state, 0);
 
     // Init replay fog picker
@@ -517,17 +633,8 @@ void match_shell_free(MatchShellState* state) {
 void match_shell_handle_network_event(MatchShellState* state, NetworkEvent event) {
     switch (event.type) {
         case NETWORK_EVENT_INPUT: {
-            // Deserialize input
-            std::vector<MatchInput> inputs;
-
-            const uint8_t* in_buffer = event.input.in_buffer;
-            size_t in_buffer_head = 1; // Advance the head by once since the first byte will contain the network message type
-
-            while (in_buffer_head < event.input.in_buffer_length) {
-                inputs.push_back(match_input_deserialize(in_buffer, in_buffer_head));
-            }
-
-            state->inputs[event.input.player_id].push(inputs);
+            input_stream_read_message(state->input_stream, network_get_player_id(), event.input.player_id, SDL_GetTicks(),
+                                        event.input.in_buffer, event.input.in_buffer_length, state->inputs[event.input.player_id]);
             break;
         }
         case NETWORK_EVENT_CHAT: {
@@ -541,7 +648,10 @@ void match_shell_handle_network_event(MatchShellState* state, NetworkEvent event
             break;
         }
         case NETWORK_EVENT_CHECKSUM: {
-            state->checksums[event.checksum.player_id].push(event.checksum.checksum);
+            DesyncChecksum checksum;
+            checksum.checksum = event.checksum.checksum;
+            memcpy(checksum.section_checksums, event.checksum.section_checksums, sizeof(checksum.section_checksums));
+            state->checksums[event.checksum.player_id].push(checksum);
             break;
         }
     #ifdef GOLD_DEBUG
@@ -557,6 +667,30 @@ void match_shell_handle_network_event(MatchShellState* state, NetworkEvent event
 
 // UPDATE
 
+void match_shell_get_input_peers(const MatchShellState* state, bool is_peer[MAX_PLAYERS]) {
+    bool is_bot[MAX_PLAYERS];
+    for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
+        is_bot[player_id] = network_get_player(player_id).status == NETWORK_PLAYER_STATUS_BOT;
+    }
+    input_stream_get_peers(state->match_state, network_get_player_id(), is_bot, is_peer);
+}
+
+void match_shell_flush_input_turn(MatchShellState* state, const std::vector<MatchInput>& inputs) {
+    bool is_peer[MAX_PLAYERS];
+    match_shell_get_input_peers(state, is_peer);
+    uint8_t reliable_buffer[NETWORK_INPUT_BUFFER_SIZE];
+    size_t reliable_buffer_length;
+    uint8_t unreliable_buffer[NETWORK_INPUT_BUFFER_SIZE];
+    size_t unreliable_buffer_length;
+    input_stream_write_turn(state->input_stream, is_peer, inputs, SDL_GetTicks(),
+                            reliable_buffer, reliable_buffer_length,
+                            unreliable_buffer, unreliable_buffer_length);
+    state->inputs[network_get_player_id()].push(inputs);
+
+    network_send_input(reliable_buffer, reliable_buffer_length);
+    network_send_input_unreliable(unreliable_buffer, unreliable_buffer_length);
+}
+
 void match_shell_update(MatchShellState* state) {
     ZoneScoped;
     
@@ -746,6 +880,8 @@ void match_shell_update(MatchShellState* state) {
         // Loading thread handling
         if (SDL_TryLockMutex(state->replay_loading_mutex)) {
             state->replay_loaded_match_timer = state->replay_loading_match_timer;
+            // Keep the workers prefetching around the playback position
+            replay_checkpoint_store_set_focus_frame(state->replay_checkpoints, state->match_timer);
             SDL_UnlockMutex(state->replay_loading_mutex);
         }
         if (state->replay_loading_thread != NULL && SDL_GetThreadState(state->replay_loading_thread) == SDL_THREAD_COMPLETE) {
@@ -1044,7 +1180,7 @@ void match_shell_update(MatchShellState* state) {
         state->disconnect_timer = 0;
 
         // All inputs received. Begin next turn
-        replay_file_write_entry(state->replay_file, (ReplayEntry) { .type = REPLAY_ENTRY_NEW_TURN });
+        replay_file_write_entry(state->replay_file, state->replay_input_codec, (ReplayEntry) { .type = REPLAY_ENTRY_NEW_TURN });
 
         // Handle input
         for (uint8_t player_id = 0; player_id < MAX_PLAYERS; player_id++) {
@@ -1055,7 +1191,7 @@ void match_shell_update(MatchShellState* state) {
             for (const MatchInput& input : state->inputs[player_id].front()) {
                 // Write input to replay file
                 if (input.type != MATCH_INPUT_NONE) {
-                    replay_file_write_entry(state->replay_file, (ReplayEntry) {
+                    replay_file_write_entry(state->replay_file, state->replay_input_codec, (ReplayEntry) {
                         .type = REPLAY_ENTRY_INPUT,
                         .input = input
                     });
@@ -1078,23 +1214,13 @@ void match_shell_update(MatchShellState* state) {
 
         // Flush input
         if (state->match_state.players[network_get_player_id()].active) {
-            // Always send at least one input per turn
-            if (state->input_queue.empty()) {
-                state->input_queue.push_back((MatchInput) { .type = MATCH_INPUT_NONE });
-            } 
-
-            // Serialize the inputs
-            uint8_t out_buffer[NETWORK_INPUT_BUFFER_SIZE];
-            size_t out_buffer_length = 1;
-            for (const MatchInput& input : state->input_queue) {
-                match_input_serialize(out_buffer, out_buffer_length, input);
-                GOLD_ASSERT(out_buffer_length <= NETWORK_INPUT_BUFFER_SIZE);
+            bool is_peer[MAX_PLAYERS];
+            match_shell_get_input_peers(state, is_peer);
+            std::vector<std::vector<MatchInput>> turns;
+            input_stream_get_turns_to_send(state->input_stream, is_peer, state->input_queue, turns);
+            for (const std::vector<MatchInput>& turn : turns) {
+                match_shell_flush_input_turn(state, turn);
             }
-            state->inputs[network_get_player_id()].push(state->input_queue);
-            state->input_queue.clear();
-
-            // Send inputs to other players
-            network_send_input(out_buffer, out_buffer_length);
         }
     }
 
@@ -1105,9 +1231,9 @@ void match_shell_update(MatchShellState* state) {
 
     // Compute checksum
     if (!state->replay_mode && state->match_timer % desync_get_checksum_frequency() == 0) {
-        uint32_t checksum = adler32_simd((uint8_t*)&state->match_state, DESYNC_BUFFER_SIZE);
+        DesyncChecksum checksum = desync_checksum_compute(state->checksum_cache, state->match_state, state->bots);
         desync_write_frame((uint8_t*)&state->match_state, state->match_timer);
-        network_send_checksum(checksum);
+        network_send_checksum(checksum.checksum, checksum.section_checksums, DESYNC_CHECKSUM_SECTION_COUNT);
         state->checksums[network_get_player_id()].push(checksum);
 
     #ifdef GOLD_SIMD_CHECKSUM_TEST
@@ -2666,7 +2792,7 @@ void match_shell_add_chat_message(MatchShellState* state, FontName prefix_font,
     strncpy(chat_message.message, message, SHELL_CHAT_MESSAGE_BUFFER_SIZE);
     state->chat.push_back(chat_message);
 
-    replay_file_write_entry(state->replay_file, (ReplayEntry) {
+    replay_file_write_entry(state->replay_file, state->replay_input_codec, (ReplayEntry) {
         .type = REPLAY_ENTRY_CHAT,
         .chat_message = chat_message
     });
@@ -2677,7 +2803,7 @@ void match_shell_handle_player_disconnect(MatchShellState* state, uint8_t player
     sprintf(message, "%s left the game.", network_get_player(player_id).name);
     match_shell_add_chat_message(state, FONT_HACK_WHITE, "", message, CHAT_MESSAGE_DURATION);
 
-    replay_file_write_entry(state->replay_file, (ReplayEntry) {
+    replay_file_write_entry(state->replay_file, state->replay_input_codec, (ReplayEntry) {
         .type = REPLAY_ENTRY_DISCONNECT,
         .disconnect_player_id = player_id
     });
@@ -2935,13 +3061,17 @@ void match_shell_replay_scrub(MatchShellState* state, uint32_t position) {
         return;
     }
 
+    SDL_LockMutex(state->replay_loading_mutex);
+    // Point the workers at the new position before loading so that the chains after it get filled next
+    replay_checkpoint_store_set_focus_frame(state->replay_checkpoints, position);
+    SDL_BroadcastCondition(state->replay_loading_condition);
     if (position < state->match_timer || (position > state->match_timer && position - state->match_timer > REPLAY_CHECKPOINT_FREQ)) {
-        uint32_t nearest_checkpoint = position / REPLAY_CHECKPOINT_FREQ;
-        SDL_LockMutex(state->replay_loading_mutex);
-        state->match_state = state->replay_checkpoints[nearest_checkpoint];
-        SDL_UnlockMutex(state->replay_loading_mutex);
-        state->match_timer = nearest_checkpoint * REPLAY_CHECKPOINT_FREQ;
+        // The nearest checkpoint may be behind the current position if its chain has not been filled yet, or if the store had to drop it to stay within its memory budget
+        if (position < state->match_timer || replay_checkpoint_store_get_nearest_frame(state->replay_checkpoints, position) > state->match_timer) {
+            state->match_timer = replay_checkpoint_store_load(state->replay_checkpoints, position, state->match_state);
+        }
     }
+    SDL_UnlockMutex(state->replay_loading_mutex);
 
     while (state->match_timer < position) {
         if (state->match_timer % TURN_DURATION == 0) {
@@ -2994,14 +3124,18 @@ bool match_shell_is_surrender_required_to_leave(const MatchShellState* state) {
 
 void match_shell_leave_match(MatchShellState* state, MatchShellMode mode) {
     if (state->replay_mode) {
-        SDL_LockMutex(state->replay_loading_early_exit_mutex);
+        SDL_LockMutex(state->replay_loading_mutex);
         state->replay_loading_early_exit = true;
-        SDL_UnlockMutex(state->replay_loading_early_exit_mutex);
+        SDL_BroadcastCondition(state->replay_loading_condition);
+        SDL_UnlockMutex(state->replay_loading_mutex);
 
         SDL_WaitThread(state->replay_loading_thread, NULL);
+        for (uint32_t worker_index = 0; worker_index < state->replay_worker_count; worker_index++) {
+            SDL_WaitThread(state->replay_worker_threads[worker_index], NULL);
+        }
 
+        SDL_DestroyCondition(state->replay_loading_condition);
         SDL_DestroyMutex(state->replay_loading_mutex);
-        SDL_DestroyMutex(state->replay_loading_early_exit_mutex);
     } else {
         network_disconnect();
         replay_file_close(state->replay_file);
@@ -3036,13 +3170,23 @@ bool match_shell_are_next_checksums_out_of_sync(const MatchShellState* state) {
                 network_get_player(player_id).status != NETWORK_PLAYER_STATUS_READY) {
             continue;
         }
-        if (state->checksums[player_id].front() != state->checksums[network_get_player_id()].front()) {
+        const DesyncChecksum& checksum = state->checksums[player_id].front();
+        const DesyncChecksum& local_checksum = state->checksums[network_get_player_id()].front();
+        if (checksum.checksum != local_checksum.checksum) {
             log_error("DESYNC found on frame %u between player %u (checksum %u) and player %u (checksum %u)", 
                 state->next_checksum_frame, 
                 player_id, 
-                state->checksums[player_id].front(),
+                checksum.checksum,
                 network_get_player_id(), 
-                state->checksums[network_get_player_id()].front());
+                local_checksum.checksum);
+            for (uint32_t section = 0; section < DESYNC_CHECKSUM_SECTION_COUNT; section++) {
+                if (checksum.section_checksums[section] != local_checksum.section_checksums[section]) {
+                    log_error("DESYNC section %s diverged (checksum %u / %u)", 
+                        desync_checksum_section_str((DesyncChecksumSection)section),
+                        checksum.section_checksums[section],
+                        local_checksum.section_checksums[section]);
+                }
+            }
             return true;
         }
     }
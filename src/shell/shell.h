@@ -3,6 +3,9 @@
 #include "defines.h"
 #include "shell/chat.h"
 #include "shell/replay.h"
+#include "shell/checkpoint.h"
+#include "shell/desync.h"
+#include "shell/input_stream.h"
 #include "match/state.h"
 #include "core/ui.h"
 #include "menu/options_menu.h"
@@ -20,7 +23,10 @@
 #define MATCH_SHELL_CAMERA_HOTKEY_COUNT 6
 
 // Timing
+// Bots always use TURN_OFFSET, while the local player's input delay adapts between TURN_OFFSET_MIN and TURN_OFFSET_MAX
 const uint32_t TURN_OFFSET = 4;
+const uint32_t TURN_OFFSET_MIN = 2;
+const uint32_t TURN_OFFSET_MAX = 8;
 const uint32_t TURN_DURATION = 4;
 
 // Chat
@@ -28,6 +34,9 @@ const uint32_t CHAT_MESSAGE_DURATION = 3U * 60U;
 const uint32_t CHAT_MESSAGE_HINT_DURATION = 5U * 60U;
 const uint32_t CHAT_MAX_LINES = 8U;
 
+// Replay
+const uint32_t REPLAY_WORKER_COUNT_MAX = 4U;
+
 // Alerts
 const uint32_t ALERT_DURATION = 90;
 const uint32_t ALERT_LINGER_DURATION = 60 * 20;
@@ -162,6 +171,7 @@ struct MatchShellState {
     // Inputs
     std::queue<std::vector<MatchInput>> inputs[MAX_PLAYERS];
     std::vector<MatchInput> input_queue;
+    InputStream input_stream;
 
     // Camera
     CameraMode camera_mode;
@@ -224,11 +234,12 @@ struct MatchShellState {
 
     // Replay file (write)
     FILE* replay_file;
+    MatchInputCodec replay_input_codec;
 
     // Replay data (read)
     bool replay_mode;
     UI replay_ui;
-    std::vector<MatchState> replay_checkpoints;
+    ReplayCheckpointStore replay_checkpoints;
     std::vector<std::vector<ReplayEntry>> replay_entries;
 
     // Replay fog
@@ -236,20 +247,26 @@ struct MatchShellState {
     std::vector<std::string> replay_fog_texts;
     std::vector<uint8_t> replay_fog_player_ids;
 
-    // Replay loading thread
+    // Replay loading threads
+    // The keyframe thread simulates the whole replay once and records a keyframe per checkpoint chain,
+    // while the worker threads fill in the deltas of each chain, starting with the chains around the replay cursor
     SDL_Thread* replay_loading_thread;
     MatchState replay_loading_match_state;
     uint32_t replay_loading_match_timer;
+    SDL_Thread* replay_worker_threads[REPLAY_WORKER_COUNT_MAX];
+    uint32_t replay_worker_count;
 
+    // Guards the checkpoint store, the loading match timer, the filling chains and early exit
     SDL_Mutex* replay_loading_mutex;
+    SDL_Condition* replay_loading_condition;
     uint32_t replay_loaded_match_timer;
-
-    SDL_Mutex* replay_loading_early_exit_mutex;
+    std::vector<bool> replay_chain_is_filling;
     bool replay_loading_early_exit;
 
     // Checksum
     uint32_t next_checksum_frame;
-    std::queue<uint32_t> checksums[MAX_PLAYERS];
+    std::queue<DesyncChecksum> checksums[MAX_PLAYERS];
+    DesyncChecksumCache checksum_cache;
 
     // Debug
     #ifdef GOLD_DEBUG
@@ -269,6 +286,8 @@ void match_shell_handle_network_event(MatchShellState* state, NetworkEvent event
 
 // Update
 void match_shell_update(MatchShellState* state);
+void match_shell_get_input_peers(const MatchShellState* state, bool is_peer[MAX_PLAYERS]);
+void match_shell_flush_input_turn(MatchShellState* state, const std::vector<MatchInput>& inputs);
 void match_shell_handle_input(MatchShellState* state);
 void match_shell_order_move(MatchShellState* state);
 EntityList match_shell_find_idle_miners(const MatchShellState* state);
@@ -3,8 +3,18 @@
 #ifdef GOLD_DEBUG
 
 #include "container/circular_vector.h"
+#include "shell/checkpoint.h"
+#include "match/input.h"
+#include "render/atlas.h"
+#include "core/logger.h"
+#include <SDL3/SDL.h>
 
 bool test_circular_vector_remove_at_ordered();
+bool test_replay_checkpoint_xor_round_trip();
+bool test_match_input_codec_round_trip();
+bool test_render_atlas_pack();
+bool test_render_player_color_surface();
+bool test_logger_multi_producer();
 
 struct TestRegistryEntry {
     const char* name;
@@ -13,6 +23,11 @@ struct TestRegistryEntry {
 
 static const TestRegistryEntry TEST_REGISTRY[] = {
     { "Circular Vector: remove_at_ordered()", test_circular_vector_remove_at_ordered },
+    { "Replay Checkpoint: XOR encode / apply round trip", test_replay_checkpoint_xor_round_trip },
+    { "Match Input: codec round trip", test_match_input_codec_round_trip },
+    { "Render Atlas: pack", test_render_atlas_pack },
+    { "Render Atlas: player color surface", test_render_player_color_surface },
+    { "Logger: multi-producer ring", test_logger_multi_producer },
     { NULL, NULL }
 };
 
@@ -105,4 +120,276 @@ bool test_circular_vector_remove_at_ordered() {
     return true;
 }
 
+bool test_replay_checkpoint_xor_round_trip() {
+    // Odd length so that the tail is not a multiple of the 8-byte run granularity
+    const size_t length = 203;
+    uint8_t base[length];
+    uint8_t data[length];
+    for (size_t index = 0; index < length; index++) {
+        base[index] = (uint8_t)(index * 7);
+        data[index] = base[index];
+    }
+    data[0] = 1;
+    data[9] = 2;
+    data[10] = 3;
+    data[100] = 4;
+    data[length - 1] = 5;
+
+    // Delta against base
+    std::vector<uint8_t> encoded;
+    replay_checkpoint_xor_encode(base, data, length, encoded);
+    TEST_ASSERT(encoded.size() < length);
+
+    uint8_t decoded[length];
+    memcpy(decoded, base, length);
+    replay_checkpoint_xor_apply(encoded, decoded, length);
+    TEST_ASSERT(memcmp(decoded, data, length) == 0);
+
+    // Keyframe against all zeroes
+    replay_checkpoint_xor_encode(NULL, data, length, encoded);
+    memset(decoded, 0, length);
+    replay_checkpoint_xor_apply(encoded, decoded, length);
+    TEST_ASSERT(memcmp(decoded, data, length) == 0);
+
+    // Unchanged data encodes to nothing
+    replay_checkpoint_xor_encode(base, base, length, encoded);
+    TEST_ASSERT(encoded.empty());
+
+    return true;
+}
+
+bool test_match_input_codec_round_trip() {
+    MatchInput inputs[4];
+
+    // Sorted selection
+    inputs[0].type = MATCH_INPUT_MOVE_ATTACK_CELL;
+    inputs[0].move.shift_command = 1;
+    inputs[0].move.target_cell = ivec2(40, 12);
+    inputs[0].move.target_id = ID_NULL;
+    inputs[0].move.entity_count = SELECTION_LIMIT;
+    for (uint8_t index = 0; index < SELECTION_LIMIT; index++) {
+        inputs[0].move.entity_ids[index] = (EntityId)(100U + (index * 3U));
+    }
+
+    // Same selection, with a cell behind the previous one
+    inputs[1].type = MATCH_INPUT_MOVE_CELL;
+    inputs[1].move.shift_command = 0;
+    inputs[1].move.target_cell = ivec2(3, 0);
+    inputs[1].move.target_id = ID_NULL;
+    inputs[1].move.entity_count = SELECTION_LIMIT;
+    memcpy(inputs[1].move.entity_ids, inputs[0].move.entity_ids, sizeof(inputs[0].move.entity_ids));
+
+    // Unsorted selection keeps its order
+    inputs[2].type = MATCH_INPUT_PATROL;
+    inputs[2].patrol.target_cell_a = ivec2(-1, 90);
+    inputs[2].patrol.target_cell_b = ivec2(60, -5);
+    inputs[2].patrol.unit_count = 3;
+    inputs[2].patrol.unit_ids[0] = ID_MAX - 1;
+    inputs[2].patrol.unit_ids[1] = 0;
+    inputs[2].patrol.unit_ids[2] = 7;
+
+    inputs[3].type = MATCH_INPUT_BUILDING_ENQUEUE;
+    inputs[3].building_enqueue.item_type = 1;
+    inputs[3].building_enqueue.item_subtype = 1U << 30;
+    inputs[3].building_enqueue.building_count = 0;
+
+    uint8_t buffer[1024];
+    size_t buffer_length = 0;
+    MatchInputCodec write_codec;
+    match_input_codec_init(write_codec);
+    for (const MatchInput& input : inputs) {
+        match_input_serialize(buffer, buffer_length, input, write_codec);
+    }
+
+    size_t buffer_head = 0;
+    MatchInputCodec read_codec;
+    match_input_codec_init(read_codec);
+    MatchInput decoded[4];
+    for (MatchInput& input : decoded) {
+        TEST_ASSERT(match_input_deserialize(buffer, buffer_length, buffer_head, read_codec, input));
+    }
+    TEST_ASSERT(buffer_head == buffer_length);
+
+    // An input that is cut short is rejected
+    size_t truncated_head = 0;
+    MatchInput truncated;
+    match_input_codec_init(read_codec);
+    TEST_ASSERT(!match_input_deserialize(buffer, 4, truncated_head, read_codec, truncated));
+
+    TEST_ASSERT(decoded[0].type == MATCH_INPUT_MOVE_ATTACK_CELL);
+    TEST_ASSERT(decoded[0].move.shift_command == 1);
+    TEST_ASSERT(decoded[0].move.target_cell == inputs[0].move.target_cell);
+    TEST_ASSERT(decoded[0].move.target_id == ID_NULL);
+    TEST_ASSERT(decoded[0].move.entity_count == SELECTION_LIMIT);
+    TEST_ASSERT(memcmp(decoded[0].move.entity_ids, inputs[0].move.entity_ids, sizeof(inputs[0].move.entity_ids)) == 0);
+
+    TEST_ASSERT(decoded[1].type == MATCH_INPUT_MOVE_CELL);
+    TEST_ASSERT(decoded[1].move.shift_command == 0);
+    TEST_ASSERT(decoded[1].move.target_cell == inputs[1].move.target_cell);
+    TEST_ASSERT(decoded[1].move.entity_count == SELECTION_LIMIT);
+    TEST_ASSERT(memcmp(decoded[1].move.entity_ids, inputs[1].move.entity_ids, sizeof(inputs[1].move.entity_ids)) == 0);
+
+    TEST_ASSERT(decoded[2].type == MATCH_INPUT_PATROL);
+    TEST_ASSERT(decoded[2].patrol.target_cell_a == inputs[2].patrol.target_cell_a);
+    TEST_ASSERT(decoded[2].patrol.target_cell_b == inputs[2].patrol.target_cell_b);
+    TEST_ASSERT(decoded[2].patrol.unit_count == 3);
+    TEST_ASSERT(memcmp(decoded[2].patrol.unit_ids, inputs[2].patrol.unit_ids, 3 * sizeof(EntityId)) == 0);
+
+    TEST_ASSERT(decoded[3].type == MATCH_INPUT_BUILDING_ENQUEUE);
+    TEST_ASSERT(decoded[3].building_enqueue.item_type == 1);
+    TEST_ASSERT(decoded[3].building_enqueue.item_subtype == 1U << 30);
+    TEST_ASSERT(decoded[3].building_enqueue.building_count == 0);
+
+    return true;
+}
+
+bool test_render_atlas_pack() {
+    // Sorted from biggest to smallest, the first rect takes up a whole atlas and the rest share the second one
+    const uint32_t count = 6;
+    const ivec2 sizes[count] = {
+        ivec2(ATLAS_SIZE, ATLAS_SIZE),
+        ivec2(ATLAS_SIZE, ATLAS_SIZE / 2),
+        ivec2(ATLAS_SIZE / 2, ATLAS_SIZE / 2),
+        ivec2(300, 200),
+        ivec2(200, 300),
+        ivec2(16, 16)
+    };
+    RenderAtlasPlacement placements[count];
+    TEST_ASSERT(render_atlas_pack(sizes, count, placements) == 2);
+    TEST_ASSERT(placements[0].atlas == 0);
+    for (uint32_t index = 1; index < count; index++) {
+        TEST_ASSERT(placements[index].atlas == 1);
+    }
+
+    for (uint32_t index = 0; index < count; index++) {
+        TEST_ASSERT(placements[index].x >= 0 && placements[index].x + sizes[index].x <= ATLAS_SIZE);
+        TEST_ASSERT(placements[index].y >= 0 && placements[index].y + sizes[index].y <= ATLAS_SIZE);
+        for (uint32_t other = 0; other < index; other++) {
+            if (placements[index].atlas != placements[other].atlas) {
+                continue;
+            }
+            bool is_overlapping = 
+                placements[index].x < placements[other].x + sizes[other].x &&
+                placements[other].x < placements[index].x + sizes[index].x &&
+                placements[index].y < placements[other].y + sizes[other].y &&
+                placements[other].y < placements[index].y + sizes[index].y;
+            TEST_ASSERT(!is_overlapping);
+        }
+    }
+
+    // A rect bigger than an atlas can never be packed
+    const ivec2 too_big_size = ivec2(ATLAS_SIZE + 1, 1);
+    TEST_ASSERT(render_atlas_pack(&too_big_size, 1, placements) == 0);
+
+    return true;
+}
+
+bool test_render_player_color_surface() {
+    // One clothes pixel, one skin pixel and one pixel that is left alone
+    SDL_Surface* sprite_surface = SDL_CreateSurface(3, 1, SDL_PIXELFORMAT_ABGR8888);
+    TEST_ASSERT(sprite_surface != NULL);
+    const SDL_PixelFormatDetails* format_details = SDL_GetPixelFormatDetails(sprite_surface->format);
+    uint32_t* sprite_pixels = (uint32_t*)sprite_surface->pixels;
+    sprite_pixels[0] = SDL_MapRGBA(format_details, NULL, 255, 0, 255, 255);
+    sprite_pixels[1] = SDL_MapRGBA(format_details, NULL, 123, 174, 121, 255);
+    sprite_pixels[2] = SDL_MapRGBA(format_details, NULL, 1, 2, 3, 255);
+    const uint32_t untouched_pixel = sprite_pixels[2];
+
+    SDL_Surface* recolor_surface = render_create_player_color_surface(sprite_surface, false);
+    TEST_ASSERT(recolor_surface != NULL);
+    TEST_ASSERT(recolor_surface->w == 3 && recolor_surface->h == MAX_PLAYERS);
+    for (int player = 0; player < MAX_PLAYERS; player++) {
+        const uint32_t* row = (const uint32_t*)((uint8_t*)recolor_surface->pixels + (player * recolor_surface->pitch));
+        SDL_Color clothes_color = render_get_color_value(RENDER_PLAYER_COLORS[player]);
+        SDL_Color skin_color = render_get_color_value(RENDER_PLAYER_SKIN_COLORS[player]);
+        TEST_ASSERT(row[0] == SDL_MapRGBA(format_details, NULL, clothes_color.r, clothes_color.g, clothes_color.b, clothes_color.a));
+        TEST_ASSERT(row[1] == SDL_MapRGBA(format_details, NULL, skin_color.r, skin_color.g, skin_color.b, skin_color.a));
+        TEST_ASSERT(row[2] == untouched_pixel);
+    }
+    SDL_DestroySurface(recolor_surface);
+
+    return true;
+}
+
+
+static const uint32_t TEST_LOGGER_THREAD_COUNT = 4U;
+// Small enough that every message fits in the ring at once, so none should be dropped even if the writer falls behind
+static const uint32_t TEST_LOGGER_MESSAGES_PER_THREAD = 200U;
+
+struct TestLoggerSinkState {
+    uint32_t next_index[TEST_LOGGER_THREAD_COUNT];
+    uint32_t out_of_order_count;
+    uint32_t dropped_report_count;
+};
+
+struct TestLoggerThreadData {
+    uint32_t thread_index;
+    SDL_AtomicInt* start;
+};
+
+static void test_logger_sink(LogLevel /*log_level*/, const char* message, void* user_data) {
+    TestLoggerSinkState* sink_state = (TestLoggerSinkState*)user_data;
+    uint32_t thread_index;
+    uint32_t message_index;
+    if (sscanf(message, "Logger test thread %u message %u", &thread_index, &message_index) == 2 && thread_index < TEST_LOGGER_THREAD_COUNT) {
+        if (message_index != sink_state->next_index[thread_index]) {
+            sink_state->out_of_order_count++;
+        }
+        sink_state->next_index[thread_index] = message_index + 1U;
+    } else if (strncmp(message, "Logger dropped", strlen("Logger dropped")) == 0) {
+        sink_state->dropped_report_count++;
+    }
+}
+
+static int test_logger_thread(void* user_data) {
+    TestLoggerThreadData* data = (TestLoggerThreadData*)user_data;
+    // Every thread starts at once so that they race for the same slots
+    while (!SDL_GetAtomicInt(data->start)) {}
+
+    for (uint32_t message_index = 0; message_index < TEST_LOGGER_MESSAGES_PER_THREAD; message_index++) {
+        // Logged as errors so that the log level can not filter them out
+        log_error("Logger test thread %u message %u", data->thread_index, message_index);
+    }
+
+    return 0;
+}
+
+bool test_logger_multi_producer() {
+    if (!logger_init("tests.log")) {
+        return false;
+    }
+
+    TestLoggerSinkState sink_state;
+    memset(&sink_state, 0, sizeof(sink_state));
+    logger_set_test_sink(test_logger_sink, &sink_state);
+
+    SDL_AtomicInt start;
+    SDL_SetAtomicInt(&start, 0);
+    TestLoggerThreadData thread_data[TEST_LOGGER_THREAD_COUNT];
+    SDL_Thread* threads[TEST_LOGGER_THREAD_COUNT];
+    for (uint32_t thread_index = 0; thread_index < TEST_LOGGER_THREAD_COUNT; thread_index++) {
+        thread_data[thread_index] = (TestLoggerThreadData) {
+            .thread_index = thread_index,
+            .start = &start
+        };
+        threads[thread_index] = SDL_CreateThread(test_logger_thread, "test_logger_thread", &thread_data[thread_index]);
+    }
+    SDL_SetAtomicInt(&start, 1);
+    for (uint32_t thread_index = 0; thread_index < TEST_LOGGER_THREAD_COUNT; thread_index++) {
+        SDL_WaitThread(threads[thread_index], NULL);
+    }
+
+    logger_flush();
+    logger_set_test_sink(NULL, NULL);
+    logger_quit();
+
+    TEST_ASSERT(sink_state.out_of_order_count == 0);
+    TEST_ASSERT(sink_state.dropped_report_count == 0);
+    for (uint32_t thread_index = 0; thread_index < TEST_LOGGER_THREAD_COUNT; thread_index++) {
+        TEST_ASSERT(sink_state.next_index[thread_index] == TEST_LOGGER_MESSAGES_PER_THREAD);
+    }
+
+    return true;
+}
+
 #endif
\ No newline at end of file
@@ -4,13 +4,20 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
 
-size_t json_parse(const char* json_str, Json** json);
-size_t json_parse_string(const char* json_str, Json** json);
+static void json_document_free_from_root(Json* root);
+static uint32_t json_hash_key(const char* key);
+static uint32_t json_object_hash_index_capacity(size_t length);
 
 Json* json_object() {
     Json* json = (Json*)malloc(sizeof(Json));
     json->type = JSON_TYPE_OBJECT;
+    json->is_arena_owned = false;
+    json->is_arena_root = false;
+    json->object.hash_index = NULL;
     json->object.capacity = 1;
     json->object.length = 0;
     json->object.keys = (char**)malloc(json->object.capacity * sizeof(char**));
@@ -22,6 +29,8 @@ Json* json_object() {
 Json* json_array() {
     Json* json = (Json*)malloc(sizeof(Json));
     json->type = JSON_TYPE_ARRAY;
+    json->is_arena_owned = false;
+    json->is_arena_root = false;
     json->array.capacity = 1;
     json->array.length = 0;
     json->array.values = (Json**)malloc(json->array.capacity * sizeof(Json*));
@@ -32,6 +41,8 @@ Json* json_array() {
 Json* json_string(const char* value) {
     Json* json = (Json*)malloc(sizeof(Json));
     json->type = JSON_TYPE_STRING;
+    json->is_arena_owned = false;
+    json->is_arena_root = false;
     json->string.length = strlen(value);
     json->string.value = (char*)malloc((json->string.length + 1) * sizeof(char));
     strcpy(json->string.value, value);
@@ -42,6 +53,8 @@ Json* json_string(const char* value) {
 Json* json_number(double value) {
     Json* json = (Json*)malloc(sizeof(Json));
     json->type = JSON_TYPE_NUMBER;
+    json->is_arena_owned = false;
+    json->is_arena_root = false;
     json->number.value = value;
 
     return json;
@@ -50,6 +63,8 @@ Json* json_number(double value) {
 Json* json_boolean(bool value) {
     Json* json = (Json*)malloc(sizeof(Json));
     json->type = JSON_TYPE_BOOLEAN;
+    json->is_arena_owned = false;
+    json->is_arena_root = false;
     json->boolean.value = value;
     
     return json;
@@ -58,6 +73,8 @@ Json* json_boolean(bool value) {
 Json* json_null() {
     Json* json = (Json*)malloc(sizeof(Json));
     json->type = JSON_TYPE_NULL;
+    json->is_arena_owned = false;
+    json->is_arena_root = false;
 
     return json;
 }
@@ -77,6 +94,16 @@ ivec2 json_to_ivec2(Json* json) {
 }
 
 void json_free(Json* json) {
+    if (json->is_arena_owned) {
+        // Values read from a file are freed all at once through the root of their document,
+        // so freeing any other value of the document does nothing
+        GOLD_ASSERT(json->is_arena_root);
+        if (json->is_arena_root) {
+            json_document_free_from_root(json);
+        }
+        return;
+    }
+
     if (json->type == JSON_TYPE_OBJECT) {
         for (size_t index = 0; index < json->object.length; index++) {
             free(json->object.keys[index]);
@@ -115,6 +142,20 @@ bool json_get_boolean(const Json* json) {
 
 Json* json_object_get(const Json* json, const char* key) {
     GOLD_ASSERT(json->type == JSON_TYPE_OBJECT);
+    if (json->object.hash_index != NULL) {
+        uint32_t capacity = json_object_hash_index_capacity(json->object.length);
+        uint32_t slot = json_hash_key(key) & (capacity - 1);
+        while (json->object.hash_index[slot] != 0) {
+            uint32_t index = json->object.hash_index[slot] - 1;
+            if (strcmp(json->object.keys[index], key) == 0) {
+                return json->object.values[index];
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        return NULL;
+    }
+
     for (size_t index = 0; index < json->object.length; index++) {
         if (strcmp(json->object.keys[index], key) == 0) {
             return json->object.values[index];
@@ -137,7 +178,7 @@ bool json_object_get_boolean(Json* json, const char* key) {
 }
 
 void json_object_set(Json* json, const char* key, Json* value) {
-    GOLD_ASSERT(json->type == JSON_TYPE_OBJECT);
+    GOLD_ASSERT(!json->is_arena_owned && json->type == JSON_TYPE_OBJECT);
     size_t index;
     for (index = 0; index < json->object.length; index++) {
         if (strcmp(json->object.keys[index], key) == 0) {
@@ -209,7 +250,7 @@ bool json_array_get_boolean(const Json* json, size_t index) {
 }
 
 void json_array_push(Json* json, Json* value) {
-    GOLD_ASSERT(json->type == JSON_TYPE_ARRAY);
+    GOLD_ASSERT(!json->is_arena_owned && json->type == JSON_TYPE_ARRAY);
 
     if (json->array.length == json->array.capacity) {
         json->array.capacity *= 2;
@@ -237,7 +278,7 @@ void json_array_push_boolean(Json* json, bool value) {
 }
 
 void json_array_set(Json* json, size_t index, Json* value) {
-    GOLD_ASSERT(json->type == JSON_TYPE_ARRAY);
+    GOLD_ASSERT(!json->is_arena_owned && json->type == JSON_TYPE_ARRAY);
 
     if (index < json->array.length) {
         json_free(json->array.values[index]);
@@ -259,77 +300,127 @@ void json_array_set_boolean(Json* json, size_t index, bool value) {
     json_array_set(json, index, json_boolean(value));
 }
 
-void json_fprintf(FILE* file, const Json* json, size_t depth) {
-    switch (json->type) {
-        case JSON_TYPE_OBJECT: {
-            if (json->object.length == 0) {
-                fprintf(file, "{}");
-                break;
-            }
+// WRITER
 
-            fprintf(file, "{\n");
+static void json_writer_begin_value(JsonWriter& writer, const char* key) {
+    if (writer.depth == 0) {
+        return;
+    }
 
-            for (size_t index = 0; index < json->object.length; index++) {
-                for (size_t depth_index = 0; depth_index < depth; depth_index++) {
-                    fprintf(file, "\t");
-                }
-                fprintf(file, "\"%s\": ", json->object.keys[index]);
-                json_fprintf(file, json->object.values[index], depth + 1);
-                if (index < json->object.length - 1) {
-                    fprintf(file, ",");
-                }
-                fprintf(file, "\n");
-            }
+    if (writer.has_values[writer.depth - 1]) {
+        fprintf(writer.file, ",");
+    }
+    fprintf(writer.file, "\n");
+    writer.has_values[writer.depth - 1] = true;
+
+    for (uint32_t depth_index = 0; depth_index < writer.depth; depth_index++) {
+        fprintf(writer.file, "\t");
+    }
+    if (key != NULL) {
+        fprintf(writer.file, "\"%s\": ", key);
+    }
+}
+
+static void json_writer_begin_container(JsonWriter& writer, const char* key, char open_char) {
+    GOLD_ASSERT(writer.depth < JSON_WRITER_DEPTH_MAX);
+    json_writer_begin_value(writer, key);
+    fprintf(writer.file, "%c", open_char);
+
+    writer.has_values[writer.depth] = false;
+    writer.depth++;
+}
+
+static void json_writer_end_container(JsonWriter& writer, char close_char) {
+    GOLD_ASSERT(writer.depth != 0);
+    writer.depth--;
+
+    // Empty containers are closed on the same line that they were opened on
+    if (writer.has_values[writer.depth]) {
+        fprintf(writer.file, "\n");
+        for (uint32_t depth_index = 0; depth_index < writer.depth; depth_index++) {
+            fprintf(writer.file, "\t");
+        }
+    }
+    fprintf(writer.file, "%c", close_char);
+}
+
+void json_writer_init(JsonWriter& writer, FILE* file) {
+    writer.file = file;
+    writer.depth = 0;
+}
+
+void json_writer_begin_object(JsonWriter& writer, const char* key) {
+    json_writer_begin_container(writer, key, '{');
+}
+
+void json_writer_end_object(JsonWriter& writer) {
+    json_writer_end_container(writer, '}');
+}
+
+void json_writer_begin_array(JsonWriter& writer, const char* key) {
+    json_writer_begin_container(writer, key, '[');
+}
+
+void json_writer_end_array(JsonWriter& writer) {
+    json_writer_end_container(writer, ']');
+}
+
+void json_writer_string(JsonWriter& writer, const char* key, const char* value) {
+    json_writer_begin_value(writer, key);
+    fprintf(writer.file, "\"%s\"", value);
+}
+
+void json_writer_number(JsonWriter& writer, const char* key, double value) {
+    json_writer_begin_value(writer, key);
+    if ((double)((int)value) == value) {
+        fprintf(writer.file, "%i", (int)value);
+    } else {
+        fprintf(writer.file, "%f", value);
+    }
+}
+
+void json_writer_boolean(JsonWriter& writer, const char* key, bool value) {
+    json_writer_begin_value(writer, key);
+    fprintf(writer.file, value ? "true" : "false");
+}
+
+void json_writer_null(JsonWriter& writer, const char* key) {
+    json_writer_begin_value(writer, key);
+    fprintf(writer.file, "null");
+}
 
-            for (size_t depth_index = 0; depth_index < depth - 1; depth_index++) {
-                fprintf(file, "\t");
+void json_writer_value(JsonWriter& writer, const char* key, const Json* json) {
+    switch (json->type) {
+        case JSON_TYPE_OBJECT: {
+            json_writer_begin_object(writer, key);
+            for (size_t index = 0; index < json->object.length; index++) {
+                json_writer_value(writer, json->object.keys[index], json->object.values[index]);
             }
-            fprintf(file, "}");
+            json_writer_end_object(writer);
             break;
         }
         case JSON_TYPE_ARRAY: {
-            if (json->array.length == 0) {
-                fprintf(file, "[]");
-                break;
-            }
-
-            fprintf(file, "[\n");
-
+            json_writer_begin_array(writer, key);
             for (size_t index = 0; index < json->array.length; index++) {
-                for (size_t depth_index = 0; depth_index < depth; depth_index++) {
-                    fprintf(file, "\t");
-                }
-                json_fprintf(file, json_array_get(json, index), depth + 1);
-                if (index < json->array.length - 1) {
-                    fprintf(file, ",");
-                }
-                fprintf(file, "\n");
+                json_writer_value(writer, NULL, json->array.values[index]);
             }
-
-            for (size_t depth_index = 0; depth_index < depth - 1; depth_index++) {
-                fprintf(file, "\t");
-            }
-            fprintf(file, "]");
+            json_writer_end_array(writer);
             break;
         }
         case JSON_TYPE_STRING: {
-            fprintf(file, "\"%s\"", json->string.value);
+            json_writer_string(writer, key, json->string.value);
             break;
         }
         case JSON_TYPE_NUMBER: {
-            if ((double)((int)json->number.value) == json->number.value) {
-                fprintf(file, "%i", (int)json->number.value);
-            } else {
-                fprintf(file, "%f", json->number.value);
-            }
+            json_writer_number(writer, key, json->number.value);
             break;
         }
         case JSON_TYPE_BOOLEAN: {
-            fprintf(file, json->boolean.value ? "true" : "false");
+            json_writer_boolean(writer, key, json->boolean.value);
             break;
         }
         case JSON_TYPE_NULL: {
-            fprintf(file, "null");
+            json_writer_null(writer, key);
             break;
         }
     }
@@ -341,206 +432,493 @@ bool json_write(const Json* json, const char* path) {
         return false;
     }
 
-    json_fprintf(file, json, 1);
+    JsonWriter writer;
+    json_writer_init(writer, file);
+    json_writer_value(writer, NULL, json);
 
     fclose(file);
 
     return true;
 }
 
-size_t json_parse_object(const char* json_str, Json** json) {
-    GOLD_ASSERT(*json_str == '{');
+// SAX
 
-    *json = json_object();
-
-    const char* json_str_ptr = json_str + 1;
-    while (*json_str_ptr != '\0' && *json_str_ptr != '}') {
-        Json* key_json;
-        json_str_ptr += json_parse_string(json_str_ptr, &key_json);
-
-        GOLD_ASSERT(*json_str_ptr == ':');
-        json_str_ptr++;
+static bool json_parse_is_char_whitespace(char c) {
+    switch (c) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\v':
+        case '\f':
+        case '\r':
+            return true;
+        default:
+            return false;
+    }
+}
 
-        Json* value_json;
-        json_str_ptr += json_parse(json_str_ptr, &value_json);
+static char* json_parse_skip_whitespace(char* text) {
+    while (json_parse_is_char_whitespace(*text)) {
+        text++;
+    }
 
-        json_object_set(*json, json_get_string(key_json), value_json);
-        json_free(key_json);
+    return text;
+}
 
-        GOLD_ASSERT(*json_str_ptr == ',' || *json_str_ptr == '}');
+static bool json_parse_is_char_delimiter(char c) {
+    return c == '\0' || c == ',' || c == '}' || c == ']' || json_parse_is_char_whitespace(c);
+}
 
-        if (*json_str_ptr == ',') {
-            json_str_ptr++;
-        }
+// Strings end at the next quote, the same as they did before escape sequences were a thing in this parser (never)
+static char* json_parse_sax_string(char* text, const char** value, size_t* length) {
+    GOLD_ASSERT(*text == '"');
+    char* end = strchr(text + 1, '"');
+    if (end == NULL) {
+        return NULL;
     }
 
-    GOLD_ASSERT(*json_str_ptr == '}');
-    json_str_ptr++;
+    *end = '\0';
+    *value = text + 1;
+    *length = end - (text + 1);
 
-    return json_str_ptr - json_str;
+    return end + 1;
 }
 
-size_t json_parse_array(const char* json_str, Json** json) {
-    GOLD_ASSERT(*json_str == '[');
+static char* json_parse_sax_value(char* text, const JsonSaxHandler& handler, uint32_t depth);
 
-    *json = json_array();
-    const char* json_str_ptr = json_str + 1;
+static char* json_parse_sax_object(char* text, const JsonSaxHandler& handler, uint32_t depth) {
+    GOLD_ASSERT(*text == '{');
+    if (!handler.begin_object(handler.user_data)) {
+        return NULL;
+    }
 
-    while (*json_str_ptr != '\0' && *json_str_ptr != ']') {
-        Json* value;
-        json_str_ptr += json_parse(json_str_ptr, &value);
+    text = json_parse_skip_whitespace(text + 1);
+    if (*text == '}') {
+        return handler.end_object(handler.user_data) ? text + 1 : NULL;
+    }
 
-        json_array_push(*json, value);
+    while (true) {
+        if (*text != '"') {
+            return NULL;
+        }
+        const char* key;
+        size_t key_length;
+        text = json_parse_sax_string(text, &key, &key_length);
+        if (text == NULL || !handler.key(handler.user_data, key, key_length)) {
+            return NULL;
+        }
 
-        GOLD_ASSERT(*json_str_ptr == ',' || *json_str_ptr == ']');
-        if (*json_str_ptr == ',') {
-            json_str_ptr++;
+        text = json_parse_skip_whitespace(text);
+        if (*text != ':') {
+            return NULL;
         }
-    }
 
-    GOLD_ASSERT(*json_str_ptr == ']');
-    json_str_ptr++;
+        text = json_parse_sax_value(json_parse_skip_whitespace(text + 1), handler, depth + 1);
+        if (text == NULL) {
+            return NULL;
+        }
 
-    return json_str_ptr - json_str;
+        text = json_parse_skip_whitespace(text);
+        if (*text == '}') {
+            return handler.end_object(handler.user_data) ? text + 1 : NULL;
+        }
+        if (*text != ',') {
+            return NULL;
+        }
+        text = json_parse_skip_whitespace(text + 1);
+    }
 }
 
-size_t json_parse_string(const char* json_str, Json** json) {
-    GOLD_ASSERT(json_str[0] == '"');
+static char* json_parse_sax_array(char* text, const JsonSaxHandler& handler, uint32_t depth) {
+    GOLD_ASSERT(*text == '[');
+    if (!handler.begin_array(handler.user_data)) {
+        return NULL;
+    }
 
-    size_t length = 0;
-    while (json_str[length + 1] != '\0' && json_str[length + 1] != '"') {
-        length++;
+    text = json_parse_skip_whitespace(text + 1);
+    if (*text == ']') {
+        return handler.end_array(handler.user_data) ? text + 1 : NULL;
     }
 
-    GOLD_ASSERT(json_str[length + 1] == '"');
+    while (true) {
+        text = json_parse_sax_value(text, handler, depth + 1);
+        if (text == NULL) {
+            return NULL;
+        }
 
-    *json = (Json*)malloc(sizeof(Json));
-    (*json)->type = JSON_TYPE_STRING;
-    (*json)->string.length = length;
-    (*json)->string.value = (char*)malloc(length + 1);
-    strncpy((*json)->string.value, json_str + 1, length);
-    (*json)->string.value[length] = '\0';
+        text = json_parse_skip_whitespace(text);
+        if (*text == ']') {
+            return handler.end_array(handler.user_data) ? text + 1 : NULL;
+        }
+        if (*text != ',') {
+            return NULL;
+        }
+        text = json_parse_skip_whitespace(text + 1);
+    }
+}
 
-    return length + 2;
+static bool json_parse_str_equals(const char* text, size_t length, const char* value) {
+    return strlen(value) == length && strncmp(text, value, length) == 0;
 }
 
-size_t json_parse_number(const char* json_str, Json** json) {
-    GOLD_ASSERT(json_str[0] >= '0' && json_str[0] <= '9');
+static char* json_parse_sax_value(char* text, const JsonSaxHandler& handler, uint32_t depth) {
+    // Deeper documents than this are almost certainly corrupt, and the recursion would eventually overflow the stack
+    if (depth > JSON_WRITER_DEPTH_MAX) {
+        return NULL;
+    }
+
+    if (*text == '{') {
+        return json_parse_sax_object(text, handler, depth);
+    }
+    if (*text == '[') {
+        return json_parse_sax_array(text, handler, depth);
+    }
+    if (*text == '"') {
+        const char* value;
+        size_t length;
+        text = json_parse_sax_string(text, &value, &length);
+        if (text == NULL || !handler.string(handler.user_data, value, length)) {
+            return NULL;
+        }
+        return text;
+    }
+    if (*text == '-' || (*text >= '0' && *text <= '9')) {
+        char* end;
+        double value = strtod(text, &end);
+        if (end == text || !json_parse_is_char_delimiter(*end) || !handler.number(handler.user_data, value)) {
+            return NULL;
+        }
+        return end;
+    }
 
     size_t length = 0;
-    while (json_str[length] != '\0' && json_str[length] != ',' && json_str[length] != '}' && json_str[length] != ']') {
+    while (!json_parse_is_char_delimiter(text[length])) {
         length++;
     }
+    if (json_parse_str_equals(text, length, "true") || json_parse_str_equals(text, length, "false")) {
+        if (!handler.boolean(handler.user_data, text[0] == 't')) {
+            return NULL;
+        }
+        return text + length;
+    }
+    if (json_parse_str_equals(text, length, "null")) {
+        if (!handler.null(handler.user_data)) {
+            return NULL;
+        }
+        return text + length;
+    }
 
-    GOLD_ASSERT(length != 0 && (json_str[length] == '\0' || json_str[length] == ',' || json_str[length] == '}' || json_str[length] == ']'));
-
-    double value = strtod(json_str, NULL);
-    *json = json_number(value);
-
-    return length;
+    return NULL;
 }
 
-bool json_parse_str_begins_with(const char* json_str, size_t length, const char* value) {
-    size_t value_length = strlen(value);
-    if (length != value_length) {
+bool json_parse_sax(char* text, const JsonSaxHandler& handler) {
+    text = json_parse_sax_value(json_parse_skip_whitespace(text), handler, 0);
+    if (text == NULL) {
         return false;
     }
 
-    return strncmp(json_str, value, length) == 0;
+    return *json_parse_skip_whitespace(text) == '\0';
+}
+
+// ARENA DOM
+
+/**
+ * json_read() loads the file into the first block of an arena and parses it in place with the SAX parser.
+ * Strings and keys point into the loaded text, and nodes and child arrays are bump allocated after it,
+ * so a document is usually a single allocation and json_free() on the root releases all of it.
+ *
+ * Children are collected on a scratch stack while their container is being parsed,
+ * so that every container gets an exactly sized array once it is closed.
+ */
+
+#define JSON_ARENA_ALIGNMENT 8U
+// Nodes take up a few times more memory than the text that they were parsed from
+#define JSON_ARENA_TEXT_SIZE_MULTIPLIER 8U
+#define JSON_OBJECT_HASH_INDEX_MIN_LENGTH 16U
+
+struct JsonArenaBlock {
+    JsonArenaBlock* next;
+    size_t capacity;
+    size_t length;
+};
+
+struct JsonDocument {
+    JsonArenaBlock* blocks;
+    Json root;
+};
+
+struct JsonDocumentBuilder {
+    JsonDocument* document;
+    // Keys and values of every container that is currently open, innermost last. Array values have a NULL key.
+    std::vector<char*> keys;
+    std::vector<Json*> values;
+    // Where each open container's values begin, and the key that the container itself will be stored under
+    std::vector<size_t> container_begin;
+    std::vector<char*> container_key;
+    char* pending_key;
+};
+
+static uint8_t* json_arena_block_data(JsonArenaBlock* block) {
+    return (uint8_t*)block + sizeof(JsonArenaBlock);
+}
+
+static JsonArenaBlock* json_arena_block_create(size_t capacity) {
+    JsonArenaBlock* block = (JsonArenaBlock*)malloc(sizeof(JsonArenaBlock) + capacity);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    block->length = 0;
+
+    return block;
 }
 
-size_t json_parse_boolean_and_null(const char* json_str, Json** json) {
-    size_t length = 0;
-    while (json_str[length] != '\0' && json_str[length] != ',' && json_str[length] != '}' && json_str[length] != ']') {
-        length++;
+static void* json_arena_alloc(JsonDocument* document, size_t size) {
+    size = (size + JSON_ARENA_ALIGNMENT - 1) & ~(size_t)(JSON_ARENA_ALIGNMENT - 1);
+
+    JsonArenaBlock* block = document->blocks;
+    if (block->capacity - block->length < size) {
+        // New blocks go to the front of the list so that the first block, which holds the document, is freed last
+        JsonArenaBlock* new_block = json_arena_block_create(std::max(block->capacity * 2, size));
+        GOLD_ASSERT(new_block != NULL);
+        new_block->next = block;
+        document->blocks = new_block;
+        block = new_block;
     }
 
-    GOLD_ASSERT(length != 0 && (json_str[length] == '\0' || json_str[length] == ',' || json_str[length] == '}' || json_str[length] == ']'));
+    void* data = json_arena_block_data(block) + block->length;
+    block->length += size;
 
-    *json = NULL;
-    if (json_parse_str_begins_with(json_str, length, "true")) {
-        *json = json_boolean(true);
-    }
-    if (json_parse_str_begins_with(json_str, length, "false")) {
-        *json = json_boolean(false);
-    }
-    if (json_parse_str_begins_with(json_str, length, "null")) {
-        *json = json_null();
+    return data;
+}
+
+static uint32_t json_hash_key(const char* key) {
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (const char* c = key; *c != '\0'; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619U;
     }
-    GOLD_ASSERT(*json != NULL);
 
-    return length;
+    return hash;
 }
 
-size_t json_parse(const char* json_str, Json** json) {
-    if (*json_str == '{') {
-        return json_parse_object(json_str, json);
+// The index is an open addressing table of value index + 1, twice the size of the object rounded up to a power of two
+static uint32_t json_object_hash_index_capacity(size_t length) {
+    uint32_t capacity = 1;
+    while (capacity < length * 2) {
+        capacity *= 2;
     }
-    if (*json_str == '[') {
-        return json_parse_array(json_str, json);
+
+    return capacity;
+}
+
+static void json_object_build_hash_index(JsonDocument* document, JsonObject& object) {
+    uint32_t capacity = json_object_hash_index_capacity(object.length);
+    object.hash_index = (uint32_t*)json_arena_alloc(document, capacity * sizeof(uint32_t));
+    memset(object.hash_index, 0, capacity * sizeof(uint32_t));
+
+    for (size_t index = 0; index < object.length; index++) {
+        uint32_t slot = json_hash_key(object.keys[index]) & (capacity - 1);
+        while (object.hash_index[slot] != 0) {
+            // Duplicate keys resolve to the first one, the same as the linear search
+            if (strcmp(object.keys[object.hash_index[slot] - 1], object.keys[index]) == 0) {
+                break;
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (object.hash_index[slot] == 0) {
+            object.hash_index[slot] = (uint32_t)index + 1;
+        }
     }
-    if (*json_str == '"') {
-        return json_parse_string(json_str, json);
+}
+
+static Json* json_document_create_value(JsonDocumentBuilder* builder, JsonType type) {
+    // The root lives inside the document so that json_free() can find the arena from it
+    Json* json = builder->values.empty() && builder->container_begin.empty()
+        ? &builder->document->root
+        : (Json*)json_arena_alloc(builder->document, sizeof(Json));
+    json->type = type;
+    json->is_arena_owned = true;
+    json->is_arena_root = json == &builder->document->root;
+
+    return json;
+}
+
+static bool json_document_push_value(JsonDocumentBuilder* builder, Json* json) {
+    builder->keys.push_back(builder->pending_key);
+    builder->values.push_back(json);
+    builder->pending_key = NULL;
+
+    return true;
+}
+
+static bool json_document_begin_container(void* user_data) {
+    JsonDocumentBuilder* builder = (JsonDocumentBuilder*)user_data;
+    builder->container_begin.push_back(builder->values.size());
+    builder->container_key.push_back(builder->pending_key);
+    builder->pending_key = NULL;
+
+    return true;
+}
+
+static bool json_document_end_container(JsonDocumentBuilder* builder, JsonType type) {
+    size_t begin = builder->container_begin.back();
+    builder->container_begin.pop_back();
+    size_t length = builder->values.size() - begin;
+
+    Json** values = (Json**)json_arena_alloc(builder->document, length * sizeof(Json*));
+    memcpy(values, builder->values.data() + begin, length * sizeof(Json*));
+
+    char** keys = NULL;
+    if (type == JSON_TYPE_OBJECT) {
+        keys = (char**)json_arena_alloc(builder->document, length * sizeof(char*));
+        memcpy(keys, builder->keys.data() + begin, length * sizeof(char*));
     }
-    if (*json_str >= '0' && *json_str <= '9') {
-        return json_parse_number(json_str, json);
+
+    builder->values.resize(begin);
+    builder->keys.resize(begin);
+    builder->pending_key = builder->container_key.back();
+    builder->container_key.pop_back();
+
+    Json* json = json_document_create_value(builder, type);
+    if (type == JSON_TYPE_OBJECT) {
+        json->object.keys = keys;
+        json->object.values = values;
+        json->object.length = length;
+        json->object.capacity = length;
+        json->object.hash_index = NULL;
+        if (length >= JSON_OBJECT_HASH_INDEX_MIN_LENGTH) {
+            json_object_build_hash_index(builder->document, json->object);
+        }
+    } else {
+        json->array.values = values;
+        json->array.length = length;
+        json->array.capacity = length;
     }
-    return json_parse_boolean_and_null(json_str, json);
+
+    return json_document_push_value(builder, json);
 }
 
-bool json_read_is_char_whitespace(char c) {
-    switch (c) {
-        case ' ':
-        case '\t':
-        case '\n':
-        case '\v':
-        case '\f':
-        case '\r':
-            return true;
-        default:
-            return false;
+static bool json_document_end_object(void* user_data) {
+    return json_document_end_container((JsonDocumentBuilder*)user_data, JSON_TYPE_OBJECT);
+}
+
+static bool json_document_end_array(void* user_data) {
+    return json_document_end_container((JsonDocumentBuilder*)user_data, JSON_TYPE_ARRAY);
+}
+
+static bool json_document_key(void* user_data, const char* key, size_t /*length*/) {
+    JsonDocumentBuilder* builder = (JsonDocumentBuilder*)user_data;
+    // Keys point into the document text, which the SAX parser has already terminated
+    builder->pending_key = (char*)key;
+
+    return true;
+}
+
+static bool json_document_string(void* user_data, const char* value, size_t length) {
+    JsonDocumentBuilder* builder = (JsonDocumentBuilder*)user_data;
+    Json* json = json_document_create_value(builder, JSON_TYPE_STRING);
+    json->string.value = (char*)value;
+    json->string.length = length;
+
+    return json_document_push_value(builder, json);
+}
+
+static bool json_document_number(void* user_data, double value) {
+    JsonDocumentBuilder* builder = (JsonDocumentBuilder*)user_data;
+    Json* json = json_document_create_value(builder, JSON_TYPE_NUMBER);
+    json->number.value = value;
+
+    return json_document_push_value(builder, json);
+}
+
+static bool json_document_boolean(void* user_data, bool value) {
+    JsonDocumentBuilder* builder = (JsonDocumentBuilder*)user_data;
+    Json* json = json_document_create_value(builder, JSON_TYPE_BOOLEAN);
+    json->boolean.value = value;
+
+    return json_document_push_value(builder, json);
+}
+
+static bool json_document_null(void* user_data) {
+    JsonDocumentBuilder* builder = (JsonDocumentBuilder*)user_data;
+    return json_document_push_value(builder, json_document_create_value(builder, JSON_TYPE_NULL));
+}
+
+static void json_document_free(JsonDocument* document) {
+    JsonArenaBlock* block = document->blocks;
+    while (block != NULL) {
+        JsonArenaBlock* next = block->next;
+        free(block);
+        block = next;
     }
 }
 
+static void json_document_free_from_root(Json* root) {
+    json_document_free((JsonDocument*)((uint8_t*)root - offsetof(JsonDocument, root)));
+}
+
 Json* json_read(const char* path) {
-    FILE* file = fopen(path, "r");
+    FILE* file = fopen(path, "rb");
     if (file == NULL) {
         return NULL;
     }
 
-    size_t buffer_length = 0;
-    size_t buffer_capacity = 1024;
-    char* buffer = (char*)malloc(buffer_capacity * sizeof(char));
-
-    char c;
-    bool is_inside_quotes = false;
-    while ((c = fgetc(file)) != EOF) {
-        if (c == '"') {
-            is_inside_quotes = !is_inside_quotes;
-        }
-        if (json_read_is_char_whitespace(c) && !is_inside_quotes) {
-            continue;
-        }
-
-        if (buffer_length == buffer_capacity) {
-            buffer_capacity *= 2;
-
-            char* temp = buffer;
-            buffer = (char*)malloc(buffer_capacity * sizeof(char));
-            memcpy(buffer, temp, buffer_length * sizeof(char));
-            free(temp);
-        }
+    fseek(file, 0, SEEK_END);
+    long file_length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (file_length < 0) {
+        fclose(file);
+        return NULL;
+    }
 
-        buffer[buffer_length] = c;
-        buffer_length++;
+    // The first block holds the document, then the text, then the nodes
+    size_t text_offset = (sizeof(JsonDocument) + JSON_ARENA_ALIGNMENT - 1) & ~(size_t)(JSON_ARENA_ALIGNMENT - 1);
+    size_t text_length = (size_t)file_length + 1;
+    JsonArenaBlock* block = json_arena_block_create(text_offset + (text_length * (JSON_ARENA_TEXT_SIZE_MULTIPLIER + 1)));
+    if (block == NULL) {
+        fclose(file);
+        return NULL;
     }
 
+    JsonDocument* document = (JsonDocument*)json_arena_block_data(block);
+    document->blocks = block;
+    char* text = (char*)json_arena_block_data(block) + text_offset;
+    size_t bytes_read = fread(text, 1, (size_t)file_length, file);
     fclose(file);
+    text[bytes_read] = '\0';
+    block->length = text_offset + text_length;
+
+    // The scratch stacks keep their memory between reads
+    static thread_local JsonDocumentBuilder builder;
+    builder.document = document;
+    builder.keys.clear();
+    builder.values.clear();
+    builder.container_begin.clear();
+    builder.container_key.clear();
+    builder.pending_key = NULL;
+
+    JsonSaxHandler handler = (JsonSaxHandler) {
+        .user_data = &builder,
+        .begin_object = json_document_begin_container,
+        .end_object = json_document_end_object,
+        .begin_array = json_document_begin_container,
+        .end_array = json_document_end_array,
+        .key = json_document_key,
+        .string = json_document_string,
+        .number = json_document_number,
+        .boolean = json_document_boolean,
+        .null = json_document_null
+    };
+    if (!json_parse_sax(text, handler)) {
+        json_document_free(document);
+        return NULL;
+    }
 
-    Json* json;
-    json_parse(buffer, &json);
-
-    free(buffer);
+    GOLD_ASSERT(builder.values.size() == 1 && builder.values[0] == &document->root);
+    document->root.is_arena_owned = true;
 
-    return json;
-}
\ No newline at end of file
+    return &document->root;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "math/gmath.h"
+#include <cstdio>
 
 enum JsonType {
     JSON_TYPE_OBJECT,
@@ -18,6 +19,8 @@ struct JsonObject {
     Json** values;
     size_t length;
     size_t capacity;
+    // Only built for large objects read by json_read(), see JSON_OBJECT_HASH_INDEX_MIN_LENGTH
+    uint32_t* hash_index;
 };
 
 struct JsonArray {
@@ -41,6 +44,10 @@ struct JsonBoolean {
 
 struct Json {
     JsonType type;
+    // Set on values read by json_read(), which are allocated from a single arena that is freed along with the root
+    bool is_arena_owned;
+    // Only the root of an arena can be passed to json_free()
+    bool is_arena_root;
     union {
         JsonObject object;
         JsonArray array;
@@ -91,5 +98,52 @@ void json_array_set_string(Json* json, size_t index, const char* value);
 void json_array_set_number(Json* json, size_t index, double value);
 void json_array_set_boolean(Json* json, size_t index, bool value);
 
+// The returned document is read-only and is freed all at once by calling json_free() on its root. Its other values cannot be freed on their own
+Json* json_read(const char* path);
 bool json_write(const Json* json, const char* path);
-Json* json_read(const char* path);
\ No newline at end of file
+
+// SAX
+
+/**
+ * Streams the values of a JSON document to a set of callbacks without building a tree.
+ *
+ * The text is parsed in place. String terminators are written into it, so the strings passed to
+ * the callbacks point into the text and stay valid for as long as the text does.
+ * Returning false from a callback stops the parse.
+ */
+struct JsonSaxHandler {
+    void* user_data;
+    bool (*begin_object)(void* user_data);
+    bool (*end_object)(void* user_data);
+    bool (*begin_array)(void* user_data);
+    bool (*end_array)(void* user_data);
+    bool (*key)(void* user_data, const char* key, size_t length);
+    bool (*string)(void* user_data, const char* value, size_t length);
+    bool (*number)(void* user_data, double value);
+    bool (*boolean)(void* user_data, bool value);
+    bool (*null)(void* user_data);
+};
+
+// Returns false if the text is not valid JSON or if a callback stopped the parse
+bool json_parse_sax(char* text, const JsonSaxHandler& handler);
+
+#define JSON_WRITER_DEPTH_MAX 32
+
+// Writes JSON straight to a file in the same format as json_write(), without building a tree
+struct JsonWriter {
+    FILE* file;
+    uint32_t depth;
+    bool has_values[JSON_WRITER_DEPTH_MAX];
+};
+
+// The key is ignored for values inside arrays and for the root value
+void json_writer_init(JsonWriter& writer, FILE* file);
+void json_writer_begin_object(JsonWriter& writer, const char* key);
+void json_writer_end_object(JsonWriter& writer);
+void json_writer_begin_array(JsonWriter& writer, const char* key);
+void json_writer_end_array(JsonWriter& writer);
+void json_writer_string(JsonWriter& writer, const char* key, const char* value);
+void json_writer_number(JsonWriter& writer, const char* key, double value);
+void json_writer_boolean(JsonWriter& writer, const char* key, bool value);
+void json_writer_null(JsonWriter& writer, const char* key);
+void json_writer_value(JsonWriter& writer, const char* key, const Json* json);
\ No newline at end of file